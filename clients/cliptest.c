@@ -85,7 +85,9 @@ weston_view_to_global_float(struct weston_view *view,
 }
 
 /* ---------------------- copied begins -----------------------*/
-/* Keep this in sync with what is in gl-renderer.c! */
+/* This is the single-pair equivalent of clip_quads_batch(), which
+ * gl-renderer.c uses. Keep the two in sync!
+ */
 
 #define max(a, b) (((a) > (b)) ? (a) : (b))
 #define min(a, b) (((a) > (b)) ? (b) : (a))
@@ -563,6 +565,82 @@ read_timer(void)
 	       1e-9 * (t.tv_nsec - begin_time.tv_nsec);
 }
 
+/* Clip a grid of surface rects against a grid of clip rects, as
+ * texture_region() in gl-renderer.c does for a fragmented damage region.
+ */
+static int
+benchmark_batch(void)
+{
+	struct weston_view view;
+	struct geometry geom;
+	pixman_box32_t boxes[16], surf_rects[16];
+	struct clip_quad quads[16];
+	float *vertices;
+	unsigned int vtxcnt[16 * 16];
+	int i, j, k;
+	double t;
+	const int N = 20000;
+
+	vertices = xmalloc(16 * 16 * 8 * 2 * sizeof *vertices);
+
+	for (i = 0; i < 16; i++) {
+		boxes[i].x1 = -40 + (i % 4) * 20;
+		boxes[i].y1 = -40 + (i / 4) * 20;
+		boxes[i].x2 = boxes[i].x1 + 20;
+		boxes[i].y2 = boxes[i].y1 + 20;
+
+		surf_rects[i].x1 = -30 + (i % 4) * 15;
+		surf_rects[i].y1 = -30 + (i / 4) * 15;
+		surf_rects[i].x2 = surf_rects[i].x1 + 15;
+		surf_rects[i].y2 = surf_rects[i].y1 + 15;
+	}
+
+	view.transform.enabled = 1;
+	view.geometry = &geom;
+
+	reset_timer();
+	for (i = 0; i < N; i++) {
+		geometry_set_phi(&geom, (float)i / 360.0f);
+		for (j = 0; j < 16; j++) {
+			const float sx[4] = { surf_rects[j].x1, surf_rects[j].x2,
+					      surf_rects[j].x2, surf_rects[j].x1 };
+			const float sy[4] = { surf_rects[j].y1, surf_rects[j].y1,
+					      surf_rects[j].y2, surf_rects[j].y2 };
+
+			for (k = 0; k < 4; k++)
+				weston_view_to_global_float(&view, sx[k], sy[k],
+							    &quads[j].x[k],
+							    &quads[j].y[k]);
+			clip_quad_init(&quads[j]);
+		}
+		clip_quads_batch(boxes, 16, quads, 16, false,
+				 vertices, 2, vtxcnt);
+	}
+	t = read_timer();
+
+	printf("%d batches of 16x16 rects took %g s, average %g us/batch\n",
+	       N, t, t / N * 1e6);
+
+	reset_timer();
+	for (i = 0; i < N; i++) {
+		GLfloat ex[8], ey[8];
+
+		geometry_set_phi(&geom, (float)i / 360.0f);
+		for (j = 0; j < 16; j++)
+			for (k = 0; k < 16; k++)
+				calculate_edges(&view, &boxes[j],
+						&surf_rects[k], ex, ey);
+	}
+	t = read_timer();
+
+	printf("%d loops of 16x16 calculate_edges() took %g s, "
+	       "average %g us/loop\n", N, t, t / N * 1e6);
+
+	free(vertices);
+
+	return 0;
+}
+
 static int
 benchmark(void)
 {
@@ -597,7 +675,7 @@ benchmark(void)
 
 	printf("%d calls took %g s, average %g us/call\n", N, t, t / N * 1e6);
 
-	return 0;
+	return benchmark_batch();
 }
 
 static void
@@ -51,6 +51,7 @@
 #include "shared/os-compatibility.h"
 #include "shared/helpers.h"
 #include "shared/string-helpers.h"
+#include "shared/timespec-util.h"
 #include "git-version.h"
 #include <libweston/version.h>
 #include "hubble.h"
@@ -124,6 +125,11 @@ public:
 
 #define MAX_CLONE_HEADS 16
 
+struct wet_config_watch {
+	struct weston_compositor *compositor;
+	struct wl_listener change_listener;
+};
+
 struct wet_head_array {
 	struct weston_head *heads[MAX_CLONE_HEADS];	/**< heads to add */
 	unsigned n;				/**< the number of heads */
@@ -175,6 +181,9 @@ public:
     pid_t autolaunch_pid;
     bool autolaunch_watch;
     bool use_color_manager;
+    struct wet_config_watch config_watch;
+    char *frame_throttle_exempt;	/**< process names, comma separated */
+    struct wl_listener client_created_listener;
 };
 
 //===================
@@ -797,6 +806,7 @@ usage(int error_code)
 		"  --tty=TTY\t\tThe tty to use\n"
 		"  --device=DEVICE\tThe framebuffer device to use\n"
 		"  --seat=SEAT\t\tThe seat that weston should run on, instead of the seat defined in XDG_SEAT\n"
+		"  --vsync\t\tWait for the vertical blank after each frame\n"
 		"\n");
 #endif
 
@@ -900,6 +910,7 @@ static const struct {
 	{ WESTON_CAP_VIEW_CLIP_MASK, "view mask clipping" },
 	{ WESTON_CAP_EXPLICIT_SYNC, "explicit sync" },
 	{ WESTON_CAP_COLOR_OPS, "color operations" },
+	{ WESTON_CAP_COLOR_3DLUT, "3D LUT color mapping" },
 };
 
 static void
@@ -1197,6 +1208,83 @@ out:
 	return ret;
 }
 
+static bool
+name_in_list(const char *name, const char *list)
+{
+	size_t len = strlen(name);
+	const char *p = list;
+
+	while (p && *p) {
+		if (strncmp(p, name, len) == 0 &&
+		    (p[len] == ',' || p[len] == '\0'))
+			return true;
+		p = strchr(p, ',');
+		if (p)
+			p++;
+	}
+
+	return false;
+}
+
+static void
+wet_client_created(struct wl_listener *listener, void *data)
+{
+	hb::Compositor *wet =
+		container_of(listener, hb::Compositor, client_created_listener);
+	struct wl_client *client = static_cast<struct wl_client*>(data);
+	char path[64];
+	char comm[32] = "";
+	pid_t pid;
+	FILE *fp;
+
+	wl_client_get_credentials(client, &pid, NULL, NULL);
+	snprintf(path, sizeof path, "/proc/%d/comm", (int)pid);
+	fp = fopen(path, "r");
+	if (!fp)
+		return;
+	if (fgets(comm, sizeof comm, fp))
+		comm[strcspn(comm, "\n")] = '\0';
+	fclose(fp);
+
+	if (comm[0] && name_in_list(comm, wet->frame_throttle_exempt)) {
+		weston_log("Not throttling occluded surfaces of %s (pid %d)\n",
+			   comm, (int)pid);
+		weston_client_set_frame_throttle(client, false);
+	}
+}
+
+/* [core] memory limits, in MiB */
+static void
+wet_set_memory_limits(struct weston_compositor *ec,
+		      struct weston_config_section *s)
+{
+	uint32_t client_mib, pressure_mib;
+
+	weston_config_section_get_uint(s, "client-memory-limit",
+				       &client_mib, 0);
+	weston_config_section_get_uint(s, "memory-pressure-limit",
+				       &pressure_mib, 0);
+	weston_compositor_set_memory_limits(ec,
+					    (uint64_t)client_mib << 20,
+					    (uint64_t)pressure_mib << 20);
+}
+
+static void
+wet_set_clipboard_policy(struct weston_compositor *ec,
+			 struct weston_config_section *s)
+{
+	uint32_t size_mib;
+	char *mime_types;
+
+	weston_config_section_get_uint(s, "clipboard-size-limit",
+				       &size_mib, 64);
+	weston_config_section_get_string(s, "clipboard-mime-types",
+					 &mime_types, NULL);
+	weston_compositor_set_clipboard_policy(ec, (uint64_t)size_mib << 20,
+					       mime_types);
+	free(mime_types);
+}
+
 static int
 weston_compositor_init_config(struct weston_compositor *ec,
 			      struct weston_config *config)
@@ -1205,6 +1293,10 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	struct xkb_rule_names xkb_names;
 	struct weston_config_section *s;
 	int repaint_msec;
+	uint32_t occluded_rate;
+	uint32_t commit_budget;
+	bool gl_shader_cache;
+	char *gl_shader_precompile;
 	bool color_management;
 	bool cal;
 
@@ -1245,6 +1337,33 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	weston_log("Output repaint window is %d ms maximum.\n",
 		   ec->repaint_msec);
 
+	weston_config_section_get_uint(s, "occluded-frame-rate",
+				       &occluded_rate, 0);
+	weston_compositor_set_occluded_frame_rate(ec, occluded_rate);
+
+	wet_set_memory_limits(ec, s);
+	wet_set_clipboard_policy(ec, s);
+
+	weston_config_section_get_uint(s, "commit-budget", &commit_budget, 0);
+	weston_compositor_set_commit_budget(ec, commit_budget);
+
+	weston_config_section_get_string(s, "frame-throttle-exempt",
+					 &compositor->frame_throttle_exempt,
+					 NULL);
+	if (compositor->frame_throttle_exempt) {
+		compositor->client_created_listener.notify = wet_client_created;
+		wl_display_add_client_created_listener(ec->wl_display,
+					&compositor->client_created_listener);
+	}
+
+	weston_config_section_get_bool(s, "gl-shader-cache",
+				       &gl_shader_cache, true);
+	weston_config_section_get_string(s, "gl-shader-precompile",
+					 &gl_shader_precompile, NULL);
+	weston_compositor_set_gl_shader_cache(ec, gl_shader_cache,
+					      gl_shader_precompile);
+	free(gl_shader_precompile);
+
 	weston_config_section_get_bool(s, "color-management",
 				       &color_management, false);
 	if (color_management) {
@@ -1411,6 +1530,107 @@ wet_output_set_transform(struct weston_output *output,
 	return 0;
 }
 
+static const char *
+config_change_type_to_string(enum weston_config_change_type type)
+{
+	switch (type) {
+	case WESTON_CONFIG_SECTION_ADDED:
+		return "added";
+	case WESTON_CONFIG_SECTION_CHANGED:
+		return "changed";
+	case WESTON_CONFIG_SECTION_REMOVED:
+		return "removed";
+	}
+
+	return "<unknown>";
+}
+
+static void
+wet_config_section_changed(struct wl_listener *listener, void *data)
+{
+	struct wet_config_watch *watch =
+		container_of(listener, struct wet_config_watch,
+			     change_listener);
+	struct weston_config_section_change *change =
+		static_cast<struct weston_config_section_change*>(data);
+	struct weston_compositor *ec = watch->compositor;
+	struct wet_output_config *parsed_options;
+	struct weston_output *output;
+	int32_t repeat_rate, repeat_delay;
+	uint32_t occluded_rate, commit_budget;
+	char *name = NULL;
+
+	weston_log("Config section [%s] %s\n", change->name,
+		   config_change_type_to_string(change->type));
+
+	if (change->type == WESTON_CONFIG_SECTION_REMOVED)
+		return;
+
+	if (strcmp(change->name, "keyboard") == 0) {
+		weston_config_section_get_int(change->section, "repeat-rate",
+					      &repeat_rate, 40);
+		weston_config_section_get_int(change->section, "repeat-delay",
+					      &repeat_delay, 400);
+		weston_compositor_set_kb_repeat_info(ec, repeat_rate,
+						     repeat_delay);
+	} else if (strcmp(change->name, "core") == 0) {
+		weston_config_section_get_uint(change->section,
+					       "occluded-frame-rate",
+					       &occluded_rate, 0);
+		weston_compositor_set_occluded_frame_rate(ec, occluded_rate);
+		wet_set_memory_limits(ec, change->section);
+		wet_set_clipboard_policy(ec, change->section);
+		weston_config_section_get_uint(change->section,
+					       "commit-budget",
+					       &commit_budget, 0);
+		weston_compositor_set_commit_budget(ec, commit_budget);
+	} else if (strcmp(change->name, "output") == 0) {
+		weston_config_section_get_string(change->section, "name",
+						 &name, NULL);
+		if (!name)
+			return;
+
+		/* Like at startup: a removed key means normal, and a
+		 * transform given on the command line still wins. */
+		parsed_options = to_wet_compositor(ec)->parsed_options;
+		wl_list_for_each(output, &ec->output_list, link) {
+			if (strcmp(output->name, name) == 0)
+				wet_output_set_transform(output,
+							 change->section,
+							 WL_OUTPUT_TRANSFORM_NORMAL,
+							 parsed_options ?
+							 parsed_options->transform :
+							 UINT32_MAX);
+		}
+		free(name);
+	}
+}
+
+static void
+wet_watch_config(hb::Compositor *wet, struct weston_config *config,
+		 struct wl_event_loop *loop)
+{
+	struct weston_config_section *section;
+	bool watch;
+
+	if (!config)
+		return;
+
+	section = weston_config_get_section(config, "core", NULL, NULL);
+	weston_config_section_get_bool(section, "watch-config", &watch, true);
+	if (!watch)
+		return;
+
+	wet->config_watch.compositor = wet->compositor;
+	wet->config_watch.change_listener.notify = wet_config_section_changed;
+	weston_config_add_change_listener(config,
+					  &wet->config_watch.change_listener);
+
+	if (weston_config_watch(config, loop) < 0)
+		weston_log("Failed to watch config file '%s' for changes.\n",
+			   weston_config_get_full_path(config));
+}
+
 static int
 wet_output_set_color_profile(struct weston_output *output,
 			     struct weston_config_section *section,
@@ -2984,6 +3204,7 @@ load_fbdev_backend(struct weston_compositor *c,
 		{ WESTON_OPTION_INTEGER, "tty", 0, &config.tty },
 		{ WESTON_OPTION_STRING, "device", 0, &config.device },
 		{ WESTON_OPTION_STRING, "seat", 0, &config.seat_id },
+		{ WESTON_OPTION_BOOLEAN, "vsync", 0, &config.use_vsync },
 	};
 
 	parse_options(fbdev_options, ARRAY_LENGTH(fbdev_options), argc, argv);
@@ -3327,6 +3548,139 @@ out:
 	return ret;
 }
 
+/** Startup phases, in the order wet_main() runs them */
+enum wet_startup_phase {
+	WET_STARTUP_CONFIG = 0,
+	WET_STARTUP_COMPOSITOR,
+	WET_STARTUP_BACKEND,
+	WET_STARTUP_OUTPUTS,
+	WET_STARTUP_SOCKET,
+	WET_STARTUP_SHELL,
+	WET_STARTUP_MODULES,
+	WET_STARTUP_XWAYLAND,
+	WET_STARTUP_AUTOLAUNCH,
+	WET_STARTUP_PHASE_COUNT
+};
+
+#define WET_STARTUP_AFTER(phase) (1u << (phase))
+
+/** The phases each startup phase depends on
+ *
+ * Phases that launch clients run as soon as what the clients need is
+ * there, so the clients start up while the compositor does the rest.
+ * Their requests get served once the event loop runs. Xwayland itself
+ * is only spawned on the first X11 connection.
+ */
+static const struct {
+	const char *name;
+	uint32_t after;
+} wet_startup_phases[] = {
+	/* WET_STARTUP_CONFIG */
+	{ "config", 0 },
+	/* WET_STARTUP_COMPOSITOR */
+	{ "compositor", WET_STARTUP_AFTER(WET_STARTUP_CONFIG) },
+	/* WET_STARTUP_BACKEND, includes EGL and GL setup */
+	{ "backend", WET_STARTUP_AFTER(WET_STARTUP_COMPOSITOR) },
+	/* WET_STARTUP_OUTPUTS */
+	{ "outputs", WET_STARTUP_AFTER(WET_STARTUP_BACKEND) },
+	/* WET_STARTUP_SOCKET */
+	{ "socket", WET_STARTUP_AFTER(WET_STARTUP_COMPOSITOR) },
+	/* WET_STARTUP_SHELL, launches the shell client */
+	{ "shell", WET_STARTUP_AFTER(WET_STARTUP_OUTPUTS) |
+		   WET_STARTUP_AFTER(WET_STARTUP_SOCKET) },
+	/* WET_STARTUP_MODULES */
+	{ "modules", WET_STARTUP_AFTER(WET_STARTUP_SHELL) },
+	/* WET_STARTUP_XWAYLAND, needs the shell's Xwayland API */
+	{ "xwayland", WET_STARTUP_AFTER(WET_STARTUP_SHELL) },
+	/* WET_STARTUP_AUTOLAUNCH, inherits DISPLAY and what modules set */
+	{ "autolaunch", WET_STARTUP_AFTER(WET_STARTUP_MODULES) |
+			WET_STARTUP_AFTER(WET_STARTUP_XWAYLAND) },
+};
+static_assert(ARRAY_LENGTH(wet_startup_phases) == WET_STARTUP_PHASE_COUNT,
+	      "wet_startup_phases must describe every wet_startup_phase");
+
+/** Startup progress and timing, logged per phase */
+struct wet_startup {
+	struct timespec begin;
+	struct timespec phase_begin;
+	int phase;			/**< running phase, -1 if none */
+	uint32_t done;			/**< WET_STARTUP_AFTER() mask */
+	struct weston_output *first_output;
+	struct wl_listener first_frame_listener;
+};
+
+static double
+wet_startup_msec_since(const struct timespec *since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_sub_to_nsec(&now, since) / 1e6;
+}
+
+static void
+wet_startup_init(struct wet_startup *startup)
+{
+	clock_gettime(CLOCK_MONOTONIC, &startup->begin);
+	startup->phase = -1;
+	startup->done = 0;
+	startup->first_output = NULL;
+}
+
+static void
+wet_startup_begin(struct wet_startup *startup, enum wet_startup_phase phase)
+{
+	/* Running a phase before what it depends on is a bug */
+	assert(startup->phase < 0);
+	assert((wet_startup_phases[phase].after & ~startup->done) == 0);
+
+	startup->phase = phase;
+	clock_gettime(CLOCK_MONOTONIC, &startup->phase_begin);
+}
+
+static void
+wet_startup_end(struct wet_startup *startup)
+{
+	assert(startup->phase >= 0);
+
+	weston_log("Startup: %s took %.1f ms\n",
+		   wet_startup_phases[startup->phase].name,
+		   wet_startup_msec_since(&startup->phase_begin));
+
+	startup->done |= WET_STARTUP_AFTER(startup->phase);
+	startup->phase = -1;
+}
+
+static void
+wet_startup_first_frame(struct wl_listener *listener, void *data)
+{
+	struct wet_startup *startup =
+		container_of(listener, struct wet_startup,
+			     first_frame_listener);
+
+	weston_log("Startup: first frame on %s after %.1f ms\n",
+		   startup->first_output->name,
+		   wet_startup_msec_since(&startup->begin));
+
+	wl_list_remove(&listener->link);
+	startup->first_output = NULL;
+}
+
+/* Time to first frame, as seen on the first output */
+static void
+wet_startup_watch_first_frame(struct wet_startup *startup,
+			      struct weston_compositor *ec)
+{
+	if (wl_list_empty(&ec->output_list))
+		return;
+
+	startup->first_output = container_of(ec->output_list.next,
+					     struct weston_output, link);
+	startup->first_frame_listener.notify = wet_startup_first_frame;
+	wl_signal_add(&startup->first_output->frame_signal,
+		      &startup->first_frame_listener);
+}
+
 static void
 weston_log_setup_scopes(struct weston_log_context *log_ctx,
 			struct weston_log_subscriber *subscriber,
@@ -3413,6 +3767,10 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 
     // Construct Compositor.
     wet.init_failed = false;
+    wet.frame_throttle_exempt = NULL;
+
+	struct wet_startup startup;
+	wet_startup_init(&startup);
 
 	bool wait_for_debugger = false;
 	struct wl_protocol_logger *protologger = NULL;
@@ -3520,6 +3878,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	sigaddset(&mask, SIGUSR1);
 	pthread_sigmask(SIG_BLOCK, &mask, NULL);
 
+	wet_startup_begin(&startup, WET_STARTUP_CONFIG);
 	if (load_configuration(&config, noconfig, config_file) < 0)
 		goto out_signals;
 	wet.config = config;
@@ -3544,7 +3903,9 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 		if (!backend)
 			backend = weston_choose_default_backend();
 	}
+	wet_startup_end(&startup);
 
+	wet_startup_begin(&startup, WET_STARTUP_COMPOSITOR);
 	wet.compositor = weston_compositor_create(display, log_ctx, &wet, test_data);
 	if (wet.compositor == NULL) {
 		weston_log("fatal: failed to create compositor\n");
@@ -3578,12 +3939,15 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 
     weston_config_section_get_bool(section, "require-input",
         &wet.compositor->require_input, true);
+	wet_startup_end(&startup);
 
     fprintf(stderr, "   - MIDDLE wet_main() 4 OK...\n");
+	wet_startup_begin(&startup, WET_STARTUP_BACKEND);
     if (load_backend(wet.compositor, backend, &argc, argv, config) < 0) {
         weston_log("fatal: failed to create compositor backend\n");
         goto out;
     }
+	wet_startup_end(&startup);
 
     fprintf(stderr, "   - MIDDLE wet_main() 5 OK...\n");
     if (test_data && !check_compositor_capabilities(wet.compositor,
@@ -3592,11 +3956,14 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
         goto out;
     }
 
+	wet_startup_begin(&startup, WET_STARTUP_OUTPUTS);
     weston_compositor_flush_heads_changed(wet.compositor);
     if (wet.init_failed) {
         fprintf(stderr, "   - MIDDLE wet.init_failed is true.\n");
         goto out;
     }
+	wet_startup_watch_first_frame(&startup, wet.compositor);
+	wet_startup_end(&startup);
 
     if (idle_time < 0) {
         weston_config_section_get_int(section, "idle-time", &idle_time, -1);
@@ -3611,6 +3978,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 
 	weston_compositor_log_capabilities(wet.compositor);
 
+	wet_startup_begin(&startup, WET_STARTUP_SOCKET);
 	server_socket = getenv("WAYLAND_SERVER_SOCKET");
 	if (server_socket) {
 		weston_log("Running with single client\n");
@@ -3634,29 +4002,40 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	} else if (weston_create_listening_socket(display, socket_name)) {
 		goto out;
 	}
+	wet_startup_end(&startup);
 
 	if (!shell)
 		weston_config_section_get_string(section, "shell", &shell,
 						 "desktop-shell.so");
 
+	wet_startup_begin(&startup, WET_STARTUP_SHELL);
 	if (wet_load_shell(wet.compositor, shell, &argc, argv) < 0)
 		goto out;
+	wet_startup_end(&startup);
 
+	wet_startup_begin(&startup, WET_STARTUP_MODULES);
 	weston_config_section_get_string(section, "modules", &modules, "");
 	if (load_modules(wet.compositor, modules, &argc, argv, &xwayland) < 0)
 		goto out;
 
 	if (load_modules(wet.compositor, option_modules, &argc, argv, &xwayland) < 0)
 		goto out;
+	wet_startup_end(&startup);
 
 	if (!xwayland) {
 		weston_config_section_get_bool(section, "xwayland", &xwayland,
 					       false);
 	}
-	if (xwayland) {
-		if (wet_load_xwayland(wet.compositor) < 0)
-			goto out;
-	}
+	wet_startup_begin(&startup, WET_STARTUP_XWAYLAND);
+	if (xwayland && wet_load_xwayland(wet.compositor) < 0)
+		goto out;
+	wet_startup_end(&startup);
+
+	/* The client starts up while the event loop gets going */
+	wet_startup_begin(&startup, WET_STARTUP_AUTOLAUNCH);
+	if (execute_autolaunch(&wet, config) < 0)
+		goto out;
+	wet_startup_end(&startup);
 
 	section = weston_config_get_section(config, "keyboard", NULL, NULL);
 	weston_config_section_get_bool(section, "numlock-on", &numlock_on, false);
@@ -3679,8 +4058,10 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 
 	weston_compositor_wake(wet.compositor);
 
-	if (execute_autolaunch(&wet, config) < 0)
-		goto out;
+	wet_watch_config(&wet, config, loop);
+
+	weston_log("Startup: ready after %.1f ms\n",
+		   wet_startup_msec_since(&startup.begin));
 
     fprintf(stderr, "   - MIDDLE wet_main() - wl_display_run()...\n");
     wl_display_run(display);
@@ -3694,10 +4075,12 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	ret = wet.compositor->exit_code;
 
 out:
+	weston_config_unwatch(config);
 	wet_compositor_destroy_layout(&wet);
 
 	/* free(NULL) is valid, and it won't be NULL if it's used */
 	free(wet.parsed_options);
+	free(wet.frame_throttle_exempt);
 
 	if (protologger)
 		wl_protocol_logger_destroy(protologger);
@@ -68,6 +68,14 @@ struct text_input_manager {
 	struct text_input *current_text_input;
 
 	struct weston_compositor *ec;
+
+	/* Input panel state as last signalled to the shell. Requests only
+	 * schedule a sync, so that the shell sees the net change once per
+	 * dispatch rather than every intermediate step. */
+	struct wl_event_source *panel_idle;
+	bool panel_shown;
+	struct weston_surface *panel_surface;
+	pixman_box32_t panel_rectangle;
 };
 
 struct input_method {
@@ -123,11 +131,62 @@ input_method_context_end_keyboard_grab(struct input_method_context *context);
 static void
 input_method_init_seat(struct weston_seat *seat);
 
+static int
+text_input_manager_sync_panel(void *data)
+{
+	struct text_input_manager *manager = data;
+	struct weston_compositor *ec = manager->ec;
+	struct text_input *current = manager->current_text_input;
+	bool visible;
+
+	manager->panel_idle = NULL;
+
+	visible = current && current->input_panel_visible &&
+		  !wl_list_empty(&current->input_methods);
+
+	if (!visible) {
+		if (manager->panel_shown)
+			wl_signal_emit(&ec->hide_input_panel_signal, ec);
+		manager->panel_shown = false;
+		manager->panel_surface = NULL;
+		return 0;
+	}
+
+	/* The surface first, overlay panels are placed relative to it */
+	if (!manager->panel_shown || manager->panel_surface != current->surface) {
+		manager->panel_shown = true;
+		manager->panel_surface = current->surface;
+		wl_signal_emit(&ec->show_input_panel_signal, current->surface);
+	}
+
+	if (memcmp(&manager->panel_rectangle, &current->cursor_rectangle,
+		   sizeof manager->panel_rectangle) != 0) {
+		manager->panel_rectangle = current->cursor_rectangle;
+		wl_signal_emit(&ec->update_input_panel_signal,
+			       &current->cursor_rectangle);
+	}
+
+	return 0;
+}
+
+static void
+text_input_manager_schedule_panel_sync(struct text_input_manager *manager)
+{
+	struct wl_event_loop *loop;
+
+	if (manager->panel_idle)
+		return;
+
+	loop = wl_display_get_event_loop(manager->ec->wl_display);
+	manager->panel_idle =
+		wl_event_loop_add_idle(loop, text_input_manager_sync_panel,
+				       manager);
+}
+
 static void
 deactivate_input_method(struct input_method *input_method)
 {
 	struct text_input *text_input = input_method->input;
-	struct weston_compositor *ec = text_input->ec;
 
 	if (input_method->context && input_method->input_method_binding) {
 		input_method_context_end_keyboard_grab(input_method->context);
@@ -143,14 +202,14 @@ deactivate_input_method(struct input_method *input_method)
 
 	if (wl_list_empty(&text_input->input_methods) &&
 	    text_input->input_panel_visible &&
-	    text_input->manager->current_text_input == text_input) {
-		wl_signal_emit(&ec->hide_input_panel_signal, ec);
+	    text_input->manager->current_text_input == text_input)
 		text_input->input_panel_visible = false;
-	}
 
 	if (text_input->manager->current_text_input == text_input)
 		text_input->manager->current_text_input = NULL;
 
+	text_input_manager_schedule_panel_sync(text_input->manager);
+
 	zwp_text_input_v1_send_leave(text_input->resource);
 }
 
@@ -164,6 +223,11 @@ destroy_text_input(struct wl_resource *resource)
 			      &text_input->input_methods, link)
 		deactivate_input_method(input_method);
 
+	if (text_input->manager->current_text_input == text_input) {
+		text_input->manager->current_text_input = NULL;
+		text_input_manager_schedule_panel_sync(text_input->manager);
+	}
+
 	free(text_input);
 }
 
@@ -195,7 +259,6 @@ text_input_activate(struct wl_client *client,
 	struct text_input *text_input = wl_resource_get_user_data(resource);
 	struct weston_seat *weston_seat = wl_resource_get_user_data(seat);
 	struct input_method *input_method;
-	struct weston_compositor *ec = text_input->ec;
 	struct text_input *current;
 
 	if (!weston_seat)
@@ -218,18 +281,11 @@ text_input_activate(struct wl_client *client,
 
 	current = text_input->manager->current_text_input;
 
-	if (current && current != text_input) {
+	if (current && current != text_input)
 		current->input_panel_visible = false;
-		wl_signal_emit(&ec->hide_input_panel_signal, ec);
-	}
 
-	if (text_input->input_panel_visible) {
-		wl_signal_emit(&ec->show_input_panel_signal,
-			       text_input->surface);
-		wl_signal_emit(&ec->update_input_panel_signal,
-			       &text_input->cursor_rectangle);
-	}
 	text_input->manager->current_text_input = text_input;
+	text_input_manager_schedule_panel_sync(text_input->manager);
 
 	zwp_text_input_v1_send_enter(text_input->resource,
 				     text_input->surface->resource);
@@ -271,15 +327,14 @@ text_input_set_cursor_rectangle(struct wl_client *client,
 				int32_t height)
 {
 	struct text_input *text_input = wl_resource_get_user_data(resource);
-	struct weston_compositor *ec = text_input->ec;
 
 	text_input->cursor_rectangle.x1 = x;
 	text_input->cursor_rectangle.y1 = y;
 	text_input->cursor_rectangle.x2 = x + width;
 	text_input->cursor_rectangle.y2 = y + height;
 
-	wl_signal_emit(&ec->update_input_panel_signal,
-		       &text_input->cursor_rectangle);
+	if (text_input == text_input->manager->current_text_input)
+		text_input_manager_schedule_panel_sync(text_input->manager);
 }
 
 static void
@@ -340,17 +395,11 @@ text_input_show_input_panel(struct wl_client *client,
 			    struct wl_resource *resource)
 {
 	struct text_input *text_input = wl_resource_get_user_data(resource);
-	struct weston_compositor *ec = text_input->ec;
 
 	text_input->input_panel_visible = true;
 
-	if (!wl_list_empty(&text_input->input_methods) &&
-	    text_input == text_input->manager->current_text_input) {
-		wl_signal_emit(&ec->show_input_panel_signal,
-			       text_input->surface);
-		wl_signal_emit(&ec->update_input_panel_signal,
-			       &text_input->cursor_rectangle);
-	}
+	if (text_input == text_input->manager->current_text_input)
+		text_input_manager_schedule_panel_sync(text_input->manager);
 }
 
 static void
@@ -358,13 +407,11 @@ text_input_hide_input_panel(struct wl_client *client,
 			    struct wl_resource *resource)
 {
 	struct text_input *text_input = wl_resource_get_user_data(resource);
-	struct weston_compositor *ec = text_input->ec;
 
 	text_input->input_panel_visible = false;
 
-	if (!wl_list_empty(&text_input->input_methods) &&
-	    text_input == text_input->manager->current_text_input)
-		wl_signal_emit(&ec->hide_input_panel_signal, ec);
+	if (text_input == text_input->manager->current_text_input)
+		text_input_manager_schedule_panel_sync(text_input->manager);
 }
 
 static void
@@ -456,6 +503,9 @@ text_input_manager_notifier_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&text_input_manager->destroy_listener.link);
 	wl_global_destroy(text_input_manager->text_input_manager_global);
 
+	if (text_input_manager->panel_idle)
+		wl_event_source_remove(text_input_manager->panel_idle);
+
 	free(text_input_manager);
 }
 
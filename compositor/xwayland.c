@@ -44,6 +44,7 @@ struct wet_xwayland {
 	struct wl_client *client;
 	int wm_fd;
 	struct weston_process process;
+	struct wl_event_source *prespawn_source;
 };
 
 static int
@@ -179,6 +180,20 @@ xserver_cleanup(struct weston_process *process, int status)
 	wxw->client = NULL;
 }
 
+static int
+prespawn_xserver(void *data)
+{
+	struct wet_xwayland *wxw = data;
+
+	wl_event_source_remove(wxw->prespawn_source);
+	wxw->prespawn_source = NULL;
+
+	weston_log("Prespawning Xwayland before the first X client\n");
+	wxw->api->spawn(wxw->xwayland);
+
+	return 0;
+}
+
 int
 wet_load_xwayland(struct weston_compositor *comp)
 {
@@ -186,6 +201,8 @@ wet_load_xwayland(struct weston_compositor *comp)
 	struct weston_xwayland *xwayland;
 	struct wet_xwayland *wxw;
 	struct wl_event_loop *loop;
+	struct weston_config_section *section;
+	int prespawn_delay;
 
 	if (weston_compositor_load_xwayland(comp) < 0)
 		return -1;
@@ -217,5 +234,20 @@ wet_load_xwayland(struct weston_compositor *comp)
 	wxw->sigusr1_source = wl_event_loop_add_signal(loop, SIGUSR1,
 						       handle_sigusr1, wxw);
 
+	/* Xwayland normally starts on the first X connection; optionally
+	 * start it once the desktop had time to settle, so that the first
+	 * X client does not pay for the server startup. */
+	section = weston_config_get_section(wet_get_config(comp),
+					    "xwayland", NULL, NULL);
+	weston_config_section_get_int(section, "prespawn-delay",
+				      &prespawn_delay, 0);
+	if (prespawn_delay > 0) {
+		wxw->prespawn_source =
+			wl_event_loop_add_timer(loop, prespawn_xserver, wxw);
+		if (wxw->prespawn_source)
+			wl_event_source_timer_update(wxw->prespawn_source,
+						     prespawn_delay * 1000);
+	}
+
 	return 0;
 }
@@ -117,17 +117,44 @@ show_input_panel_surface(struct input_panel_surface *ipsurf)
 				 input_panel_slide_done, ipsurf);
 }
 
+/* Overlay panels follow the cursor; move those on screen only when
+ * their place actually changes, the rest waits for their commit. */
+static void
+place_overlay_panels(struct desktop_shell *shell)
+{
+	float x, y;
+
+	for (auto& input_surface: shell->input_panel.surfaces) {
+		if (!input_surface->panel ||
+		    !weston_view_is_mapped(input_surface->view))
+			continue;
+		if (calc_input_panel_position(input_surface, &x, &y))
+			continue;
+		if (input_surface->view->geometry.x == x &&
+		    input_surface->view->geometry.y == y)
+			continue;
+
+		weston_view_set_position(input_surface->view, x, y);
+		weston_view_schedule_repaint(input_surface->view);
+	}
+}
+
 static void
 show_input_panels(struct wl_listener *listener, void *data)
 {
 	struct desktop_shell *shell =
 		container_of(listener, struct desktop_shell,
                  show_input_panel_listener);
+	struct weston_surface *surface = (struct weston_surface*)data;
+	bool surface_changed = shell->text_input.surface != surface;
 
-	shell->text_input.surface = (struct weston_surface*)data;
+	shell->text_input.surface = surface;
 
-	if (shell->showing_input_panels)
+	if (shell->showing_input_panels) {
+		if (surface_changed)
+			place_overlay_panels(shell);
 		return;
+	}
 
 	shell->showing_input_panels = true;
 
@@ -173,7 +200,14 @@ update_input_panels(struct wl_listener *listener, void *data)
 		container_of(listener, struct desktop_shell,
 			     update_input_panel_listener);
 
+	if (memcmp(&shell->text_input.cursor_rectangle, data,
+		   sizeof(pixman_box32_t)) == 0)
+		return;
+
 	memcpy(&shell->text_input.cursor_rectangle, data, sizeof(pixman_box32_t));
+
+	if (shell->showing_input_panels)
+		place_overlay_panels(shell);
 }
 
 static int
@@ -2869,8 +2869,7 @@ static void desktop_surface_removed(
         shsurf->shell->win_close_animation_type == AnimationType::Fade) {
 
         if (shsurf->shell->compositor->state == WESTON_COMPOSITOR_ACTIVE) {
-            pixman_region32_fini(&surface->pending.input);
-            pixman_region32_init(&surface->pending.input);
+            weston_surface_set_pending_input_rect(surface, 0, 0, 0, 0);
             pixman_region32_fini(&surface->input);
             pixman_region32_init(&surface->input);
             weston_fade_run(shsurf->view, 1.0, 0.0, 300.0,
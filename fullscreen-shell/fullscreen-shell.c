@@ -49,6 +49,7 @@ struct fullscreen_shell {
 	struct weston_layer layer;
 	struct wl_list output_list;
 	struct wl_listener output_created_listener;
+	struct wl_listener output_heads_changed_listener;
 
 	struct wl_listener seat_created_listener;
 
@@ -60,6 +61,14 @@ struct fullscreen_shell {
 	struct wl_list default_surface_list; /* struct fs_client_surface::link */
 };
 
+/* Number of refused present_surface_for_mode sizes remembered per output */
+#define FS_MODE_CACHE_SIZE 4
+
+struct fs_mode_match {
+	int32_t width, height;
+	int32_t refresh;
+};
+
 struct fs_output {
 	struct fullscreen_shell *shell;
 	struct wl_list link;
@@ -81,11 +90,18 @@ struct fs_output {
 	struct wl_listener surface_destroyed;
 	struct weston_view *view;
 	struct weston_view *black_view;
+	bool black_view_shown;
 	struct weston_transform transform; /* matrix from x, y */
 
 	int presented_for_mode;
 	enum zwp_fullscreen_shell_v1_present_method method;
 	uint32_t framerate;
+
+	/* Modes the backend refused, so that a client retrying the same
+	 * size does not go through a mode switch attempt every commit. */
+	struct fs_mode_match refused_modes[FS_MODE_CACHE_SIZE];
+	unsigned int refused_mode_count;
+	unsigned int refused_mode_next;
 };
 
 struct pointer_focus_listener {
@@ -226,6 +242,12 @@ black_surface_committed(struct weston_surface *es, int32_t sx, int32_t sy)
 {
 }
 
+static int
+black_surface_get_label(struct weston_surface *surface, char *buf, size_t len)
+{
+	return snprintf(buf, len, "fullscreen black background");
+}
+
 static struct weston_view *
 create_black_surface(struct weston_compositor *ec, struct fs_output *fsout,
 		     float x, float y, int w, int h)
@@ -247,6 +269,7 @@ create_black_surface(struct weston_compositor *ec, struct fs_output *fsout,
 
 	surface->committed = black_surface_committed;
 	surface->committed_private = fsout;
+	weston_surface_set_label_func(surface, black_surface_get_label);
 	weston_surface_set_color(surface, 0.0f, 0.0f, 0.0f, 1.0f);
 	pixman_region32_fini(&surface->opaque);
 	pixman_region32_init_rect(&surface->opaque, 0, 0, w, h);
@@ -289,6 +312,68 @@ output_destroyed(struct wl_listener *listener, void *data)
 	fs_output_destroy(output);
 }
 
+static bool
+fs_output_view_covers_output(struct fs_output *fsout)
+{
+	struct weston_output *output = fsout->output;
+	struct weston_view *view = fsout->view;
+	struct weston_surface *surface;
+	pixman_box32_t box;
+
+	if (!view || view->alpha < 1.0f)
+		return false;
+
+	/* Scaled views never line up with the output exactly */
+	if (!wl_list_empty(&fsout->transform.link))
+		return false;
+
+	surface = view->surface;
+	if (view->geometry.x != output->x || view->geometry.y != output->y ||
+	    surface->width != output->width ||
+	    surface->height != output->height)
+		return false;
+
+	if (surface->is_opaque)
+		return true;
+
+	box.x1 = 0;
+	box.y1 = 0;
+	box.x2 = surface->width;
+	box.y2 = surface->height;
+
+	return pixman_region32_contains_rectangle(&surface->opaque, &box) ==
+		PIXMAN_REGION_IN;
+}
+
+/* The black backdrop only matters where the presented surface leaves the
+ * output uncovered.  Keeping it out of the layer when the client buffer
+ * covers the whole output lets the backend put that buffer straight on
+ * the primary plane instead of compositing it over black.
+ */
+static void
+fs_output_update_black_view(struct fs_output *fsout)
+{
+	struct weston_layer_entry *bottom;
+	bool show = !fs_output_view_covers_output(fsout);
+
+	if (show == fsout->black_view_shown)
+		return;
+
+	if (show) {
+		bottom = container_of(fsout->shell->layer.view_list.link.prev,
+				      struct weston_layer_entry, link);
+		weston_layer_entry_insert(bottom,
+					  &fsout->black_view->layer_link);
+		weston_view_geometry_dirty(fsout->black_view);
+	} else {
+		weston_view_damage_below(fsout->black_view);
+		weston_layer_entry_remove(&fsout->black_view->layer_link);
+	}
+
+	fsout->black_view_shown = show;
+	weston_output_schedule_repaint(fsout->output);
+}
+
 static void
 surface_destroyed(struct wl_listener *listener, void *data)
 {
@@ -299,6 +384,8 @@ surface_destroyed(struct wl_listener *listener, void *data)
 	fsout->view = NULL;
 	wl_list_remove(&fsout->transform.link);
 	wl_list_init(&fsout->transform.link);
+
+	fs_output_update_black_view(fsout);
 }
 
 static void
@@ -340,6 +427,7 @@ fs_output_create(struct fullscreen_shell *shell, struct weston_output *output)
 	fsout->black_view->is_mapped = true;
 	weston_layer_entry_insert(&shell->layer.view_list,
 		       &fsout->black_view->layer_link);
+	fsout->black_view_shown = true;
 	wl_list_init(&fsout->transform.link);
 
 	if (!wl_list_empty(&shell->default_surface_list)) {
@@ -528,6 +616,72 @@ fs_output_configure_simple(struct fs_output *fsout,
 				fsout->output->height);
 }
 
+static bool
+fs_output_mode_refused(struct fs_output *fsout, struct weston_mode *mode)
+{
+	struct fs_mode_match *match;
+	unsigned int i;
+
+	for (i = 0; i < fsout->refused_mode_count; i++) {
+		match = &fsout->refused_modes[i];
+		if (match->width == mode->width &&
+		    match->height == mode->height &&
+		    match->refresh == mode->refresh)
+			return true;
+	}
+
+	return false;
+}
+
+static void
+fs_output_add_refused_mode(struct fs_output *fsout, struct weston_mode *mode)
+{
+	struct fs_mode_match *match;
+
+	match = &fsout->refused_modes[fsout->refused_mode_next];
+	match->width = mode->width;
+	match->height = mode->height;
+	match->refresh = mode->refresh;
+
+	fsout->refused_mode_next =
+		(fsout->refused_mode_next + 1) % FS_MODE_CACHE_SIZE;
+	if (fsout->refused_mode_count < FS_MODE_CACHE_SIZE)
+		fsout->refused_mode_count++;
+}
+
+static void
+fs_output_forget_refused_modes(struct fs_output *fsout)
+{
+	fsout->refused_mode_count = 0;
+	fsout->refused_mode_next = 0;
+}
+
+static int
+fs_output_switch_mode(struct fs_output *fsout, struct weston_mode *mode)
+{
+	struct weston_output *output = fsout->output;
+	struct weston_mode *current = output->current_mode;
+	int ret;
+
+	/* Already there; switching again would only reset the output and
+	 * resend its mode to every client. */
+	if (current && current->width == mode->width &&
+	    current->height == mode->height &&
+	    (mode->refresh == 0 || current->refresh == mode->refresh) &&
+	    output->current_scale == output->native_scale)
+		return 0;
+
+	if (fs_output_mode_refused(fsout, mode))
+		return -1;
+
+	ret = weston_output_mode_switch_to_temporary(output, mode,
+						     output->native_scale);
+	if (ret != 0)
+		fs_output_add_refused_mode(fsout, mode);
+
+	return ret;
+}
+
 static void
 fs_output_configure_for_mode(struct fs_output *fsout,
 			     struct weston_surface *configured_surface)
@@ -572,8 +726,7 @@ fs_output_configure_for_mode(struct fs_output *fsout,
 	mode.flags = 0;
 	mode.refresh = fsout->pending.framerate;
 
-	ret = weston_output_mode_switch_to_temporary(fsout->output, &mode,
-					fsout->output->native_scale);
+	ret = fs_output_switch_mode(fsout, &mode);
 
 	if (ret != 0) {
 		/* The mode switch failed.  Clear the pending and
@@ -619,6 +772,7 @@ fs_output_configure(struct fs_output *fsout,
 			fs_output_configure_simple(fsout, surface);
 	}
 
+	fs_output_update_black_view(fsout);
 	weston_output_schedule_repaint(fsout->output);
 }
 
@@ -731,6 +885,7 @@ fs_output_set_surface(struct fs_output *fsout, struct weston_surface *surface,
 
 		fsout->surface = NULL;
 
+		fs_output_update_black_view(fsout);
 		weston_output_schedule_repaint(fsout->output);
 	}
 }
@@ -860,6 +1015,17 @@ output_created(struct wl_listener *listener, void *data)
 	fs_output_create(shell, data);
 }
 
+/* A monitor plugged in or out may come with other modes, so what the
+ * backend refused before is worth trying again. */
+static void
+output_heads_changed(struct wl_listener *listener, void *data)
+{
+	struct fs_output *fsout = fs_output_for_output(data);
+
+	if (fsout)
+		fs_output_forget_refused_modes(fsout);
+}
+
 static void
 client_destroyed(struct wl_listener *listener, void *data)
 {
@@ -927,6 +1093,10 @@ wet_shell_init(struct weston_compositor *compositor,
 	wl_list_for_each(output, &compositor->output_list, link)
 		fs_output_create(shell, output);
 
+	shell->output_heads_changed_listener.notify = output_heads_changed;
+	wl_signal_add(&compositor->output_heads_changed_signal,
+		      &shell->output_heads_changed_listener);
+
 	shell->seat_created_listener.notify = seat_created;
 	wl_signal_add(&compositor->seat_created_signal,
 		      &shell->seat_created_listener);
@@ -30,11 +30,12 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include <libweston/libweston.h>
 
-#define WESTON_FBDEV_BACKEND_CONFIG_VERSION 2
+#define WESTON_FBDEV_BACKEND_CONFIG_VERSION 3
 
 struct libinput_device;
 
@@ -61,6 +62,14 @@ struct weston_fbdev_backend_config {
 	 * backend destruction.
 	 */
 	char *seat_id;
+
+	/** Wait for the vertical blank with FBIO_WAITFORVSYNC after each
+	 * frame.
+	 *
+	 * This ties frame timing to the display, but blocks the compositor
+	 * until the blank. Drivers without the ioctl fall back to a timer.
+	 */
+	bool use_vsync;
 };
 
 #ifdef  __cplusplus
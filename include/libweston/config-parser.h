@@ -75,6 +75,23 @@ parse_options(const struct weston_option *options,
 
 struct weston_config_section;
 struct weston_config;
+struct wl_event_loop;
+struct wl_listener;
+
+enum weston_config_change_type {
+	WESTON_CONFIG_SECTION_ADDED,
+	WESTON_CONFIG_SECTION_CHANGED,
+	WESTON_CONFIG_SECTION_REMOVED,
+};
+
+/** Data passed to weston_config change listeners */
+struct weston_config_section_change {
+	enum weston_config_change_type type;
+	/** Removed sections stay valid but empty until the config is
+	 * destroyed */
+	struct weston_config_section *section;
+	const char *name;
+};
 
 struct weston_config_section *
 weston_config_get_section(struct weston_config *config, const char *section,
@@ -117,6 +134,19 @@ weston_config_get_full_path(struct weston_config *config);
 void
 weston_config_destroy(struct weston_config *config);
 
+int
+weston_config_reload(struct weston_config *config);
+
+void
+weston_config_add_change_listener(struct weston_config *config,
+				  struct wl_listener *listener);
+
+int
+weston_config_watch(struct weston_config *config, struct wl_event_loop *loop);
+
+void
+weston_config_unwatch(struct weston_config *config);
+
 int weston_config_next_section(struct weston_config *config,
 			       struct weston_config_section **section,
 			       const char **name);
@@ -975,6 +975,18 @@ struct weston_plane {
 
 struct weston_drm_format_array;
 
+/** What accounted memory is used for
+ *
+ * \sa weston_surface_charge_memory, weston_compositor_charge_memory
+ */
+enum weston_memory_kind {
+	WESTON_MEMORY_CLIENT_BUFFER = 0,	/**< buffers clients attached */
+	WESTON_MEMORY_TEXTURE,		/**< renderer copies of contents */
+	WESTON_MEMORY_FRAMEBUFFER,	/**< renderer-private framebuffers */
+	WESTON_MEMORY_SCANOUT,		/**< backend scanout buffers */
+	WESTON_MEMORY_KIND_COUNT
+};
+
 struct weston_renderer {
 	int (*read_pixels)(struct weston_output *output,
 			       pixman_format_code_t format, void *pixels,
@@ -1006,6 +1018,11 @@ struct weston_renderer {
 
 	const struct weston_drm_format_array *
 			(*get_supported_formats)(struct weston_compositor *ec);
+
+	/** Drop what is only kept to speed up repaints and is not used by
+	 * the next one, e.g. for surfaces that are not shown, see
+	 * weston_compositor_set_memory_limits(). Optional. */
+	void (*release_hidden_caches)(struct weston_compositor *ec);
 };
 
 enum weston_capability {
@@ -1029,6 +1046,9 @@ enum weston_capability {
 
 	/* renderer supports color management operations */
 	WESTON_CAP_COLOR_OPS			= 0x0040,
+
+	/* renderer supports 3D LUT color mapping, needed for ICC profiles */
+	WESTON_CAP_COLOR_3DLUT			= 0x0080,
 };
 
 /* Configuration struct for a backend.
@@ -1221,6 +1241,28 @@ struct weston_compositor {
 	struct weston_log_scope *debug_scene;
 	struct weston_log_scope *timeline;
 
+	/* Scratch regions for repaint damage math, see region-arena.h */
+	struct weston_region_arena *region_arena;
+
+	/* Frame callbacks of occluded surfaces, see frame-throttle.h */
+	struct weston_frame_throttle *frame_throttle;
+
+	/* Buffer and texture memory per client, see memory-accounting.h */
+	struct weston_memory_accounting *memory;
+
+	/* Requests per client and commit budget, see dispatch-stats.h */
+	struct weston_dispatch_stats *dispatch_stats;
+
+	/* What the clipboard keeps, see
+	 * weston_compositor_set_clipboard_policy() */
+	uint64_t clipboard_size_limit;
+	char *clipboard_mime_types;
+
+	/* GL renderer program binaries, see
+	 * weston_compositor_set_gl_shader_cache() */
+	bool gl_shader_cache;
+	char *gl_shader_precompile;
+
 	struct content_protection *content_protection;
 };
 
@@ -1237,6 +1279,10 @@ struct weston_buffer {
 	uint32_t busy_count;
 	int y_inverted;
 	void *backend_private;
+
+	/* Charged when first attached, see weston_memory_charge_buffer() */
+	struct weston_memory_owner *memory_owner;
+	uint64_t memory_bytes;
 };
 
 struct weston_buffer_reference {
@@ -1424,9 +1470,13 @@ struct weston_surface_state {
 
 	/* wl_surface.set_opaque_region */
 	pixman_region32_t opaque;
+	/* Bumped whenever opaque is set, equal generations mean equal regions */
+	uint32_t opaque_generation;
 
 	/* wl_surface.set_input_region */
 	pixman_region32_t input;
+	/* Bumped whenever input is set, equal generations mean equal regions */
+	uint32_t input_generation;
 
 	/* wl_surface.frame */
 	struct wl_list frame_callback_list;
@@ -1499,6 +1549,13 @@ struct weston_surface {
 	pixman_region32_t opaque;        /* part of geometry, see below */
 	pixman_region32_t input;
 	int32_t width, height;
+
+	/* What opaque and input were last clipped from in a commit */
+	struct {
+		uint32_t opaque_generation;
+		uint32_t input_generation;
+		int32_t width, height;
+	} committed_regions;
 	int32_t ref_count;
 
 	/* Not for long-term storage.  This exists for book-keeping while
@@ -1577,11 +1634,29 @@ struct weston_surface {
 	/* An list of per seat pointer constraints. */
 	struct wl_list pointer_constraints;
 
+	/* Held back while occluded, see weston_frame_throttle */
+	struct wl_list frame_throttle_link;
+	struct timespec frame_throttle_since;
+
+	/* Memory charged to the surface, see weston_surface_charge_memory() */
+	struct weston_memory_owner *memory_owner;
+	struct wl_list memory_link;	/* weston_memory_owner::surface_list */
+	uint64_t memory_bytes[WESTON_MEMORY_KIND_COUNT];
+
 	/* zwp_surface_synchronization_v1 resource for this surface */
 	struct wl_resource *synchronization_resource;
 	int acquire_fence_fd;
 	struct weston_buffer_release_reference buffer_release_ref;
 
+	/* A commit held back until its acquire fence signals, or until the
+	 * event loop is idle when its client went over its commit budget */
+	struct {
+		struct weston_surface_state state;
+		struct weston_buffer_reference buffer_ref;
+		struct wl_event_source *source;
+		struct wl_event_source *idle;
+	} fence_wait;
+
 	struct weston_dmabuf_feedback *dmabuf_feedback;
 
 	enum weston_hdcp_protection desired_protection;
@@ -1853,6 +1928,16 @@ weston_surface_set_role(struct weston_surface *surface,
 const char *
 weston_surface_get_role(struct weston_surface *surface);
 
+void
+weston_surface_set_pending_opaque_rect(struct weston_surface *surface,
+				       int32_t x, int32_t y,
+				       int32_t width, int32_t height);
+
+void
+weston_surface_set_pending_input_rect(struct weston_surface *surface,
+				      int32_t x, int32_t y,
+				      int32_t width, int32_t height);
+
 void
 weston_surface_set_label_func(struct weston_surface *surface,
 			      int (*desc)(struct weston_surface *,
@@ -1927,6 +2012,31 @@ weston_output_get_destroy_listener(struct weston_output *output,
 int
 weston_compositor_set_xkb_rule_names(struct weston_compositor *ec,
 				     struct xkb_rule_names *names);
+void
+weston_compositor_set_kb_repeat_info(struct weston_compositor *ec,
+				     int32_t rate, int32_t delay);
+void
+weston_compositor_set_occluded_frame_rate(struct weston_compositor *compositor,
+					  uint32_t rate_hz);
+void
+weston_client_set_frame_throttle(struct wl_client *client, bool throttle);
+void
+weston_compositor_set_memory_limits(struct weston_compositor *compositor,
+				    uint64_t client_limit,
+				    uint64_t pressure_limit);
+void
+weston_compositor_charge_memory(struct weston_compositor *compositor,
+				enum weston_memory_kind kind, int64_t delta);
+void
+weston_surface_charge_memory(struct weston_surface *surface,
+			     enum weston_memory_kind kind, int64_t delta);
+void
+weston_compositor_set_commit_budget(struct weston_compositor *compositor,
+				    uint32_t commits);
+void
+weston_compositor_set_clipboard_policy(struct weston_compositor *compositor,
+				       uint64_t size_limit,
+				       const char *mime_types);
 
 /* String literal of spaces, the same width as the timestamp. */
 #define STAMP_SPACE "               "
@@ -2052,6 +2162,10 @@ weston_compositor_load_xwayland(struct weston_compositor *compositor);
 int
 weston_compositor_load_color_manager(struct weston_compositor *compositor);
 
+void
+weston_compositor_set_gl_shader_cache(struct weston_compositor *compositor,
+				      bool enabled, const char *precompile);
+
 bool
 weston_head_is_connected(struct weston_head *head);
 
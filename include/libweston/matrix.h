@@ -31,6 +31,14 @@
 extern "C" {
 #endif
 
+/** Kinds of transformation accumulated in a weston_matrix
+ *
+ * A type of 0 is the identity, translate and scale alone keep the matrix
+ * axis-aligned, and anything without WESTON_MATRIX_TRANSFORM_OTHER is
+ * affine.  The matrix functions take fast paths based on these bits, so
+ * code that fills in weston_matrix::d by hand must set the type to match,
+ * WESTON_MATRIX_TRANSFORM_OTHER when in doubt.
+ */
 enum weston_matrix_transform_type {
 	WESTON_MATRIX_TRANSFORM_TRANSLATE	= (1 << 0),
 	WESTON_MATRIX_TRANSFORM_SCALE		= (1 << 1),
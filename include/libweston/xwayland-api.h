@@ -109,6 +109,19 @@ struct weston_xwayland_api {
 	 */
 	void
 	(*xserver_exited)(struct weston_xwayland *xwayland, int exit_status);
+
+	/** Start the Xwayland server without waiting for an X client.
+	 *
+	 * Spawns the server through the \a spawn_func given to \a listen,
+	 * as if a client had connected. Does nothing if the server is
+	 * already running.
+	 *
+	 * \param xwayland The Xwayland context object.
+	 *
+	 * \return 0 on success, a negative number otherwise.
+	 */
+	int
+	(*spawn)(struct weston_xwayland *xwayland);
 };
 
 /** Retrieve the API object for the libweston Xwayland module.
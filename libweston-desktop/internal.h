@@ -33,6 +33,8 @@ struct weston_compositor *
 weston_desktop_get_compositor(struct weston_desktop *desktop);
 struct wl_display *
 weston_desktop_get_display(struct weston_desktop *desktop);
+struct weston_log_scope *
+weston_desktop_get_configure_scope(struct weston_desktop *desktop);
 
 void
 weston_desktop_api_ping_timeout(struct weston_desktop *desktop,
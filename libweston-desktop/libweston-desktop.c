@@ -29,6 +29,7 @@
 #include <assert.h>
 
 #include <libweston/libweston.h>
+#include <libweston/weston-log.h>
 #include <libweston/zalloc.h>
 #include "shared/helpers.h"
 
@@ -43,6 +44,7 @@ struct weston_desktop {
 	struct wl_global *xdg_wm_base;	 /* Stable protocol xdg_shell replaces xdg_shell_unstable_v6 */
 	struct wl_global *xdg_shell_v6;  /* Unstable xdg_shell_unstable_v6 protocol. */
 	struct wl_global *wl_shell;
+	struct weston_log_scope *configure_scope;
 };
 
 void
@@ -70,6 +72,11 @@ weston_desktop_create(struct weston_compositor *compositor,
 		MIN(sizeof(struct weston_desktop_api), api->struct_size);
 	memcpy(&desktop->api, api, desktop->api.struct_size);
 
+	desktop->configure_scope =
+		weston_compositor_add_log_scope(compositor, "xdg-configure",
+						"Configure round trips of xdg toplevels\n",
+						NULL, NULL, NULL);
+
 	desktop->xdg_wm_base =
 		weston_desktop_xdg_wm_base_create(desktop, display);
 	if (desktop->xdg_wm_base == NULL) {
@@ -113,6 +120,8 @@ weston_desktop_destroy(struct weston_desktop *desktop)
 	if (desktop->xdg_wm_base != NULL)
 		wl_global_destroy(desktop->xdg_wm_base);
 
+	weston_log_scope_destroy(desktop->configure_scope);
+
 	free(desktop);
 }
 
@@ -129,6 +138,12 @@ weston_desktop_get_display(struct weston_desktop *desktop)
 	return desktop->compositor->wl_display;
 }
 
+struct weston_log_scope *
+weston_desktop_get_configure_scope(struct weston_desktop *desktop)
+{
+	return desktop->configure_scope;
+}
+
 void
 weston_desktop_api_ping_timeout(struct weston_desktop *desktop,
 				struct weston_desktop_client *client)
@@ -28,16 +28,19 @@
 
 #include <stdbool.h>
 #include <assert.h>
+#include <time.h>
 
 #include <wayland-server.h>
 
 #include <libweston/libweston.h>
+#include <libweston/weston-log.h>
 #include <libweston/zalloc.h>
 #include "xdg-shell-server-protocol.h"
 
 #include <libweston-desktop/libweston-desktop.h>
 #include "internal.h"
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 
 /************************************************************************************
  * WARNING: This file implements the stable xdg shell protocol.
@@ -78,6 +81,15 @@ struct weston_desktop_xdg_surface {
 	struct wl_event_source *configure_idle;
 	struct wl_list configure_list; /* weston_desktop_xdg_surface_configure::link */
 
+	/* A toplevel has at most one size change in flight: later sizes
+	 * wait, coalesced, until the client acked and committed it. */
+	bool configure_deferred;
+	unsigned int configure_coalesced;
+	bool ack_uncommitted;
+	uint32_t acked_serial;
+	struct timespec acked_send_time;
+	struct timespec ack_time;
+
 	bool has_next_geometry;
 	struct weston_geometry next_geometry;
 
@@ -87,6 +99,7 @@ struct weston_desktop_xdg_surface {
 struct weston_desktop_xdg_surface_configure {
 	struct wl_list link; /* weston_desktop_xdg_surface::configure_list */
 	uint32_t serial;
+	struct timespec send_time;
 };
 
 struct weston_desktop_xdg_toplevel_state {
@@ -1046,6 +1059,7 @@ weston_desktop_xdg_surface_send_configure(void *user_data)
 	wl_list_insert(surface->configure_list.prev, &configure->link);
 	configure->serial =
 		wl_display_next_serial(weston_desktop_get_display(surface->desktop));
+	clock_gettime(CLOCK_MONOTONIC, &configure->send_time);
 
 	switch (surface->role) {
 	case WESTON_DESKTOP_XDG_SURFACE_ROLE_NONE:
@@ -1063,6 +1077,36 @@ weston_desktop_xdg_surface_send_configure(void *user_data)
 	xdg_surface_send_configure(surface->resource, configure->serial);
 }
 
+static void
+weston_desktop_xdg_toplevel_get_configured(struct weston_desktop_xdg_toplevel *toplevel,
+					   struct weston_desktop_xdg_toplevel_state *state,
+					   struct weston_size *size)
+{
+	if (wl_list_empty(&toplevel->base.configure_list)) {
+		/* Last configure is actually the current state, just use it */
+		*state = toplevel->current.state;
+		size->width = toplevel->base.surface->width;
+		size->height = toplevel->base.surface->height;
+	} else {
+		struct weston_desktop_xdg_toplevel_configure *configure =
+			wl_container_of(toplevel->base.configure_list.prev,
+					configure, base.link);
+
+		*state = configure->state;
+		*size = configure->size;
+	}
+}
+
+static bool
+weston_desktop_xdg_toplevel_state_equal(const struct weston_desktop_xdg_toplevel_state *a,
+					const struct weston_desktop_xdg_toplevel_state *b)
+{
+	return a->activated == b->activated &&
+	       a->fullscreen == b->fullscreen &&
+	       a->maximized == b->maximized &&
+	       a->resizing == b->resizing;
+}
+
 static bool
 weston_desktop_xdg_toplevel_state_compare(struct weston_desktop_xdg_toplevel *toplevel)
 {
@@ -1074,27 +1118,11 @@ weston_desktop_xdg_toplevel_state_compare(struct weston_desktop_xdg_toplevel *to
 	if (!toplevel->base.configured)
 		return false;
 
-	if (wl_list_empty(&toplevel->base.configure_list)) {
-		/* Last configure is actually the current state, just use it */
-		configured.state = toplevel->current.state;
-		configured.size.width = toplevel->base.surface->width;
-		configured.size.height = toplevel->base.surface->height;
-	} else {
-		struct weston_desktop_xdg_toplevel_configure *configure =
-			wl_container_of(toplevel->base.configure_list.prev,
-					configure, base.link);
+	weston_desktop_xdg_toplevel_get_configured(toplevel, &configured.state,
+						   &configured.size);
 
-		configured.state = configure->state;
-		configured.size = configure->size;
-	}
-
-	if (toplevel->pending.state.activated != configured.state.activated)
-		return false;
-	if (toplevel->pending.state.fullscreen != configured.state.fullscreen)
-		return false;
-	if (toplevel->pending.state.maximized != configured.state.maximized)
-		return false;
-	if (toplevel->pending.state.resizing != configured.state.resizing)
+	if (!weston_desktop_xdg_toplevel_state_equal(&toplevel->pending.state,
+						     &configured.state))
 		return false;
 
 	if (toplevel->pending.size.width == configured.size.width &&
@@ -1108,6 +1136,25 @@ weston_desktop_xdg_toplevel_state_compare(struct weston_desktop_xdg_toplevel *to
 	return false;
 }
 
+/* Whether the pending change is only a new size, and the client has not
+ * caught up with the last configure yet. Such a change can wait: the
+ * client would only draw a size that is already stale. */
+static bool
+weston_desktop_xdg_toplevel_defer_configure(struct weston_desktop_xdg_toplevel *toplevel)
+{
+	struct weston_desktop_xdg_toplevel_state state;
+	struct weston_size size;
+
+	if (wl_list_empty(&toplevel->base.configure_list) &&
+	    !toplevel->base.ack_uncommitted)
+		return false;
+
+	weston_desktop_xdg_toplevel_get_configured(toplevel, &state, &size);
+
+	return weston_desktop_xdg_toplevel_state_equal(&toplevel->pending.state,
+						       &state);
+}
+
 static void
 weston_desktop_xdg_surface_schedule_configure(struct weston_desktop_xdg_surface *surface)
 {
@@ -1121,6 +1168,13 @@ weston_desktop_xdg_surface_schedule_configure(struct weston_desktop_xdg_surface
 		break;
 	case WESTON_DESKTOP_XDG_SURFACE_ROLE_TOPLEVEL:
 		pending_same = weston_desktop_xdg_toplevel_state_compare((struct weston_desktop_xdg_toplevel *) surface);
+		surface->configure_deferred = false;
+		if (!pending_same && surface->configure_idle == NULL &&
+		    weston_desktop_xdg_toplevel_defer_configure((struct weston_desktop_xdg_toplevel *) surface)) {
+			surface->configure_deferred = true;
+			surface->configure_coalesced++;
+			return;
+		}
 		break;
 	case WESTON_DESKTOP_XDG_SURFACE_ROLE_POPUP:
 		break;
@@ -1315,6 +1369,10 @@ weston_desktop_xdg_surface_protocol_ack_configure(struct wl_client *wl_client,
 	}
 
 	surface->configured = true;
+	surface->ack_uncommitted = true;
+	surface->acked_serial = serial;
+	surface->acked_send_time = configure->send_time;
+	clock_gettime(CLOCK_MONOTONIC, &surface->ack_time);
 
 	switch (surface->role) {
 	case WESTON_DESKTOP_XDG_SURFACE_ROLE_NONE:
@@ -1342,6 +1400,37 @@ weston_desktop_xdg_surface_ping(struct weston_desktop_surface *dsurface,
 			      serial);
 }
 
+static void
+weston_desktop_xdg_surface_log_round_trip(struct weston_desktop_xdg_surface *surface)
+{
+	struct weston_log_scope *scope =
+		weston_desktop_get_configure_scope(surface->desktop);
+	struct weston_desktop_client *client;
+	struct timespec now;
+	pid_t pid;
+
+	if (!weston_log_scope_is_enabled(scope))
+		return;
+
+	client = weston_desktop_surface_get_client(surface->desktop_surface);
+	wl_client_get_credentials(weston_desktop_client_get_client(client),
+				  &pid, NULL, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	weston_log_scope_printf(scope,
+				"pid %d surface %u: configure %u acked after "
+				"%.1f ms, committed after %.1f ms, %u sizes "
+				"coalesced\n",
+				pid, surface->surface->resource ?
+				wl_resource_get_id(surface->surface->resource) : 0,
+				surface->acked_serial,
+				timespec_sub_to_nsec(&surface->ack_time,
+						     &surface->acked_send_time) / 1e6,
+				timespec_sub_to_nsec(&now,
+						     &surface->acked_send_time) / 1e6,
+				surface->configure_coalesced);
+}
+
 static void
 weston_desktop_xdg_surface_committed(struct weston_desktop_surface *dsurface,
 				     void *user_data,
@@ -1377,6 +1466,18 @@ weston_desktop_xdg_surface_committed(struct weston_desktop_surface *dsurface,
 		weston_desktop_xdg_popup_committed((struct weston_desktop_xdg_popup *) surface);
 		break;
 	}
+
+	if (!surface->ack_uncommitted)
+		return;
+
+	/* The client drew what it acked; it is ready for the latest size,
+	 * so resizing goes at the rate the client can keep up with. */
+	weston_desktop_xdg_surface_log_round_trip(surface);
+	surface->ack_uncommitted = false;
+	surface->configure_coalesced = 0;
+	if (surface->configure_deferred &&
+	    wl_list_empty(&surface->configure_list))
+		weston_desktop_xdg_surface_schedule_configure(surface);
 }
 
 static void
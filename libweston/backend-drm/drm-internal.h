@@ -351,6 +351,10 @@ struct drm_fb {
 
 	/* Used by dumb fbs */
 	void *map;
+
+	/* Compositor-allocated fbs are charged as scanout memory */
+	struct weston_compositor *compositor;
+	uint64_t charged_bytes;
 };
 
 struct drm_buffer_fb {
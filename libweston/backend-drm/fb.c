@@ -46,6 +46,10 @@
 static void
 drm_fb_destroy(struct drm_fb *fb)
 {
+	if (fb->compositor)
+		weston_compositor_charge_memory(fb->compositor,
+						WESTON_MEMORY_SCANOUT,
+						-(int64_t)fb->charged_bytes);
 	if (fb->fb_id != 0)
 		drmModeRmFB(fb->fd, fb->fb_id);
 	free(fb);
@@ -68,6 +72,15 @@ drm_fb_destroy_dumb(struct drm_fb *fb)
 	drm_fb_destroy(fb);
 }
 
+static void
+drm_fb_charge(struct drm_backend *b, struct drm_fb *fb, uint64_t bytes)
+{
+	fb->compositor = b->compositor;
+	fb->charged_bytes = bytes;
+	weston_compositor_charge_memory(b->compositor, WESTON_MEMORY_SCANOUT,
+					bytes);
+}
+
 static int
 drm_fb_addfb(struct drm_backend *b, struct drm_fb *fb)
 {
@@ -175,6 +188,8 @@ drm_fb_create_dumb(struct drm_backend *b, int width, int height,
 	if (fb->map == MAP_FAILED)
 		goto err_add_fb;
 
+	drm_fb_charge(b, fb, fb->size);
+
 	return fb;
 
 err_add_fb:
@@ -300,7 +315,8 @@ drm_fb_get_from_dmabuf(struct linux_dmabuf_buffer *dmabuf,
 		goto err_free;
 	}
 
-	if (is_opaque)
+	if (is_opaque && (pixel_format_get_caps(fb->format) &
+			  PIXEL_FORMAT_CAP_HAS_OPAQUE_SUBSTITUTE))
 		fb->format = pixel_format_get_opaque_substitute(fb->format);
 
 	if (backend->min_width > fb->width ||
@@ -387,7 +403,8 @@ drm_fb_get_from_bo(struct gbm_bo *bo, struct drm_backend *backend,
 
 	/* We can scanout an ARGB buffer if the surface's opaque region covers
 	 * the whole output, but we have to use XRGB as the KMS format code. */
-	if (is_opaque)
+	if (is_opaque && (pixel_format_get_caps(fb->format) &
+			  PIXEL_FORMAT_CAP_HAS_OPAQUE_SUBSTITUTE))
 		fb->format = pixel_format_get_opaque_substitute(fb->format);
 
 	if (backend->min_width > fb->width ||
@@ -407,6 +424,11 @@ drm_fb_get_from_bo(struct gbm_bo *bo, struct drm_backend *backend,
 
 	gbm_bo_set_user_data(bo, fb, drm_fb_destroy_gbm);
 
+	/* Client buffers are already charged to their clients */
+	if (type == BUFFER_GBM_SURFACE || type == BUFFER_CURSOR)
+		drm_fb_charge(backend, fb,
+			      (uint64_t)gbm_bo_get_stride(bo) * fb->height);
+
 	return fb;
 
 err_free:
@@ -61,6 +61,7 @@ struct fbdev_backend {
 	struct udev_input input;
 	uint32_t output_transform;
 	struct wl_listener session_listener;
+	bool use_vsync;
 };
 
 struct fbdev_screeninfo {
@@ -93,12 +94,28 @@ struct fbdev_output {
 	struct weston_mode mode;
 	struct wl_event_source *finish_frame_timer;
 
+	/* Kept open for panning and FBIO_WAITFORVSYNC, -1 when unmapped */
+	int fd;
+
 	/* framebuffer mmap details */
 	size_t buffer_length;
 	void *fb;
 
-	/* pixman details. */
-	pixman_image_t *hw_surface;
+	/* One page per screen-sized slice of the frame buffer; with two,
+	 * the hidden one is drawn and then panned to. */
+	pixman_image_t *hw_surfaces[2];
+	int num_pages;
+	int front_page;
+
+	/* yres_virtual to restore on unmap, 0 if we did not grow it */
+	uint32_t saved_yres_virtual;
+
+	/* Damage of the frame drawn into the other page */
+	pixman_region32_t previous_damage;
+
+	bool use_vsync;
+	struct timespec vblank_ts;
+	struct wl_event_source *vblank_idle;
 };
 
 static const char default_seat[] = "seat0";
@@ -142,28 +159,103 @@ fbdev_output_start_repaint_loop(struct weston_output *output)
 	return 0;
 }
 
+static int
+fbdev_output_pan(struct fbdev_output *output, int page)
+{
+	struct fbdev_head *head = fbdev_output_get_head(output);
+	struct fb_var_screeninfo varinfo;
+
+	if (ioctl(output->fd, FBIOGET_VSCREENINFO, &varinfo) < 0)
+		return -1;
+
+	varinfo.xoffset = 0;
+	varinfo.yoffset = page * head->fb_info.y_resolution;
+	varinfo.activate = FB_ACTIVATE_VBL;
+
+	return ioctl(output->fd, FBIOPAN_DISPLAY, &varinfo);
+}
+
+static void
+vblank_idle_handler(void *data)
+{
+	struct fbdev_output *output = data;
+
+	output->vblank_idle = NULL;
+	weston_output_finish_frame(&output->base, &output->vblank_ts,
+				   WP_PRESENTATION_FEEDBACK_KIND_VSYNC);
+}
+
+/* Block until the next vertical blank, at which point a pan issued
+ * before has taken effect. Returns false if the driver cannot do it. */
+static bool
+fbdev_output_wait_for_vsync(struct fbdev_output *output)
+{
+	struct wl_event_loop *loop;
+	uint32_t crtc = 0;
+
+	if (ioctl(output->fd, FBIO_WAITFORVSYNC, &crtc) < 0) {
+		weston_log("fbdev: FBIO_WAITFORVSYNC failed (%s), "
+			   "falling back to timed frames\n", strerror(errno));
+		output->use_vsync = false;
+		return false;
+	}
+
+	weston_compositor_read_presentation_clock(output->base.compositor,
+						  &output->vblank_ts);
+
+	/* The frame cannot be finished from within repaint. */
+	loop = wl_display_get_event_loop(output->base.compositor->wl_display);
+	output->vblank_idle = wl_event_loop_add_idle(loop, vblank_idle_handler,
+						     output);
+
+	return output->vblank_idle != NULL;
+}
+
 static int
 fbdev_output_repaint(struct weston_output *base, pixman_region32_t *damage,
 		     void *repaint_data)
 {
 	struct fbdev_output *output = to_fbdev_output(base);
 	struct weston_compositor *ec = output->base.compositor;
+	int page = output->front_page;
+
+	if (output->num_pages > 1) {
+		/* The back page is a frame behind; catch it up with what
+		 * went into the front page as well. */
+		page = !output->front_page;
+		pixman_renderer_output_set_hw_extra_damage(base,
+						&output->previous_damage);
+	}
 
 	/* Repaint the damaged region onto the back buffer. */
-	pixman_renderer_output_set_buffer(base, output->hw_surface);
+	pixman_renderer_output_set_buffer(base, output->hw_surfaces[page]);
 	ec->renderer->repaint_output(base, damage);
+	pixman_region32_copy(&output->previous_damage, damage);
 
 	/* Update the damage region. */
 	pixman_region32_subtract(&ec->primary_plane.damage,
 	                         &ec->primary_plane.damage, damage);
 
-	/* Schedule the end of the frame. We do not sync this to the frame
-	 * buffer clock because users who want that should be using the DRM
-	 * compositor. FBIO_WAITFORVSYNC blocks and FB_ACTIVATE_VBL requires
-	 * panning, which is broken in most kernel drivers.
-	 *
-	 * Finish the frame synchronised to the specified refresh rate. The
-	 * refresh rate is given in mHz and the interval in ms. */
+	if (page != output->front_page) {
+		if (fbdev_output_pan(output, page) < 0) {
+			weston_log("fbdev: panning failed (%s), "
+				   "falling back to a single buffer\n",
+				   strerror(errno));
+			/* Keep showing the front page, which becomes the
+			 * only one; it is missing this frame. */
+			output->num_pages = 1;
+			weston_output_damage(base);
+		} else {
+			output->front_page = page;
+		}
+	}
+
+	if (output->use_vsync && fbdev_output_wait_for_vsync(output))
+		return 0;
+
+	/* Without vsync, finish the frame synchronised to the specified
+	 * refresh rate. The refresh rate is given in mHz and the interval
+	 * in ms. */
 	wl_event_source_timer_update(output->finish_frame_timer,
 	                             1000000 / output->mode.refresh);
 
@@ -422,17 +514,86 @@ fbdev_frame_buffer_open(const char *fb_dev,
 	return fd;
 }
 
-/* Closes the FD on success or failure. */
+static void
+fbdev_frame_buffer_unmap(struct fbdev_output *output);
+
+/* Undoes the virtual resolution growth of fbdev_frame_buffer_setup_pages */
+static void
+fbdev_frame_buffer_restore_pages(struct fbdev_output *output, int fd)
+{
+	struct fb_var_screeninfo varinfo;
+
+	if (ioctl(fd, FBIOGET_VSCREENINFO, &varinfo) < 0)
+		goto out;
+
+	varinfo.yres_virtual = output->saved_yres_virtual;
+	varinfo.yoffset = 0;
+	varinfo.activate = FB_ACTIVATE_NOW;
+	if (ioctl(fd, FBIOPUT_VSCREENINFO, &varinfo) < 0)
+		weston_log("Failed to restore frame buffer virtual "
+			   "resolution: %s\n", strerror(errno));
+
+out:
+	output->saved_yres_virtual = 0;
+}
+
+/* Returns how many screen pages fit in the frame buffer and can be panned
+ * between, growing the virtual resolution if there is memory for it. */
+static int
+fbdev_frame_buffer_setup_pages(struct fbdev_output *output, int fd,
+			       struct fbdev_screeninfo *info)
+{
+	struct fb_var_screeninfo varinfo;
+	struct fb_fix_screeninfo fixinfo;
+	size_t page_length = info->line_length * info->y_resolution;
+	uint32_t yres_virtual;
+
+	if (ioctl(fd, FBIOGET_FSCREENINFO, &fixinfo) < 0 ||
+	    ioctl(fd, FBIOGET_VSCREENINFO, &varinfo) < 0)
+		return 1;
+
+	if (fixinfo.ypanstep == 0 ||
+	    info->y_resolution % fixinfo.ypanstep != 0 ||
+	    info->buffer_length < 2 * page_length)
+		return 1;
+
+	if (varinfo.yres_virtual < 2 * info->y_resolution) {
+		yres_virtual = varinfo.yres_virtual;
+		varinfo.yres_virtual = 2 * info->y_resolution;
+		varinfo.activate = FB_ACTIVATE_NOW;
+		if (ioctl(fd, FBIOPUT_VSCREENINFO, &varinfo) < 0)
+			return 1;
+		output->saved_yres_virtual = yres_virtual;
+
+		if (ioctl(fd, FBIOGET_FSCREENINFO, &fixinfo) < 0)
+			return 1;
+
+		/* The driver may have picked another layout. */
+		if (fixinfo.line_length != info->line_length ||
+		    varinfo.yres_virtual < 2 * info->y_resolution)
+			return 1;
+	}
+
+	return 2;
+}
+
+/* Takes ownership of the FD, which is closed on failure or on unmap. */
 static int
 fbdev_frame_buffer_map(struct fbdev_output *output, int fd)
 {
 	struct fbdev_head *head;
-	int retval = -1;
+	size_t page_length;
+	int i;
 
 	head = fbdev_output_get_head(output);
 
 	weston_log("Mapping fbdev frame buffer.\n");
 
+	output->num_pages = fbdev_frame_buffer_setup_pages(output, fd,
+							   &head->fb_info);
+	output->front_page = 0;
+	page_length = head->fb_info.line_length * head->fb_info.y_resolution;
+
 	/* Map the frame buffer. Write-only mode, since we don't want to read
 	 * anything back (because it's slow). */
 	output->buffer_length = head->fb_info.buffer_length;
@@ -442,56 +603,87 @@ fbdev_frame_buffer_map(struct fbdev_output *output, int fd)
 		weston_log("Failed to mmap frame buffer: %s\n",
 		           strerror(errno));
 		output->fb = NULL;
-		goto out_close;
+		if (output->saved_yres_virtual)
+			fbdev_frame_buffer_restore_pages(output, fd);
+		close(fd);
+		return -1;
 	}
-
-	/* Create a pixman image to wrap the memory mapped frame buffer. */
-	output->hw_surface =
-		pixman_image_create_bits(head->fb_info.pixel_format,
-		                         head->fb_info.x_resolution,
-		                         head->fb_info.y_resolution,
-		                         output->fb,
-		                         head->fb_info.line_length);
-	if (output->hw_surface == NULL) {
-		weston_log("Failed to create surface for frame buffer.\n");
-		goto out_unmap;
+	output->fd = fd;
+
+	/* Create a pixman image to wrap each page of the frame buffer. */
+	for (i = 0; i < output->num_pages; i++) {
+		output->hw_surfaces[i] =
+			pixman_image_create_bits(head->fb_info.pixel_format,
+			                         head->fb_info.x_resolution,
+			                         head->fb_info.y_resolution,
+			                         (void *)((char *)output->fb +
+			                                  i * page_length),
+			                         head->fb_info.line_length);
+		if (output->hw_surfaces[i] == NULL) {
+			weston_log("Failed to create surface for frame buffer.\n");
+			fbdev_frame_buffer_unmap(output);
+			return -1;
+		}
 	}
 
-	/* Success! */
-	retval = 0;
+	if (output->num_pages > 1 && fbdev_output_pan(output, 0) < 0)
+		output->num_pages = 1;
 
-out_unmap:
-	if (retval != 0 && output->fb != NULL) {
-		munmap(output->fb, output->buffer_length);
-		output->fb = NULL;
-	}
+	weston_log_continue(STAMP_SPACE "%s buffered\n",
+			    output->num_pages > 1 ? "double" : "single");
 
-out_close:
-	if (fd >= 0)
-		close(fd);
+	/* Neither page holds anything yet. */
+	pixman_region32_fini(&output->previous_damage);
+	pixman_region32_init_rect(&output->previous_damage,
+				  output->base.x, output->base.y,
+				  head->fb_info.x_resolution,
+				  head->fb_info.y_resolution);
 
-	return retval;
+	return 0;
 }
 
 static void
 fbdev_frame_buffer_unmap(struct fbdev_output *output)
 {
+	unsigned i;
+
 	if (!output->fb) {
-		assert(!output->hw_surface);
+		assert(!output->hw_surfaces[0]);
 		return;
 	}
 
 	weston_log("Unmapping fbdev frame buffer.\n");
 
-	if (output->hw_surface)
-		pixman_image_unref(output->hw_surface);
-	output->hw_surface = NULL;
+	if (output->vblank_idle) {
+		wl_event_source_remove(output->vblank_idle);
+		output->vblank_idle = NULL;
+	}
+
+	/* Whoever gets the frame buffer next expects the first page. */
+	if (output->front_page != 0)
+		fbdev_output_pan(output, 0);
+	output->front_page = 0;
+
+	for (i = 0; i < ARRAY_LENGTH(output->hw_surfaces); i++) {
+		if (output->hw_surfaces[i])
+			pixman_image_unref(output->hw_surfaces[i]);
+		output->hw_surfaces[i] = NULL;
+	}
 
 	if (munmap(output->fb, output->buffer_length) < 0)
 		weston_log("Failed to munmap frame buffer: %s\n",
 		           strerror(errno));
 
 	output->fb = NULL;
+
+	/* Hand the frame buffer back with the layout we found it in. */
+	if (output->saved_yres_virtual)
+		fbdev_frame_buffer_restore_pages(output, output->fd);
+
+	close(output->fd);
+	output->fd = -1;
+
+	pixman_region32_clear(&output->previous_damage);
 }
 
 
@@ -649,6 +841,9 @@ fbdev_output_create(struct weston_compositor *compositor,
 		return NULL;
 
 	output->backend = to_fbdev_backend(compositor);
+	output->fd = -1;
+	output->use_vsync = output->backend->use_vsync;
+	pixman_region32_init(&output->previous_damage);
 
 	weston_output_init(&output->base, compositor, name);
 
@@ -674,6 +869,7 @@ fbdev_output_destroy(struct weston_output *base)
 	/* Remove the output. */
 	weston_output_release(&output->base);
 
+	pixman_region32_fini(&output->previous_damage);
 	free(output);
 }
 
@@ -901,6 +1097,7 @@ fbdev_backend_create(struct weston_compositor *compositor,
 		return NULL;
 
 	backend->compositor = compositor;
+	backend->use_vsync = param->use_vsync;
 	compositor->backend = &backend->base;
 	if (weston_compositor_set_presentation_clock_software(
 							compositor) < 0)
@@ -972,6 +1169,7 @@ config_init_to_defaults(struct weston_fbdev_backend_config *config)
 	config->tty = 0; /* default to current tty */
 	config->device = NULL;
 	config->seat_id = NULL;
+	config->use_vsync = false;
 }
 
 WL_EXPORT int
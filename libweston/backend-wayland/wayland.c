@@ -59,7 +59,9 @@
 #include "fullscreen-shell-unstable-v1-client-protocol.h"
 #include "xdg-shell-client-protocol.h"
 #include "presentation-time-server-protocol.h"
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
 #include "linux-dmabuf.h"
+#include "libweston-internal.h"
 #include <libweston/windowed-output-api.h>
 
 #define WINDOW_TITLE "Weston Compositor"
@@ -80,6 +82,11 @@ struct wayland_backend {
 		struct xdg_wm_base *xdg_wm_base;
 		struct zwp_fullscreen_shell_v1 *fshell;
 		struct wl_shm *shm;
+		struct wl_subcompositor *subcompositor;
+		struct zwp_linux_dmabuf_v1 *dmabuf;
+		uint32_t dmabuf_version;
+		/** Formats and modifiers the parent can import */
+		struct weston_drm_format_array dmabuf_formats;
 
 		struct wl_list output_list;
 
@@ -100,6 +107,9 @@ struct wayland_backend {
 	/* These struct wayland_input objects are waiting for the outer
 	 * compositor to provide a name and initial capabilities. */
 	struct wl_list pending_input_list;
+
+	/* struct wayland_passthrough_buffer::link */
+	struct wl_list passthrough_buffer_list;
 };
 
 struct wayland_output {
@@ -142,6 +152,20 @@ struct wayland_output {
 	struct weston_mode mode;
 
 	struct wl_callback *frame_cb;
+
+	/** A client dmabuf forwarded to the parent as-is
+	 *
+	 * The view showing it goes on the plane, so it is not composited
+	 * into the output; the parent puts the sub-surface on top instead.
+	 */
+	struct {
+		struct wl_surface *surface;
+		struct wl_subsurface *subsurface;
+		struct weston_plane plane;
+		struct wayland_passthrough_buffer *buffer;
+		bool mapped;
+		int32_t x, y;
+	} passthrough;
 };
 
 struct wayland_parent_output {
@@ -192,6 +216,23 @@ struct wayland_shm_buffer {
 	cairo_surface_t *c_surface;
 };
 
+/** Parent wl_buffer importing a client dmabuf, hung off
+ * weston_buffer::backend_private */
+struct wayland_passthrough_buffer {
+	struct wayland_backend *backend;
+	struct wl_list link;	/* wayland_backend::passthrough_buffer_list */
+	struct weston_buffer *buffer;
+	struct wl_listener buffer_destroy_listener;
+
+	/* Import in flight, NULL once answered */
+	struct zwp_linux_buffer_params_v1 *params;
+	struct wl_buffer *parent_buffer;
+	bool failed;
+
+	/* Keeps the client buffer busy while the parent holds on to it */
+	struct weston_buffer_reference ref;
+};
+
 struct wayland_input {
 	struct weston_seat base;
 	struct wayland_backend *backend;
@@ -677,6 +718,373 @@ wayland_output_repaint_pixman(struct weston_output *output_base,
 	return 0;
 }
 
+static void
+wayland_passthrough_buffer_destroy(struct wayland_passthrough_buffer *pb)
+{
+	struct weston_output *output_base;
+	struct wayland_output *output;
+
+	wl_list_for_each(output_base, &pb->backend->compositor->output_list,
+			 link) {
+		output = to_wayland_output(output_base);
+		if (output->passthrough.buffer == pb)
+			output->passthrough.buffer = NULL;
+	}
+
+	if (pb->params)
+		zwp_linux_buffer_params_v1_destroy(pb->params);
+	if (pb->parent_buffer)
+		wl_buffer_destroy(pb->parent_buffer);
+
+	wl_list_remove(&pb->buffer_destroy_listener.link);
+	wl_list_remove(&pb->link);
+	pb->buffer->backend_private = NULL;
+	free(pb);
+}
+
+static void
+passthrough_buffer_handle_buffer_destroy(struct wl_listener *listener,
+					 void *data)
+{
+	struct wayland_passthrough_buffer *pb =
+		container_of(listener, struct wayland_passthrough_buffer,
+			     buffer_destroy_listener);
+
+	/* The client buffer is going away, there is nobody to release. */
+	if (pb->ref.buffer) {
+		wl_list_remove(&pb->ref.destroy_listener.link);
+		pb->ref.buffer = NULL;
+	}
+
+	wayland_passthrough_buffer_destroy(pb);
+}
+
+static void
+passthrough_buffer_release(void *data, struct wl_buffer *buffer)
+{
+	struct wayland_passthrough_buffer *pb = data;
+
+	weston_buffer_reference(&pb->ref, NULL);
+}
+
+static const struct wl_buffer_listener passthrough_buffer_listener = {
+	passthrough_buffer_release
+};
+
+static void
+passthrough_params_created(void *data,
+			   struct zwp_linux_buffer_params_v1 *params,
+			   struct wl_buffer *buffer)
+{
+	struct wayland_passthrough_buffer *pb = data;
+
+	zwp_linux_buffer_params_v1_destroy(pb->params);
+	pb->params = NULL;
+
+	pb->parent_buffer = buffer;
+	wl_buffer_add_listener(buffer, &passthrough_buffer_listener, pb);
+
+	/* Try again now that the parent has it. */
+	weston_compositor_schedule_repaint(pb->backend->compositor);
+}
+
+static void
+passthrough_params_failed(void *data,
+			  struct zwp_linux_buffer_params_v1 *params)
+{
+	struct wayland_passthrough_buffer *pb = data;
+
+	zwp_linux_buffer_params_v1_destroy(pb->params);
+	pb->params = NULL;
+	pb->failed = true;
+}
+
+static const struct zwp_linux_buffer_params_v1_listener passthrough_params_listener = {
+	passthrough_params_created,
+	passthrough_params_failed
+};
+
+/** Get the parent import of a client dmabuf, starting it if needed
+ *
+ * The import is asynchronous, so that a buffer the parent rejects costs a
+ * failed event rather than a protocol error. Returns NULL while the import
+ * is pending, or if the buffer cannot be forwarded at all.
+ */
+static struct wayland_passthrough_buffer *
+wayland_backend_get_passthrough_buffer(struct wayland_backend *b,
+				       struct weston_buffer *buffer)
+{
+	struct wayland_passthrough_buffer *pb = buffer->backend_private;
+	struct linux_dmabuf_buffer *dmabuf;
+	struct dmabuf_attributes *attr;
+	struct weston_drm_format *fmt;
+	int i;
+
+	if (pb)
+		return pb->parent_buffer ? pb : NULL;
+
+	dmabuf = linux_dmabuf_buffer_get(buffer->resource);
+	if (!dmabuf)
+		return NULL;
+
+	pb = zalloc(sizeof *pb);
+	if (!pb)
+		return NULL;
+
+	pb->backend = b;
+	wl_list_insert(&b->passthrough_buffer_list, &pb->link);
+	pb->buffer = buffer;
+	pb->buffer_destroy_listener.notify =
+		passthrough_buffer_handle_buffer_destroy;
+	wl_signal_add(&buffer->destroy_signal, &pb->buffer_destroy_listener);
+	buffer->backend_private = pb;
+
+	attr = &dmabuf->attributes;
+	fmt = weston_drm_format_array_find_format(&b->parent.dmabuf_formats,
+						  attr->format);
+	if (!fmt || !weston_drm_format_has_modifier(fmt, attr->modifier[0])) {
+		pb->failed = true;
+		return NULL;
+	}
+
+	pb->params = zwp_linux_dmabuf_v1_create_params(b->parent.dmabuf);
+	for (i = 0; i < attr->n_planes; i++) {
+		zwp_linux_buffer_params_v1_add(pb->params, attr->fd[i], i,
+					       attr->offset[i],
+					       attr->stride[i],
+					       attr->modifier[i] >> 32,
+					       attr->modifier[i] & 0xffffffff);
+	}
+	zwp_linux_buffer_params_v1_add_listener(pb->params,
+						&passthrough_params_listener,
+						pb);
+	zwp_linux_buffer_params_v1_create(pb->params, attr->width,
+					  attr->height, attr->format,
+					  attr->flags);
+	wl_display_flush(b->parent.wl_display);
+
+	return NULL;
+}
+
+/** Can the view be shown by the parent instead of composited?
+ *
+ * It must be an unscaled, untransformed, fully opaque dmabuf lying
+ * entirely within the output, with nothing composited on top of it,
+ * because the sub-surface always stacks above the output contents.
+ */
+static struct wayland_passthrough_buffer *
+wayland_output_try_passthrough(struct wayland_output *output,
+			       struct weston_view *ev,
+			       pixman_region32_t *above)
+{
+	struct wayland_backend *b = to_wayland_backend(output->base.compositor);
+	struct weston_surface *surface = ev->surface;
+	struct weston_buffer_viewport *vp = &surface->buffer_viewport;
+	pixman_region32_t r;
+	bool inside;
+
+	if (!weston_view_has_valid_buffer(ev) || ev->alpha != 1.0f)
+		return NULL;
+
+	if (ev->transform.matrix.type > WESTON_MATRIX_TRANSFORM_TRANSLATE)
+		return NULL;
+
+	if (output->base.transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+	    vp->buffer.transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+	    vp->buffer.scale != output->base.current_scale ||
+	    vp->buffer.src_width != wl_fixed_from_int(-1) ||
+	    vp->surface.width != -1)
+		return NULL;
+
+	pixman_region32_init(&r);
+	pixman_region32_subtract(&r, &ev->transform.boundingbox,
+				 &output->base.region);
+	inside = !pixman_region32_not_empty(&r);
+	pixman_region32_intersect(&r, &ev->transform.boundingbox, above);
+	inside = inside && !pixman_region32_not_empty(&r);
+	pixman_region32_fini(&r);
+	if (!inside)
+		return NULL;
+
+	return wayland_backend_get_passthrough_buffer(b,
+						      surface->buffer_ref.buffer);
+}
+
+static void
+wayland_output_update_passthrough(struct wayland_output *output,
+				  struct weston_view *ev,
+				  struct wayland_passthrough_buffer *pb)
+{
+	struct wl_surface *surface = output->passthrough.surface;
+	struct weston_surface *ws;
+	pixman_region32_t damage;
+	pixman_box32_t *extents, *rects;
+	int32_t fx = 0, fy = 0, x, y;
+	int i, n;
+
+	if (!pb) {
+		if (output->passthrough.mapped) {
+			wl_surface_attach(surface, NULL, 0, 0);
+			wl_surface_commit(surface);
+			output->passthrough.mapped = false;
+		}
+		output->passthrough.buffer = NULL;
+		return;
+	}
+
+	ws = ev->surface;
+
+	if (output->frame)
+		frame_interior(output->frame, &fx, &fy, NULL, NULL);
+	extents = pixman_region32_extents(&ev->transform.boundingbox);
+	x = fx + (extents->x1 - output->base.x) * output->base.current_scale;
+	y = fy + (extents->y1 - output->base.y) * output->base.current_scale;
+	if (x != output->passthrough.x || y != output->passthrough.y) {
+		wl_subsurface_set_position(output->passthrough.subsurface,
+					   x, y);
+		output->passthrough.x = x;
+		output->passthrough.y = y;
+	}
+
+	pixman_region32_init(&damage);
+	if (pb != output->passthrough.buffer) {
+		pixman_region32_init_rect(&damage, 0, 0,
+					  pb->buffer->width,
+					  pb->buffer->height);
+	} else {
+		weston_surface_to_buffer_region(ws, &ws->damage, &damage);
+	}
+
+	/* Damage is only ever the client's, whatever surrounds the view
+	 * is composited into the output below. */
+	rects = pixman_region32_rectangles(&damage, &n);
+	if (n > 0) {
+		wl_surface_attach(surface, pb->parent_buffer, 0, 0);
+		for (i = 0; i < n; i++)
+			wl_surface_damage(surface, rects[i].x1, rects[i].y1,
+					  rects[i].x2 - rects[i].x1,
+					  rects[i].y2 - rects[i].y1);
+		weston_buffer_reference(&pb->ref, ws->buffer_ref.buffer);
+		output->passthrough.buffer = pb;
+		output->passthrough.mapped = true;
+	}
+	pixman_region32_fini(&damage);
+
+	/* The sub-surface is synchronized, so this shows up with the
+	 * parent commit from repaint. */
+	wl_surface_commit(surface);
+}
+
+static void
+wayland_output_assign_planes(struct weston_output *output_base,
+			     void *repaint_data)
+{
+	struct wayland_output *output = to_wayland_output(output_base);
+	struct weston_compositor *ec = output_base->compositor;
+	struct wayland_passthrough_buffer *pb = NULL;
+	struct weston_view *passthrough_view = NULL;
+	struct weston_paint_node *pnode;
+	struct weston_view *ev;
+	pixman_region32_t above;
+
+	pixman_region32_init(&above);
+
+	wl_list_for_each(pnode, &output_base->paint_node_z_order_list,
+			 z_order_link) {
+		ev = pnode->view;
+
+		/* TODO: turn this into assert once z_order_list is pruned. */
+		if (!(ev->output_mask & (1u << output_base->id)))
+			continue;
+
+		/* Keep dmabufs around to forward them again without a new
+		 * commit, e.g. on a repaint for some other view. */
+		ev->surface->keep_buffer = output->passthrough.surface &&
+			weston_view_has_valid_buffer(ev) &&
+			linux_dmabuf_buffer_get(ev->surface->buffer_ref.buffer->resource);
+
+		if (!passthrough_view && output->passthrough.surface) {
+			pb = wayland_output_try_passthrough(output, ev, &above);
+			if (pb)
+				passthrough_view = ev;
+		}
+
+		if (ev == passthrough_view) {
+			weston_view_move_to_plane(ev, &output->passthrough.plane);
+			ev->psf_flags = WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY;
+		} else {
+			weston_view_move_to_plane(ev, &ec->primary_plane);
+			ev->psf_flags = 0;
+			pixman_region32_union(&above, &above,
+					      &ev->transform.boundingbox);
+		}
+	}
+
+	pixman_region32_fini(&above);
+
+	if (output->passthrough.surface)
+		wayland_output_update_passthrough(output, passthrough_view, pb);
+}
+
+static int
+wayland_output_init_passthrough(struct wayland_output *output)
+{
+	struct wayland_backend *b = to_wayland_backend(output->base.compositor);
+	struct wl_region *region;
+
+	weston_plane_init(&output->passthrough.plane, b->compositor, 0, 0);
+	weston_compositor_stack_plane(b->compositor, &output->passthrough.plane,
+				      &b->compositor->primary_plane);
+
+	/* Clients can only send dmabufs if the renderer imports them. */
+	if (!b->parent.subcompositor || !b->parent.dmabuf ||
+	    !b->compositor->renderer->import_dmabuf)
+		return 0;
+
+	output->passthrough.surface =
+		wl_compositor_create_surface(b->parent.compositor);
+	if (!output->passthrough.surface)
+		return -1;
+
+	output->passthrough.subsurface =
+		wl_subcompositor_get_subsurface(b->parent.subcompositor,
+						output->passthrough.surface,
+						output->parent.surface);
+	if (!output->passthrough.subsurface) {
+		wl_surface_destroy(output->passthrough.surface);
+		output->passthrough.surface = NULL;
+		return -1;
+	}
+
+	/* Input belongs to the output surface underneath. */
+	region = wl_compositor_create_region(b->parent.compositor);
+	wl_surface_set_input_region(output->passthrough.surface, region);
+	wl_region_destroy(region);
+
+	output->passthrough.x = 0;
+	output->passthrough.y = 0;
+	output->passthrough.buffer = NULL;
+	output->passthrough.mapped = false;
+
+	return 0;
+}
+
+static void
+wayland_output_fini_passthrough(struct wayland_output *output)
+{
+	weston_plane_release(&output->passthrough.plane);
+
+	if (!output->passthrough.surface)
+		return;
+
+	wl_subsurface_destroy(output->passthrough.subsurface);
+	output->passthrough.subsurface = NULL;
+	wl_surface_destroy(output->passthrough.surface);
+	output->passthrough.surface = NULL;
+	output->passthrough.buffer = NULL;
+	output->passthrough.mapped = false;
+}
+
 static void
 wayland_backend_destroy_output_surface(struct wayland_output *output)
 {
@@ -734,6 +1142,7 @@ wayland_output_disable(struct weston_output *base)
 
 	wayland_output_destroy_shm_buffers(output);
 
+	wayland_output_fini_passthrough(output);
 	wayland_backend_destroy_output_surface(output);
 
 	if (output->frame)
@@ -1275,8 +1684,13 @@ wayland_output_enable(struct weston_output *base)
 #endif
 	}
 
+	if (wayland_output_init_passthrough(output) < 0)
+		weston_log("wayland-backend: failed to set up client buffer "
+			   "passthrough, compositing everything\n");
+
 	output->base.start_repaint_loop = wayland_output_start_repaint_loop;
-	output->base.assign_planes = NULL;
+	output->base.assign_planes = output->passthrough.surface ?
+				     wayland_output_assign_planes : NULL;
 	output->base.set_backlight = NULL;
 	output->base.set_dpms = NULL;
 	output->base.switch_mode = wayland_output_switch_mode;
@@ -2654,6 +3068,50 @@ static const struct xdg_wm_base_listener wm_base_listener = {
 	xdg_wm_base_ping,
 };
 
+static void
+wayland_backend_add_parent_format(struct wayland_backend *b,
+				  uint32_t format, uint64_t modifier)
+{
+	struct weston_drm_format *fmt;
+
+	fmt = weston_drm_format_array_find_format(&b->parent.dmabuf_formats,
+						  format);
+	if (!fmt)
+		fmt = weston_drm_format_array_add_format(&b->parent.dmabuf_formats,
+							 format);
+	if (fmt && !weston_drm_format_has_modifier(fmt, modifier))
+		weston_drm_format_add_modifier(fmt, modifier);
+}
+
+static void
+parent_dmabuf_format(void *data, struct zwp_linux_dmabuf_v1 *dmabuf,
+		     uint32_t format)
+{
+	struct wayland_backend *b = data;
+
+	/* Version 3 lists the modifiers explicitly. */
+	if (b->parent.dmabuf_version < 3)
+		wayland_backend_add_parent_format(b, format,
+						  DRM_FORMAT_MOD_INVALID);
+}
+
+static void
+parent_dmabuf_modifier(void *data, struct zwp_linux_dmabuf_v1 *dmabuf,
+		       uint32_t format, uint32_t modifier_hi,
+		       uint32_t modifier_lo)
+{
+	struct wayland_backend *b = data;
+
+	wayland_backend_add_parent_format(b, format,
+					  ((uint64_t)modifier_hi << 32) |
+					  modifier_lo);
+}
+
+static const struct zwp_linux_dmabuf_v1_listener parent_dmabuf_listener = {
+	parent_dmabuf_format,
+	parent_dmabuf_modifier
+};
+
 static void
 registry_handle_global(void *data, struct wl_registry *registry, uint32_t name,
 		       const char *interface, uint32_t version)
@@ -2686,6 +3144,18 @@ registry_handle_global(void *data, struct wl_registry *registry, uint32_t name,
 	} else if (strcmp(interface, "wl_shm") == 0) {
 		b->parent.shm =
 			wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, "wl_subcompositor") == 0) {
+		b->parent.subcompositor =
+			wl_registry_bind(registry, name,
+					 &wl_subcompositor_interface, 1);
+	} else if (strcmp(interface, "zwp_linux_dmabuf_v1") == 0) {
+		b->parent.dmabuf_version = MIN(version, 3);
+		b->parent.dmabuf =
+			wl_registry_bind(registry, name,
+					 &zwp_linux_dmabuf_v1_interface,
+					 b->parent.dmabuf_version);
+		zwp_linux_dmabuf_v1_add_listener(b->parent.dmabuf,
+						 &parent_dmabuf_listener, b);
 	}
 }
 
@@ -2743,6 +3213,7 @@ wayland_destroy(struct weston_compositor *ec)
 	struct wayland_backend *b = to_wayland_backend(ec);
 	struct weston_head *base, *next;
 	struct wayland_input *input, *next_input;
+	struct wayland_passthrough_buffer *pb, *next_pb;
 
 	wl_event_source_remove(b->parent.wl_source);
 
@@ -2757,9 +3228,23 @@ wayland_destroy(struct weston_compositor *ec)
 	wl_list_for_each_safe(input, next_input, &b->pending_input_list, link)
 		wayland_input_destroy(input);
 
+	/* Client buffers outlive the backend, detach them while the parent
+	 * connection is still there. */
+	wl_list_for_each_safe(pb, next_pb, &b->passthrough_buffer_list, link) {
+		weston_buffer_reference(&pb->ref, NULL);
+		wayland_passthrough_buffer_destroy(pb);
+	}
+
 	if (b->parent.shm)
 		wl_shm_destroy(b->parent.shm);
 
+	if (b->parent.dmabuf)
+		zwp_linux_dmabuf_v1_destroy(b->parent.dmabuf);
+	weston_drm_format_array_fini(&b->parent.dmabuf_formats);
+
+	if (b->parent.subcompositor)
+		wl_subcompositor_destroy(b->parent.subcompositor);
+
 	if (b->parent.xdg_wm_base)
 		xdg_wm_base_destroy(b->parent.xdg_wm_base);
 
@@ -2869,8 +3354,10 @@ wayland_backend_create(struct weston_compositor *compositor,
 	}
 
 	wl_list_init(&b->parent.output_list);
+	weston_drm_format_array_init(&b->parent.dmabuf_formats);
 	wl_list_init(&b->input_list);
 	wl_list_init(&b->pending_input_list);
+	wl_list_init(&b->passthrough_buffer_list);
 	b->parent.registry = wl_display_get_registry(b->parent.wl_display);
 	wl_registry_add_listener(b->parent.registry, &registry_listener, b);
 	wl_display_roundtrip(b->parent.wl_display);
@@ -2941,6 +3428,7 @@ wayland_backend_create(struct weston_compositor *compositor,
 	return b;
 err_display:
 	wl_display_disconnect(b->parent.wl_display);
+	weston_drm_format_array_fini(&b->parent.dmabuf_formats);
 err_compositor:
 	weston_compositor_shutdown(compositor);
 	free(b);
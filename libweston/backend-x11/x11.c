@@ -90,6 +90,7 @@ struct x11_backend {
 	struct xkb_keymap	*xkb_keymap;
 	unsigned int		 has_xkb;
 	uint8_t			 xkb_event_base;
+	uint8_t			 shm_event_base;
 	int			 fullscreen;
 	int			 no_input;
 	int			 use_pixman;
@@ -125,6 +126,21 @@ struct x11_head {
 	struct weston_head	base;
 };
 
+/* Number of rectangles above which the damage extents are pushed in one
+ * request instead of one request per rectangle. */
+#define X11_SHM_MAX_PUT_RECTS 32
+
+/* How long to wait for an ShmCompletion event before finishing the frame
+ * anyway, e.g. when the PutImage failed. */
+#define X11_SHM_COMPLETION_TIMEOUT_MS 100
+
+struct x11_shm_buffer {
+	xcb_shm_seg_t		segment;
+	int			shm_id;
+	void		       *buf;
+	pixman_image_t	       *image;
+};
+
 struct x11_output {
 	struct weston_output	base;
 
@@ -134,10 +150,12 @@ struct x11_output {
 	struct wl_event_source *finish_frame_timer;
 
 	xcb_gc_t		gc;
-	xcb_shm_seg_t		segment;
-	pixman_image_t	       *hw_surface;
-	int			shm_id;
-	void		       *buf;
+	struct x11_shm_buffer	shm_buffers[2];
+	int			shm_current;
+	/* Damage of the frame that went into the other buffer */
+	pixman_region32_t	previous_damage;
+	/* Segment whose ShmCompletion ends the frame, 0 if none pending */
+	xcb_shm_seg_t		frame_segment;
 	uint8_t			depth;
 	int32_t                 scale;
 	bool			resize_pending;
@@ -432,58 +450,62 @@ x11_output_repaint_gl(struct weston_output *output_base,
 	return 0;
 }
 
-static void
-set_clip_for_output(struct weston_output *output_base, pixman_region32_t *region)
+/* Push the damaged part of an SHM buffer to the output window
+ *
+ * One PutImage per damage rectangle, so that an idle desktop with a blinking
+ * cursor does not cost a full window upload. Only the last request asks for
+ * an ShmCompletion event, which is what finishes the frame.
+ *
+ * Returns false if there was nothing to put.
+ */
+static bool
+x11_output_put_damage(struct x11_output *output, struct x11_shm_buffer *shm,
+		      pixman_region32_t *damage)
 {
-	struct x11_output *output = to_x11_output(output_base);
-	struct weston_compositor *ec = output->base.compositor;
-	struct x11_backend *b = to_x11_backend(ec);
+	struct weston_output *output_base = &output->base;
+	struct x11_backend *b = to_x11_backend(output_base->compositor);
 	pixman_region32_t transformed_region;
 	pixman_box32_t *rects;
-	xcb_rectangle_t *output_rects;
-	xcb_void_cookie_t cookie;
+	pixman_box32_t extents;
+	uint16_t width = pixman_image_get_width(shm->image);
+	uint16_t height = pixman_image_get_height(shm->image);
 	int nrects, i;
-	xcb_generic_error_t *err;
 
 	pixman_region32_init(&transformed_region);
-	pixman_region32_copy(&transformed_region, region);
+	pixman_region32_copy(&transformed_region, damage);
 	pixman_region32_translate(&transformed_region,
 				  -output_base->x, -output_base->y);
 	weston_transformed_region(output_base->width, output_base->height,
 				  output_base->transform,
 				  output_base->current_scale,
 				  &transformed_region, &transformed_region);
+	pixman_region32_intersect_rect(&transformed_region,
+				       &transformed_region,
+				       0, 0, width, height);
 
 	rects = pixman_region32_rectangles(&transformed_region, &nrects);
-	output_rects = calloc(nrects, sizeof(xcb_rectangle_t));
-
-	if (output_rects == NULL) {
-		pixman_region32_fini(&transformed_region);
-		return;
+	if (nrects > X11_SHM_MAX_PUT_RECTS) {
+		extents = *pixman_region32_extents(&transformed_region);
+		rects = &extents;
+		nrects = 1;
 	}
 
 	for (i = 0; i < nrects; i++) {
-		output_rects[i].x = rects[i].x1;
-		output_rects[i].y = rects[i].y1;
-		output_rects[i].width = rects[i].x2 - rects[i].x1;
-		output_rects[i].height = rects[i].y2 - rects[i].y1;
+		xcb_shm_put_image(b->conn, output->window, output->gc,
+				  width, height,
+				  rects[i].x1, rects[i].y1,
+				  rects[i].x2 - rects[i].x1,
+				  rects[i].y2 - rects[i].y1,
+				  rects[i].x1, rects[i].y1,
+				  output->depth, XCB_IMAGE_FORMAT_Z_PIXMAP,
+				  i == nrects - 1, shm->segment, 0);
 	}
 
 	pixman_region32_fini(&transformed_region);
 
-	cookie = xcb_set_clip_rectangles_checked(b->conn, XCB_CLIP_ORDERING_UNSORTED,
-					output->gc,
-					0, 0, nrects,
-					output_rects);
-	err = xcb_request_check(b->conn, cookie);
-	if (err != NULL) {
-		weston_log("Failed to set clip rects, err: %d\n", err->error_code);
-		free(err);
-	}
-	free(output_rects);
+	return nrects > 0;
 }
 
-
 static int
 x11_output_repaint_shm(struct weston_output *output_base,
 		       pixman_region32_t *damage,
@@ -492,30 +514,33 @@ x11_output_repaint_shm(struct weston_output *output_base,
 	struct x11_output *output = to_x11_output(output_base);
 	struct weston_compositor *ec = output->base.compositor;
 	struct x11_backend *b = to_x11_backend(ec);
-	xcb_void_cookie_t cookie;
-	xcb_generic_error_t *err;
+	struct x11_shm_buffer *shm = &output->shm_buffers[output->shm_current];
 
-	pixman_renderer_output_set_buffer(output_base, output->hw_surface);
+	/* The buffer still holds the frame before last, so bring it up to
+	 * date with what went into the other buffer as well. */
+	pixman_renderer_output_set_hw_extra_damage(output_base,
+						   &output->previous_damage);
+	pixman_renderer_output_set_buffer(output_base, shm->image);
 	ec->renderer->repaint_output(output_base, damage);
+	pixman_region32_copy(&output->previous_damage, damage);
 
 	pixman_region32_subtract(&ec->primary_plane.damage,
 				 &ec->primary_plane.damage, damage);
-	set_clip_for_output(output_base, damage);
-	cookie = xcb_shm_put_image_checked(b->conn, output->window, output->gc,
-					pixman_image_get_width(output->hw_surface),
-					pixman_image_get_height(output->hw_surface),
-					0, 0,
-					pixman_image_get_width(output->hw_surface),
-					pixman_image_get_height(output->hw_surface),
-					0, 0, output->depth, XCB_IMAGE_FORMAT_Z_PIXMAP,
-					0, output->segment, 0);
-	err = xcb_request_check(b->conn, cookie);
-	if (err != NULL) {
-		weston_log("Failed to put shm image, err: %d\n", err->error_code);
-		free(err);
+
+	if (x11_output_put_damage(output, shm, damage)) {
+		output->frame_segment = shm->segment;
+		output->shm_current = !output->shm_current;
+		xcb_flush(b->conn);
+
+		/* Only a fallback, the ShmCompletion event disarms it. */
+		wl_event_source_timer_update(output->finish_frame_timer,
+					     X11_SHM_COMPLETION_TIMEOUT_MS);
+	} else {
+		/* Nothing to show; keep rendering into the same buffer,
+		 * which is now as current as the window. */
+		wl_event_source_timer_update(output->finish_frame_timer, 10);
 	}
 
-	wl_event_source_timer_update(output->finish_frame_timer, 10);
 	return 0;
 }
 
@@ -525,6 +550,9 @@ finish_frame_handler(void *data)
 	struct x11_output *output = data;
 	struct timespec ts;
 
+	/* A completion arriving after this is stale. */
+	output->frame_segment = 0;
+
 	weston_compositor_read_presentation_clock(output->base.compositor, &ts);
 	weston_output_finish_frame(&output->base, &ts, 0);
 
@@ -532,21 +560,47 @@ finish_frame_handler(void *data)
 }
 
 static void
-x11_output_deinit_shm(struct x11_backend *b, struct x11_output *output)
+x11_shm_buffer_fini(struct x11_backend *b, struct x11_shm_buffer *shm)
 {
 	xcb_void_cookie_t cookie;
 	xcb_generic_error_t *err;
-	xcb_free_gc(b->conn, output->gc);
 
-	pixman_image_unref(output->hw_surface);
-	output->hw_surface = NULL;
-	cookie = xcb_shm_detach_checked(b->conn, output->segment);
-	err = xcb_request_check(b->conn, cookie);
-	if (err) {
-		weston_log("xcb_shm_detach failed, error %d\n", err->error_code);
-		free(err);
+	if (shm->image) {
+		pixman_image_unref(shm->image);
+		shm->image = NULL;
+	}
+
+	if (shm->segment) {
+		cookie = xcb_shm_detach_checked(b->conn, shm->segment);
+		err = xcb_request_check(b->conn, cookie);
+		if (err) {
+			weston_log("xcb_shm_detach failed, error %d\n",
+				   err->error_code);
+			free(err);
+		}
+		shm->segment = 0;
+	}
+
+	if (shm->buf) {
+		shmdt(shm->buf);
+		shm->buf = NULL;
 	}
-	shmdt(output->buf);
+}
+
+static void
+x11_output_deinit_shm(struct x11_backend *b, struct x11_output *output)
+{
+	unsigned i;
+
+	xcb_free_gc(b->conn, output->gc);
+
+	for (i = 0; i < ARRAY_LENGTH(output->shm_buffers); i++)
+		x11_shm_buffer_fini(b, &output->shm_buffers[i]);
+
+	/* A pending frame is finished by the timer. */
+	output->frame_segment = 0;
+	pixman_region32_fini(&output->previous_damage);
+	pixman_region32_init(&output->previous_damage);
 }
 
 static void
@@ -699,6 +753,47 @@ get_depth_of_visual(xcb_screen_t *screen,
 	return 0;
 }
 
+static int
+x11_shm_buffer_init(struct x11_backend *b, struct x11_shm_buffer *shm,
+		    pixman_format_code_t pixman_format,
+		    int width, int height, int bitsperpixel)
+{
+	xcb_void_cookie_t cookie;
+	xcb_generic_error_t *err;
+
+	/* Create SHM segment and attach it */
+	shm->shm_id = shmget(IPC_PRIVATE, width * height * (bitsperpixel / 8), IPC_CREAT | S_IRWXU);
+	if (shm->shm_id == -1) {
+		weston_log("x11shm: failed to allocate SHM segment\n");
+		return -1;
+	}
+	shm->buf = shmat(shm->shm_id, NULL, 0 /* read/write */);
+	if (-1 == (long)shm->buf) {
+		weston_log("x11shm: failed to attach SHM segment\n");
+		shm->buf = NULL;
+		shmctl(shm->shm_id, IPC_RMID, NULL);
+		return -1;
+	}
+	shm->segment = xcb_generate_id(b->conn);
+	cookie = xcb_shm_attach_checked(b->conn, shm->segment, shm->shm_id, 1);
+	err = xcb_request_check(b->conn, cookie);
+	shmctl(shm->shm_id, IPC_RMID, NULL);
+	if (err) {
+		weston_log("x11shm: xcb_shm_attach error %d, op code %d, resource id %d\n",
+			   err->error_code, err->major_code, err->minor_code);
+		free(err);
+		shm->segment = 0;
+		x11_shm_buffer_fini(b, shm);
+		return -1;
+	}
+
+	/* Now create pixman image */
+	shm->image = pixman_image_create_bits(pixman_format, width, height, shm->buf,
+		width * (bitsperpixel / 8));
+
+	return 0;
+}
+
 static int
 x11_output_init_shm(struct x11_backend *b, struct x11_output *output,
 	int width, int height)
@@ -706,11 +801,10 @@ x11_output_init_shm(struct x11_backend *b, struct x11_output *output,
 	xcb_visualtype_t *visual_type;
 	xcb_screen_t *screen;
 	xcb_format_iterator_t fmt;
-	xcb_void_cookie_t cookie;
-	xcb_generic_error_t *err;
 	const xcb_query_extension_reply_t *ext;
 	int bitsperpixel = 0;
 	pixman_format_code_t pixman_format;
+	unsigned i;
 
 	/* Check if SHM is available */
 	ext = xcb_get_extension_data(b->conn, &xcb_shm_id);
@@ -766,32 +860,23 @@ x11_output_init_shm(struct x11_backend *b, struct x11_output *output,
 	}
 
 
-	/* Create SHM segment and attach it */
-	output->shm_id = shmget(IPC_PRIVATE, width * height * (bitsperpixel / 8), IPC_CREAT | S_IRWXU);
-	if (output->shm_id == -1) {
-		weston_log("x11shm: failed to allocate SHM segment\n");
-		return -1;
-	}
-	output->buf = shmat(output->shm_id, NULL, 0 /* read/write */);
-	if (-1 == (long)output->buf) {
-		weston_log("x11shm: failed to attach SHM segment\n");
-		return -1;
-	}
-	output->segment = xcb_generate_id(b->conn);
-	cookie = xcb_shm_attach_checked(b->conn, output->segment, output->shm_id, 1);
-	err = xcb_request_check(b->conn, cookie);
-	if (err) {
-		weston_log("x11shm: xcb_shm_attach error %d, op code %d, resource id %d\n",
-			   err->error_code, err->major_code, err->minor_code);
-		free(err);
-		return -1;
+	for (i = 0; i < ARRAY_LENGTH(output->shm_buffers); i++) {
+		if (x11_shm_buffer_init(b, &output->shm_buffers[i],
+					pixman_format, width, height,
+					bitsperpixel) < 0) {
+			while (i--)
+				x11_shm_buffer_fini(b, &output->shm_buffers[i]);
+			return -1;
+		}
 	}
+	output->shm_current = 0;
+	output->frame_segment = 0;
+	b->shm_event_base = ext->first_event;
 
-	shmctl(output->shm_id, IPC_RMID, NULL);
-
-	/* Now create pixman image */
-	output->hw_surface = pixman_image_create_bits(pixman_format, width, height, output->buf,
-		width * (bitsperpixel / 8));
+	/* Neither buffer holds anything yet. */
+	pixman_region32_init_rect(&output->previous_damage,
+				  output->base.x, output->base.y,
+				  width, height);
 
 	output->gc = xcb_generate_id(b->conn);
 	xcb_create_gc(b->conn, output->gc, output->window, 0, NULL);
@@ -1445,6 +1530,31 @@ x11_backend_next_event(struct x11_backend *b,
 	return *event != NULL;
 }
 
+static void
+x11_backend_deliver_shm_completion(struct x11_backend *b,
+				   xcb_shm_completion_event_t *completion)
+{
+	struct x11_output *output;
+	struct timespec ts;
+
+	output = x11_backend_find_output(b, completion->drawable);
+	if (!output)
+		return;
+
+	/* Completions of earlier puts, or of a frame already finished by
+	 * the fallback timer, carry no news. */
+	if (output->frame_segment == 0 ||
+	    output->frame_segment != completion->shmseg)
+		return;
+
+	output->frame_segment = 0;
+	wl_event_source_timer_update(output->finish_frame_timer, 0);
+
+	weston_compositor_read_presentation_clock(b->compositor, &ts);
+	weston_output_finish_frame(&output->base, &ts,
+				   WP_PRESENTATION_FEEDBACK_KIND_HW_COMPLETION);
+}
+
 static int
 x11_backend_handle_event(int fd, uint32_t mask, void *data)
 {
@@ -1458,6 +1568,7 @@ x11_backend_handle_event(int fd, uint32_t mask, void *data)
 	xcb_focus_in_event_t *focus_in;
 	xcb_expose_event_t *expose;
 	xcb_configure_notify_event_t *configure;
+	xcb_generic_error_t *error;
 	xcb_atom_t atom;
 	xcb_window_t window;
 	uint32_t *k;
@@ -1654,7 +1765,19 @@ x11_backend_handle_event(int fd, uint32_t mask, void *data)
 			notify_keyboard_focus_out(&b->core_seat);
 			break;
 
+		case 0:
+			/* Errors of unchecked requests, such as PutImage */
+			error = (xcb_generic_error_t *) event;
+			weston_log("X11 error %d, request %d.%d, resource 0x%x\n",
+				   error->error_code, error->major_code,
+				   error->minor_code, error->resource_id);
+			break;
+
 		default:
+			if (b->shm_event_base &&
+			    response_type == b->shm_event_base + XCB_SHM_COMPLETION)
+				x11_backend_deliver_shm_completion(b,
+					(xcb_shm_completion_event_t *) event);
 			break;
 		}
 
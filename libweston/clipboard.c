@@ -28,18 +28,27 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <linux/input.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/uio.h>
 
 #include <libweston/libweston.h>
 #include "libweston-internal.h"
 #include "shared/helpers.h"
+#include "shared/os-compatibility.h"
+
+/* First allocation of the contents file, doubled as it fills up */
+#define CLIPBOARD_INITIAL_SIZE 4096
 
 struct clipboard_source {
 	struct weston_data_source base;
-	struct wl_array contents;
+	int contents_fd;
+	size_t size;
+	size_t alloc;
 	struct clipboard *clipboard;
 	struct wl_event_source *event_source;
 	uint32_t serial;
@@ -74,35 +83,116 @@ clipboard_source_unref(struct clipboard_source *source)
 	s = source->base.mime_types.data;
 	free(*s);
 	wl_array_release(&source->base.mime_types);
-	wl_array_release(&source->contents);
+	close(source->contents_fd);
 	free(source);
 }
 
+/* The contents live in a memfd rather than on the compositor heap, so
+ * that they can be spliced in from the source and sent out to pastes
+ * without copying through user space. */
+static int
+clipboard_create_contents_file(void)
+{
+	int fd;
+
+#ifdef HAVE_MEMFD_CREATE
+	fd = memfd_create("weston-clipboard", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd >= 0)
+		return fd;
+#endif
+	fd = os_create_anonymous_file(0);
+
+	return fd;
+}
+
+/* Trim the contents file to what was read and make it immutable. */
+static void
+clipboard_source_seal(struct clipboard_source *source)
+{
+	if (ftruncate(source->contents_fd, source->size) == 0)
+		source->alloc = source->size;
+
+#ifdef HAVE_MEMFD_CREATE
+	fcntl(source->contents_fd, F_ADD_SEALS,
+	      F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+}
+
+/* Double the contents file, up to the size limit */
+static bool
+clipboard_source_grow(struct clipboard_source *source, uint64_t limit)
+{
+	size_t alloc;
+
+	alloc = source->alloc ? source->alloc * 2 : CLIPBOARD_INITIAL_SIZE;
+	if (limit && alloc > limit)
+		alloc = limit;
+	if (alloc <= source->size)
+		return false;
+
+	if (ftruncate(source->contents_fd, alloc) < 0)
+		return false;
+
+	source->alloc = alloc;
+
+	return true;
+}
+
+/* All of the selection was read */
+static void
+clipboard_source_finish(struct clipboard_source *source, int fd)
+{
+	wl_event_source_remove(source->event_source);
+	close(fd);
+	source->event_source = NULL;
+	clipboard_source_seal(source);
+}
+
+static void
+clipboard_source_drop(struct clipboard_source *source)
+{
+	struct clipboard *clipboard = source->clipboard;
+
+	weston_log("clipboard: dropping %s selection after %zu bytes\n",
+		   *(char **)source->base.mime_types.data, source->size);
+	clipboard_source_unref(source);
+	clipboard->source = NULL;
+}
+
 static int
 clipboard_source_data(int fd, uint32_t mask, void *data)
 {
 	struct clipboard_source *source = data;
 	struct clipboard *clipboard = source->clipboard;
-	char *p;
-	int len, size;
-
-	if (source->contents.alloc - source->contents.size < 1024) {
-		wl_array_add(&source->contents, 1024);
-		source->contents.size -= 1024;
+	struct weston_compositor *compositor = clipboard->seat->compositor;
+	loff_t offset;
+	ssize_t len;
+	char probe;
+
+	if (source->size == source->alloc &&
+	    !clipboard_source_grow(source, compositor->clipboard_size_limit)) {
+		/* A selection of exactly the limit ends here; only drop it
+		 * once more data actually arrives. */
+		len = read(fd, &probe, sizeof probe);
+		if (len == 0)
+			clipboard_source_finish(source, fd);
+		else if (len > 0 || (errno != EAGAIN && errno != EINTR))
+			clipboard_source_drop(source);
+		return 1;
 	}
 
-	p = source->contents.data + source->contents.size;
-	size = source->contents.alloc - source->contents.size;
-	len = read(fd, p, size);
+	offset = source->size;
+	len = splice(fd, NULL, source->contents_fd, &offset,
+		     source->alloc - source->size, SPLICE_F_NONBLOCK);
 	if (len == 0) {
-		wl_event_source_remove(source->event_source);
-		close(fd);
-		source->event_source = NULL;
+		clipboard_source_finish(source, fd);
 	} else if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 1;
 		clipboard_source_unref(source);
 		clipboard->source = NULL;
 	} else {
-		source->contents.size += len;
+		source->size += len;
 	}
 
 	return 1;
@@ -147,7 +237,12 @@ clipboard_source_create(struct clipboard *clipboard,
 	if (source == NULL)
 		return NULL;
 
-	wl_array_init(&source->contents);
+	source->contents_fd = clipboard_create_contents_file();
+	if (source->contents_fd < 0) {
+		free(source);
+		return NULL;
+	}
+
 	wl_array_init(&source->base.mime_types);
 	source->base.resource = NULL;
 	source->base.accept = clipboard_source_accept;
@@ -178,6 +273,7 @@ clipboard_source_create(struct clipboard *clipboard,
  err_strdup:
 	wl_array_release(&source->base.mime_types);
  err_add:
+	close(source->contents_fd);
 	free(source);
 
 	return NULL;
@@ -185,7 +281,7 @@ clipboard_source_create(struct clipboard *clipboard,
 
 struct clipboard_client {
 	struct wl_event_source *event_source;
-	size_t offset;
+	off_t offset;
 	struct clipboard_source *source;
 };
 
@@ -193,17 +289,16 @@ static int
 clipboard_client_data(int fd, uint32_t mask, void *data)
 {
 	struct clipboard_client *client = data;
-	char *p;
 	size_t size;
-	int len;
+	ssize_t len;
 
-	size = client->source->contents.size;
-	p = client->source->contents.data;
-	len = write(fd, p + client->offset, size - client->offset);
-	if (len > 0)
-		client->offset += len;
+	size = client->source->size;
+	len = sendfile(fd, client->source->contents_fd, &client->offset,
+		       size - client->offset);
+	if (len < 0 && (errno == EAGAIN || errno == EINTR))
+		return 1;
 
-	if (client->offset == size || len <= 0) {
+	if ((size_t)client->offset == size || len <= 0) {
 		close(fd);
 		wl_event_source_remove(client->event_source);
 		clipboard_source_unref(client->source);
@@ -222,14 +317,60 @@ clipboard_client_create(struct clipboard_source *source, int fd)
 		wl_display_get_event_loop(seat->compositor->wl_display);
 
 	client = zalloc(sizeof *client);
-	if (client == NULL)
+	if (client == NULL) {
+		close(fd);
 		return;
+	}
+
+	/* A large selection must not block the compositor on a slow
+	 * reader; send what fits and wait for the pipe to drain. */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 
 	client->source = source;
-	source->refcount++;
 	client->event_source =
 		wl_event_loop_add_fd(loop, fd, WL_EVENT_WRITABLE,
 				     clipboard_client_data, client);
+	if (client->event_source == NULL) {
+		close(fd);
+		free(client);
+		return;
+	}
+	source->refcount++;
+}
+
+/* Whether the MIME type matches one of the comma separated patterns,
+ * each either a full type or a "major/*" wildcard. */
+static bool
+clipboard_mime_type_allowed(const char *patterns, const char *mime_type)
+{
+	const char *p, *end;
+	size_t len;
+
+	if (patterns == NULL)
+		return true;
+
+	for (p = patterns; *p; p = end + (*end == ',')) {
+		while (*p == ' ')
+			p++;
+		end = strchrnul(p, ',');
+		len = end - p;
+		while (len > 0 && p[len - 1] == ' ')
+			len--;
+		if (len == 0)
+			continue;
+
+		if (len == 1 && p[0] == '*')
+			return true;
+		if (len >= 2 && p[len - 2] == '/' && p[len - 1] == '*') {
+			if (strncmp(mime_type, p, len - 1) == 0)
+				return true;
+		} else if (strlen(mime_type) == len &&
+			   strncmp(mime_type, p, len) == 0) {
+			return true;
+		}
+	}
+
+	return false;
 }
 
 static void
@@ -239,7 +380,9 @@ clipboard_set_selection(struct wl_listener *listener, void *data)
 		container_of(listener, struct clipboard, selection_listener);
 	struct weston_seat *seat = data;
 	struct weston_data_source *source = seat->selection_data_source;
-	const char **mime_types;
+	const char *policy = seat->compositor->clipboard_mime_types;
+	const char **mime_types, *mime_type = NULL;
+	size_t i;
 	int p[2];
 
 	if (source == NULL) {
@@ -258,15 +401,22 @@ clipboard_set_selection(struct wl_listener *listener, void *data)
 
 	clipboard->source = NULL;
 
+	/* Persist the first offered type the policy allows */
 	mime_types = source->mime_types.data;
+	for (i = 0; i < source->mime_types.size / sizeof *mime_types; i++) {
+		if (clipboard_mime_type_allowed(policy, mime_types[i])) {
+			mime_type = mime_types[i];
+			break;
+		}
+	}
 
-	if (!mime_types || pipe2(p, O_CLOEXEC) == -1)
+	if (!mime_type || pipe2(p, O_CLOEXEC) == -1)
 		return;
 
-	source->send(source, mime_types[0], p[1]);
+	source->send(source, mime_type, p[1]);
 
 	clipboard->source =
-		clipboard_source_create(clipboard, mime_types[0],
+		clipboard_source_create(clipboard, mime_type,
 					seat->selection_serial, p[0]);
 	if (clipboard->source == NULL) {
 		close(p[0]);
@@ -306,3 +456,23 @@ clipboard_create(struct weston_seat *seat)
 
 	return clipboard;
 }
+
+/** Limit what the compositor keeps of the selection after its owner is gone
+ *
+ * \param compositor The compositor.
+ * \param size_limit Selections larger than this many bytes are dropped,
+ * 0 for no limit.
+ * \param mime_types Comma separated MIME types to keep, each either a full
+ * type or a "major/*" wildcard such as "text/*". NULL keeps any type.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_set_clipboard_policy(struct weston_compositor *compositor,
+				       uint64_t size_limit,
+				       const char *mime_types)
+{
+	free(compositor->clipboard_mime_types);
+	compositor->clipboard_mime_types = mime_types ? strdup(mime_types) : NULL;
+	compositor->clipboard_size_limit = size_limit;
+}
@@ -41,6 +41,39 @@ cmlcms_destroy_color_transform(struct weston_color_transform *xform_base)
 	cmlcms_color_transform_destroy(xform);
 }
 
+/*
+ * Without an output color profile, content and output are assumed to be
+ * sRGB SDR and the blending space is optical sRGB SDR.
+ *
+ * With an output color profile, blending happens in the output's electrical
+ * color space: content is mapped from sRGB to the output profile with the
+ * full ICC transformation, and the blending result needs no further
+ * transformation.
+ */
+static bool
+cmlcms_supports_output_profile(struct weston_color_manager_lcms *cm)
+{
+	/* The ICC transformation is evaluated as a 3D LUT */
+	return cm->base.compositor->capabilities & WESTON_CAP_COLOR_3DLUT;
+}
+
+static struct cmlcms_color_transform *
+cmlcms_get_sRGB_to_output_profile(struct weston_color_manager_lcms *cm,
+				  struct weston_output *output)
+{
+	struct cmlcms_color_transform_search_param param = {
+		.type = CMLCMS_TYPE_sRGB_TO_OUTPUT,
+		.input_profile = NULL,
+		.output_profile = get_cprof(output->color_profile),
+		.intent = INTENT_PERCEPTUAL,
+	};
+
+	if (!cmlcms_supports_output_profile(cm))
+		return NULL;
+
+	return cmlcms_color_transform_get(cm, &param);
+}
+
 static bool
 cmlcms_get_surface_color_transform(struct weston_color_manager *cm_base,
 				   struct weston_surface *surface,
@@ -50,16 +83,23 @@ cmlcms_get_surface_color_transform(struct weston_color_manager *cm_base,
 	struct weston_color_manager_lcms *cm = get_cmlcms(cm_base);
 	struct cmlcms_color_transform_search_param param = {
 		/*
-		 * Assumes both content and output color spaces are sRGB SDR.
+		 * Assumes content color space is sRGB SDR.
 		 * This defines the blending space as optical sRGB SDR.
 		 */
 		.type = CMLCMS_TYPE_EOTF_sRGB,
 	};
 	struct cmlcms_color_transform *xform;
 
-	/* TODO: use output color profile */
-	if (output->color_profile)
-		return false;
+	if (output->color_profile) {
+		xform = cmlcms_get_sRGB_to_output_profile(cm, output);
+		if (!xform)
+			return false;
+
+		surf_xform->transform = &xform->base;
+		surf_xform->identity_pipeline = false;
+
+		return true;
+	}
 
 	xform = cmlcms_color_transform_get(cm, &param);
 	if (!xform)
@@ -86,9 +126,14 @@ cmlcms_get_output_color_transform(struct weston_color_manager *cm_base,
 	};
 	struct cmlcms_color_transform *xform;
 
-	/* TODO: use output color profile */
-	if (output->color_profile)
-		return false;
+	/* Blending space is the output color space */
+	if (output->color_profile) {
+		if (!cmlcms_supports_output_profile(cm))
+			return false;
+
+		*xform_out = NULL;
+		return true;
+	}
 
 	xform = cmlcms_color_transform_get(cm, &param);
 	if (!xform)
@@ -103,11 +148,17 @@ cmlcms_get_sRGB_to_output_color_transform(struct weston_color_manager *cm_base,
 					  struct weston_output *output,
 					  struct weston_color_transform **xform_out)
 {
-	/* Assumes output color space is sRGB SDR */
+	struct weston_color_manager_lcms *cm = get_cmlcms(cm_base);
+	struct cmlcms_color_transform *xform;
 
-	/* TODO: use output color profile */
-	if (output->color_profile)
-		return false;
+	if (output->color_profile) {
+		xform = cmlcms_get_sRGB_to_output_profile(cm, output);
+		if (!xform)
+			return false;
+
+		*xform_out = &xform->base;
+		return true;
+	}
 
 	/* Identity transform */
 	*xform_out = NULL;
@@ -127,9 +178,14 @@ cmlcms_get_sRGB_to_blend_color_transform(struct weston_color_manager *cm_base,
 	};
 	struct cmlcms_color_transform *xform;
 
-	/* TODO: use output color profile */
-	if (output->color_profile)
-		return false;
+	if (output->color_profile) {
+		xform = cmlcms_get_sRGB_to_output_profile(cm, output);
+		if (!xform)
+			return false;
+
+		*xform_out = &xform->base;
+		return true;
+	}
 
 	xform = cmlcms_color_transform_get(cm, &param);
 	if (!xform)
@@ -174,8 +230,13 @@ static void
 cmlcms_destroy(struct weston_color_manager *cm_base)
 {
 	struct weston_color_manager_lcms *cm = get_cmlcms(cm_base);
+	unsigned i;
+
+	cmlcms_color_transform_cache_release(cm);
 
-	assert(wl_list_empty(&cm->color_transform_list));
+	for (i = 0; i < ARRAY_LENGTH(cm->color_transform_hash); i++)
+		assert(wl_list_empty(&cm->color_transform_hash[i]));
+	assert(wl_list_empty(&cm->color_transform_lru));
 	assert(wl_list_empty(&cm->color_profile_list));
 
 	cmsDeleteContext(cm->lcms_ctx);
@@ -186,6 +247,7 @@ WL_EXPORT struct weston_color_manager *
 weston_color_manager_create(struct weston_compositor *compositor)
 {
 	struct weston_color_manager_lcms *cm;
+	unsigned i;
 
 	cm = zalloc(sizeof *cm);
 	if (!cm)
@@ -207,7 +269,9 @@ weston_color_manager_create(struct weston_compositor *compositor)
 	cm->base.get_sRGB_to_blend_color_transform =
 	      cmlcms_get_sRGB_to_blend_color_transform;
 
-	wl_list_init(&cm->color_transform_list);
+	for (i = 0; i < ARRAY_LENGTH(cm->color_transform_hash); i++)
+		wl_list_init(&cm->color_transform_hash[i]);
+	wl_list_init(&cm->color_transform_lru);
 	wl_list_init(&cm->color_profile_list);
 
 	return &cm->base;
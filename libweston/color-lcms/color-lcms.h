@@ -33,11 +33,20 @@
 #include "color.h"
 #include "shared/helpers.h"
 
+#define CMLCMS_COLOR_TRANSFORM_HASH_SIZE 16
+
+/* Transformations kept alive by the color manager while unused */
+#define CMLCMS_COLOR_TRANSFORM_CACHE_SIZE 8
+
 struct weston_color_manager_lcms {
 	struct weston_color_manager base;
 	cmsContext lcms_ctx;
 
-	struct wl_list color_transform_list; /* cmlcms_color_transform::link */
+	/* cmlcms_color_transform::link, bucketed by search_key hash */
+	struct wl_list color_transform_hash[CMLCMS_COLOR_TRANSFORM_HASH_SIZE];
+	/* cmlcms_color_transform::lru_link, most recently used first */
+	struct wl_list color_transform_lru;
+	unsigned color_transform_lru_count;
 	struct wl_list color_profile_list; /* cmlcms_color_profile::link */
 };
 
@@ -85,23 +94,40 @@ cmlcms_destroy_color_profile(struct weston_color_profile *cprof_base);
 enum cmlcms_color_transform_type {
 	CMLCMS_TYPE_EOTF_sRGB = 0,
 	CMLCMS_TYPE_EOTF_sRGB_INV,
+	/* sRGB to output_profile, both electrical, as a 3D LUT */
+	CMLCMS_TYPE_sRGB_TO_OUTPUT,
 	CMLCMS_TYPE__END,
 };
 
 struct cmlcms_color_transform_search_param {
 	enum cmlcms_color_transform_type type;
+	/* for CMLCMS_TYPE_sRGB_TO_OUTPUT, NULL means built-in sRGB */
+	struct cmlcms_color_profile *input_profile;
+	/* for CMLCMS_TYPE_sRGB_TO_OUTPUT, otherwise NULL */
+	struct cmlcms_color_profile *output_profile;
+	/* ICC rendering intent, for CMLCMS_TYPE_sRGB_TO_OUTPUT */
+	cmsUInt32Number intent;
 };
 
 struct cmlcms_color_transform {
 	struct weston_color_transform base;
 
-	/* weston_color_manager_lcms::color_transform_list */
+	/* weston_color_manager_lcms::color_transform_hash */
 	struct wl_list link;
 
+	/* weston_color_manager_lcms::color_transform_lru, while the color
+	 * manager holds a reference */
+	struct wl_list lru_link;
+	bool cached;
+
 	struct cmlcms_color_transform_search_param search_key;
+	uint32_t search_hash;
 
 	/* for EOTF types */
 	cmsToneCurve *curve;
+
+	/* for CMLCMS_TYPE_sRGB_TO_OUTPUT */
+	cmsHTRANSFORM cmap_3dlut;
 };
 
 static inline struct cmlcms_color_transform *
@@ -117,4 +143,7 @@ cmlcms_color_transform_get(struct weston_color_manager_lcms *cm,
 void
 cmlcms_color_transform_destroy(struct cmlcms_color_transform *xform);
 
+void
+cmlcms_color_transform_cache_release(struct weston_color_manager_lcms *cm);
+
 #endif /* WESTON_COLOR_LCMS_H */
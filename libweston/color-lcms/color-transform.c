@@ -78,52 +78,210 @@ cmlcms_fill_in_tone_curve(struct weston_color_transform *xform_base,
 	}
 }
 
+static void
+cmlcms_fill_in_3dlut(struct weston_color_transform *xform_base,
+		     float *lut, unsigned len)
+{
+	struct cmlcms_color_transform *xform = get_xform(xform_base);
+	float divider = len - 1;
+	float *row;
+	unsigned r, g, b;
+
+	assert(xform->cmap_3dlut != NULL);
+	assert(len > 1);
+
+	/* Fill in the input values of one R row, then transform in place. */
+	for (b = 0; b < len; b++) {
+		for (g = 0; g < len; g++) {
+			row = lut + 3 * len * (g + len * b);
+			for (r = 0; r < len; r++) {
+				row[3 * r + 0] = r / divider;
+				row[3 * r + 1] = g / divider;
+				row[3 * r + 2] = b / divider;
+			}
+			cmsDoTransform(xform->cmap_3dlut, row, row, len);
+		}
+	}
+}
+
 void
 cmlcms_color_transform_destroy(struct cmlcms_color_transform *xform)
 {
 	wl_list_remove(&xform->link);
 	if (xform->curve)
 		cmsFreeToneCurve(xform->curve);
+	if (xform->cmap_3dlut)
+		cmsDeleteTransform(xform->cmap_3dlut);
+	if (xform->search_key.input_profile)
+		weston_color_profile_unref(&xform->search_key.input_profile->base);
+	if (xform->search_key.output_profile)
+		weston_color_profile_unref(&xform->search_key.output_profile->base);
 	free(xform);
 }
 
+static bool
+cmlcms_color_transform_init_eotf(struct weston_color_manager_lcms *cm,
+				 struct cmlcms_color_transform *xform,
+				 enum cmlcms_color_transform_type type)
+{
+	const struct tone_curve_def *tonedef = &predefined_eotf_curves[type];
+
+	xform->curve = cmsBuildParametricToneCurve(cm->lcms_ctx,
+						   tonedef->cmstype,
+						   tonedef->params);
+	if (xform->curve == NULL) {
+		weston_log("color-lcms error: failed to build parametric tone curve.\n");
+		return false;
+	}
+
+	xform->base.pre_curve.type = WESTON_COLOR_CURVE_TYPE_LUT_3x1D;
+	xform->base.pre_curve.u.lut_3x1d.fill_in = cmlcms_fill_in_tone_curve;
+	xform->base.pre_curve.u.lut_3x1d.optimal_len = 256;
+
+	return true;
+}
+
+/*
+ * The complete ICC-to-ICC transformation from sRGB to the output profile,
+ * sampled into a 3D LUT so that renderers evaluate it with one texture
+ * fetch. The LUT is indexed with electrical (non-linear) values, which
+ * spends its points more evenly than linear light would.
+ */
+static bool
+cmlcms_color_transform_init_3dlut(struct weston_color_manager_lcms *cm,
+				  struct cmlcms_color_transform *xform,
+		const struct cmlcms_color_transform_search_param *param)
+{
+	struct cmlcms_color_profile *output_profile = param->output_profile;
+	cmsHPROFILE input_profile;
+	cmsHPROFILE sRGB_profile = NULL;
+
+	assert(output_profile);
+
+	if (param->input_profile) {
+		input_profile = param->input_profile->profile;
+	} else {
+		sRGB_profile = cmsCreate_sRGBProfileTHR(cm->lcms_ctx);
+		if (!sRGB_profile) {
+			weston_log("color-lcms error: failed to create sRGB profile.\n");
+			return false;
+		}
+		input_profile = sRGB_profile;
+	}
+
+	xform->cmap_3dlut = cmsCreateTransformTHR(cm->lcms_ctx,
+						  input_profile, TYPE_RGB_FLT,
+						  output_profile->profile,
+						  TYPE_RGB_FLT,
+						  param->intent, 0);
+	if (sRGB_profile)
+		cmsCloseProfile(sRGB_profile);
+	if (!xform->cmap_3dlut) {
+		weston_log("color-lcms error: failed to create a transformation to %s.\n",
+			   output_profile->base.description);
+		return false;
+	}
+
+	xform->base.pre_curve.type = WESTON_COLOR_CURVE_TYPE_IDENTITY;
+	xform->base.mapping.type = WESTON_COLOR_MAPPING_TYPE_3D_LUT;
+	xform->base.mapping.u.lut3d.fill_in = cmlcms_fill_in_3dlut;
+	xform->base.mapping.u.lut3d.optimal_len = 33;
+
+	return true;
+}
+
+static uint32_t
+hash_u32(uint32_t hash, uint32_t value)
+{
+	return (hash ^ value) * 16777619u;
+}
+
+static uint32_t
+hash_ptr(uint32_t hash, const void *ptr)
+{
+	uint64_t value = (uintptr_t)ptr;
+
+	hash = hash_u32(hash, (uint32_t)value);
+	return hash_u32(hash, (uint32_t)(value >> 32));
+}
+
+static uint32_t
+search_param_hash(const struct cmlcms_color_transform_search_param *param)
+{
+	uint32_t hash = 2166136261u;
+
+	/* FNV-1a over every field that takes part in transform_matches_params() */
+	hash = hash_u32(hash, param->type);
+	hash = hash_ptr(hash, param->input_profile);
+	hash = hash_ptr(hash, param->output_profile);
+	hash = hash_u32(hash, param->intent);
+
+	/* Profile pointers differ only above their alignment, and FNV does
+	 * not carry high bits down to the bucket index; fold them in. */
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+
+	return hash;
+}
+
+static struct wl_list *
+transform_bucket(struct weston_color_manager_lcms *cm, uint32_t hash)
+{
+	return &cm->color_transform_hash[hash % CMLCMS_COLOR_TRANSFORM_HASH_SIZE];
+}
+
 static struct cmlcms_color_transform *
 cmlcms_color_transform_create(struct weston_color_manager_lcms *cm,
-			const struct cmlcms_color_transform_search_param *param)
+			const struct cmlcms_color_transform_search_param *param,
+			uint32_t hash)
 {
 	struct cmlcms_color_transform *xform;
-	const struct tone_curve_def *tonedef;
 
 	if (param->type < 0 || param->type >= CMLCMS_TYPE__END) {
 		weston_log("color-lcms error: bad color transform type in %s.\n",
 			   __func__);
 		return NULL;
 	}
-	tonedef = &predefined_eotf_curves[param->type];
 
 	xform = zalloc(sizeof *xform);
 	if (!xform)
 		return NULL;
 
-	xform->curve = cmsBuildParametricToneCurve(cm->lcms_ctx,
-						   tonedef->cmstype,
-						   tonedef->params);
-	if (xform->curve == NULL) {
-		weston_log("color-lcms error: failed to build parametric tone curve.\n");
-		free(xform);
-		return NULL;
+	switch (param->type) {
+	case CMLCMS_TYPE_EOTF_sRGB:
+	case CMLCMS_TYPE_EOTF_sRGB_INV:
+		if (!cmlcms_color_transform_init_eotf(cm, xform, param->type))
+			goto err;
+		break;
+	case CMLCMS_TYPE_sRGB_TO_OUTPUT:
+		if (!cmlcms_color_transform_init_3dlut(cm, xform, param))
+			goto err;
+		if (param->input_profile)
+			weston_color_profile_ref(&param->input_profile->base);
+		weston_color_profile_ref(&param->output_profile->base);
+		break;
+	case CMLCMS_TYPE__END:
+		assert(0);
+		goto err;
 	}
 
 	weston_color_transform_init(&xform->base, &cm->base);
 	xform->search_key = *param;
+	xform->search_hash = hash;
 
-	xform->base.pre_curve.type = WESTON_COLOR_CURVE_TYPE_LUT_3x1D;
-	xform->base.pre_curve.u.lut_3x1d.fill_in = cmlcms_fill_in_tone_curve;
-	xform->base.pre_curve.u.lut_3x1d.optimal_len = 256;
-
-	wl_list_insert(&cm->color_transform_list, &xform->link);
+	wl_list_insert(transform_bucket(cm, hash), &xform->link);
+	wl_list_init(&xform->lru_link);
 
 	return xform;
+
+err:
+	if (xform->curve)
+		cmsFreeToneCurve(xform->curve);
+	if (xform->cmap_3dlut)
+		cmsDeleteTransform(xform->cmap_3dlut);
+	free(xform);
+	return NULL;
 }
 
 static bool
@@ -133,25 +291,97 @@ transform_matches_params(const struct cmlcms_color_transform *xform,
 	if (xform->search_key.type != param->type)
 		return false;
 
+	if (xform->search_key.input_profile != param->input_profile)
+		return false;
+
+	if (xform->search_key.output_profile != param->output_profile)
+		return false;
+
+	if (xform->search_key.intent != param->intent)
+		return false;
+
 	return true;
 }
 
+/*
+ * The color manager keeps a reference of its own to the most recently
+ * used transformations, so that a surface or output asking again after
+ * the last user went away gets the same object, and the LUT textures
+ * renderers attached to it, instead of rebuilding them. Dropping the
+ * reference of the least recently used one bounds what stays alive.
+ */
+static void
+cmlcms_color_transform_cache_hold(struct weston_color_manager_lcms *cm,
+				  struct cmlcms_color_transform *xform)
+{
+	struct cmlcms_color_transform *oldest;
+
+	if (xform->cached) {
+		wl_list_remove(&xform->lru_link);
+		wl_list_insert(&cm->color_transform_lru, &xform->lru_link);
+		return;
+	}
+
+	weston_color_transform_ref(&xform->base);
+	wl_list_insert(&cm->color_transform_lru, &xform->lru_link);
+	xform->cached = true;
+	cm->color_transform_lru_count++;
+
+	while (cm->color_transform_lru_count >
+	       CMLCMS_COLOR_TRANSFORM_CACHE_SIZE) {
+		oldest = container_of(cm->color_transform_lru.prev,
+				      struct cmlcms_color_transform, lru_link);
+		wl_list_remove(&oldest->lru_link);
+		wl_list_init(&oldest->lru_link);
+		oldest->cached = false;
+		cm->color_transform_lru_count--;
+
+		/* still findable while other users hold it */
+		weston_color_transform_unref(&oldest->base);
+	}
+}
+
 struct cmlcms_color_transform *
 cmlcms_color_transform_get(struct weston_color_manager_lcms *cm,
 			   const struct cmlcms_color_transform_search_param *param)
 {
 	struct cmlcms_color_transform *xform;
+	uint32_t hash = search_param_hash(param);
 
-	wl_list_for_each(xform, &cm->color_transform_list, link) {
-		if (transform_matches_params(xform, param)) {
+	wl_list_for_each(xform, transform_bucket(cm, hash), link) {
+		if (xform->search_hash == hash &&
+		    transform_matches_params(xform, param)) {
 			weston_color_transform_ref(&xform->base);
+			cmlcms_color_transform_cache_hold(cm, xform);
 			return xform;
 		}
 	}
 
-	xform = cmlcms_color_transform_create(cm, param);
-	if (!xform)
+	xform = cmlcms_color_transform_create(cm, param, hash);
+	if (!xform) {
 		weston_log("color-lcms error: failed to create a color transformation.\n");
+		return NULL;
+	}
+
+	cmlcms_color_transform_cache_hold(cm, xform);
 
 	return xform;
 }
+
+/** Drop the color manager's own references to cached transformations
+ *
+ * Called on color manager destruction, when no other users remain.
+ */
+void
+cmlcms_color_transform_cache_release(struct weston_color_manager_lcms *cm)
+{
+	struct cmlcms_color_transform *xform, *tmp;
+
+	wl_list_for_each_safe(xform, tmp, &cm->color_transform_lru, lru_link) {
+		wl_list_remove(&xform->lru_link);
+		wl_list_init(&xform->lru_link);
+		xform->cached = false;
+		weston_color_transform_unref(&xform->base);
+	}
+	cm->color_transform_lru_count = 0;
+}
@@ -98,6 +98,61 @@ struct weston_color_curve {
 	} u;
 };
 
+/** Type or formula for a color mapping */
+enum weston_color_mapping_type {
+	/** Identity function, no-op */
+	WESTON_COLOR_MAPPING_TYPE_IDENTITY = 0,
+
+	/** Three-dimensional look-up table */
+	WESTON_COLOR_MAPPING_TYPE_3D_LUT,
+};
+
+/** 3D_LUT parameters */
+struct weston_color_mapping_3dlut {
+	/**
+	 * Approximate a color mapping with a 3D LUT
+	 *
+	 * A 3D LUT is a mapping from the unit cube [0.0, 1.0]^3 to RGB
+	 * triplets. Each axis is sampled at len points with a step of
+	 * 1.0 / (len - 1), the first point corresponding to 0.0 and the last
+	 * to 1.0. When the input is between points, trilinear interpolation
+	 * should be used.
+	 *
+	 * This function fills in the given array with the LUT values.
+	 *
+	 * \param xform This color transformation object.
+	 * \param lut Array of 3 x len x len x len elements. Each element is
+	 * an RGB triplet, the R input index varies fastest and the B input
+	 * index slowest, i.e. the triplet for input indices (r, g, b) starts
+	 * at lut[3 * (r + len * (g + len * b))].
+	 * \param len The number of points on each axis.
+	 */
+	void
+	(*fill_in)(struct weston_color_transform *xform,
+		   float *lut, unsigned len);
+
+	/** Optimal 3D LUT size along one axis for storage vs. precision */
+	unsigned optimal_len;
+};
+
+/**
+ * A three-dimensional color mapping
+ *
+ * This object can represent a function that maps RGB triplets to RGB
+ * triplets with arbitrary cross-channel dependencies, for example the
+ * complete transformation from one ICC profile to another.
+ */
+struct weston_color_mapping {
+	/** Which member of 'u' defines the color mapping. */
+	enum weston_color_mapping_type type;
+
+	/** Parameters for the color mapping. */
+	union {
+		/* identity: no parameters */
+		struct weston_color_mapping_3dlut lut3d;
+	} u;
+};
+
 /**
  * Describes a color transformation formula
  *
@@ -106,7 +161,8 @@ struct weston_color_curve {
  * Sub-classed by the color manager that created this.
  *
  * For a renderer to support WESTON_CAP_COLOR_OPS it must implement everything
- * that this structure can represent.
+ * that this structure can represent, except the 3D LUT color mapping, which
+ * is WESTON_CAP_COLOR_3DLUT.
  */
 struct weston_color_transform {
 	struct weston_color_manager *cm;
@@ -124,7 +180,7 @@ struct weston_color_transform {
 	struct weston_color_curve pre_curve;
 
 	/** Step 3: color mapping */
-	/* TBD: e.g. a 3D LUT or a matrix */
+	struct weston_color_mapping mapping;
 
 	/** Step 4: color curve after color mapping */
 	/* struct weston_color_curve post_curve; */
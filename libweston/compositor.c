@@ -52,6 +52,7 @@
 #include <time.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <poll.h>
 
 #include "timeline.h"
 
@@ -73,6 +74,10 @@
 #include <libweston/version.h>
 #include <libweston/plugin-registry.h>
 #include "pixel-formats.h"
+#include "region-arena.h"
+#include "frame-throttle.h"
+#include "memory-accounting.h"
+#include "dispatch-stats.h"
 #include "backend.h"
 #include "libweston-internal.h"
 #include "color.h"
@@ -526,6 +531,9 @@ weston_surface_state_init(struct weston_surface_state *state)
 	pixman_region32_init(&state->damage_buffer);
 	pixman_region32_init(&state->opaque);
 	region_init_infinite(&state->input);
+	/* Generation 0 is never valid, see weston_surface_commit_state() */
+	state->opaque_generation = 1;
+	state->input_generation = 1;
 
 	wl_list_init(&state->frame_callback_list);
 	wl_list_init(&state->feedback_list);
@@ -601,6 +609,7 @@ weston_surface_create(struct weston_compositor *compositor)
 	surface->buffer_viewport.surface.width = -1;
 
 	weston_surface_state_init(&surface->pending);
+	weston_surface_state_init(&surface->fence_wait.state);
 
 	pixman_region32_init(&surface->damage);
 	pixman_region32_init(&surface->opaque);
@@ -610,6 +619,8 @@ weston_surface_create(struct weston_compositor *compositor)
 	wl_list_init(&surface->paint_node_list);
 
 	wl_list_init(&surface->frame_callback_list);
+	wl_list_init(&surface->frame_throttle_link);
+	wl_list_init(&surface->memory_link);
 	wl_list_init(&surface->feedback_list);
 
 	wl_list_init(&surface->subsurface_list);
@@ -2329,6 +2340,13 @@ weston_surface_destroy(struct weston_surface *surface)
 
 	weston_surface_state_fini(&surface->pending);
 
+	if (surface->fence_wait.source)
+		wl_event_source_remove(surface->fence_wait.source);
+	if (surface->fence_wait.idle)
+		wl_event_source_remove(surface->fence_wait.idle);
+	weston_surface_state_fini(&surface->fence_wait.state);
+	weston_buffer_reference(&surface->fence_wait.buffer_ref, NULL);
+
 	weston_buffer_reference(&surface->buffer_ref, NULL);
 	weston_buffer_release_reference(&surface->buffer_release_ref, NULL);
 
@@ -2338,6 +2356,7 @@ weston_surface_destroy(struct weston_surface *surface)
 
 	wl_resource_for_each_safe(cb, next, &surface->frame_callback_list)
 		wl_resource_destroy(cb);
+	weston_frame_throttle_forget(surface);
 
 	weston_presentation_feedback_discard_list(&surface->feedback_list);
 
@@ -2348,6 +2367,8 @@ weston_surface_destroy(struct weston_surface *surface)
 
 	fd_clear(&surface->acquire_fence_fd);
 
+	weston_memory_surface_fini(surface);
+
 	free(surface);
 }
 
@@ -2381,6 +2402,7 @@ weston_buffer_destroy_handler(struct wl_listener *listener, void *data)
 		container_of(listener, struct weston_buffer, destroy_listener);
 
 	weston_signal_emit_mutable(&buffer->destroy_signal, buffer);
+	weston_memory_uncharge_buffer(buffer);
 	free(buffer);
 }
 
@@ -2511,6 +2533,15 @@ static void
 weston_surface_attach(struct weston_surface *surface,
 		      struct weston_buffer *buffer)
 {
+	struct weston_memory_accounting *ma = surface->compositor->memory;
+
+	/* Refuse a buffer over the client's limit before the renderer
+	 * imports it, the client is on its way out then. */
+	if (buffer && !weston_memory_charge_buffer(ma, buffer)) {
+		wl_client_post_no_memory(wl_resource_get_client(buffer->resource));
+		return;
+	}
+
 	weston_buffer_reference(&surface->buffer_ref, buffer);
 
 	if (!buffer) {
@@ -2520,6 +2551,14 @@ weston_surface_attach(struct weston_surface *surface,
 
 	surface->compositor->renderer->attach(surface, buffer);
 
+	/* EGL buffers only get a size from the renderer, so they can only
+	 * be charged, or refused, after it had a look at them. */
+	if (buffer && !weston_memory_charge_buffer(ma, buffer)) {
+		wl_client_post_no_memory(wl_resource_get_client(buffer->resource));
+		weston_surface_attach(surface, NULL);
+		return;
+	}
+
 	weston_surface_calculate_size_from_buffer(surface);
 	weston_presentation_feedback_discard_list(&surface->feedback_list);
 }
@@ -2561,65 +2600,99 @@ surface_flush_damage(struct weston_surface *surface)
 		TL_POINT(surface->compositor, "core_flush_damage", TLP_SURFACE(surface),
 			 TLP_OUTPUT(surface->output), TLP_END);
 
-	pixman_region32_clear(&surface->damage);
+	weston_region_empty(&surface->damage);
 }
 
+/*
+ * All temporaries come from the compositor's region arena, and every
+ * operation writes into a region distinct from its operands, so that
+ * pixman can reuse the storage of earlier frames. An arena that cannot
+ * grow hands out plain regions instead, finished before returning.
+ */
 static void
 view_accumulate_damage(struct weston_view *view,
 		       pixman_region32_t *opaque)
 {
-	pixman_region32_t damage;
+	struct weston_region_arena *arena = view->surface->compositor->region_arena;
+	pixman_region32_t damage_fallback, tmp_fallback;
+	pixman_region32_t *damage;
+	pixman_region32_t *tmp;
 
-	pixman_region32_init(&damage);
-	if (view->transform.enabled) {
-		pixman_box32_t *extents;
+	weston_region_arena_copy(arena, &view->clip, opaque);
+
+	tmp = weston_region_arena_get_or_init(arena, &tmp_fallback);
+	weston_region_arena_union(arena, tmp, opaque,
+				  &view->transform.opaque);
+	weston_region_swap(opaque, tmp);
+
+	/* Most surfaces are not damaged in most frames */
+	if (!pixman_region32_not_empty(&view->surface->damage)) {
+		weston_region_arena_release(tmp, &tmp_fallback);
+		return;
+	}
 
-		extents = pixman_region32_extents(&view->surface->damage);
-		view_compute_bbox(view, extents, &damage);
+	damage = weston_region_arena_get_or_init(arena, &damage_fallback);
+	if (view->transform.enabled) {
+		pixman_region32_t bbox;
+
+		/* A single rectangle, never allocates */
+		view_compute_bbox(view,
+				  pixman_region32_extents(&view->surface->damage),
+				  &bbox);
+		weston_region_arena_intersect(arena, tmp, &bbox,
+					      &view->transform.boundingbox);
+		pixman_region32_fini(&bbox);
 	} else {
-		pixman_region32_copy(&damage, &view->surface->damage);
-		pixman_region32_translate(&damage,
+		weston_region_arena_copy(arena, damage, &view->surface->damage);
+		pixman_region32_translate(damage,
 					  view->geometry.x, view->geometry.y);
+		weston_region_arena_intersect(arena, tmp, damage,
+					      &view->transform.boundingbox);
 	}
 
-	pixman_region32_intersect(&damage, &damage,
-				  &view->transform.boundingbox);
-	pixman_region32_subtract(&damage, &damage, opaque);
-	pixman_region32_union(&view->plane->damage,
-			      &view->plane->damage, &damage);
-	pixman_region32_fini(&damage);
-	pixman_region32_copy(&view->clip, opaque);
-	pixman_region32_union(opaque, opaque, &view->transform.opaque);
+	/* view->clip is the opaque region above this view */
+	weston_region_arena_subtract(arena, damage, tmp, &view->clip);
+	weston_region_arena_union(arena, tmp, &view->plane->damage, damage);
+	weston_region_swap(&view->plane->damage, tmp);
+
+	weston_region_arena_release(damage, &damage_fallback);
+	weston_region_arena_release(tmp, &tmp_fallback);
 }
 
 static void
 output_accumulate_damage(struct weston_output *output)
 {
 	struct weston_compositor *ec = output->compositor;
+	struct weston_region_arena *arena = ec->region_arena;
 	struct weston_plane *plane;
 	struct weston_paint_node *pnode;
-	pixman_region32_t opaque, clip;
+	pixman_region32_t opaque_fallback, clip_fallback, tmp_fallback;
+	pixman_region32_t *opaque, *clip, *tmp;
 
-	pixman_region32_init(&clip);
+	clip = weston_region_arena_get_or_init(arena, &clip_fallback);
+	opaque = weston_region_arena_get_or_init(arena, &opaque_fallback);
+	tmp = weston_region_arena_get_or_init(arena, &tmp_fallback);
 
 	wl_list_for_each(plane, &ec->plane_list, link) {
-		pixman_region32_copy(&plane->clip, &clip);
+		weston_region_arena_copy(arena, &plane->clip, clip);
 
-		pixman_region32_init(&opaque);
+		weston_region_empty(opaque);
 
 		wl_list_for_each(pnode, &output->paint_node_z_order_list,
 				 z_order_link) {
 			if (pnode->view->plane != plane)
 				continue;
 
-			view_accumulate_damage(pnode->view, &opaque);
+			view_accumulate_damage(pnode->view, opaque);
 		}
 
-		pixman_region32_union(&clip, &clip, &opaque);
-		pixman_region32_fini(&opaque);
+		weston_region_arena_union(arena, tmp, clip, opaque);
+		weston_region_swap(clip, tmp);
 	}
 
-	pixman_region32_fini(&clip);
+	weston_region_arena_release(clip, &clip_fallback);
+	weston_region_arena_release(opaque, &opaque_fallback);
+	weston_region_arena_release(tmp, &tmp_fallback);
 
 	wl_list_for_each(pnode, &output->paint_node_z_order_list,
 			 z_order_link) {
@@ -2872,7 +2945,8 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 	struct weston_animation *animation, *next;
 	struct wl_resource *cb, *cnext;
 	struct wl_list frame_callback_list;
-	pixman_region32_t output_damage;
+	pixman_region32_t output_damage_fallback, tmp_fallback;
+	pixman_region32_t *output_damage, *tmp;
 	int r;
 	uint32_t frame_time_msec;
 	enum weston_hdcp_protection highest_requested = WESTON_HDCP_DISABLE;
@@ -2914,6 +2988,9 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 		}
 	}
 
+	output_accumulate_damage(output);
+
+	/* After the damage pass, which computes view clips for occlusion */
 	wl_list_init(&frame_callback_list);
 	wl_list_for_each(pnode, &output->paint_node_z_order_list,
 			 z_order_link) {
@@ -2921,28 +2998,35 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 		 * same surface.
 		 */
 		if (pnode->surface->output == output) {
+			weston_output_take_feedback_list(output, pnode->surface);
+
+			if (weston_frame_throttle_hold(ec->frame_throttle,
+						       pnode->surface, output))
+				continue;
+
 			wl_list_insert_list(&frame_callback_list,
 					    &pnode->surface->frame_callback_list);
 			wl_list_init(&pnode->surface->frame_callback_list);
-
-			weston_output_take_feedback_list(output, pnode->surface);
 		}
 	}
 
-	output_accumulate_damage(output);
-
-	pixman_region32_init(&output_damage);
-	pixman_region32_intersect(&output_damage,
-				  &ec->primary_plane.damage, &output->region);
-	pixman_region32_subtract(&output_damage,
-				 &output_damage, &ec->primary_plane.clip);
+	tmp = weston_region_arena_get_or_init(ec->region_arena, &tmp_fallback);
+	output_damage = weston_region_arena_get_or_init(ec->region_arena,
+							&output_damage_fallback);
+	weston_region_arena_intersect(ec->region_arena, tmp,
+				      &ec->primary_plane.damage,
+				      &output->region);
+	weston_region_arena_subtract(ec->region_arena, output_damage,
+				     tmp, &ec->primary_plane.clip);
 
 	if (output->dirty)
 		weston_output_update_matrix(output);
 
-	r = output->repaint(output, &output_damage, repaint_data);
+	r = output->repaint(output, output_damage, repaint_data);
 
-	pixman_region32_fini(&output_damage);
+	weston_region_arena_release(output_damage, &output_damage_fallback);
+	weston_region_arena_release(tmp, &tmp_fallback);
+	weston_region_arena_reset(ec->region_arena);
 
 	output->repaint_needed = false;
 	if (r == 0)
@@ -3505,6 +3589,56 @@ surface_frame(struct wl_client *client,
 		       wl_resource_get_link(cb));
 }
 
+/** Replace the pending opaque region of a surface with a rectangle
+ *
+ * \param surface The surface.
+ * \param x, y, width, height The rectangle in surface coordinates. An
+ * empty rectangle clears the opaque region.
+ *
+ * For shells and window managers that set regions on behalf of a client.
+ * Writing surface->pending.opaque directly would not be noticed by the
+ * next commit.
+ *
+ * \ingroup surface
+ */
+WL_EXPORT void
+weston_surface_set_pending_opaque_rect(struct weston_surface *surface,
+				       int32_t x, int32_t y,
+				       int32_t width, int32_t height)
+{
+	pixman_region32_fini(&surface->pending.opaque);
+	if (width > 0 && height > 0)
+		pixman_region32_init_rect(&surface->pending.opaque,
+					  x, y, width, height);
+	else
+		pixman_region32_init(&surface->pending.opaque);
+	surface->pending.opaque_generation++;
+}
+
+/** Replace the pending input region of a surface with a rectangle
+ *
+ * \param surface The surface.
+ * \param x, y, width, height The rectangle in surface coordinates. An
+ * empty rectangle makes the surface take no input.
+ *
+ * See weston_surface_set_pending_opaque_rect().
+ *
+ * \ingroup surface
+ */
+WL_EXPORT void
+weston_surface_set_pending_input_rect(struct weston_surface *surface,
+				      int32_t x, int32_t y,
+				      int32_t width, int32_t height)
+{
+	pixman_region32_fini(&surface->pending.input);
+	if (width > 0 && height > 0)
+		pixman_region32_init_rect(&surface->pending.input,
+					  x, y, width, height);
+	else
+		pixman_region32_init(&surface->pending.input);
+	surface->pending.input_generation++;
+}
+
 static void
 surface_set_opaque_region(struct wl_client *client,
 			  struct wl_resource *resource,
@@ -3520,6 +3654,7 @@ surface_set_opaque_region(struct wl_client *client,
 	} else {
 		pixman_region32_clear(&surface->pending.opaque);
 	}
+	surface->pending.opaque_generation++;
 }
 
 static void
@@ -3538,6 +3673,7 @@ surface_set_input_region(struct wl_client *client,
 		pixman_region32_fini(&surface->pending.input);
 		region_init_infinite(&surface->pending.input);
 	}
+	surface->pending.input_generation++;
 }
 
 /* Cause damage to this sub-surface and all its children.
@@ -3802,6 +3938,7 @@ weston_surface_commit_state(struct weston_surface *surface,
 {
 	struct weston_view *view;
 	pixman_region32_t opaque;
+	bool size_changed;
 
 	/* wl_surface.set_buffer_transform */
 	/* wl_surface.set_buffer_scale */
@@ -3853,22 +3990,44 @@ weston_surface_commit_state(struct weston_surface *surface,
 				       0, 0, surface->width, surface->height);
 	pixman_region32_clear(&state->damage_surface);
 
+	/*
+	 * Opaque and input regions are sticky, most commits repeat the
+	 * previous ones. Clip them again only if either they or the
+	 * surface size changed.
+	 */
+	size_changed = surface->committed_regions.width != surface->width ||
+		       surface->committed_regions.height != surface->height;
+	surface->committed_regions.width = surface->width;
+	surface->committed_regions.height = surface->height;
+
 	/* wl_surface.set_opaque_region */
-	pixman_region32_init(&opaque);
-	pixman_region32_intersect_rect(&opaque, &state->opaque,
-				       0, 0, surface->width, surface->height);
+	if (size_changed || surface->committed_regions.opaque_generation !=
+			    state->opaque_generation) {
+		pixman_region32_init(&opaque);
+		pixman_region32_intersect_rect(&opaque, &state->opaque,
+					       0, 0,
+					       surface->width, surface->height);
+
+		if (!pixman_region32_equal(&opaque, &surface->opaque)) {
+			pixman_region32_copy(&surface->opaque, &opaque);
+			wl_list_for_each(view, &surface->views, surface_link)
+				weston_view_geometry_dirty(view);
+		}
 
-	if (!pixman_region32_equal(&opaque, &surface->opaque)) {
-		pixman_region32_copy(&surface->opaque, &opaque);
-		wl_list_for_each(view, &surface->views, surface_link)
-			weston_view_geometry_dirty(view);
+		pixman_region32_fini(&opaque);
+		surface->committed_regions.opaque_generation =
+			state->opaque_generation;
 	}
 
-	pixman_region32_fini(&opaque);
-
 	/* wl_surface.set_input_region */
-	pixman_region32_intersect_rect(&surface->input, &state->input,
-				       0, 0, surface->width, surface->height);
+	if (size_changed || surface->committed_regions.input_generation !=
+			    state->input_generation) {
+		pixman_region32_intersect_rect(&surface->input, &state->input,
+					       0, 0,
+					       surface->width, surface->height);
+		surface->committed_regions.input_generation =
+			state->input_generation;
+	}
 
 	/* wl_surface.frame */
 	wl_list_insert_list(&surface->frame_callback_list,
@@ -3913,6 +4072,150 @@ static void
 weston_subsurface_parent_commit(struct weston_subsurface *sub,
 				int parent_is_synchronized);
 
+static void
+weston_surface_cache_pending(struct weston_surface *surface,
+			     struct weston_surface_state *cached,
+			     struct weston_buffer_reference *cached_buffer_ref);
+
+static bool
+sync_file_is_signaled(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return poll(&pfd, 1, 0) == 1;
+}
+
+/* Apply a commit that was waiting for its acquire fence */
+static void
+weston_surface_commit_fence_wait(struct weston_surface *surface)
+{
+	struct weston_subsurface *sub;
+
+	if (surface->fence_wait.source) {
+		wl_event_source_remove(surface->fence_wait.source);
+		surface->fence_wait.source = NULL;
+	}
+	if (surface->fence_wait.idle) {
+		wl_event_source_remove(surface->fence_wait.idle);
+		surface->fence_wait.idle = NULL;
+	}
+
+	if (surface->fence_wait.state.acquire_fence_fd >= 0)
+		TL_POINT(surface->compositor, "core_commit_fence_signaled",
+			 TLP_SURFACE(surface), TLP_END);
+
+	weston_surface_commit_state(surface, &surface->fence_wait.state);
+	weston_buffer_reference(&surface->fence_wait.buffer_ref, NULL);
+
+	weston_surface_commit_subsurface_order(surface);
+
+	weston_surface_schedule_repaint(surface);
+
+	wl_list_for_each(sub, &surface->subsurface_list, parent_link) {
+		if (sub->surface != surface)
+			weston_subsurface_parent_commit(sub, 0);
+	}
+}
+
+static int
+weston_surface_fence_signaled(int fd, uint32_t mask, void *data)
+{
+	struct weston_surface *surface = data;
+
+	weston_surface_commit_fence_wait(surface);
+
+	return 0;
+}
+
+static int
+weston_surface_commit_idle(void *data)
+{
+	struct weston_surface *surface = data;
+
+	surface->fence_wait.idle = NULL;
+	weston_surface_commit_fence_wait(surface);
+
+	return 0;
+}
+
+/** Hold back a commit whose buffer is not ready yet
+ *
+ * A commit with an unsignaled acquire fence is cached instead of applied,
+ * so that outputs keep showing the previous buffer rather than having
+ * the renderer or the display controller wait on the fence. Commits
+ * arriving while one is held back are folded into it, and the held back
+ * state waits only for the fence of the newest buffer: buffers that were
+ * never ready in time are skipped. The wait shows up in the timeline
+ * between core_commit_fence_wait and core_commit_fence_signaled.
+ *
+ * Only commits applied directly are held back; synchronized sub-surfaces
+ * apply their cache with their parent and let the renderer wait.
+ *
+ * The same goes for commits of a client over its commit budget for this
+ * loop iteration, see weston_compositor_set_commit_budget(). Those are
+ * folded until the event loop is idle.
+ *
+ * \return true if the pending state was taken over.
+ */
+static bool
+weston_surface_defer_commit(struct weston_surface *surface)
+{
+	struct wl_event_loop *loop;
+	bool over_budget;
+	int fd;
+
+	over_budget =
+		weston_dispatch_charge_commit(surface->compositor->dispatch_stats,
+					      wl_resource_get_client(surface->resource));
+
+	if (!surface->fence_wait.source && !surface->fence_wait.idle) {
+		fd = surface->pending.acquire_fence_fd;
+		if (!surface->pending.newly_attached || fd < 0 ||
+		    sync_file_is_signaled(fd)) {
+			if (!over_budget)
+				return false;
+		} else {
+			TL_POINT(surface->compositor, "core_commit_fence_wait",
+				 TLP_SURFACE(surface), TLP_END);
+		}
+	}
+
+	weston_surface_cache_pending(surface, &surface->fence_wait.state,
+				     &surface->fence_wait.buffer_ref);
+
+	if (surface->fence_wait.source) {
+		wl_event_source_remove(surface->fence_wait.source);
+		surface->fence_wait.source = NULL;
+	}
+
+	loop = wl_display_get_event_loop(surface->compositor->wl_display);
+
+	fd = surface->fence_wait.state.acquire_fence_fd;
+	if (fd < 0 || sync_file_is_signaled(fd)) {
+		if (over_budget && !surface->fence_wait.idle)
+			surface->fence_wait.idle =
+				wl_event_loop_add_idle(loop,
+						       weston_surface_commit_idle,
+						       surface);
+		if (!surface->fence_wait.idle)
+			weston_surface_commit_fence_wait(surface);
+		return true;
+	}
+
+	if (surface->fence_wait.idle) {
+		wl_event_source_remove(surface->fence_wait.idle);
+		surface->fence_wait.idle = NULL;
+	}
+
+	surface->fence_wait.source =
+		wl_event_loop_add_fd(loop, fd, WL_EVENT_READABLE,
+				     weston_surface_fence_signaled, surface);
+	if (!surface->fence_wait.source)
+		weston_surface_commit_fence_wait(surface);
+
+	return true;
+}
+
 static void
 surface_commit(struct wl_client *client, struct wl_resource *resource)
 {
@@ -3984,6 +4287,9 @@ surface_commit(struct wl_client *client, struct wl_resource *resource)
 		return;
 	}
 
+	if (weston_surface_defer_commit(surface))
+		return;
+
 	weston_surface_commit(surface);
 
 	wl_list_for_each(sub, &surface->subsurface_list, parent_link) {
@@ -4095,6 +4401,8 @@ compositor_create_surface(struct wl_client *client,
 	wl_resource_set_implementation(surface->resource, &surface_interface,
 				       surface, destroy_surface);
 
+	weston_memory_surface_init(surface, client);
+
 	wl_signal_emit(&ec->create_surface_signal, surface);
 
 	return;
@@ -4193,68 +4501,100 @@ weston_subsurface_commit_from_cache(struct weston_subsurface *sub)
 	sub->has_cached_data = 0;
 }
 
+/** Fold the pending state of a surface into a cached state
+ *
+ * Used by synchronized sub-surfaces and by commits waiting for their
+ * acquire fence. The cached state accumulates damage, callbacks and
+ * feedback; a newly attached buffer replaces the cached one.
+ */
 static void
-weston_subsurface_commit_to_cache(struct weston_subsurface *sub)
+weston_surface_cache_pending(struct weston_surface *surface,
+			     struct weston_surface_state *cached,
+			     struct weston_buffer_reference *cached_buffer_ref)
 {
-	struct weston_surface *surface = sub->surface;
-
-	/*
-	 * If this commit would cause the surface to move by the
-	 * attach(dx, dy) parameters, the old damage region must be
-	 * translated to correspond to the new surface coordinate system
-	 * origin.
-	 */
-	pixman_region32_translate(&sub->cached.damage_surface,
-				  -surface->pending.sx, -surface->pending.sy);
-	pixman_region32_union(&sub->cached.damage_surface,
-			      &sub->cached.damage_surface,
-			      &surface->pending.damage_surface);
-	pixman_region32_clear(&surface->pending.damage_surface);
+	if (pixman_region32_not_empty(&cached->damage_surface)) {
+		/*
+		 * If this commit would cause the surface to move by the
+		 * attach(dx, dy) parameters, the old damage region must be
+		 * translated to correspond to the new surface coordinate
+		 * system origin.
+		 */
+		pixman_region32_translate(&cached->damage_surface,
+					  -surface->pending.sx,
+					  -surface->pending.sy);
+		pixman_region32_union(&cached->damage_surface,
+				      &cached->damage_surface,
+				      &surface->pending.damage_surface);
+		pixman_region32_clear(&surface->pending.damage_surface);
+	} else {
+		/* Nothing accumulated yet: hand the damage over, and give
+		 * the empty region's storage back to pending. */
+		weston_region_swap(&cached->damage_surface,
+			    &surface->pending.damage_surface);
+	}
 
 	if (surface->pending.newly_attached) {
-		sub->cached.newly_attached = 1;
-		weston_surface_state_set_buffer(&sub->cached,
+		cached->newly_attached = 1;
+		weston_surface_state_set_buffer(cached,
 						surface->pending.buffer);
-		weston_buffer_reference(&sub->cached_buffer_ref,
+		weston_buffer_reference(cached_buffer_ref,
 					surface->pending.buffer);
 		weston_presentation_feedback_discard_list(
-					&sub->cached.feedback_list);
+					&cached->feedback_list);
 		/* zwp_surface_synchronization_v1.set_acquire_fence */
-		fd_move(&sub->cached.acquire_fence_fd,
+		fd_move(&cached->acquire_fence_fd,
 			&surface->pending.acquire_fence_fd);
 		/* zwp_surface_synchronization_v1.get_release */
-		weston_buffer_release_move(&sub->cached.buffer_release_ref,
+		weston_buffer_release_move(&cached->buffer_release_ref,
 					   &surface->pending.buffer_release_ref);
 	}
-	sub->cached.desired_protection = surface->pending.desired_protection;
-	sub->cached.protection_mode = surface->pending.protection_mode;
+	cached->desired_protection = surface->pending.desired_protection;
+	cached->protection_mode = surface->pending.protection_mode;
 	assert(surface->pending.acquire_fence_fd == -1);
 	assert(surface->pending.buffer_release_ref.buffer_release == NULL);
-	sub->cached.sx += surface->pending.sx;
-	sub->cached.sy += surface->pending.sy;
+	cached->sx += surface->pending.sx;
+	cached->sy += surface->pending.sy;
 
-	apply_damage_buffer(&sub->cached.damage_surface, surface, &surface->pending);
+	apply_damage_buffer(&cached->damage_surface, surface, &surface->pending);
 
-	sub->cached.buffer_viewport.changed |=
+	cached->buffer_viewport.changed |=
 		surface->pending.buffer_viewport.changed;
-	sub->cached.buffer_viewport.buffer =
+	cached->buffer_viewport.buffer =
 		surface->pending.buffer_viewport.buffer;
-	sub->cached.buffer_viewport.surface =
+	cached->buffer_viewport.surface =
 		surface->pending.buffer_viewport.surface;
 
 	weston_surface_reset_pending_buffer(surface);
 
-	pixman_region32_copy(&sub->cached.opaque, &surface->pending.opaque);
+	/* Pending opaque and input regions are sticky, copy only changes */
+	if (cached->opaque_generation != surface->pending.opaque_generation) {
+		pixman_region32_copy(&cached->opaque,
+				     &surface->pending.opaque);
+		cached->opaque_generation =
+			surface->pending.opaque_generation;
+	}
 
-	pixman_region32_copy(&sub->cached.input, &surface->pending.input);
+	if (cached->input_generation != surface->pending.input_generation) {
+		pixman_region32_copy(&cached->input,
+				     &surface->pending.input);
+		cached->input_generation =
+			surface->pending.input_generation;
+	}
 
-	wl_list_insert_list(&sub->cached.frame_callback_list,
+	wl_list_insert_list(&cached->frame_callback_list,
 			    &surface->pending.frame_callback_list);
 	wl_list_init(&surface->pending.frame_callback_list);
 
-	wl_list_insert_list(&sub->cached.feedback_list,
+	wl_list_insert_list(&cached->feedback_list,
 			    &surface->pending.feedback_list);
 	wl_list_init(&surface->pending.feedback_list);
+}
+
+static void
+weston_subsurface_commit_to_cache(struct weston_subsurface *sub)
+{
+	weston_surface_cache_pending(sub->surface, &sub->cached,
+				     &sub->cached_buffer_ref);
 
 	sub->has_cached_data = 1;
 }
@@ -4283,12 +4623,18 @@ weston_subsurface_commit(struct weston_subsurface *sub)
 
 	/* Recursive check for effectively synchronized. */
 	if (weston_subsurface_is_synchronized(sub)) {
+		/* Keep commit order when switched from desync while a
+		 * commit was held back for its fence. */
+		if (sub->surface->fence_wait.source)
+			weston_surface_commit_fence_wait(sub->surface);
 		weston_subsurface_commit_to_cache(sub);
 	} else {
 		if (sub->has_cached_data) {
 			/* flush accumulated state from cache */
 			weston_subsurface_commit_to_cache(sub);
 			weston_subsurface_commit_from_cache(sub);
+		} else if (weston_surface_defer_commit(surface)) {
+			return;
 		} else {
 			weston_surface_commit(surface);
 		}
@@ -7651,6 +7997,14 @@ weston_compositor_print_scene_graph(struct weston_compositor *ec)
 
 	fprintf(fp, "\n");
 
+	fprintf(fp, "Damage region arena: %u regions, "
+		"%" PRIu64 " storage allocations in %" PRIu64 " frames, "
+		"%" PRIu64 " in the last frame\n\n",
+		(unsigned) (ec->region_arena->slots.size /
+			    sizeof(pixman_region32_t *)),
+		ec->region_arena->allocations, ec->region_arena->frames,
+		ec->region_arena->last_frame_allocations);
+
 	wl_list_for_each(layer, &ec->layer_list, link) {
 		struct weston_view *view;
 		int view_idx = 0;
@@ -7779,6 +8133,36 @@ weston_compositor_create(struct wl_display *display,
 
 	ec->content_protection = NULL;
 
+	ec->region_arena = zalloc(sizeof *ec->region_arena);
+	if (!ec->region_arena)
+		goto fail;
+	weston_region_arena_init(ec->region_arena);
+
+	ec->frame_throttle = zalloc(sizeof *ec->frame_throttle);
+	if (!ec->frame_throttle)
+		goto fail;
+	if (weston_frame_throttle_init(ec->frame_throttle, ec) < 0) {
+		free(ec->frame_throttle);
+		ec->frame_throttle = NULL;
+		goto fail;
+	}
+
+	ec->memory = zalloc(sizeof *ec->memory);
+	if (!ec->memory)
+		goto fail;
+	weston_memory_accounting_init(ec->memory, ec);
+
+	ec->dispatch_stats = zalloc(sizeof *ec->dispatch_stats);
+	if (!ec->dispatch_stats)
+		goto fail;
+	if (weston_dispatch_stats_init(ec->dispatch_stats, ec) < 0) {
+		free(ec->dispatch_stats);
+		ec->dispatch_stats = NULL;
+		goto fail;
+	}
+
+	ec->gl_shader_cache = true;
+
 	if (!wl_global_create(ec->wl_display, &wl_compositor_interface, 4,
 			      ec, compositor_bind))
 		goto fail;
@@ -7853,6 +8237,22 @@ weston_compositor_create(struct wl_display *display,
 	return ec;
 
 fail:
+	if (ec->dispatch_stats) {
+		weston_dispatch_stats_fini(ec->dispatch_stats);
+		free(ec->dispatch_stats);
+	}
+	if (ec->memory) {
+		weston_memory_accounting_fini(ec->memory);
+		free(ec->memory);
+	}
+	if (ec->frame_throttle) {
+		weston_frame_throttle_fini(ec->frame_throttle);
+		free(ec->frame_throttle);
+	}
+	if (ec->region_arena) {
+		weston_region_arena_fini(ec->region_arena);
+		free(ec->region_arena);
+	}
 	free(ec);
 	return NULL;
 }
@@ -8236,6 +8636,20 @@ weston_compositor_destroy(struct weston_compositor *compositor)
 		weston_dmabuf_feedback_format_table_destroy(compositor->dmabuf_feedback_format_table);
 	}
 
+	weston_dispatch_stats_fini(compositor->dispatch_stats);
+	free(compositor->dispatch_stats);
+
+	weston_memory_accounting_fini(compositor->memory);
+	free(compositor->memory);
+
+	weston_frame_throttle_fini(compositor->frame_throttle);
+	free(compositor->frame_throttle);
+
+	weston_region_arena_fini(compositor->region_arena);
+	free(compositor->region_arena);
+
+	free(compositor->clipboard_mime_types);
+	free(compositor->gl_shader_precompile);
 	free(compositor);
 }
 
@@ -8389,6 +8803,28 @@ weston_compositor_load_color_manager(struct weston_compositor *compositor)
 	return 0;
 }
 
+/** Configure the GL renderer's shader program cache
+ *
+ * \param compositor The compositor.
+ * \param enabled Whether linked program binaries are kept on disk.
+ * \param precompile Comma separated texture variant names, or "cached",
+ * to compile in the background after startup. An empty string disables
+ * precompiling, NULL keeps the renderer's default.
+ *
+ * Takes effect when the GL renderer is created, so it must be called
+ * before loading the backend.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_set_gl_shader_cache(struct weston_compositor *compositor,
+				      bool enabled, const char *precompile)
+{
+	compositor->gl_shader_cache = enabled;
+	free(compositor->gl_shader_precompile);
+	compositor->gl_shader_precompile = precompile ? strdup(precompile) : NULL;
+}
+
 /** Resolve an internal compositor error by disconnecting the client.
  *
  * This function is used in cases when the wl_buffer turns out
@@ -430,7 +430,7 @@ drag_surface_configure(struct weston_drag *drag,
 		weston_layer_entry_remove(&drag->icon->layer_link);
 		weston_layer_entry_insert(list, &drag->icon->layer_link);
 		weston_view_update_transform(drag->icon);
-		pixman_region32_clear(&es->pending.input);
+		weston_surface_set_pending_input_rect(es, 0, 0, 0, 0);
 		es->is_mapped = true;
 		drag->icon->is_mapped = true;
 	}
@@ -624,7 +624,8 @@ data_device_end_drag_grab(struct weston_drag *drag,
 
 		drag->icon->surface->committed = NULL;
 		weston_surface_set_label_func(drag->icon->surface, NULL);
-		pixman_region32_clear(&drag->icon->surface->pending.input);
+		weston_surface_set_pending_input_rect(drag->icon->surface,
+						      0, 0, 0, 0);
 		wl_list_remove(&drag->icon_destroy_listener.link);
 		weston_view_destroy(drag->icon);
 	}
@@ -0,0 +1,323 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "dispatch-stats.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+static void
+dispatch_client_destroy(struct wl_listener *listener, void *data)
+{
+	struct weston_dispatch_client *dc =
+		wl_container_of(listener, dc, destroy_listener);
+
+	if (dc->stats->current == dc)
+		dc->stats->current = NULL;
+
+	wl_list_remove(&dc->link);
+	free(dc);
+}
+
+static struct weston_dispatch_client *
+dispatch_client_get(struct weston_dispatch_stats *ds, struct wl_client *client)
+{
+	struct wl_listener *listener;
+	struct weston_dispatch_client *dc;
+
+	listener = wl_client_get_destroy_listener(client,
+						  dispatch_client_destroy);
+	if (listener)
+		return wl_container_of(listener, dc, destroy_listener);
+
+	dc = zalloc(sizeof *dc);
+	if (!dc)
+		return NULL;
+
+	dc->stats = ds;
+	wl_client_get_credentials(client, &dc->pid, NULL, NULL);
+	wl_list_insert(ds->client_list.prev, &dc->link);
+
+	dc->destroy_listener.notify = dispatch_client_destroy;
+	wl_client_add_destroy_listener(client, &dc->destroy_listener);
+
+	return dc;
+}
+
+/* Charge the time since the last request to the client that sent it */
+static void
+dispatch_stats_switch(struct weston_dispatch_stats *ds,
+		      struct weston_dispatch_client *next,
+		      const struct timespec *now)
+{
+	if (ds->current)
+		ds->current->dispatch_nsec +=
+			timespec_sub_to_nsec(now, &ds->current_since);
+
+	ds->current = next;
+	ds->current_since = *now;
+}
+
+static void
+dispatch_stats_roll_window(struct weston_dispatch_stats *ds,
+			   const struct timespec *now)
+{
+	struct weston_dispatch_client *dc;
+	int64_t elapsed;
+
+	elapsed = timespec_sub_to_msec(now, &ds->window_start);
+	if (elapsed < 1000)
+		return;
+
+	wl_list_for_each(dc, &ds->client_list, link) {
+		dc->rate = (uint64_t)dc->window_requests * 1000 / elapsed;
+		dc->peak_rate = MAX(dc->peak_rate, dc->rate);
+		dc->window_requests = 0;
+	}
+	ds->window_start = *now;
+}
+
+/* Runs once the event loop has dispatched every ready source */
+static int
+dispatch_stats_idle(void *data)
+{
+	struct weston_dispatch_stats *ds = data;
+	struct weston_dispatch_client *dc;
+	struct timespec now;
+
+	ds->idle_source = NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	dispatch_stats_switch(ds, NULL, &now);
+
+	wl_list_for_each(dc, &ds->client_list, link)
+		dc->iteration_commits = 0;
+
+	return 0;
+}
+
+static void
+dispatch_stats_arm_idle(struct weston_dispatch_stats *ds)
+{
+	struct wl_event_loop *loop;
+
+	if (ds->idle_source)
+		return;
+
+	loop = wl_display_get_event_loop(ds->compositor->wl_display);
+	ds->idle_source = wl_event_loop_add_idle(loop, dispatch_stats_idle, ds);
+}
+
+static void
+dispatch_stats_log(void *user_data, enum wl_protocol_logger_type direction,
+		   const struct wl_protocol_logger_message *message)
+{
+	struct weston_dispatch_stats *ds = user_data;
+	struct weston_dispatch_client *dc;
+	struct timespec now;
+	const char *name;
+
+	if (direction != WL_PROTOCOL_LOGGER_REQUEST)
+		return;
+
+	dc = dispatch_client_get(ds,
+				 wl_resource_get_client(message->resource));
+	if (!dc)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	dispatch_stats_switch(ds, dc, &now);
+	dispatch_stats_roll_window(ds, &now);
+	dispatch_stats_arm_idle(ds);
+
+	ds->requests++;
+	dc->requests++;
+	dc->window_requests++;
+
+	if (strcmp(wl_resource_get_class(message->resource), "wl_surface") != 0)
+		return;
+
+	name = message->message->name;
+	if (strcmp(name, "commit") == 0)
+		dc->commits++;
+	else if (strcmp(name, "frame") == 0)
+		dc->frames++;
+	else if (strncmp(name, "damage", 6) == 0)
+		dc->damages++;
+}
+
+/** Count a commit against its client's budget
+ *
+ * \return true if the client already had its budget of commits applied in
+ * this loop iteration, and the commit should wait until the loop is idle.
+ */
+bool
+weston_dispatch_charge_commit(struct weston_dispatch_stats *ds,
+			      struct wl_client *client)
+{
+	struct weston_dispatch_client *dc;
+
+	if (!ds->commit_budget)
+		return false;
+
+	dc = dispatch_client_get(ds, client);
+	if (!dc)
+		return false;
+
+	dispatch_stats_arm_idle(ds);
+
+	if (dc->iteration_commits < ds->commit_budget) {
+		dc->iteration_commits++;
+		return false;
+	}
+
+	dc->deferred_commits++;
+	ds->deferred_commits++;
+
+	return true;
+}
+
+/* The protocol logger runs on every request, so it is only installed
+ * once the numbers are looked at or the commit budget is in use. */
+static void
+dispatch_stats_update_logger(struct weston_dispatch_stats *ds)
+{
+	struct timespec now;
+
+	if (ds->commit_budget || ds->scope_used) {
+		if (ds->logger)
+			return;
+
+		clock_gettime(CLOCK_MONOTONIC, &ds->window_start);
+		ds->logger = wl_display_add_protocol_logger(
+				ds->compositor->wl_display,
+				dispatch_stats_log, ds);
+		if (!ds->logger)
+			weston_log("Error: cannot count requests per client\n");
+	} else if (ds->logger) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		dispatch_stats_switch(ds, NULL, &now);
+		wl_protocol_logger_destroy(ds->logger);
+		ds->logger = NULL;
+	}
+}
+
+/** Cap the commits applied per client and event loop iteration
+ *
+ * \param compositor The compositor.
+ * \param commits Commits a client gets applied right away per loop
+ * iteration; further ones are folded per surface and applied once the
+ * loop is idle. 0 for no limit.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_set_commit_budget(struct weston_compositor *compositor,
+				    uint32_t commits)
+{
+	compositor->dispatch_stats->commit_budget = commits;
+	dispatch_stats_update_logger(compositor->dispatch_stats);
+}
+
+static void
+dispatch_stats_scope_subscribe(struct weston_log_subscription *sub,
+			       void *data)
+{
+	struct weston_dispatch_stats *ds = data;
+	struct weston_dispatch_client *dc;
+
+	if (!ds->scope_used) {
+		ds->scope_used = true;
+		dispatch_stats_update_logger(ds);
+	}
+
+	if (!ds->logger) {
+		weston_log_subscription_printf(sub,
+			"Requests are not being counted\n");
+		weston_log_subscription_complete(sub);
+		return;
+	}
+
+	weston_log_subscription_printf(sub, "Requests: %" PRIu64 "\n",
+				       ds->requests);
+	if (ds->commit_budget)
+		weston_log_subscription_printf(sub,
+			"Commit budget: %u per client and loop iteration, "
+			"commits deferred: %" PRIu64 "\n",
+			ds->commit_budget, ds->deferred_commits);
+
+	wl_list_for_each(dc, &ds->client_list, link) {
+		weston_log_subscription_printf(sub,
+			"Client pid %d: %" PRIu64 " requests, %u/s "
+			"(peak %u/s), dispatch %.1f ms\n"
+			"\tcommit %" PRIu64 " damage %" PRIu64
+			" frame %" PRIu64 " deferred %" PRIu64 "\n",
+			(int)dc->pid, dc->requests, dc->rate, dc->peak_rate,
+			dc->dispatch_nsec / 1e6, dc->commits, dc->damages,
+			dc->frames, dc->deferred_commits);
+	}
+
+	weston_log_subscription_complete(sub);
+}
+
+int
+weston_dispatch_stats_init(struct weston_dispatch_stats *ds,
+			   struct weston_compositor *compositor)
+{
+	ds->compositor = compositor;
+	wl_list_init(&ds->client_list);
+
+	ds->scope = weston_compositor_add_log_scope(compositor, "dispatch",
+			"Requests and dispatch time per client\n",
+			dispatch_stats_scope_subscribe, NULL, ds);
+
+	return 0;
+}
+
+void
+weston_dispatch_stats_fini(struct weston_dispatch_stats *ds)
+{
+	struct weston_dispatch_client *dc, *next;
+
+	wl_list_for_each_safe(dc, next, &ds->client_list, link) {
+		wl_list_remove(&dc->destroy_listener.link);
+		wl_list_remove(&dc->link);
+		free(dc);
+	}
+
+	if (ds->idle_source)
+		wl_event_source_remove(ds->idle_source);
+
+	if (ds->logger)
+		wl_protocol_logger_destroy(ds->logger);
+	weston_log_scope_destroy(ds->scope);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_DISPATCH_STATS_H
+#define WESTON_DISPATCH_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <wayland-server-core.h>
+
+struct weston_compositor;
+struct weston_log_scope;
+struct wl_protocol_logger;
+
+/** Requests of one client, found through its destroy listener */
+struct weston_dispatch_client {
+	struct weston_dispatch_stats *stats;
+	struct wl_list link;		/* weston_dispatch_stats::client_list */
+	struct wl_listener destroy_listener;
+	pid_t pid;
+
+	uint64_t requests;
+	uint64_t commits;
+	uint64_t damages;
+	uint64_t frames;
+	uint64_t dispatch_nsec;
+
+	uint32_t window_requests;	/* since weston_dispatch_stats::window_start */
+	uint32_t rate;			/* requests per second, last window */
+	uint32_t peak_rate;
+
+	uint32_t iteration_commits;	/* applied in this loop iteration */
+	uint64_t deferred_commits;
+};
+
+/** Per-client request accounting and fair commit scheduling
+ *
+ * Once the "dispatch" debug scope was subscribed to, or while a commit
+ * budget is set, every request goes through a protocol logger, which
+ * counts it against its client. The time until the next request, or
+ * until the event loop goes idle, is taken as the time spent dispatching
+ * it; this is an estimate, as other event sources may run in between.
+ *
+ * libwayland dispatches a client until its socket is drained, so the
+ * number of requests cannot be capped. What can be capped is the number
+ * of commits applied: past the budget, further commits of a client in
+ * the same loop iteration are folded together and applied once the loop
+ * goes idle, so a flood costs one commit per surface.
+ */
+struct weston_dispatch_stats {
+	struct weston_compositor *compositor;
+	struct wl_list client_list;	/* weston_dispatch_client::link */
+	struct wl_protocol_logger *logger;	/* NULL unless needed */
+	bool scope_used;
+
+	struct weston_dispatch_client *current;
+	struct timespec current_since;
+	struct wl_event_source *idle_source;
+	struct timespec window_start;
+
+	uint32_t commit_budget;		/* 0 if unlimited */
+	uint64_t requests;
+	uint64_t deferred_commits;
+
+	struct weston_log_scope *scope;
+};
+
+int
+weston_dispatch_stats_init(struct weston_dispatch_stats *ds,
+			   struct weston_compositor *compositor);
+
+void
+weston_dispatch_stats_fini(struct weston_dispatch_stats *ds);
+
+bool
+weston_dispatch_charge_commit(struct weston_dispatch_stats *ds,
+			      struct wl_client *client);
+
+#endif /* WESTON_DISPATCH_STATS_H */
@@ -26,11 +26,76 @@
 #include "config.h"
 
 #include <assert.h>
+#include <string.h>
 
 #include <libweston/libweston.h>
 #include "libweston-internal.h"
 #include "shared/weston-drm-fourcc.h"
 
+/* Both the formats of a weston_drm_format_array and the modifiers of each
+ * weston_drm_format are kept sorted in ascending order. Lookups are binary
+ * searches, and the set operations below are linear merges of two sorted
+ * sequences rather than a lookup per element.
+ */
+
+static unsigned int
+format_array_count(const struct weston_drm_format_array *formats)
+{
+	return formats->arr.size / sizeof(struct weston_drm_format);
+}
+
+/* Index of the first format that is not less than 'format' */
+static unsigned int
+format_array_lower_bound(const struct weston_drm_format_array *formats,
+			 uint32_t format)
+{
+	const struct weston_drm_format *fmts = formats->arr.data;
+	unsigned int lo = 0, hi = format_array_count(formats), mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (fmts[mid].format < format)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Index of the first modifier that is not less than 'modifier' */
+static unsigned int
+modifiers_lower_bound(const uint64_t *modifiers, unsigned int num_modifiers,
+		      uint64_t modifier)
+{
+	unsigned int lo = 0, hi = num_modifiers, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (modifiers[mid] < modifier)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static int
+modifiers_append(struct wl_array *modifiers_result, uint64_t modifier)
+{
+	uint64_t *mod;
+
+	mod = wl_array_add(modifiers_result, sizeof(*mod));
+	if (!mod) {
+		weston_log("%s: out of memory\n", __func__);
+		return -1;
+	}
+	*mod = modifier;
+
+	return 0;
+}
+
 /**
  * Initialize a weston_drm_format_array
  *
@@ -40,6 +105,7 @@ WL_EXPORT void
 weston_drm_format_array_init(struct weston_drm_format_array *formats)
 {
 	wl_array_init(&formats->arr);
+	formats->latest = 0;
 }
 
 /**
@@ -115,7 +181,9 @@ weston_drm_format_array_replace(struct weston_drm_format_array *formats,
 /**
  * Add format to weston_drm_format_array
  *
- * Adding repeated formats is considered an error.
+ * Adding repeated formats is considered an error. The format is inserted at
+ * its sorted position, so pointers to other formats of the array are not
+ * stable across this call.
  *
  * @param formats The weston_drm_format_array that receives the format
  * @param format The format to add to the array
@@ -125,17 +193,24 @@ WL_EXPORT struct weston_drm_format *
 weston_drm_format_array_add_format(struct weston_drm_format_array *formats,
 				   uint32_t format)
 {
-	struct weston_drm_format *fmt;
+	struct weston_drm_format *fmt, *fmts;
+	unsigned int count = format_array_count(formats);
+	unsigned int pos = format_array_lower_bound(formats, format);
 
 	/* We should not try to add repeated formats to an array. */
-	assert(!weston_drm_format_array_find_format(formats, format));
+	assert(pos == count ||
+	       ((struct weston_drm_format *) formats->arr.data)[pos].format != format);
 
-	fmt = wl_array_add(&formats->arr, sizeof(*fmt));
-	if (!fmt) {
+	if (!wl_array_add(&formats->arr, sizeof(*fmt))) {
 		weston_log("%s: out of memory\n", __func__);
 		return NULL;
 	}
 
+	fmts = formats->arr.data;
+	memmove(&fmts[pos + 1], &fmts[pos], (count - pos) * sizeof(*fmt));
+	formats->latest = pos;
+
+	fmt = &fmts[pos];
 	fmt->format = format;
 	wl_array_init(&fmt->modifiers);
 
@@ -154,14 +229,17 @@ WL_EXPORT void
 weston_drm_format_array_remove_latest_format(struct weston_drm_format_array *formats)
 {
 	struct wl_array *array = &formats->arr;
-	struct weston_drm_format *fmt;
+	struct weston_drm_format *fmts = array->data;
+	unsigned int count = format_array_count(formats);
 
-	assert(array->size >= sizeof(*fmt));
+	assert(array->size >= sizeof(*fmts));
+	assert(formats->latest < count);
 
-	array->size -= sizeof(*fmt);
+	wl_array_release(&fmts[formats->latest].modifiers);
+	memmove(&fmts[formats->latest], &fmts[formats->latest + 1],
+		(count - formats->latest - 1) * sizeof(*fmts));
 
-	fmt = array->data + array->size;
-	wl_array_release(&fmt->modifiers);
+	array->size -= sizeof(*fmts);
 }
 
 /**
@@ -175,11 +253,11 @@ WL_EXPORT struct weston_drm_format *
 weston_drm_format_array_find_format(const struct weston_drm_format_array *formats,
 				    uint32_t format)
 {
-	struct weston_drm_format *fmt;
+	struct weston_drm_format *fmts = formats->arr.data;
+	unsigned int pos = format_array_lower_bound(formats, format);
 
-	wl_array_for_each(fmt, &formats->arr)
-		if (fmt->format == format)
-			return fmt;
+	if (pos < format_array_count(formats) && fmts[pos].format == format)
+		return &fmts[pos];
 
 	return NULL;
 }
@@ -213,67 +291,53 @@ WL_EXPORT bool
 weston_drm_format_array_equal(const struct weston_drm_format_array *formats_A,
 			      const struct weston_drm_format_array *formats_B)
 {
-	struct weston_drm_format *fmt_A, *fmt_B;
-	const uint64_t *modifiers_A;
-	unsigned num_modifiers_A, num_modifiers_B;
+	const struct weston_drm_format *fmts_A = formats_A->arr.data;
+	const struct weston_drm_format *fmts_B = formats_B->arr.data;
+	unsigned int count = format_array_count(formats_A);
 	unsigned int i;
 
 	if (formats_A->arr.size != formats_B->arr.size)
 		return false;
 
-	wl_array_for_each(fmt_A, &formats_A->arr) {
-		fmt_B = weston_drm_format_array_find_format(formats_B,
-							    fmt_A->format);
-		if (!fmt_B)
+	/* Both arrays are sorted, so equal sets are equal sequences. */
+	for (i = 0; i < count; i++) {
+		if (fmts_A[i].format != fmts_B[i].format)
 			return false;
-
-		modifiers_A = weston_drm_format_get_modifiers(fmt_A, &num_modifiers_A);
-		weston_drm_format_get_modifiers(fmt_B, &num_modifiers_B);
-		if (num_modifiers_A != num_modifiers_B)
+		if (fmts_A[i].modifiers.size != fmts_B[i].modifiers.size)
+			return false;
+		if (fmts_A[i].modifiers.size != 0 &&
+		    memcmp(fmts_A[i].modifiers.data, fmts_B[i].modifiers.data,
+			   fmts_A[i].modifiers.size) != 0)
 			return false;
-		for (i = 0; i < num_modifiers_A; i++)
-			if (!weston_drm_format_has_modifier(fmt_B, modifiers_A[i]))
-				return false;
 	}
 
 	return true;
 }
 
-/**
- * Joins two weston_drm_format_array, keeping the result in A
- *
- * @param formats_A The weston_drm_format_array that receives the formats from B
- * @param formats_B The weston_drm_format_array whose formats are added to A
- * @return 0 on success, -1 on failure
- */
-WL_EXPORT int
-weston_drm_format_array_join(struct weston_drm_format_array *formats_A,
-			     const struct weston_drm_format_array *formats_B)
+static int
+modifiers_union(const struct weston_drm_format *fmt_A,
+		const struct weston_drm_format *fmt_B,
+		struct wl_array *modifiers_result)
 {
-	struct weston_drm_format *fmt_A, *fmt_B;
-	const uint64_t *modifiers;
-	unsigned int num_modifiers;
-	unsigned int i;
-	int ret;
-
-	wl_array_for_each(fmt_B, &formats_B->arr) {
-		fmt_A = weston_drm_format_array_find_format(formats_A,
-							    fmt_B->format);
-		if (!fmt_A) {
-			fmt_A = weston_drm_format_array_add_format(formats_A,
-								   fmt_B->format);
-			if (!fmt_A)
-				return -1;
-		}
-
-		modifiers = weston_drm_format_get_modifiers(fmt_B, &num_modifiers);
-		for (i = 0; i < num_modifiers; i++) {
-			if (weston_drm_format_has_modifier(fmt_A, modifiers[i]))
-				continue;
-			ret = weston_drm_format_add_modifier(fmt_A, modifiers[i]);
-			if (ret < 0)
-				return -1;
+	const uint64_t *mods_A, *mods_B;
+	unsigned int num_A, num_B;
+	unsigned int i = 0, j = 0;
+	uint64_t mod;
+
+	mods_A = weston_drm_format_get_modifiers(fmt_A, &num_A);
+	mods_B = weston_drm_format_get_modifiers(fmt_B, &num_B);
+
+	while (i < num_A || j < num_B) {
+		if (j == num_B || (i < num_A && mods_A[i] < mods_B[j])) {
+			mod = mods_A[i++];
+		} else if (i == num_A || mods_B[j] < mods_A[i]) {
+			mod = mods_B[j++];
+		} else {
+			mod = mods_A[i++];
+			j++;
 		}
+		if (modifiers_append(modifiers_result, mod) < 0)
+			return -1;
 	}
 
 	return 0;
@@ -284,67 +348,133 @@ modifiers_intersect(const struct weston_drm_format *fmt_A,
 		    const struct weston_drm_format *fmt_B,
 		    struct wl_array *modifiers_result)
 {
-	const uint64_t *modifiers;
-	unsigned int num_modifiers;
-	uint64_t *mod;
-	unsigned int i;
+	const uint64_t *mods_A, *mods_B;
+	unsigned int num_A, num_B;
+	unsigned int i = 0, j = 0;
+
+	mods_A = weston_drm_format_get_modifiers(fmt_A, &num_A);
+	mods_B = weston_drm_format_get_modifiers(fmt_B, &num_B);
+
+	while (i < num_A && j < num_B) {
+		if (mods_A[i] < mods_B[j]) {
+			i++;
+		} else if (mods_B[j] < mods_A[i]) {
+			j++;
+		} else {
+			if (modifiers_append(modifiers_result, mods_A[i]) < 0)
+				return -1;
+			i++;
+			j++;
+		}
+	}
 
-	modifiers = weston_drm_format_get_modifiers(fmt_A, &num_modifiers);
-	for (i = 0; i < num_modifiers; i++) {
-		if (!weston_drm_format_has_modifier(fmt_B, modifiers[i]))
-			continue;
-		mod = wl_array_add(modifiers_result, sizeof(modifiers[i]));
-		if (!mod) {
-			weston_log("%s: out of memory\n", __func__);
-			return -1;
+	return 0;
+}
+
+static int
+modifiers_subtract(const struct weston_drm_format *fmt_A,
+		   const struct weston_drm_format *fmt_B,
+		   struct wl_array *modifiers_result)
+{
+	const uint64_t *mods_A, *mods_B;
+	unsigned int num_A, num_B;
+	unsigned int i = 0, j = 0;
+
+	mods_A = weston_drm_format_get_modifiers(fmt_A, &num_A);
+	mods_B = weston_drm_format_get_modifiers(fmt_B, &num_B);
+
+	while (i < num_A) {
+		if (j == num_B || mods_A[i] < mods_B[j]) {
+			if (modifiers_append(modifiers_result, mods_A[i]) < 0)
+				return -1;
+			i++;
+		} else if (mods_B[j] < mods_A[i]) {
+			j++;
+		} else {
+			i++;
+			j++;
 		}
-		*mod = modifiers[i];
 	}
 
 	return 0;
 }
 
-/**
- * Compute the intersection between two DRM-format arrays, keeping the result in A
- *
- * @param formats_A The weston_drm_format_array that keeps the result
- * @param formats_B The other weston_drm_format_array
- * @return 0 on success, -1 on failure
+enum format_array_op {
+	FORMAT_ARRAY_JOIN,
+	FORMAT_ARRAY_INTERSECT,
+	FORMAT_ARRAY_SUBTRACT,
+};
+
+/* Merge the sorted formats of A and B into a new array according to 'op',
+ * and make it the content of A. Formats are visited in ascending order, so
+ * every add_format() below appends at the end of the result.
  */
-WL_EXPORT int
-weston_drm_format_array_intersect(struct weston_drm_format_array *formats_A,
-				  const struct weston_drm_format_array *formats_B)
+static int
+format_array_merge(struct weston_drm_format_array *formats_A,
+		   const struct weston_drm_format_array *formats_B,
+		   enum format_array_op op)
 {
 	struct weston_drm_format_array formats_result;
-	struct weston_drm_format *fmt_result, *fmt_A, *fmt_B;
+	struct weston_drm_format *fmts_A = formats_A->arr.data;
+	struct weston_drm_format *fmts_B = formats_B->arr.data;
+	unsigned int num_A = format_array_count(formats_A);
+	unsigned int num_B = format_array_count(formats_B);
+	struct weston_drm_format *fmt_only = NULL;
+	struct weston_drm_format *fmt_result;
+	unsigned int i = 0, j = 0;
 	int ret;
 
 	weston_drm_format_array_init(&formats_result);
 
-	wl_array_for_each(fmt_A, &formats_A->arr) {
-		fmt_B = weston_drm_format_array_find_format(formats_B,
-							    fmt_A->format);
-		if (!fmt_B)
-			continue;
+	while (i < num_A || j < num_B) {
+		if (j == num_B || (i < num_A && fmts_A[i].format < fmts_B[j].format)) {
+			/* only in A */
+			if (op != FORMAT_ARRAY_INTERSECT)
+				fmt_only = &fmts_A[i];
+			i++;
+		} else if (i == num_A || fmts_B[j].format < fmts_A[i].format) {
+			/* only in B */
+			if (op == FORMAT_ARRAY_JOIN)
+				fmt_only = &fmts_B[j];
+			j++;
+		} else {
+			/* in both */
+			fmt_result = weston_drm_format_array_add_format(&formats_result,
+									fmts_A[i].format);
+			if (!fmt_result)
+				goto err;
 
-		fmt_result = weston_drm_format_array_add_format(&formats_result,
-								fmt_A->format);
-		if (!fmt_result)
-			goto err;
+			if (op == FORMAT_ARRAY_JOIN)
+				ret = modifiers_union(&fmts_A[i], &fmts_B[j],
+						      &fmt_result->modifiers);
+			else if (op == FORMAT_ARRAY_INTERSECT)
+				ret = modifiers_intersect(&fmts_A[i], &fmts_B[j],
+							  &fmt_result->modifiers);
+			else
+				ret = modifiers_subtract(&fmts_A[i], &fmts_B[j],
+							 &fmt_result->modifiers);
+			if (ret < 0)
+				goto err;
 
-		ret = modifiers_intersect(fmt_A, fmt_B, &fmt_result->modifiers);
-		if (ret < 0)
-			goto err;
+			if (fmt_result->modifiers.size == 0)
+				weston_drm_format_array_remove_latest_format(&formats_result);
+			i++;
+			j++;
+			continue;
+		}
 
-		if (fmt_result->modifiers.size == 0)
-			weston_drm_format_array_remove_latest_format(&formats_result);
+		if (fmt_only) {
+			ret = add_format_and_modifiers(&formats_result,
+						       fmt_only->format,
+						       &fmt_only->modifiers);
+			if (ret < 0)
+				goto err;
+			fmt_only = NULL;
+		}
 	}
 
-	ret = weston_drm_format_array_replace(formats_A, &formats_result);
-	if (ret < 0)
-		goto err;
-
-	weston_drm_format_array_fini(&formats_result);
+	weston_drm_format_array_fini(formats_A);
+	*formats_A = formats_result;
 	return 0;
 
 err:
@@ -352,29 +482,32 @@ err:
 	return -1;
 }
 
-static int
-modifiers_subtract(const struct weston_drm_format *fmt_A,
-		   const struct weston_drm_format *fmt_B,
-		   struct wl_array *modifiers_result)
+/**
+ * Joins two weston_drm_format_array, keeping the result in A
+ *
+ * @param formats_A The weston_drm_format_array that receives the formats from B
+ * @param formats_B The weston_drm_format_array whose formats are added to A
+ * @return 0 on success, -1 on failure
+ */
+WL_EXPORT int
+weston_drm_format_array_join(struct weston_drm_format_array *formats_A,
+			     const struct weston_drm_format_array *formats_B)
 {
-	const uint64_t *modifiers;
-	unsigned int num_modifiers;
-	uint64_t *mod;
-	unsigned int i;
-
-	modifiers = weston_drm_format_get_modifiers(fmt_A, &num_modifiers);
-	for (i = 0; i < num_modifiers; i++) {
-		if (weston_drm_format_has_modifier(fmt_B, modifiers[i]))
-			continue;
-		mod = wl_array_add(modifiers_result, sizeof(modifiers[i]));
-		if (!mod) {
-			weston_log("%s: out of memory\n", __func__);
-			return -1;
-		}
-		*mod = modifiers[i];
-	}
+	return format_array_merge(formats_A, formats_B, FORMAT_ARRAY_JOIN);
+}
 
-	return 0;
+/**
+ * Compute the intersection between two DRM-format arrays, keeping the result in A
+ *
+ * @param formats_A The weston_drm_format_array that keeps the result
+ * @param formats_B The other weston_drm_format_array
+ * @return 0 on success, -1 on failure
+ */
+WL_EXPORT int
+weston_drm_format_array_intersect(struct weston_drm_format_array *formats_A,
+				  const struct weston_drm_format_array *formats_B)
+{
+	return format_array_merge(formats_A, formats_B, FORMAT_ARRAY_INTERSECT);
 }
 
 /**
@@ -388,47 +521,7 @@ WL_EXPORT int
 weston_drm_format_array_subtract(struct weston_drm_format_array *formats_A,
 				 const struct weston_drm_format_array *formats_B)
 {
-	struct weston_drm_format_array formats_result;
-	struct weston_drm_format *fmt_result, *fmt_A, *fmt_B;
-	int ret;
-
-	weston_drm_format_array_init(&formats_result);
-
-	wl_array_for_each(fmt_A, &formats_A->arr) {
-		fmt_B = weston_drm_format_array_find_format(formats_B,
-							    fmt_A->format);
-		if (!fmt_B) {
-			ret = add_format_and_modifiers(&formats_result, fmt_A->format,
-						       &fmt_A->modifiers);
-			if (ret < 0)
-				goto err;
-
-			continue;
-		}
-
-		fmt_result = weston_drm_format_array_add_format(&formats_result,
-								fmt_A->format);
-		if (!fmt_result)
-			goto err;
-
-		ret = modifiers_subtract(fmt_A, fmt_B, &fmt_result->modifiers);
-		if (ret < 0)
-			goto err;
-
-		if (fmt_result->modifiers.size == 0)
-			weston_drm_format_array_remove_latest_format(&formats_result);
-	}
-
-	ret = weston_drm_format_array_replace(formats_A, &formats_result);
-	if (ret < 0)
-		goto err;
-
-	weston_drm_format_array_fini(&formats_result);
-	return 0;
-
-err:
-	weston_drm_format_array_fini(&formats_result);
-	return -1;
+	return format_array_merge(formats_A, formats_B, FORMAT_ARRAY_SUBTRACT);
 }
 
 /**
@@ -445,17 +538,26 @@ WL_EXPORT int
 weston_drm_format_add_modifier(struct weston_drm_format *format,
 			       uint64_t modifier)
 {
-	uint64_t *mod;
+	uint64_t *mods;
+	unsigned int num_modifiers;
+	unsigned int pos;
+
+	mods = format->modifiers.data;
+	num_modifiers = format->modifiers.size / sizeof(*mods);
+	pos = modifiers_lower_bound(mods, num_modifiers, modifier);
 
 	/* We should not try to add repeated modifiers to a set. */
-	assert(!weston_drm_format_has_modifier(format, modifier));
+	assert(pos == num_modifiers || mods[pos] != modifier);
 
-	mod = wl_array_add(&format->modifiers, sizeof(*mod));
-	if (!mod) {
+	if (!wl_array_add(&format->modifiers, sizeof(*mods))) {
 		weston_log("%s: out of memory\n", __func__);
 		return -1;
 	}
-	*mod = modifier;
+
+	mods = format->modifiers.data;
+	memmove(&mods[pos + 1], &mods[pos],
+		(num_modifiers - pos) * sizeof(*mods));
+	mods[pos] = modifier;
 
 	return 0;
 }
@@ -474,14 +576,12 @@ weston_drm_format_has_modifier(const struct weston_drm_format *format,
 {
 	const uint64_t *modifiers;
 	unsigned int num_modifiers;
-	unsigned int i;
+	unsigned int pos;
 
 	modifiers = weston_drm_format_get_modifiers(format, &num_modifiers);
-	for (i = 0; i < num_modifiers; i++)
-		if (modifiers[i] == modifier)
-			return true;
+	pos = modifiers_lower_bound(modifiers, num_modifiers, modifier);
 
-	return false;
+	return pos < num_modifiers && modifiers[pos] == modifier;
 }
 
 /**
@@ -0,0 +1,320 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "frame-throttle.h"
+#include "libweston-internal.h"
+#include "region-arena.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+/* Per-client policy, found through its destroy listener */
+struct frame_throttle_client {
+	struct wl_listener destroy_listener;
+	bool throttle;
+};
+
+static void
+frame_throttle_client_destroy(struct wl_listener *listener, void *data)
+{
+	struct frame_throttle_client *ftc =
+		wl_container_of(listener, ftc, destroy_listener);
+
+	free(ftc);
+}
+
+static bool
+client_is_throttled(struct wl_client *client)
+{
+	struct wl_listener *listener;
+	struct frame_throttle_client *ftc;
+
+	listener = wl_client_get_destroy_listener(client,
+						  frame_throttle_client_destroy);
+	if (!listener)
+		return true;
+
+	ftc = wl_container_of(listener, ftc, destroy_listener);
+	return ftc->throttle;
+}
+
+/** Choose whether a client's occluded surfaces are throttled
+ *
+ * \param client The client.
+ * \param throttle False to always send its frame callbacks on repaint.
+ *
+ * Clients are throttled by default, when the compositor has an occluded
+ * frame rate set.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_client_set_frame_throttle(struct wl_client *client, bool throttle)
+{
+	struct wl_listener *listener;
+	struct frame_throttle_client *ftc;
+
+	listener = wl_client_get_destroy_listener(client,
+						  frame_throttle_client_destroy);
+	if (listener) {
+		ftc = wl_container_of(listener, ftc, destroy_listener);
+		ftc->throttle = throttle;
+		return;
+	}
+
+	ftc = zalloc(sizeof *ftc);
+	if (!ftc)
+		return;
+
+	ftc->throttle = throttle;
+	ftc->destroy_listener.notify = frame_throttle_client_destroy;
+	wl_client_add_destroy_listener(client, &ftc->destroy_listener);
+}
+
+/** Set the frame callback rate of occluded surfaces
+ *
+ * \param compositor The compositor.
+ * \param rate_hz Frame callbacks per second, 0 to not throttle.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_set_occluded_frame_rate(struct weston_compositor *compositor,
+					  uint32_t rate_hz)
+{
+	struct weston_frame_throttle *ft = compositor->frame_throttle;
+
+	ft->interval_msec = rate_hz ? MAX(1000 / rate_hz, 1u) : 0;
+}
+
+/* Count the frames the client would have drawn at the output refresh
+ * rate while it was held back, minus the one it is about to draw. */
+static void
+frame_throttle_account(struct weston_frame_throttle *ft,
+		       struct weston_surface *surface,
+		       const struct timespec *now)
+{
+	int64_t held_nsec;
+	int64_t refresh_nsec;
+
+	if (!surface->output || !surface->output->current_mode ||
+	    surface->output->current_mode->refresh <= 0)
+		return;
+
+	held_nsec = timespec_sub_to_nsec(now, &surface->frame_throttle_since);
+	refresh_nsec = millihz_to_nsec(surface->output->current_mode->refresh);
+	if (held_nsec > refresh_nsec)
+		ft->saved += held_nsec / refresh_nsec - 1;
+}
+
+static void
+frame_throttle_release(struct weston_frame_throttle *ft,
+		       struct weston_surface *surface,
+		       const struct timespec *now)
+{
+	struct wl_resource *cb, *next;
+	uint32_t msecs = timespec_to_msec(now);
+
+	wl_resource_for_each_safe(cb, next, &surface->frame_callback_list) {
+		wl_callback_send_done(cb, msecs);
+		wl_resource_destroy(cb);
+	}
+
+	ft->released++;
+	frame_throttle_account(ft, surface, now);
+
+	weston_frame_throttle_forget(surface);
+}
+
+static int
+frame_throttle_timer_handler(void *data)
+{
+	struct weston_frame_throttle *ft = data;
+	struct weston_surface *surface, *next;
+	struct timespec now;
+
+	ft->timer_armed = false;
+
+	weston_compositor_read_presentation_clock(ft->compositor, &now);
+
+	wl_list_for_each_safe(surface, next, &ft->surface_list,
+			      frame_throttle_link)
+		frame_throttle_release(ft, surface, &now);
+
+	return 0;
+}
+
+/* Whether all views of the surface on the output are covered by opaque
+ * content above them. Valid after the output's damage was accumulated. */
+static bool
+surface_is_occluded(struct weston_surface *surface,
+		    struct weston_output *output)
+{
+	struct weston_region_arena *arena = surface->compositor->region_arena;
+	struct weston_view *view;
+	pixman_region32_t visible_fallback, tmp_fallback;
+	pixman_region32_t *visible, *tmp;
+	bool occluded = true;
+
+	visible = weston_region_arena_get_or_init(arena, &visible_fallback);
+	tmp = weston_region_arena_get_or_init(arena, &tmp_fallback);
+
+	wl_list_for_each(view, &surface->views, surface_link) {
+		if (!(view->output_mask & (1u << output->id)))
+			continue;
+
+		if (!view->plane) {
+			occluded = false;
+			break;
+		}
+
+		weston_region_arena_intersect(arena, tmp,
+					      &view->transform.boundingbox,
+					      &output->region);
+		weston_region_arena_subtract(arena, visible, tmp, &view->clip);
+		weston_region_arena_subtract(arena, tmp, visible,
+					     &view->plane->clip);
+		if (pixman_region32_not_empty(tmp)) {
+			occluded = false;
+			break;
+		}
+	}
+
+	weston_region_arena_release(visible, &visible_fallback);
+	weston_region_arena_release(tmp, &tmp_fallback);
+
+	return occluded;
+}
+
+/** Keep a surface's frame callbacks back in this repaint
+ *
+ * \return true if the callbacks stay on the surface, to be sent by the
+ * throttle timer or a later repaint in which the surface is visible.
+ */
+bool
+weston_frame_throttle_hold(struct weston_frame_throttle *ft,
+			   struct weston_surface *surface,
+			   struct weston_output *output)
+{
+	if (ft->interval_msec == 0 ||
+	    wl_list_empty(&surface->frame_callback_list) ||
+	    !surface->resource ||
+	    surface->output_mask != (1u << output->id) ||
+	    !client_is_throttled(wl_resource_get_client(surface->resource)) ||
+	    !surface_is_occluded(surface, output)) {
+		/* Visible again: the repaint sends what was held back */
+		if (!wl_list_empty(&surface->frame_throttle_link)) {
+			frame_throttle_account(ft, surface, &output->frame_time);
+			weston_frame_throttle_forget(surface);
+		}
+		return false;
+	}
+
+	if (wl_list_empty(&surface->frame_throttle_link)) {
+		wl_list_insert(&ft->surface_list, &surface->frame_throttle_link);
+		surface->frame_throttle_since = output->frame_time;
+		ft->held++;
+	}
+
+	if (!ft->timer_armed) {
+		wl_event_source_timer_update(ft->timer, ft->interval_msec);
+		ft->timer_armed = true;
+	}
+
+	return true;
+}
+
+/** Drop a surface from the throttled set, its callbacks go out normally */
+void
+weston_frame_throttle_forget(struct weston_surface *surface)
+{
+	wl_list_remove(&surface->frame_throttle_link);
+	wl_list_init(&surface->frame_throttle_link);
+}
+
+static void
+frame_throttle_scope_subscribe(struct weston_log_subscription *sub,
+			       void *data)
+{
+	struct weston_frame_throttle *ft = data;
+
+	if (ft->interval_msec)
+		weston_log_subscription_printf(sub,
+			"Occluded surfaces get frame callbacks every %u ms\n",
+			ft->interval_msec);
+	else
+		weston_log_subscription_printf(sub,
+			"Occluded surfaces are not throttled\n");
+
+	weston_log_subscription_printf(sub,
+		"Surfaces held back: %d\n"
+		"Times surfaces were held back: %" PRIu64 "\n"
+		"Callback batches sent by the throttle: %" PRIu64 "\n"
+		"Client frames saved: %" PRIu64 "\n",
+		wl_list_length(&ft->surface_list),
+		ft->held, ft->released, ft->saved);
+	weston_log_subscription_complete(sub);
+}
+
+int
+weston_frame_throttle_init(struct weston_frame_throttle *ft,
+			   struct weston_compositor *compositor)
+{
+	struct wl_event_loop *loop;
+
+	ft->compositor = compositor;
+	wl_list_init(&ft->surface_list);
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	ft->timer = wl_event_loop_add_timer(loop, frame_throttle_timer_handler,
+					    ft);
+	if (!ft->timer)
+		return -1;
+
+	ft->scope = weston_compositor_add_log_scope(compositor, "frame-throttle",
+			"Frame callback throttling of occluded surfaces\n",
+			frame_throttle_scope_subscribe, NULL, ft);
+
+	return 0;
+}
+
+void
+weston_frame_throttle_fini(struct weston_frame_throttle *ft)
+{
+	struct weston_surface *surface, *next;
+
+	wl_list_for_each_safe(surface, next, &ft->surface_list,
+			      frame_throttle_link)
+		weston_frame_throttle_forget(surface);
+
+	weston_log_scope_destroy(ft->scope);
+	wl_event_source_remove(ft->timer);
+}
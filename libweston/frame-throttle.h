@@ -0,0 +1,74 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_FRAME_THROTTLE_H
+#define WESTON_FRAME_THROTTLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+
+struct weston_compositor;
+struct weston_output;
+struct weston_surface;
+struct weston_log_scope;
+struct wl_event_source;
+
+/** Frame callbacks of occluded surfaces
+ *
+ * A surface whose views on its output are entirely covered by opaque
+ * content does not get its frame callbacks from the repaint. They are
+ * answered by a timer at the occluded frame rate instead, so hidden
+ * clients stop rendering at the output refresh rate.
+ */
+struct weston_frame_throttle {
+	struct weston_compositor *compositor;
+	uint32_t interval_msec;		/* 0 if disabled */
+	struct wl_event_source *timer;
+	bool timer_armed;
+	struct wl_list surface_list;	/* weston_surface::frame_throttle_link */
+	struct weston_log_scope *scope;
+
+	uint64_t held;			/* times a surface got held back */
+	uint64_t released;		/* callback batches sent by the timer */
+	uint64_t saved;			/* estimated client frames not drawn */
+};
+
+int
+weston_frame_throttle_init(struct weston_frame_throttle *ft,
+			   struct weston_compositor *compositor);
+
+void
+weston_frame_throttle_fini(struct weston_frame_throttle *ft);
+
+bool
+weston_frame_throttle_hold(struct weston_frame_throttle *ft,
+			   struct weston_surface *surface,
+			   struct weston_output *output);
+
+void
+weston_frame_throttle_forget(struct weston_surface *surface);
+
+#endif /* WESTON_FRAME_THROTTLE_H */
@@ -1304,6 +1304,48 @@ weston_keyboard_create(void)
 	return keyboard;
 }
 
+/** Change the keyboard repeat rate and delay at runtime
+ *
+ * \param ec The compositor.
+ * \param rate Repeat rate in characters per second.
+ * \param delay Repeat delay in milliseconds.
+ *
+ * The new values are sent to every wl_keyboard already bound by clients.
+ */
+WL_EXPORT void
+weston_compositor_set_kb_repeat_info(struct weston_compositor *ec,
+				     int32_t rate, int32_t delay)
+{
+	struct weston_seat *seat;
+	struct weston_keyboard *keyboard;
+	struct wl_resource *resource;
+
+	if (ec->kb_repeat_rate == rate && ec->kb_repeat_delay == delay)
+		return;
+
+	ec->kb_repeat_rate = rate;
+	ec->kb_repeat_delay = delay;
+
+	wl_list_for_each(seat, &ec->seat_list, link) {
+		keyboard = seat->keyboard_state;
+		if (!keyboard)
+			continue;
+
+		wl_resource_for_each(resource, &keyboard->resource_list) {
+			if (wl_resource_get_version(resource) <
+			    WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION)
+				continue;
+			wl_keyboard_send_repeat_info(resource, rate, delay);
+		}
+		wl_resource_for_each(resource, &keyboard->focus_resource_list) {
+			if (wl_resource_get_version(resource) <
+			    WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION)
+				continue;
+			wl_keyboard_send_repeat_info(resource, rate, delay);
+		}
+	}
+}
+
 static void
 weston_xkb_info_destroy(struct weston_xkb_info *xkb_info);
 
@@ -2690,7 +2732,7 @@ pointer_cursor_surface_committed(struct weston_surface *es,
 
 	weston_view_set_position(pointer->sprite, x, y);
 
-	empty_region(&es->pending.input);
+	weston_surface_set_pending_input_rect(es, 0, 0, 0, 0);
 	empty_region(&es->input);
 
 	if (!weston_surface_is_mapped(es)) {
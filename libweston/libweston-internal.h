@@ -333,8 +333,11 @@ struct weston_drm_format {
 	struct wl_array modifiers;
 };
 
+/* Formats are kept sorted by code, and modifiers by value. */
 struct weston_drm_format_array {
 	struct wl_array arr;
+	/* index of the format last added, for remove_latest_format() */
+	unsigned int latest;
 };
 
 void
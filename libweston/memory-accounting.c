@@ -0,0 +1,487 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "linux-dmabuf.h"
+#include "memory-accounting.h"
+#include "pixel-formats.h"
+#include "shared/helpers.h"
+
+static const char *const memory_kind_names[] = {
+	[WESTON_MEMORY_CLIENT_BUFFER] = "buffers",
+	[WESTON_MEMORY_TEXTURE] = "textures",
+	[WESTON_MEMORY_FRAMEBUFFER] = "framebuffers",
+	[WESTON_MEMORY_SCANOUT] = "scanout",
+};
+static_assert(ARRAY_LENGTH(memory_kind_names) == WESTON_MEMORY_KIND_COUNT,
+	      "memory_kind_names must name every weston_memory_kind");
+
+static uint64_t
+memory_sum(const uint64_t bytes[WESTON_MEMORY_KIND_COUNT])
+{
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < WESTON_MEMORY_KIND_COUNT; i++)
+		sum += bytes[i];
+
+	return sum;
+}
+
+static void
+memory_add(uint64_t *counter, int64_t delta)
+{
+	/* Saturate, a stray release must not wrap the books around */
+	if (delta < 0 && (uint64_t)-delta > *counter)
+		*counter = 0;
+	else
+		*counter += delta;
+}
+
+static int
+memory_pressure_handler(void *data)
+{
+	struct weston_memory_accounting *ma = data;
+	struct weston_compositor *ec = ma->compositor;
+	uint64_t before;
+
+	ma->pressure_source = NULL;
+
+	before = memory_sum(ma->bytes);
+	if (!ma->pressure_limit || before <= ma->pressure_limit)
+		return 0;
+
+	if (!ec->renderer || !ec->renderer->release_hidden_caches)
+		return 0;
+
+	ec->renderer->release_hidden_caches(ec);
+	ma->pressure_events++;
+
+	weston_log_scope_printf(ma->scope,
+		"Memory pressure: %" PRIu64 " KiB in use, limit %" PRIu64
+		" KiB, released %" PRIu64 " KiB of caches\n",
+		before / 1024, ma->pressure_limit / 1024,
+		(before - MIN(before, memory_sum(ma->bytes))) / 1024);
+
+	return 0;
+}
+
+static void
+memory_charge(struct weston_memory_accounting *ma,
+	      struct weston_memory_owner *owner,
+	      enum weston_memory_kind kind, int64_t delta)
+{
+	struct wl_event_loop *loop;
+	uint64_t in_use;
+
+	memory_add(&ma->bytes[kind], delta);
+	if (owner)
+		memory_add(&owner->bytes[kind], delta);
+	else
+		memory_add(&ma->internal[kind], delta);
+
+	if (delta <= 0)
+		return;
+
+	in_use = memory_sum(ma->bytes);
+	ma->peak = MAX(ma->peak, in_use);
+
+	/* Release from idle, the caller may be using what would go away */
+	if (ma->pressure_limit && in_use > ma->pressure_limit &&
+	    !ma->pressure_source) {
+		loop = wl_display_get_event_loop(ma->compositor->wl_display);
+		ma->pressure_source =
+			wl_event_loop_add_idle(loop, memory_pressure_handler,
+					       ma);
+	}
+}
+
+static void
+memory_owner_client_destroy(struct wl_listener *listener, void *data)
+{
+	struct weston_memory_owner *owner =
+		wl_container_of(listener, owner, client_destroy_listener);
+
+	/* Its surfaces and buffers go next and drop the last references */
+	owner->client = NULL;
+}
+
+static struct weston_memory_owner *
+memory_owner_get(struct weston_memory_accounting *ma, struct wl_client *client)
+{
+	struct wl_listener *listener;
+	struct weston_memory_owner *owner;
+
+	listener = wl_client_get_destroy_listener(client,
+						  memory_owner_client_destroy);
+	if (listener) {
+		owner = wl_container_of(listener, owner,
+					client_destroy_listener);
+		owner->refcount++;
+		return owner;
+	}
+
+	owner = zalloc(sizeof *owner);
+	if (!owner)
+		return NULL;
+
+	owner->accounting = ma;
+	owner->client = client;
+	owner->refcount = 1;
+	wl_client_get_credentials(client, &owner->pid, NULL, NULL);
+	wl_list_init(&owner->surface_list);
+	wl_list_insert(ma->owner_list.prev, &owner->link);
+
+	owner->client_destroy_listener.notify = memory_owner_client_destroy;
+	wl_client_add_destroy_listener(client, &owner->client_destroy_listener);
+
+	return owner;
+}
+
+static void
+memory_owner_unref(struct weston_memory_owner *owner)
+{
+	if (--owner->refcount > 0)
+		return;
+
+	assert(wl_list_empty(&owner->surface_list));
+
+	if (owner->client)
+		wl_list_remove(&owner->client_destroy_listener.link);
+	wl_list_remove(&owner->link);
+	free(owner);
+}
+
+/** Charge memory allocated for a surface
+ *
+ * \param surface The surface the allocation belongs to.
+ * \param kind What the memory is used for.
+ * \param delta Bytes allocated, or released if negative.
+ *
+ * The memory counts against the client owning the surface, if any.
+ * Everything charged must be released again by the time the surface
+ * destroy signal handlers have run.
+ *
+ * \ingroup surface
+ */
+WL_EXPORT void
+weston_surface_charge_memory(struct weston_surface *surface,
+			     enum weston_memory_kind kind, int64_t delta)
+{
+	if (delta == 0)
+		return;
+
+	memory_add(&surface->memory_bytes[kind], delta);
+	memory_charge(surface->compositor->memory, surface->memory_owner,
+		      kind, delta);
+}
+
+/** Charge memory the compositor allocated for itself
+ *
+ * \param compositor The compositor.
+ * \param kind What the memory is used for.
+ * \param delta Bytes allocated, or released if negative.
+ *
+ * For output framebuffers and other allocations that belong to no
+ * particular surface.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_charge_memory(struct weston_compositor *compositor,
+				enum weston_memory_kind kind, int64_t delta)
+{
+	if (delta == 0)
+		return;
+
+	memory_charge(compositor->memory, NULL, kind, delta);
+}
+
+/** Set the memory limits
+ *
+ * \param compositor The compositor.
+ * \param client_limit Bytes of buffers one client may have attached, a
+ * client going over it gets disconnected. 0 for no limit.
+ * \param pressure_limit Bytes in use above which the renderer is asked to
+ * drop the caches of hidden surfaces. 0 for no limit.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_set_memory_limits(struct weston_compositor *compositor,
+				    uint64_t client_limit,
+				    uint64_t pressure_limit)
+{
+	struct weston_memory_accounting *ma = compositor->memory;
+
+	ma->client_limit = client_limit;
+	ma->pressure_limit = pressure_limit;
+}
+
+/* Bytes a client buffer takes, as far as the compositor can tell */
+static uint64_t
+buffer_memory_size(struct weston_buffer *buffer)
+{
+	struct wl_shm_buffer *shm_buffer;
+	struct linux_dmabuf_buffer *dmabuf;
+	const struct pixel_format_info *info;
+	uint64_t size = 0;
+	int i;
+
+	shm_buffer = wl_shm_buffer_get(buffer->resource);
+	if (shm_buffer)
+		return (uint64_t)wl_shm_buffer_get_stride(shm_buffer) *
+		       wl_shm_buffer_get_height(shm_buffer);
+
+	dmabuf = linux_dmabuf_buffer_get(buffer->resource);
+	if (dmabuf) {
+		info = pixel_format_get_info(dmabuf->attributes.format);
+		for (i = 0; i < dmabuf->attributes.n_planes; i++) {
+			size += (uint64_t)dmabuf->attributes.stride[i] *
+				(info ? pixel_format_height_for_plane(info, i,
+						dmabuf->attributes.height) :
+				 (unsigned int)dmabuf->attributes.height);
+		}
+		return size;
+	}
+
+	/* wl_drm and other EGL buffers, assume 32 bits per pixel */
+	return (uint64_t)buffer->width * buffer->height * 4;
+}
+
+/** Charge a newly attached buffer to its client
+ *
+ * \return false if the buffer takes the client over its limit, the
+ * buffer stays uncharged then.
+ */
+bool
+weston_memory_charge_buffer(struct weston_memory_accounting *ma,
+			    struct weston_buffer *buffer)
+{
+	struct weston_memory_owner *owner;
+	uint64_t size;
+
+	if (buffer->memory_owner)
+		return true;
+
+	size = buffer_memory_size(buffer);
+	if (size == 0)
+		return true;
+
+	owner = memory_owner_get(ma, wl_resource_get_client(buffer->resource));
+	if (!owner)
+		return true;
+
+	if (ma->client_limit &&
+	    owner->bytes[WESTON_MEMORY_CLIENT_BUFFER] + size > ma->client_limit) {
+		ma->refused++;
+		weston_log("Client (pid %d) goes over its buffer memory "
+			   "limit of %" PRIu64 " KiB\n", (int)owner->pid,
+			   ma->client_limit / 1024);
+		memory_owner_unref(owner);
+		return false;
+	}
+
+	buffer->memory_owner = owner;
+	buffer->memory_bytes = size;
+	memory_charge(ma, owner, WESTON_MEMORY_CLIENT_BUFFER, size);
+
+	return true;
+}
+
+/** Release what weston_memory_charge_buffer() charged */
+void
+weston_memory_uncharge_buffer(struct weston_buffer *buffer)
+{
+	struct weston_memory_owner *owner = buffer->memory_owner;
+
+	if (!owner)
+		return;
+
+	if (owner->accounting)
+		memory_charge(owner->accounting, owner,
+			      WESTON_MEMORY_CLIENT_BUFFER,
+			      -(int64_t)buffer->memory_bytes);
+	memory_owner_unref(owner);
+	buffer->memory_owner = NULL;
+	buffer->memory_bytes = 0;
+}
+
+/** Charge the surface's allocations to the client that created it */
+void
+weston_memory_surface_init(struct weston_surface *surface,
+			   struct wl_client *client)
+{
+	struct weston_memory_owner *owner;
+
+	owner = memory_owner_get(surface->compositor->memory, client);
+	if (!owner)
+		return;
+
+	surface->memory_owner = owner;
+	wl_list_insert(owner->surface_list.prev, &surface->memory_link);
+}
+
+/** Release anything still charged to a surface being destroyed */
+void
+weston_memory_surface_fini(struct weston_surface *surface)
+{
+	struct weston_memory_accounting *ma = surface->compositor->memory;
+	int i;
+
+	for (i = 0; i < WESTON_MEMORY_KIND_COUNT; i++) {
+		if (surface->memory_bytes[i] == 0)
+			continue;
+
+		memory_charge(ma, surface->memory_owner, i,
+			      -(int64_t)surface->memory_bytes[i]);
+		surface->memory_bytes[i] = 0;
+	}
+
+	wl_list_remove(&surface->memory_link);
+	wl_list_init(&surface->memory_link);
+
+	if (surface->memory_owner)
+		memory_owner_unref(surface->memory_owner);
+	surface->memory_owner = NULL;
+}
+
+static void
+memory_print_kinds(struct weston_log_subscription *sub,
+		   const uint64_t bytes[WESTON_MEMORY_KIND_COUNT])
+{
+	int i;
+
+	for (i = 0; i < WESTON_MEMORY_KIND_COUNT; i++) {
+		if (bytes[i] == 0)
+			continue;
+
+		weston_log_subscription_printf(sub, " %s %" PRIu64 " KiB",
+					       memory_kind_names[i],
+					       bytes[i] / 1024);
+	}
+	weston_log_subscription_printf(sub, "\n");
+}
+
+static void
+memory_print_surface(struct weston_log_subscription *sub,
+		     struct weston_surface *surface)
+{
+	struct weston_buffer *buffer = surface->buffer_ref.buffer;
+	char desc[512];
+
+	if (!surface->get_label ||
+	    surface->get_label(surface, desc, sizeof desc) < 0)
+		snprintf(desc, sizeof desc, "[no description available]");
+
+	weston_log_subscription_printf(sub, "\tSurface %s:", desc);
+	if (buffer && buffer->memory_owner)
+		weston_log_subscription_printf(sub,
+			" attached buffer %" PRIu64 " KiB", buffer->memory_bytes / 1024);
+	memory_print_kinds(sub, surface->memory_bytes);
+}
+
+static void
+memory_scope_subscribe(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_memory_accounting *ma = data;
+	struct weston_memory_owner *owner;
+	struct weston_surface *surface;
+
+	weston_log_subscription_printf(sub,
+		"Memory in use: %" PRIu64 " KiB, peak %" PRIu64 " KiB\n"
+		"Total:", memory_sum(ma->bytes) / 1024, ma->peak / 1024);
+	memory_print_kinds(sub, ma->bytes);
+
+	if (ma->client_limit)
+		weston_log_subscription_printf(sub,
+			"Client buffer limit: %" PRIu64 " KiB, "
+			"buffers refused: %" PRIu64 "\n",
+			ma->client_limit / 1024, ma->refused);
+	if (ma->pressure_limit)
+		weston_log_subscription_printf(sub,
+			"Pressure limit: %" PRIu64 " KiB, "
+			"caches released: %" PRIu64 " times\n",
+			ma->pressure_limit / 1024, ma->pressure_events);
+
+	weston_log_subscription_printf(sub, "Compositor:");
+	memory_print_kinds(sub, ma->internal);
+
+	wl_list_for_each(owner, &ma->owner_list, link) {
+		weston_log_subscription_printf(sub, "Client pid %d%s:",
+			(int)owner->pid, owner->client ? "" : " (gone)");
+		memory_print_kinds(sub, owner->bytes);
+
+		wl_list_for_each(surface, &owner->surface_list, memory_link)
+			memory_print_surface(sub, surface);
+	}
+
+	weston_log_subscription_complete(sub);
+}
+
+int
+weston_memory_accounting_init(struct weston_memory_accounting *ma,
+			      struct weston_compositor *compositor)
+{
+	ma->compositor = compositor;
+	wl_list_init(&ma->owner_list);
+
+	ma->scope = weston_compositor_add_log_scope(compositor, "memory",
+			"Memory used for client buffers, textures and "
+			"framebuffers, per client and surface\n",
+			memory_scope_subscribe, NULL, ma);
+
+	return 0;
+}
+
+void
+weston_memory_accounting_fini(struct weston_memory_accounting *ma)
+{
+	struct weston_memory_owner *owner, *next;
+
+	/* Owners of buffers outliving the compositor go with their last
+	 * reference, without touching the books anymore. */
+	wl_list_for_each_safe(owner, next, &ma->owner_list, link) {
+		if (owner->client)
+			wl_list_remove(&owner->client_destroy_listener.link);
+		wl_list_remove(&owner->link);
+		wl_list_init(&owner->link);
+		owner->client = NULL;
+		owner->accounting = NULL;
+	}
+
+	if (ma->pressure_source)
+		wl_event_source_remove(ma->pressure_source);
+
+	weston_log_scope_destroy(ma->scope);
+}
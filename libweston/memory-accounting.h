@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_MEMORY_ACCOUNTING_H
+#define WESTON_MEMORY_ACCOUNTING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <wayland-server-core.h>
+#include <libweston/libweston.h>
+
+struct weston_log_scope;
+
+/** Memory charged to one client
+ *
+ * Found through the client's destroy listener and kept alive by the
+ * surfaces and buffers charged to it, which may outlive the client by a
+ * little while its resources get destroyed.
+ */
+struct weston_memory_owner {
+	struct weston_memory_accounting *accounting;
+	struct wl_list link;		/* weston_memory_accounting::owner_list */
+	struct wl_listener client_destroy_listener;
+	struct wl_client *client;	/* NULL once the client is gone */
+	pid_t pid;
+	int refcount;
+
+	struct wl_list surface_list;	/* weston_surface::memory_link */
+	uint64_t bytes[WESTON_MEMORY_KIND_COUNT];
+};
+
+/** Compositor-wide memory accounting
+ *
+ * Client buffers are charged to the client when first attached, renderer
+ * and backend allocations to the surface they were made for, or to the
+ * compositor itself. A client going over the per-client limit is
+ * disconnected; going over the pressure limit makes the renderer drop
+ * what it only keeps to speed up repaints of hidden surfaces.
+ */
+struct weston_memory_accounting {
+	struct weston_compositor *compositor;
+	struct wl_list owner_list;	/* weston_memory_owner::link */
+
+	uint64_t bytes[WESTON_MEMORY_KIND_COUNT];	/* everything */
+	uint64_t internal[WESTON_MEMORY_KIND_COUNT];	/* no client */
+	uint64_t peak;
+
+	uint64_t client_limit;		/* 0 if unlimited */
+	uint64_t pressure_limit;	/* 0 if unlimited */
+	struct wl_event_source *pressure_source;
+
+	struct weston_log_scope *scope;
+
+	uint64_t pressure_events;	/* caches released under pressure */
+	uint64_t refused;		/* buffers over a client's limit */
+};
+
+int
+weston_memory_accounting_init(struct weston_memory_accounting *ma,
+			      struct weston_compositor *compositor);
+
+void
+weston_memory_accounting_fini(struct weston_memory_accounting *ma);
+
+void
+weston_memory_surface_init(struct weston_surface *surface,
+			   struct wl_client *client);
+
+void
+weston_memory_surface_fini(struct weston_surface *surface);
+
+bool
+weston_memory_charge_buffer(struct weston_memory_accounting *ma,
+			    struct weston_buffer *buffer);
+
+void
+weston_memory_uncharge_buffer(struct weston_buffer *buffer);
+
+#endif /* WESTON_MEMORY_ACCOUNTING_H */
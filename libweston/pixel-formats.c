@@ -28,6 +28,7 @@
 
 #include <endian.h>
 #include <inttypes.h>
+#include <assert.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -474,6 +475,153 @@ static const struct pixel_format_info pixel_format_table[] = {
 	},
 };
 
+/* Lookup indices over pixel_format_table, built on first use. Slots hold
+ * a table index plus one, so that zero marks an empty slot. The table is
+ * constant, so the indices never change once built. Like the rest of
+ * libweston, this assumes lookups happen from a single thread.
+ */
+#define PIXEL_FORMAT_HASH_BITS 8
+#define PIXEL_FORMAT_HASH_SIZE (1u << PIXEL_FORMAT_HASH_BITS)
+#define PIXEL_FORMAT_HASH_MASK (PIXEL_FORMAT_HASH_SIZE - 1)
+
+static_assert(ARRAY_LENGTH(pixel_format_table) < PIXEL_FORMAT_HASH_SIZE / 2,
+	      "pixel format hash tables must stay at most half full");
+
+static struct {
+	bool built;
+	uint8_t by_format[PIXEL_FORMAT_HASH_SIZE];
+	uint8_t by_name[PIXEL_FORMAT_HASH_SIZE];
+	uint8_t by_opaque_substitute[PIXEL_FORMAT_HASH_SIZE];
+	uint8_t opaque_substitute[ARRAY_LENGTH(pixel_format_table)];
+	uint32_t caps[ARRAY_LENGTH(pixel_format_table)];
+} pixel_format_index;
+
+static inline uint32_t
+pixel_format_hash(uint32_t format)
+{
+	/* Fibonacci hashing; fourcc codes differ mostly in their top bytes */
+	return (format * 2654435769u) >> (32 - PIXEL_FORMAT_HASH_BITS);
+}
+
+static uint32_t
+pixel_format_hash_name(const char *name)
+{
+	uint32_t hash = 2166136261u;
+	unsigned char c;
+
+	for (; *name; name++) {
+		c = *name;
+		if (c >= 'a' && c <= 'z')
+			c -= 'a' - 'A';
+		hash = (hash ^ c) * 16777619u;
+	}
+
+	return hash & PIXEL_FORMAT_HASH_MASK;
+}
+
+static void
+pixel_format_index_insert(uint8_t *slots, uint32_t hash, unsigned int index)
+{
+	while (slots[hash])
+		hash = (hash + 1) & PIXEL_FORMAT_HASH_MASK;
+	slots[hash] = index + 1;
+}
+
+static const struct pixel_format_info *
+pixel_format_index_find(const uint8_t *slots, uint32_t hash,
+			uint32_t format, bool match_opaque_substitute)
+{
+	const struct pixel_format_info *info;
+
+	for (; slots[hash]; hash = (hash + 1) & PIXEL_FORMAT_HASH_MASK) {
+		info = &pixel_format_table[slots[hash] - 1];
+		if ((match_opaque_substitute ? info->opaque_substitute :
+					       info->format) == format)
+			return info;
+	}
+
+	return NULL;
+}
+
+static uint32_t
+pixel_format_derive_caps(const struct pixel_format_info *info)
+{
+	uint32_t caps = 0;
+
+	if (info->opaque_substitute)
+		caps |= PIXEL_FORMAT_CAP_HAS_OPAQUE_SUBSTITUTE;
+	else
+		caps |= PIXEL_FORMAT_CAP_OPAQUE;
+
+	/* only YUV formats come without RGB channel bits */
+	if (!info->bits.r && !info->bits.g && !info->bits.b)
+		caps |= PIXEL_FORMAT_CAP_YUV;
+
+	if (info->num_planes > 1)
+		caps |= PIXEL_FORMAT_CAP_MULTI_PLANAR;
+
+	if (info->hsub > 1 || info->vsub > 1)
+		caps |= PIXEL_FORMAT_CAP_SUBSAMPLED;
+
+	return caps;
+}
+
+static void
+pixel_format_index_build(void)
+{
+	const struct pixel_format_info *info, *sub;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(pixel_format_table); i++) {
+		info = &pixel_format_table[i];
+
+		/* keep the first entry for a code, as the linear scan did */
+		if (!pixel_format_index_find(pixel_format_index.by_format,
+					     pixel_format_hash(info->format),
+					     info->format, false))
+			pixel_format_index_insert(pixel_format_index.by_format,
+						  pixel_format_hash(info->format),
+						  i);
+
+		pixel_format_index_insert(pixel_format_index.by_name,
+					  pixel_format_hash_name(info->drm_format_name),
+					  i);
+
+		if (info->opaque_substitute &&
+		    !pixel_format_index_find(pixel_format_index.by_opaque_substitute,
+					     pixel_format_hash(info->opaque_substitute),
+					     info->opaque_substitute, true))
+			pixel_format_index_insert(pixel_format_index.by_opaque_substitute,
+						  pixel_format_hash(info->opaque_substitute),
+						  i);
+
+		pixel_format_index.caps[i] = pixel_format_derive_caps(info);
+	}
+
+	/* second pass, so that substitutes later in the table are found */
+	for (i = 0; i < ARRAY_LENGTH(pixel_format_table); i++) {
+		info = &pixel_format_table[i];
+		if (!info->opaque_substitute)
+			continue;
+
+		sub = pixel_format_index_find(pixel_format_index.by_format,
+					      pixel_format_hash(info->opaque_substitute),
+					      info->opaque_substitute, false);
+		if (sub)
+			pixel_format_index.opaque_substitute[i] =
+				sub - pixel_format_table + 1;
+	}
+
+	pixel_format_index.built = true;
+}
+
+static inline void
+pixel_format_index_ensure(void)
+{
+	if (!pixel_format_index.built)
+		pixel_format_index_build();
+}
+
 WL_EXPORT const struct pixel_format_info *
 pixel_format_get_info_shm(uint32_t format)
 {
@@ -488,14 +636,11 @@ pixel_format_get_info_shm(uint32_t format)
 WL_EXPORT const struct pixel_format_info *
 pixel_format_get_info(uint32_t format)
 {
-	unsigned int i;
+	pixel_format_index_ensure();
 
-	for (i = 0; i < ARRAY_LENGTH(pixel_format_table); i++) {
-		if (pixel_format_table[i].format == format)
-			return &pixel_format_table[i];
-	}
-
-	return NULL;
+	return pixel_format_index_find(pixel_format_index.by_format,
+				       pixel_format_hash(format),
+				       format, false);
 }
 
 WL_EXPORT const struct pixel_format_info *
@@ -518,10 +663,14 @@ WL_EXPORT const struct pixel_format_info *
 pixel_format_get_info_by_drm_name(const char *drm_format_name)
 {
 	const struct pixel_format_info *info;
-	unsigned int i;
+	uint32_t hash;
 
-	for (i = 0; i < ARRAY_LENGTH(pixel_format_table); i++) {
-		info = &pixel_format_table[i];
+	pixel_format_index_ensure();
+
+	hash = pixel_format_hash_name(drm_format_name);
+	for (; pixel_format_index.by_name[hash];
+	     hash = (hash + 1) & PIXEL_FORMAT_HASH_MASK) {
+		info = &pixel_format_table[pixel_format_index.by_name[hash] - 1];
 		if (strcasecmp(info->drm_format_name, drm_format_name) == 0)
 			return info;
 	}
@@ -529,6 +678,14 @@ pixel_format_get_info_by_drm_name(const char *drm_format_name)
 	return NULL;
 }
 
+WL_EXPORT uint32_t
+pixel_format_get_caps(const struct pixel_format_info *info)
+{
+	pixel_format_index_ensure();
+
+	return pixel_format_index.caps[info - pixel_format_table];
+}
+
 WL_EXPORT unsigned int
 pixel_format_get_plane_count(const struct pixel_format_info *info)
 {
@@ -544,23 +701,28 @@ pixel_format_is_opaque(const struct pixel_format_info *info)
 WL_EXPORT const struct pixel_format_info *
 pixel_format_get_opaque_substitute(const struct pixel_format_info *info)
 {
+	unsigned int sub;
+
 	if (!info->opaque_substitute)
 		return info;
-	else
-		return pixel_format_get_info(info->opaque_substitute);
+
+	pixel_format_index_ensure();
+
+	sub = pixel_format_index.opaque_substitute[info - pixel_format_table];
+	if (!sub)
+		return NULL;
+
+	return &pixel_format_table[sub - 1];
 }
 
 WL_EXPORT const struct pixel_format_info *
 pixel_format_get_info_by_opaque_substitute(uint32_t format)
 {
-	unsigned int i;
+	pixel_format_index_ensure();
 
-	for (i = 0; i < ARRAY_LENGTH(pixel_format_table); i++) {
-		if (pixel_format_table[i].opaque_substitute == format)
-			return &pixel_format_table[i];
-	}
-
-	return NULL;
+	return pixel_format_index_find(pixel_format_index.by_opaque_substitute,
+				       pixel_format_hash(format),
+				       format, true);
 }
 
 WL_EXPORT unsigned int
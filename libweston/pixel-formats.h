@@ -120,6 +120,22 @@ struct pixel_format_info {
 	} component_type;
 };
 
+/**
+ * Capability bits of a pixel format, see pixel_format_get_caps()
+ */
+enum pixel_format_caps {
+	/** No significant alpha channel, see pixel_format_is_opaque() */
+	PIXEL_FORMAT_CAP_OPAQUE = 1 << 0,
+	/** Has alpha and an opaque_substitute */
+	PIXEL_FORMAT_CAP_HAS_OPAQUE_SUBSTITUTE = 1 << 1,
+	/** Luma/chroma rather than RGB channels */
+	PIXEL_FORMAT_CAP_YUV = 1 << 2,
+	/** More than one plane in the base (non-modified) format */
+	PIXEL_FORMAT_CAP_MULTI_PLANAR = 1 << 3,
+	/** Secondary planes are horizontally or vertically subsampled */
+	PIXEL_FORMAT_CAP_SUBSAMPLED = 1 << 4,
+};
+
 /**
  * Get pixel format information for a DRM format code
  *
@@ -185,6 +201,20 @@ pixel_format_get_info_count(void);
 const struct pixel_format_info *
 pixel_format_get_info_by_drm_name(const char *drm_format_name);
 
+/**
+ * Get the precomputed capability bits of a pixel format
+ *
+ * The bits are derived once from the format table, so hot paths can test
+ * several properties of a format with a single mask instead of looking at
+ * the individual members.
+ *
+ * @param format Pixel format info structure, as returned by one of the
+ *               pixel_format_get_info*() functions
+ * @returns A bitmask of enum pixel_format_caps
+ */
+uint32_t
+pixel_format_get_caps(const struct pixel_format_info *format);
+
 /**
  * Get number of planes used by a pixel format
  *
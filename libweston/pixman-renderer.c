@@ -663,7 +663,8 @@ pixman_renderer_attach(struct weston_surface *es, struct weston_buffer *buffer)
 		return;
 	}
 
-	es->is_opaque = pixel_format_is_opaque(pixel_info);
+	es->is_opaque = pixel_format_get_caps(pixel_info) &
+			PIXEL_FORMAT_CAP_OPAQUE;
 
 	buffer->shm_buffer = shm_buffer;
 	buffer->width = wl_shm_buffer_get_width(shm_buffer);
@@ -959,6 +960,10 @@ pixman_renderer_output_create(struct weston_output *output,
 			free(po);
 			return -1;
 		}
+
+		weston_compositor_charge_memory(output->compositor,
+						WESTON_MEMORY_FRAMEBUFFER,
+						(int64_t)w * h * 4);
 	}
 
 	output->renderer_state = po;
@@ -971,8 +976,13 @@ pixman_renderer_output_destroy(struct weston_output *output)
 {
 	struct pixman_output_state *po = get_output_state(output);
 
-	if (po->shadow_image)
+	if (po->shadow_image) {
+		weston_compositor_charge_memory(output->compositor,
+				WESTON_MEMORY_FRAMEBUFFER,
+				-(int64_t)pixman_image_get_stride(po->shadow_image) *
+				pixman_image_get_height(po->shadow_image));
 		pixman_image_unref(po->shadow_image);
+	}
 
 	if (po->hw_buffer)
 		pixman_image_unref(po->hw_buffer);
@@ -0,0 +1,232 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "region-arena.h"
+
+/* Empty a region, keeping its rectangle storage for the next frame. */
+static void
+region_empty_keep_storage(pixman_region32_t *region)
+{
+	if (region->data && region->data->size > 0) {
+		/* pixman accepts numRects == 0 with storage as empty */
+		region->data->numRects = 0;
+		region->extents.x1 = region->extents.x2 = 0;
+		region->extents.y1 = region->extents.y2 = 0;
+	} else {
+		pixman_region32_clear(region);
+	}
+}
+
+WL_EXPORT void
+weston_region_arena_init(struct weston_region_arena *arena)
+{
+	wl_array_init(&arena->slots);
+	arena->used = 0;
+	arena->frames = 0;
+	arena->allocations = 0;
+	arena->frame_allocations = 0;
+	arena->last_frame_allocations = 0;
+}
+
+WL_EXPORT void
+weston_region_arena_fini(struct weston_region_arena *arena)
+{
+	pixman_region32_t **slot;
+
+	wl_array_for_each(slot, &arena->slots) {
+		pixman_region32_fini(*slot);
+		free(*slot);
+	}
+	wl_array_release(&arena->slots);
+}
+
+/** Take an empty scratch region, valid until weston_region_arena_reset()
+ *
+ * \return the region, or NULL if the arena is out of memory.
+ */
+WL_EXPORT pixman_region32_t *
+weston_region_arena_get(struct weston_region_arena *arena)
+{
+	pixman_region32_t **slots = arena->slots.data;
+	pixman_region32_t **slot;
+	pixman_region32_t *region;
+
+	if (arena->used < arena->slots.size / sizeof *slots)
+		return slots[arena->used++];
+
+	region = malloc(sizeof *region);
+	if (!region)
+		return NULL;
+
+	slot = wl_array_add(&arena->slots, sizeof *slot);
+	if (!slot) {
+		free(region);
+		return NULL;
+	}
+
+	pixman_region32_init(region);
+	*slot = region;
+	arena->used++;
+	arena->allocations++;
+	arena->frame_allocations++;
+
+	return region;
+}
+
+/** Take a scratch region, or fall back to a plain one when out of memory
+ *
+ * If the arena cannot grow, \p fallback is initialized and returned
+ * instead, so the damage math degrades to allocating per frame rather
+ * than failing. Either way, hand the result to
+ * weston_region_arena_release() once done with it.
+ */
+WL_EXPORT pixman_region32_t *
+weston_region_arena_get_or_init(struct weston_region_arena *arena,
+				pixman_region32_t *fallback)
+{
+	pixman_region32_t *region;
+
+	region = weston_region_arena_get(arena);
+	if (region)
+		return region;
+
+	pixman_region32_init(fallback);
+
+	return fallback;
+}
+
+/** Finish \p fallback if weston_region_arena_get_or_init() returned it
+ *
+ * Regions from the arena itself stay taken until the reset.
+ */
+WL_EXPORT void
+weston_region_arena_release(pixman_region32_t *region,
+			    pixman_region32_t *fallback)
+{
+	if (region == fallback)
+		pixman_region32_fini(fallback);
+}
+
+/** Return all scratch regions to the arena, at the end of a repaint */
+WL_EXPORT void
+weston_region_arena_reset(struct weston_region_arena *arena)
+{
+	pixman_region32_t **slots = arena->slots.data;
+	unsigned i;
+
+	for (i = 0; i < arena->used; i++)
+		region_empty_keep_storage(slots[i]);
+	arena->used = 0;
+
+	arena->frames++;
+	arena->last_frame_allocations = arena->frame_allocations;
+	arena->frame_allocations = 0;
+}
+
+static void
+arena_account(struct weston_region_arena *arena,
+	      pixman_region32_t *dst, pixman_region32_data_t *old_data)
+{
+	if (dst->data != old_data && dst->data && dst->data->size > 0) {
+		arena->allocations++;
+		arena->frame_allocations++;
+	}
+}
+
+WL_EXPORT void
+weston_region_arena_copy(struct weston_region_arena *arena,
+			 pixman_region32_t *dst, pixman_region32_t *src)
+{
+	pixman_region32_data_t *old_data = dst->data;
+
+	pixman_region32_copy(dst, src);
+	arena_account(arena, dst, old_data);
+}
+
+WL_EXPORT void
+weston_region_arena_union(struct weston_region_arena *arena,
+			  pixman_region32_t *dst,
+			  pixman_region32_t *a, pixman_region32_t *b)
+{
+	pixman_region32_data_t *old_data = dst->data;
+
+	assert(dst != a && dst != b);
+
+	pixman_region32_union(dst, a, b);
+	arena_account(arena, dst, old_data);
+}
+
+WL_EXPORT void
+weston_region_arena_intersect(struct weston_region_arena *arena,
+			      pixman_region32_t *dst,
+			      pixman_region32_t *a, pixman_region32_t *b)
+{
+	pixman_region32_data_t *old_data = dst->data;
+
+	assert(dst != a && dst != b);
+
+	pixman_region32_intersect(dst, a, b);
+	arena_account(arena, dst, old_data);
+}
+
+WL_EXPORT void
+weston_region_arena_subtract(struct weston_region_arena *arena,
+			     pixman_region32_t *dst,
+			     pixman_region32_t *a, pixman_region32_t *b)
+{
+	pixman_region32_data_t *old_data = dst->data;
+
+	assert(dst != a && dst != b);
+
+	pixman_region32_subtract(dst, a, b);
+	arena_account(arena, dst, old_data);
+}
+
+/** Exchange two regions, including their storage, without copying */
+WL_EXPORT void
+weston_region_swap(pixman_region32_t *a, pixman_region32_t *b)
+{
+	pixman_region32_t tmp = *a;
+
+	*a = *b;
+	*b = tmp;
+}
+
+/** Empty a long-lived region, keeping its storage like the arena slots
+ *
+ * For regions that outlive a repaint but are emptied by it, such as
+ * surface damage: the next union into the empty region copies into the
+ * kept storage instead of allocating.
+ */
+WL_EXPORT void
+weston_region_empty(pixman_region32_t *region)
+{
+	region_empty_keep_storage(region);
+}
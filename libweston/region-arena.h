@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_REGION_ARENA_H
+#define WESTON_REGION_ARENA_H
+
+#include <stdint.h>
+#include <pixman.h>
+#include <wayland-util.h>
+
+/** Scratch regions for the damage math of one repaint
+ *
+ * pixman keeps the rectangles of a region in heap storage, and the usual
+ * init/op/fini sequence on a temporary allocates that storage again every
+ * frame. Regions taken from the arena live across frames instead: they
+ * are handed out in the same order each repaint and emptied, not freed,
+ * by weston_region_arena_reset(), so once their storage has grown to the
+ * shapes a scene produces, the damage math stops allocating.
+ *
+ * pixman also replaces the storage of a destination that aliases one of
+ * the operands, so the weston_region_arena_* operations below require
+ * distinct regions. They count every storage (re)allocation of their
+ * destination, which the scene-graph debug scope reports.
+ */
+struct weston_region_arena {
+	struct wl_array slots;		/* pixman_region32_t * */
+	unsigned used;
+
+	uint64_t frames;
+	uint64_t allocations;		/* since creation */
+	uint64_t frame_allocations;	/* in the current frame */
+	uint64_t last_frame_allocations;
+};
+
+void
+weston_region_arena_init(struct weston_region_arena *arena);
+
+void
+weston_region_arena_fini(struct weston_region_arena *arena);
+
+pixman_region32_t *
+weston_region_arena_get(struct weston_region_arena *arena);
+
+pixman_region32_t *
+weston_region_arena_get_or_init(struct weston_region_arena *arena,
+				pixman_region32_t *fallback);
+
+void
+weston_region_arena_release(pixman_region32_t *region,
+			    pixman_region32_t *fallback);
+
+void
+weston_region_arena_reset(struct weston_region_arena *arena);
+
+void
+weston_region_arena_copy(struct weston_region_arena *arena,
+			 pixman_region32_t *dst, pixman_region32_t *src);
+
+void
+weston_region_arena_union(struct weston_region_arena *arena,
+			  pixman_region32_t *dst,
+			  pixman_region32_t *a, pixman_region32_t *b);
+
+void
+weston_region_arena_intersect(struct weston_region_arena *arena,
+			      pixman_region32_t *dst,
+			      pixman_region32_t *a, pixman_region32_t *b);
+
+void
+weston_region_arena_subtract(struct weston_region_arena *arena,
+			     pixman_region32_t *dst,
+			     pixman_region32_t *a, pixman_region32_t *b);
+
+void
+weston_region_swap(pixman_region32_t *a, pixman_region32_t *b);
+
+void
+weston_region_empty(pixman_region32_t *region);
+
+#endif /* WESTON_REGION_ARENA_H */
@@ -46,10 +46,18 @@
 #define SHADER_COLOR_CURVE_IDENTITY 0
 #define SHADER_COLOR_CURVE_LUT_3x1D 1
 
+/* enum gl_shader_color_mapping */
+#define SHADER_COLOR_MAPPING_IDENTITY 0
+#define SHADER_COLOR_MAPPING_3DLUT 1
+
 #if DEF_VARIANT == SHADER_VARIANT_EXTERNAL
 #extension GL_OES_EGL_image_external : require
 #endif
 
+#if DEF_COLOR_MAPPING == SHADER_COLOR_MAPPING_3DLUT
+#extension GL_OES_texture_3D : require
+#endif
+
 #ifdef GL_FRAGMENT_PRECISION_HIGH
 #define HIGHPRECISION highp
 #else
@@ -66,6 +74,7 @@ compile_const int c_variant = DEF_VARIANT;
 compile_const bool c_input_is_premult = DEF_INPUT_IS_PREMULT;
 compile_const bool c_green_tint = DEF_GREEN_TINT;
 compile_const int c_color_pre_curve = DEF_COLOR_PRE_CURVE;
+compile_const int c_color_mapping = DEF_COLOR_MAPPING;
 
 vec4
 yuva2rgba(vec4 yuva)
@@ -110,6 +119,11 @@ uniform vec4 unicolor;
 uniform HIGHPRECISION sampler2D color_pre_curve_lut_2d;
 uniform HIGHPRECISION vec2 color_pre_curve_lut_scale_offset;
 
+#if DEF_COLOR_MAPPING == SHADER_COLOR_MAPPING_3DLUT
+uniform HIGHPRECISION sampler3D color_mapping_lut_3d;
+uniform HIGHPRECISION vec2 color_mapping_lut_scale_offset;
+#endif
+
 vec4
 sample_input_texture()
 {
@@ -199,6 +213,23 @@ color_pre_curve(vec3 color)
 	}
 }
 
+/*
+ * Sample a 3D LUT with trilinear filtering, one texture fetch for the
+ * whole color mapping.
+ */
+vec3
+color_mapping(vec3 color)
+{
+#if DEF_COLOR_MAPPING == SHADER_COLOR_MAPPING_3DLUT
+	vec3 pos = color * color_mapping_lut_scale_offset.s +
+		   color_mapping_lut_scale_offset.t;
+
+	return texture3D(color_mapping_lut_3d, pos).rgb;
+#else
+	return color;
+#endif
+}
+
 vec4
 color_pipeline(vec4 color)
 {
@@ -206,6 +237,7 @@ color_pipeline(vec4 color)
 	color.a *= alpha;
 
 	color.rgb = color_pre_curve(color.rgb);
+	color.rgb = color_mapping(color.rgb);
 
 	return color;
 }
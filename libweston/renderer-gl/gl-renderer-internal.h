@@ -56,6 +56,12 @@ enum gl_shader_color_curve {
 	SHADER_COLOR_CURVE_LUT_3x1D,
 };
 
+/* Keep the following in sync with fragment.glsl. */
+enum gl_shader_color_mapping {
+	SHADER_COLOR_MAPPING_IDENTITY = 0,
+	SHADER_COLOR_MAPPING_3DLUT,
+};
+
 /** GL shader requirements key
  *
  * This structure is used as a binary blob key for building and searching
@@ -71,12 +77,13 @@ struct gl_shader_requirements
 	bool input_is_premult:1;
 	bool green_tint:1;
 	unsigned color_pre_curve:1; /* enum gl_shader_color_curve */
+	unsigned color_mapping:1; /* enum gl_shader_color_mapping */
 
 	/*
 	 * The total size of all bitfields plus pad_bits_ must fill up exactly
 	 * how many bytes the compiler allocates for them together.
 	 */
-	unsigned pad_bits_:25;
+	unsigned pad_bits_:24;
 };
 static_assert(sizeof(struct gl_shader_requirements) ==
 	      4 /* total bitfield size in bytes */,
@@ -96,6 +103,8 @@ struct gl_shader_config {
 	GLuint input_tex[GL_SHADER_INPUT_TEX_MAX];
 	GLuint color_pre_curve_lut_tex;
 	GLfloat color_pre_curve_lut_scale_offset[2];
+	GLuint color_mapping_lut_tex;
+	GLfloat color_mapping_lut_scale_offset[2];
 };
 
 struct gl_renderer {
@@ -118,6 +127,7 @@ struct gl_renderer {
 
 	struct wl_array vertices;
 	struct wl_array vtxcnt;
+	struct wl_array clip_quads;
 
 	EGLDeviceEXT egl_device;
 	const char *drm_device;
@@ -153,6 +163,14 @@ struct gl_renderer {
 	bool has_dmabuf_import;
 	struct wl_list dmabuf_images;
 	struct wl_list dmabuf_formats;
+	struct weston_log_scope *dmabuf_scope;
+	struct {
+		unsigned hits;	/* attaches that reused cached textures */
+		unsigned misses;	/* attaches that had to bind textures */
+	} dmabuf_texture_stats;
+
+	/* Surfaces holding an RGB copy of their YUV contents */
+	struct wl_list yuv_cache_list; /* gl_surface_state::yuv_cache_link */
 
 	bool has_texture_type_2_10_10_10_rev;
 	bool has_gl_texture_rg;
@@ -179,6 +197,8 @@ struct gl_renderer {
 	PFNEGLWAITSYNCKHRPROC wait_sync;
 
 	bool gl_supports_color_transforms;
+	/* color transforms with a 3D LUT color mapping step */
+	bool gl_supports_color_mapping_3dlut;
 
 	/** Shader program cache in most recently used order
 	 *
@@ -186,6 +206,27 @@ struct gl_renderer {
 	 */
 	struct wl_list shader_list;
 	struct weston_log_scope *shader_scope;
+
+	bool has_program_binary;
+	PFNGLGETPROGRAMBINARYOESPROC get_program_binary;
+	PFNGLPROGRAMBINARYOESPROC program_binary;
+
+	/** On-disk program binary cache directory, NULL if disabled */
+	char *shader_cache_dir;
+
+	/** Programs to build on idle, struct gl_shader_requirements */
+	struct wl_array shader_precompile_queue;
+	size_t shader_precompile_next;
+	struct wl_event_source *shader_precompile_source;
+	struct timespec shader_precompile_begin;
+
+	struct {
+		unsigned compiled;
+		unsigned loaded;
+		int64_t compile_nsec;
+		int64_t load_nsec;
+		int64_t saved_nsec;
+	} shader_stats;
 };
 
 static inline struct gl_renderer *
@@ -236,6 +277,15 @@ gl_renderer_create_fallback_shader(struct gl_renderer *gr);
 void
 gl_renderer_garbage_collect_programs(struct gl_renderer *gr);
 
+void
+gl_shader_cache_init(struct gl_renderer *gr);
+
+void
+gl_shader_cache_fini(struct gl_renderer *gr);
+
+void
+gl_renderer_schedule_shader_precompile(struct gl_renderer *gr);
+
 bool
 gl_renderer_use_program(struct gl_renderer *gr,
 			const struct gl_shader_config *sconf);
@@ -53,6 +53,7 @@
 #include "linux-dmabuf-unstable-v1-server-protocol.h"
 #include "linux-explicit-synchronization.h"
 #include "pixel-formats.h"
+#include "region-arena.h"
 
 #include "shared/fd-util.h"
 #include "shared/helpers.h"
@@ -119,6 +120,9 @@ struct egl_image {
 	struct gl_renderer *renderer;
 	EGLImageKHR image;
 	int refcount;
+
+	/* Texture bound to this image once, owned by the image; 0 if none */
+	GLuint texture;
 };
 
 enum import_type {
@@ -173,6 +177,8 @@ struct gl_surface_state {
 
 	GLuint textures[3];
 	int num_textures;
+	/* textures[] belong to images[] (cached dmabuf textures) */
+	bool textures_borrowed;
 	bool needs_full_upload;
 	pixman_region32_t texture_damage;
 
@@ -186,6 +192,15 @@ struct gl_surface_state {
 	int num_images;
 	enum gl_shader_texture_variant shader_variant;
 
+	/* RGB copy of the YUV contents for surfaces drawn several times
+	 * per repaint cycle; reset on every attach and upload. */
+	struct gl_fbo_texture yuv_cache;
+	bool yuv_cache_valid;
+	struct wl_list yuv_cache_link; /* gl_renderer::yuv_cache_list */
+
+	/* SHM texture storage charged to the surface */
+	uint64_t texture_bytes;
+
 	struct weston_buffer_reference buffer_ref;
 	struct weston_buffer_release_reference buffer_release_ref;
 	enum buffer_type buffer_type;
@@ -407,6 +422,8 @@ egl_image_unref(struct egl_image *image)
 	if (image->refcount > 0)
 		return image->refcount;
 
+	if (image->texture)
+		glDeleteTextures(1, &image->texture);
 	gr->destroy_image(gr->egl_display, image->image);
 	free(image);
 
@@ -439,81 +456,6 @@ dmabuf_image_destroy(struct dmabuf_image *image)
 	free(image);
 }
 
-#define max(a, b) (((a) > (b)) ? (a) : (b))
-#define min(a, b) (((a) > (b)) ? (b) : (a))
-
-/*
- * Compute the boundary vertices of the intersection of the global coordinate
- * aligned rectangle 'rect', and an arbitrary quadrilateral produced from
- * 'surf_rect' when transformed from surface coordinates into global coordinates.
- * The vertices are written to 'ex' and 'ey', and the return value is the
- * number of vertices. Vertices are produced in clockwise winding order.
- * Guarantees to produce either zero vertices, or 3-8 vertices with non-zero
- * polygon area.
- */
-static int
-calculate_edges(struct weston_view *ev, pixman_box32_t *rect,
-		pixman_box32_t *surf_rect, GLfloat *ex, GLfloat *ey)
-{
-
-	struct clip_context ctx;
-	int i, n;
-	GLfloat min_x, max_x, min_y, max_y;
-	struct polygon8 surf = {
-		{ surf_rect->x1, surf_rect->x2, surf_rect->x2, surf_rect->x1 },
-		{ surf_rect->y1, surf_rect->y1, surf_rect->y2, surf_rect->y2 },
-		4
-	};
-
-	ctx.clip.x1 = rect->x1;
-	ctx.clip.y1 = rect->y1;
-	ctx.clip.x2 = rect->x2;
-	ctx.clip.y2 = rect->y2;
-
-	/* transform surface to screen space: */
-	for (i = 0; i < surf.n; i++)
-		weston_view_to_global_float(ev, surf.x[i], surf.y[i],
-					    &surf.x[i], &surf.y[i]);
-
-	/* find bounding box: */
-	min_x = max_x = surf.x[0];
-	min_y = max_y = surf.y[0];
-
-	for (i = 1; i < surf.n; i++) {
-		min_x = min(min_x, surf.x[i]);
-		max_x = max(max_x, surf.x[i]);
-		min_y = min(min_y, surf.y[i]);
-		max_y = max(max_y, surf.y[i]);
-	}
-
-	/* First, simple bounding box check to discard early transformed
-	 * surface rects that do not intersect with the clip region:
-	 */
-	if ((min_x >= ctx.clip.x2) || (max_x <= ctx.clip.x1) ||
-	    (min_y >= ctx.clip.y2) || (max_y <= ctx.clip.y1))
-		return 0;
-
-	/* Simple case, bounding box edges are parallel to surface edges,
-	 * there will be only four edges.  We just need to clip the surface
-	 * vertices to the clip rect bounds:
-	 */
-	if (!ev->transform.enabled)
-		return clip_simple(&ctx, &surf, ex, ey);
-
-	/* Transformed case: use a general polygon clipping algorithm to
-	 * clip the surface rectangle with each side of 'rect'.
-	 * The algorithm is Sutherland-Hodgman, as explained in
-	 * http://www.codeguru.com/cpp/misc/misc/graphics/article.php/c8965/Polygon-Clipping.htm
-	 * but without looking at any of that code.
-	 */
-	n = clip_transformed(&ctx, &surf, ex, ey);
-
-	if (n < 3)
-		return 0;
-
-	return n;
-}
-
 static bool
 merge_down(pixman_box32_t *a, pixman_box32_t *b, pixman_box32_t *merge)
 {
@@ -562,6 +504,13 @@ compress_bands(pixman_box32_t *inrects, int nrects, pixman_box32_t **outrects)
 	return nout;
 }
 
+/*
+ * Transform every rectangle of 'surf_region' from surface coordinates into
+ * global coordinates once, then clip the resulting quadrilaterals against
+ * every rectangle of 'region' in one batch. The intersections are emitted
+ * into gr->vertices as triangle fans with texture coordinates, and their
+ * vertex counts into gr->vtxcnt.
+ */
 static int
 texture_region(struct weston_view *ev,
 	       pixman_region32_t *region,
@@ -571,11 +520,13 @@ texture_region(struct weston_view *ev,
 	struct weston_compositor *ec = ev->surface->compositor;
 	struct gl_renderer *gr = get_renderer(ec);
 	GLfloat *v, inv_width, inv_height;
-	unsigned int *vtxcnt, nvtx = 0;
+	unsigned int *vtxcnt, nvtx, total = 0;
 	pixman_box32_t *rects, *surf_rects;
 	pixman_box32_t *raw_rects;
-	int i, j, k, nrects, nsurf, raw_nrects;
+	struct clip_quad *quads;
+	int i, j, nrects, nsurf, raw_nrects;
 	bool used_band_compression;
+	bool axis_aligned;
 	raw_rects = pixman_region32_rectangles(region, &raw_nrects);
 	surf_rects = pixman_region32_rectangles(surf_region, &nsurf);
 
@@ -587,62 +538,69 @@ texture_region(struct weston_view *ev,
 		nrects = compress_bands(raw_rects, raw_nrects, &rects);
 		used_band_compression = true;
 	}
+
+	/* Without rotation or shear the transformed surface rects stay
+	 * parallel to the clip rects, and there will be only four edges.
+	 * Clipping is then just clamping the vertices to the clip rect.
+	 */
+	axis_aligned = !ev->transform.enabled ||
+		       (ev->transform.matrix.type &
+			~(WESTON_MATRIX_TRANSFORM_TRANSLATE |
+			  WESTON_MATRIX_TRANSFORM_SCALE)) == 0;
+
+	/* transform surface rects to screen space, once each: */
+	gr->clip_quads.size = 0;
+	quads = wl_array_add(&gr->clip_quads, nsurf * sizeof *quads);
+	for (j = 0; j < nsurf; j++) {
+		const pixman_box32_t *surf_rect = &surf_rects[j];
+		const float sx[4] = { surf_rect->x1, surf_rect->x2,
+				      surf_rect->x2, surf_rect->x1 };
+		const float sy[4] = { surf_rect->y1, surf_rect->y1,
+				      surf_rect->y2, surf_rect->y2 };
+
+		for (i = 0; i < 4; i++)
+			weston_view_to_global_float(ev, sx[i], sy[i],
+						    &quads[j].x[i],
+						    &quads[j].y[i]);
+		clip_quad_init(&quads[j]);
+	}
+
 	/* worst case we can have 8 vertices per rect (ie. clipped into
 	 * an octagon):
 	 */
 	v = wl_array_add(&gr->vertices, nrects * nsurf * 8 * 4 * sizeof *v);
 	vtxcnt = wl_array_add(&gr->vtxcnt, nrects * nsurf * sizeof *vtxcnt);
 
+	/* The transformed surface, after clipping to the clip region,
+	 * can have as many as eight sides, emitted as a triangle-fan.
+	 * The first vertex in the triangle fan can be chosen arbitrarily,
+	 * since the area is guaranteed to be convex.
+	 *
+	 * If a corner of the transformed surface falls outside of the
+	 * clip region, instead of emitting one vertex for the corner
+	 * of the surface, up to two are emitted for two corresponding
+	 * intersection point(s) between the surface and the clip region.
+	 */
+	nvtx = clip_quads_batch(rects, nrects, quads, nsurf, axis_aligned,
+				v, 4, vtxcnt);
+
 	inv_width = 1.0 / gs->pitch;
 	inv_height = 1.0 / gs->height;
 
-	for (i = 0; i < nrects; i++) {
-		pixman_box32_t *rect = &rects[i];
-		for (j = 0; j < nsurf; j++) {
-			pixman_box32_t *surf_rect = &surf_rects[j];
-			GLfloat sx, sy, bx, by;
-			GLfloat ex[8], ey[8];          /* edge points in screen space */
-			int n;
-
-			/* The transformed surface, after clipping to the clip region,
-			 * can have as many as eight sides, emitted as a triangle-fan.
-			 * The first vertex in the triangle fan can be chosen arbitrarily,
-			 * since the area is guaranteed to be convex.
-			 *
-			 * If a corner of the transformed surface falls outside of the
-			 * clip region, instead of emitting one vertex for the corner
-			 * of the surface, up to two are emitted for two corresponding
-			 * intersection point(s) between the surface and the clip region.
-			 *
-			 * To do this, we first calculate the (up to eight) points that
-			 * form the intersection of the clip rect and the transformed
-			 * surface.
-			 */
-			n = calculate_edges(ev, rect, surf_rect, ex, ey);
-			if (n < 3)
-				continue;
+	for (i = 0; i < (int)nvtx; i++)
+		total += vtxcnt[i];
 
-			/* emit edge points: */
-			for (k = 0; k < n; k++) {
-				weston_view_from_global_float(ev, ex[k], ey[k],
-							      &sx, &sy);
-				/* position: */
-				*(v++) = ex[k];
-				*(v++) = ey[k];
-				/* texcoord: */
-				weston_surface_to_buffer_float(ev->surface,
-							       sx, sy,
-							       &bx, &by);
-				*(v++) = bx * inv_width;
-				if (gs->y_inverted) {
-					*(v++) = by * inv_height;
-				} else {
-					*(v++) = (gs->height - by) * inv_height;
-				}
-			}
+	/* fill in texcoords for the emitted edge points: */
+	for (i = 0; i < (int)total; i++, v += 4) {
+		GLfloat sx, sy, bx, by;
 
-			vtxcnt[nvtx++] = n;
-		}
+		weston_view_from_global_float(ev, v[0], v[1], &sx, &sy);
+		weston_surface_to_buffer_float(ev->surface, sx, sy, &bx, &by);
+		v[2] = bx * inv_width;
+		if (gs->y_inverted)
+			v[3] = by * inv_height;
+		else
+			v[3] = (gs->height - by) * inv_height;
 	}
 
 	if (used_band_compression)
@@ -993,13 +951,23 @@ gl_shader_config_set_input_textures(struct gl_shader_config *sconf,
 {
 	int i;
 
+	for (i = 0; i < 4; i++)
+		sconf->unicolor[i] = gs->color[i];
+
+	if (gs->yuv_cache_valid) {
+		sconf->req.variant = SHADER_VARIANT_RGBX;
+		sconf->req.input_is_premult =
+			gl_shader_texture_variant_can_be_premult(SHADER_VARIANT_RGBX);
+		sconf->input_tex[0] = gs->yuv_cache.tex;
+		for (i = 1; i < GL_SHADER_INPUT_TEX_MAX; i++)
+			sconf->input_tex[i] = 0;
+		return;
+	}
+
 	sconf->req.variant = gs->shader_variant;
 	sconf->req.input_is_premult =
 		gl_shader_texture_variant_can_be_premult(gs->shader_variant);
 
-	for (i = 0; i < 4; i++)
-		sconf->unicolor[i] = gs->color[i];
-
 	assert(gs->num_textures <= GL_SHADER_INPUT_TEX_MAX);
 	for (i = 0; i < gs->num_textures; i++)
 		sconf->input_tex[i] = gs->textures[i];
@@ -1034,18 +1002,207 @@ gl_shader_config_init_for_paint_node(struct gl_shader_config *sconf,
 	return true;
 }
 
+static bool
+shader_variant_is_yuv(enum gl_shader_texture_variant v)
+{
+	switch (v) {
+	case SHADER_VARIANT_Y_U_V:
+	case SHADER_VARIANT_Y_UV:
+	case SHADER_VARIANT_Y_XUXV:
+	case SHADER_VARIANT_XYUV:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Whether the surface is drawn more than once per repaint cycle */
+static bool
+surface_has_multiple_draws(struct weston_surface *surface)
+{
+	struct weston_view *view;
+	int views = 0;
+
+	if (__builtin_popcount(surface->output_mask) > 1)
+		return true;
+
+	wl_list_for_each(view, &surface->views, surface_link) {
+		if (view->plane == &surface->compositor->primary_plane &&
+		    ++views > 1)
+			return true;
+	}
+
+	return false;
+}
+
+static void
+gl_surface_state_fini_yuv_cache(struct gl_surface_state *gs)
+{
+	gs->yuv_cache_valid = false;
+	if (!gs->yuv_cache.fbo)
+		return;
+
+	weston_surface_charge_memory(gs->surface, WESTON_MEMORY_TEXTURE,
+				     -(int64_t)gs->yuv_cache.width *
+				     gs->yuv_cache.height * 4);
+	wl_list_remove(&gs->yuv_cache_link);
+	wl_list_init(&gs->yuv_cache_link);
+	gl_fbo_texture_fini(&gs->yuv_cache);
+}
+
+/* The RGB copy has 8-bit channels, which only holds 8-bit YUV losslessly */
+static bool
+gl_surface_state_yuv_fits_cache(struct gl_surface_state *gs)
+{
+	switch (gs->buffer_type) {
+	case BUFFER_TYPE_SHM:
+		return gs->gl_pixel_type == GL_UNSIGNED_BYTE;
+	case BUFFER_TYPE_EGL:
+		/* Planes of yuv_formats[] and wl_drm YUV are all 8-bit */
+		return true;
+	default:
+		return false;
+	}
+}
+
+/** Convert the YUV contents of a surface to RGB once per commit
+ *
+ * Surfaces with several views or on several outputs would otherwise go
+ * through the YUV shader for each of them. The copy keeps the texture
+ * coordinate space of the planes, so paint nodes sample it like the
+ * originals. Leaves the framebuffer binding and viewport changed.
+ *
+ * External images are not cached: the driver converts them, not our shaders.
+ */
+static void
+gl_surface_state_update_yuv_cache(struct gl_renderer *gr,
+				  struct gl_surface_state *gs)
+{
+	static const GLfloat verts[4 * 2] = {
+		0.0f, 0.0f,
+		1.0f, 0.0f,
+		1.0f, 1.0f,
+		0.0f, 1.0f
+	};
+	static const GLfloat projmat[16] = { /* transpose */
+		 2.0f,  0.0f, 0.0f, 0.0f,
+		 0.0f,  2.0f, 0.0f, 0.0f,
+		 0.0f,  0.0f, 1.0f, 0.0f,
+		-1.0f, -1.0f, 0.0f, 1.0f
+	};
+	struct gl_shader_config sconf = {
+		.view_alpha = 1.0f,
+		.input_tex_filter = GL_NEAREST,
+	};
+
+	if (gs->yuv_cache_valid || gs->direct_display ||
+	    !shader_variant_is_yuv(gs->shader_variant))
+		return;
+
+	if (!surface_has_multiple_draws(gs->surface) ||
+	    !gl_surface_state_yuv_fits_cache(gs)) {
+		gl_surface_state_fini_yuv_cache(gs);
+		return;
+	}
+
+	if (gs->yuv_cache.fbo &&
+	    (gs->yuv_cache.width != gs->pitch ||
+	     gs->yuv_cache.height != gs->height))
+		gl_surface_state_fini_yuv_cache(gs);
+
+	if (!gs->yuv_cache.fbo) {
+		if (!gl_fbo_texture_init(&gs->yuv_cache, gs->pitch, gs->height,
+					 GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE))
+			return;
+
+		weston_surface_charge_memory(gs->surface, WESTON_MEMORY_TEXTURE,
+					     (int64_t)gs->pitch * gs->height * 4);
+		wl_list_insert(&gr->yuv_cache_list, &gs->yuv_cache_link);
+	}
+
+	if (ensure_surface_buffer_is_ready(gr, gs) < 0)
+		return;
+
+	gl_shader_config_set_input_textures(&sconf, gs);
+	ARRAY_COPY(sconf.projection.d, projmat);
+	sconf.projection.type = WESTON_MATRIX_TRANSFORM_SCALE |
+				WESTON_MATRIX_TRANSFORM_TRANSLATE;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, gs->yuv_cache.fbo);
+	glViewport(0, 0, gs->yuv_cache.width, gs->yuv_cache.height);
+	glDisable(GL_BLEND);
+
+	if (!gl_renderer_use_program(gr, &sconf))
+		return;
+
+	/* position: */
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, verts);
+	glEnableVertexAttribArray(0);
+
+	/* texcoord: */
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, verts);
+	glEnableVertexAttribArray(1);
+
+	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(0);
+
+	gs->yuv_cache_valid = true;
+}
+
+/* Whether the next repaint samples the RGB copy of the surface */
+static bool
+gl_surface_state_yuv_cache_in_use(struct gl_surface_state *gs)
+{
+	struct weston_surface *surface = gs->surface;
+	struct weston_view *view;
+
+	if (!gs->yuv_cache_valid || !surface_has_multiple_draws(surface))
+		return false;
+
+	wl_list_for_each(view, &surface->views, surface_link) {
+		if (view->output_mask != 0 &&
+		    view->plane == &surface->compositor->primary_plane)
+			return true;
+	}
+
+	return false;
+}
+
+/* Under memory pressure, give up the RGB copies that the next repaint
+ * does not sample: of surfaces on no output or on other planes only, of
+ * surfaces back to a single draw, and copies already out of date. They
+ * get converted again once drawn several times. */
+static void
+gl_renderer_release_hidden_caches(struct weston_compositor *ec)
+{
+	struct gl_renderer *gr = get_renderer(ec);
+	struct gl_surface_state *gs, *tmp;
+
+	wl_list_for_each_safe(gs, tmp, &gr->yuv_cache_list, yuv_cache_link) {
+		if (!gl_surface_state_yuv_cache_in_use(gs))
+			gl_surface_state_fini_yuv_cache(gs);
+	}
+}
+
 static void
 draw_paint_node(struct weston_paint_node *pnode,
 		pixman_region32_t *damage /* in global coordinates */)
 {
 	struct gl_renderer *gr = get_renderer(pnode->surface->compositor);
 	struct gl_surface_state *gs = get_surface_state(pnode->surface);
+	struct weston_region_arena *arena = gr->compositor->region_arena;
 	/* repaint bounding region in global coordinates: */
-	pixman_region32_t repaint;
+	pixman_region32_t *repaint;
 	/* opaque region in surface coordinates: */
-	pixman_region32_t surface_opaque;
+	pixman_region32_t *surface_opaque;
 	/* non-opaque region in surface coordinates: */
-	pixman_region32_t surface_blend;
+	pixman_region32_t *surface_blend;
+	pixman_region32_t surface_rect;
+	pixman_region32_t *tmp;
+	pixman_region32_t repaint_fallback, surface_opaque_fallback;
+	pixman_region32_t surface_blend_fallback, tmp_fallback;
 	GLint filter;
 	struct gl_shader_config sconf;
 
@@ -1055,12 +1212,20 @@ draw_paint_node(struct weston_paint_node *pnode,
 	if (gs->shader_variant == SHADER_VARIANT_NONE && !gs->direct_display)
 		return;
 
-	pixman_region32_init(&repaint);
-	pixman_region32_intersect(&repaint,
-				  &pnode->view->transform.boundingbox, damage);
-	pixman_region32_subtract(&repaint, &repaint, &pnode->view->clip);
-
-	if (!pixman_region32_not_empty(&repaint))
+	/* Scratch regions are returned to the arena after the repaint,
+	 * fallbacks for an exhausted arena are finished below */
+	tmp = weston_region_arena_get_or_init(arena, &tmp_fallback);
+	repaint = weston_region_arena_get_or_init(arena, &repaint_fallback);
+	surface_blend = weston_region_arena_get_or_init(arena,
+							&surface_blend_fallback);
+	surface_opaque = weston_region_arena_get_or_init(arena,
+							 &surface_opaque_fallback);
+	weston_region_arena_intersect(arena, tmp,
+				      &pnode->view->transform.boundingbox,
+				      damage);
+	weston_region_arena_subtract(arena, repaint, tmp, &pnode->view->clip);
+
+	if (!pixman_region32_not_empty(repaint))
 		goto out;
 
 	if (ensure_surface_buffer_is_ready(gr, gs) < 0)
@@ -1078,26 +1243,32 @@ draw_paint_node(struct weston_paint_node *pnode,
 		goto out;
 
 	/* blended region is whole surface minus opaque region: */
-	pixman_region32_init_rect(&surface_blend, 0, 0,
+	pixman_region32_init_rect(&surface_rect, 0, 0,
 				  pnode->surface->width, pnode->surface->height);
-	if (pnode->view->geometry.scissor_enabled)
-		pixman_region32_intersect(&surface_blend, &surface_blend,
-					  &pnode->view->geometry.scissor);
-	pixman_region32_subtract(&surface_blend, &surface_blend,
-				 &pnode->surface->opaque);
+	if (pnode->view->geometry.scissor_enabled) {
+		weston_region_arena_intersect(arena, tmp, &surface_rect,
+					      &pnode->view->geometry.scissor);
+		weston_region_arena_subtract(arena, surface_blend, tmp,
+					     &pnode->surface->opaque);
+	} else {
+		weston_region_arena_subtract(arena, surface_blend,
+					     &surface_rect,
+					     &pnode->surface->opaque);
+	}
+	pixman_region32_fini(&surface_rect);
 
 	/* XXX: Should we be using ev->transform.opaque here? */
-	pixman_region32_init(&surface_opaque);
 	if (pnode->view->geometry.scissor_enabled)
-		pixman_region32_intersect(&surface_opaque,
-					  &pnode->surface->opaque,
-					  &pnode->view->geometry.scissor);
+		weston_region_arena_intersect(arena, surface_opaque,
+					      &pnode->surface->opaque,
+					      &pnode->view->geometry.scissor);
 	else
-		pixman_region32_copy(&surface_opaque, &pnode->surface->opaque);
+		weston_region_arena_copy(arena, surface_opaque,
+					 &pnode->surface->opaque);
 
 	maybe_censor_override(&sconf, pnode->output, pnode->view);
 
-	if (pixman_region32_not_empty(&surface_opaque)) {
+	if (pixman_region32_not_empty(surface_opaque)) {
 		struct gl_shader_config alt = sconf;
 
 		if (alt.req.variant == SHADER_VARIANT_RGBA) {
@@ -1115,22 +1286,22 @@ draw_paint_node(struct weston_paint_node *pnode,
 			glDisable(GL_BLEND);
 
 		repaint_region(gr, pnode->view, pnode->output,
-			       &repaint, &surface_opaque, &alt);
+			       repaint, surface_opaque, &alt);
 		gs->used_in_output_repaint = true;
 	}
 
-	if (pixman_region32_not_empty(&surface_blend)) {
+	if (pixman_region32_not_empty(surface_blend)) {
 		glEnable(GL_BLEND);
 		repaint_region(gr, pnode->view, pnode->output,
-			       &repaint, &surface_blend, &sconf);
+			       repaint, surface_blend, &sconf);
 		gs->used_in_output_repaint = true;
 	}
 
-	pixman_region32_fini(&surface_blend);
-	pixman_region32_fini(&surface_opaque);
-
 out:
-	pixman_region32_fini(&repaint);
+	weston_region_arena_release(surface_opaque, &surface_opaque_fallback);
+	weston_region_arena_release(surface_blend, &surface_blend_fallback);
+	weston_region_arena_release(repaint, &repaint_fallback);
+	weston_region_arena_release(tmp, &tmp_fallback);
 }
 
 static void
@@ -1630,13 +1801,16 @@ gl_renderer_repaint_output(struct weston_output *output,
 		return;
 
 	/* Clear the used_in_output_repaint flag, so that we can properly track
-	 * which surfaces were used in this output repaint. */
+	 * which surfaces were used in this output repaint. YUV surfaces drawn
+	 * more than once get their RGB copy refreshed here, before the output
+	 * framebuffer is bound. */
 	wl_list_for_each_reverse(pnode, &output->paint_node_z_order_list,
 				 z_order_link) {
 		if (pnode->view->plane == &compositor->primary_plane) {
 			struct gl_surface_state *gs =
 				get_surface_state(pnode->view->surface);
 			gs->used_in_output_repaint = false;
+			gl_surface_state_update_yuv_cache(gr, gs);
 		}
 	}
 
@@ -1868,6 +2042,8 @@ gl_renderer_flush_damage(struct weston_surface *surface)
 	    !gs->needs_full_upload)
 		goto done;
 
+	gs->yuv_cache_valid = false;
+
 	data = wl_shm_buffer_get_data(buffer->shm_buffer);
 
 	glActiveTexture(GL_TEXTURE0);
@@ -1929,11 +2105,74 @@ done:
 	weston_buffer_release_reference(&gs->buffer_release_ref, NULL);
 }
 
+static void
+drop_borrowed_textures(struct gl_surface_state *gs)
+{
+	if (!gs->textures_borrowed)
+		return;
+
+	gs->num_textures = 0;
+	gs->textures_borrowed = false;
+}
+
+static void
+gl_surface_state_set_texture_bytes(struct gl_surface_state *gs, uint64_t bytes)
+{
+	weston_surface_charge_memory(gs->surface, WESTON_MEMORY_TEXTURE,
+				     (int64_t)bytes - (int64_t)gs->texture_bytes);
+	gs->texture_bytes = bytes;
+}
+
+/* Bytes of a texel in the SHM upload textures */
+static unsigned int
+shm_texel_size(GLenum gl_format, GLenum gl_pixel_type)
+{
+	switch (gl_pixel_type) {
+	case GL_UNSIGNED_SHORT_5_6_5:
+		return 2;
+	case GL_HALF_FLOAT:
+		return 8;
+	case GL_UNSIGNED_INT_2_10_10_10_REV_EXT:
+		return 4;
+	}
+
+	switch (gl_format) {
+	case GL_R8_EXT:
+	case GL_LUMINANCE:
+		return 1;
+	case GL_RG8_EXT:
+	case GL_LUMINANCE_ALPHA:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+static uint64_t
+shm_texture_size(const struct gl_surface_state *gs)
+{
+	uint64_t size = 0;
+	int j;
+
+	for (j = 0; j < gs->num_textures; j++)
+		size += (uint64_t)(gs->pitch / gs->hsub[j]) *
+			(gs->height / gs->vsub[j]) *
+			shm_texel_size(gs->gl_format[j], gs->gl_pixel_type);
+
+	return size;
+}
+
 static void
 ensure_textures(struct gl_surface_state *gs, GLenum target, int num_textures)
 {
 	int i;
 
+	drop_borrowed_textures(gs);
+
+	/* Only SHM textures have storage of their own, the caller
+	 * charges it again if needed. */
+	gl_surface_state_set_texture_bytes(gs, 0);
+
 	if (num_textures <= gs->num_textures) {
 		glDeleteTextures(gs->num_textures - num_textures, &gs->textures[num_textures]);
 		gs->num_textures = num_textures;
@@ -2136,6 +2375,7 @@ unsupported:
 		gs->surface = es;
 
 		ensure_textures(gs, GL_TEXTURE_2D, num_planes);
+		gl_surface_state_set_texture_bytes(gs, shm_texture_size(gs));
 	}
 }
 
@@ -2608,6 +2848,7 @@ static struct dmabuf_image *
 import_dmabuf(struct gl_renderer *gr,
 	      struct linux_dmabuf_buffer *dmabuf)
 {
+	const struct pixel_format_info *info;
 	struct egl_image *egl_image;
 	struct dmabuf_image *image;
 	GLenum target;
@@ -2630,7 +2871,11 @@ import_dmabuf(struct gl_renderer *gr,
 			image->shader_variant = SHADER_VARIANT_EXTERNAL;
 		}
 	} else {
-		if (!import_yuv_dmabuf(gr, image)) {
+		/* only YUV formats have a shader conversion to fall back to */
+		info = pixel_format_get_info(dmabuf->attributes.format);
+		if ((info && !(pixel_format_get_caps(info) &
+			       PIXEL_FORMAT_CAP_YUV)) ||
+		    !import_yuv_dmabuf(gr, image)) {
 			dmabuf_image_destroy(image);
 			return NULL;
 		}
@@ -2778,6 +3023,63 @@ gl_renderer_import_dmabuf(struct weston_compositor *ec,
 	return true;
 }
 
+/** Create the textures of a dmabuf image on first use
+ *
+ * \return true if any texture had to be created.
+ */
+static bool
+dmabuf_image_bind_textures(struct gl_renderer *gr, struct dmabuf_image *image)
+{
+	struct egl_image *egl_image;
+	GLenum target;
+	bool created = false;
+	int i;
+
+	target = gl_shader_texture_variant_get_target(image->shader_variant);
+
+	for (i = 0; i < image->num_images; i++) {
+		egl_image = image->images[i];
+		if (egl_image->texture)
+			continue;
+
+		glActiveTexture(GL_TEXTURE0 + i);
+		glGenTextures(1, &egl_image->texture);
+		glBindTexture(target, egl_image->texture);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		gr->image_target_texture_2d(target, egl_image->image);
+		glBindTexture(target, 0);
+		created = true;
+	}
+
+	return created;
+}
+
+static void
+dmabuf_scope_new_subscription(struct weston_log_subscription *subs,
+			      void *data)
+{
+	struct gl_renderer *gr = data;
+	struct dmabuf_image *image;
+	unsigned images = 0;
+	unsigned textures = 0;
+	int i;
+
+	wl_list_for_each(image, &gr->dmabuf_images, link) {
+		images++;
+		for (i = 0; i < image->num_images; i++)
+			textures += image->images[i]->texture != 0;
+	}
+
+	weston_log_subscription_printf(subs,
+		"dmabuf buffers: %u, with %u cached textures\n"
+		"Attaches reusing textures: %u, binding textures: %u\n",
+		images, textures,
+		gr->dmabuf_texture_stats.hits,
+		gr->dmabuf_texture_stats.misses);
+	weston_log_subscription_complete(subs);
+}
+
 static bool
 dmabuf_is_opaque(struct linux_dmabuf_buffer *dmabuf)
 {
@@ -2788,7 +3090,7 @@ dmabuf_is_opaque(struct linux_dmabuf_buffer *dmabuf)
 	if (!info)
 		return false;
 
-	return pixel_format_is_opaque(info);
+	return pixel_format_get_caps(info) & PIXEL_FORMAT_CAP_OPAQUE;
 }
 
 static void
@@ -2822,6 +3124,7 @@ gl_renderer_attach_dmabuf(struct weston_surface *surface,
 	for (i = 0; i < gs->num_images; i++)
 		egl_image_unref(gs->images[i]);
 	gs->num_images = 0;
+	drop_borrowed_textures(gs);
 
 	gs->pitch = buffer->width;
 	gs->height = buffer->height;
@@ -2846,17 +3149,30 @@ gl_renderer_attach_dmabuf(struct weston_surface *surface,
 	/* The dmabuf_image should have been created during the import */
 	assert(image != NULL);
 
+	/* Release textures the surface owns, e.g. from an earlier SHM buffer */
+	target = gl_shader_texture_variant_get_target(image->shader_variant);
+	ensure_textures(gs, target, 0);
+
 	gs->num_images = image->num_images;
 	for (i = 0; i < gs->num_images; ++i)
 		gs->images[i] = egl_image_ref(image->images[i]);
 
-	target = gl_shader_texture_variant_get_target(image->shader_variant);
-	ensure_textures(gs, target, gs->num_images);
-	for (i = 0; i < gs->num_images; ++i) {
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(target, gs->textures[i]);
-		gr->image_target_texture_2d(target, gs->images[i]->image);
-	}
+	/*
+	 * The textures live as long as the EGLImages, so a buffer the client
+	 * attaches again, as video players cycling a small pool do, is
+	 * displayed without re-specifying any texture. The EGLImages are
+	 * siblings of the dmabuf storage: new contents are visible through
+	 * them without a re-bind.
+	 */
+	if (dmabuf_image_bind_textures(gr, image))
+		gr->dmabuf_texture_stats.misses++;
+	else
+		gr->dmabuf_texture_stats.hits++;
+
+	for (i = 0; i < gs->num_images; ++i)
+		gs->textures[i] = image->images[i]->texture;
+	gs->num_textures = gs->num_images;
+	gs->textures_borrowed = true;
 
 	gs->shader_variant = image->shader_variant;
 }
@@ -2938,14 +3254,20 @@ gl_renderer_attach(struct weston_surface *es, struct weston_buffer *buffer)
 	weston_buffer_release_reference(&gs->buffer_release_ref,
 					es->buffer_release_ref.buffer_release);
 
+	gs->yuv_cache_valid = false;
+
 	if (!buffer) {
+		gl_surface_state_fini_yuv_cache(gs);
+
 		for (i = 0; i < gs->num_images; i++) {
 			egl_image_unref(gs->images[i]);
 			gs->images[i] = NULL;
 		}
 		gs->num_images = 0;
+		drop_borrowed_textures(gs);
 		glDeleteTextures(gs->num_textures, gs->textures);
 		gs->num_textures = 0;
+		gl_surface_state_set_texture_bytes(gs, 0);
 		gs->buffer_type = BUFFER_TYPE_NULL;
 		gs->y_inverted = true;
 		gs->direct_display = false;
@@ -3149,7 +3471,10 @@ surface_state_destroy(struct gl_surface_state *gs, struct gl_renderer *gr)
 
 	gs->surface->renderer_state = NULL;
 
+	drop_borrowed_textures(gs);
 	glDeleteTextures(gs->num_textures, gs->textures);
+	gl_surface_state_set_texture_bytes(gs, 0);
+	gl_surface_state_fini_yuv_cache(gs);
 
 	for (i = 0; i < gs->num_images; i++)
 		egl_image_unref(gs->images[i]);
@@ -3207,6 +3532,7 @@ gl_renderer_create_surface(struct weston_surface *surface)
 	gs->direct_display = false;
 
 	gs->surface = surface;
+	wl_list_init(&gs->yuv_cache_link);
 
 	pixman_region32_init(&gs->texture_damage);
 	surface->renderer_state = gs;
@@ -3388,6 +3714,10 @@ gl_renderer_output_create(struct weston_output *output,
 		if (ret) {
 			weston_log("Output %s uses 16F shadow.\n",
 				   output->name);
+			weston_compositor_charge_memory(output->compositor,
+						WESTON_MEMORY_FRAMEBUFFER,
+						(int64_t)go->shadow.width *
+						go->shadow.height * 8);
 		} else {
 			weston_log("Output %s failed to create 16F shadow.\n",
 				   output->name);
@@ -3492,8 +3822,13 @@ gl_renderer_output_destroy(struct weston_output *output)
 	for (i = 0; i < 2; i++)
 		pixman_region32_fini(&go->buffer_damage[i]);
 
-	if (shadow_exists(go))
+	if (shadow_exists(go)) {
+		weston_compositor_charge_memory(output->compositor,
+						WESTON_MEMORY_FRAMEBUFFER,
+						-(int64_t)go->shadow.width *
+						go->shadow.height * 8);
 		gl_fbo_texture_fini(&go->shadow);
+	}
 
 	eglMakeCurrent(gr->egl_display,
 		       gr->dummy_surface, gr->dummy_surface, gr->egl_context);
@@ -3544,18 +3879,20 @@ gl_renderer_destroy(struct weston_compositor *ec)
 	if (gr->has_bind_display)
 		gr->unbind_display(gr->egl_display, ec->wl_display);
 
+	gl_shader_cache_fini(gr);
 	gl_renderer_shader_list_destroy(gr);
 	if (gr->fallback_shader)
 		gl_shader_destroy(gr, gr->fallback_shader);
 
+	/* Cached dmabuf textures need the context */
+	wl_list_for_each_safe(image, next, &gr->dmabuf_images, link)
+		dmabuf_image_destroy(image);
+
 	/* Work around crash in egl_dri2.c's dri2_make_current() - when does this apply? */
 	eglMakeCurrent(gr->egl_display,
 		       EGL_NO_SURFACE, EGL_NO_SURFACE,
 		       EGL_NO_CONTEXT);
 
-	wl_list_for_each_safe(image, next, &gr->dmabuf_images, link)
-		dmabuf_image_destroy(image);
-
 	wl_list_for_each_safe(format, next_format, &gr->dmabuf_formats, link)
 		dmabuf_format_destroy(format);
 
@@ -3570,12 +3907,14 @@ gl_renderer_destroy(struct weston_compositor *ec)
 
 	wl_array_release(&gr->vertices);
 	wl_array_release(&gr->vtxcnt);
+	wl_array_release(&gr->clip_quads);
 
 	if (gr->fragment_binding)
 		weston_binding_destroy(gr->fragment_binding);
 	if (gr->fan_binding)
 		weston_binding_destroy(gr->fan_binding);
 
+	weston_log_scope_destroy(gr->dmabuf_scope);
 	weston_log_scope_destroy(gr->shader_scope);
 	free(gr);
 }
@@ -3657,12 +3996,24 @@ gl_renderer_display_create(struct weston_compositor *ec,
 
 	gr->compositor = ec;
 	wl_list_init(&gr->shader_list);
+	wl_list_init(&gr->dmabuf_images);
+	wl_list_init(&gr->yuv_cache_list);
+	wl_array_init(&gr->shader_precompile_queue);
 	gr->platform = options->egl_platform;
 
 	gr->shader_scope = gl_shader_scope_create(gr);
 	if (!gr->shader_scope)
 		goto fail;
 
+	gr->dmabuf_scope = weston_compositor_add_log_scope(ec,
+		"gl-dmabuf-cache",
+		"GL renderer dmabuf texture cache statistics.\n",
+		dmabuf_scope_new_subscription,
+		NULL,
+		gr);
+	if (!gr->dmabuf_scope)
+		goto fail;
+
 	if (gl_renderer_setup_egl_client_extensions(gr) < 0)
 		goto fail;
 
@@ -3675,6 +4026,7 @@ gl_renderer_display_create(struct weston_compositor *ec,
 	gr->base.surface_get_content_size =
 		gl_renderer_surface_get_content_size;
 	gr->base.surface_copy_content = gl_renderer_surface_copy_content;
+	gr->base.release_hidden_caches = gl_renderer_release_hidden_caches;
 
 	if (gl_renderer_setup_egl_display(gr, options->egl_native_display) < 0)
 		goto fail;
@@ -3711,7 +4063,6 @@ gl_renderer_display_create(struct weston_compositor *ec,
 	if (gr->has_native_fence_sync && gr->has_wait_sync)
 		ec->capabilities |= WESTON_CAP_EXPLICIT_SYNC;
 
-	wl_list_init(&gr->dmabuf_images);
 	if (gr->has_dmabuf_import) {
 		gr->base.import_dmabuf = gl_renderer_import_dmabuf;
 		gr->base.get_supported_formats = gl_renderer_get_supported_formats;
@@ -3770,6 +4121,10 @@ gl_renderer_display_create(struct weston_compositor *ec,
 
 	if (gr->gl_supports_color_transforms)
 		ec->capabilities |= WESTON_CAP_COLOR_OPS;
+	if (gr->gl_supports_color_mapping_3dlut)
+		ec->capabilities |= WESTON_CAP_COLOR_3DLUT;
+
+	gl_renderer_schedule_shader_precompile(gr);
 
 	return 0;
 
@@ -3785,9 +4140,11 @@ fail_feedback:
 		ec->dmabuf_feedback_format_table = NULL;
 	}
 fail_terminate:
+	gl_shader_cache_fini(gr);
 	weston_drm_format_array_fini(&gr->supported_formats);
 	eglTerminate(gr->egl_display);
 fail:
+	weston_log_scope_destroy(gr->dmabuf_scope);
 	weston_log_scope_destroy(gr->shader_scope);
 	free(gr);
 	ec->renderer = NULL;
@@ -3955,6 +4312,27 @@ gl_renderer_setup(struct weston_compositor *ec, EGLSurface egl_surface)
 		gr->gl_supports_color_transforms = true;
 	}
 
+	/* the shaders are GLSL ES 1.00, where sampler3D needs the extension
+	 * even on GLES 3 */
+	if (gr->gl_supports_color_transforms &&
+	    weston_check_egl_extension(extensions, "GL_OES_texture_3D"))
+		gr->gl_supports_color_mapping_3dlut = true;
+
+	if (gr->gl_version >= gr_gl_version(3, 0)) {
+		gr->get_program_binary =
+			(void *) eglGetProcAddress("glGetProgramBinary");
+		gr->program_binary =
+			(void *) eglGetProcAddress("glProgramBinary");
+	} else if (weston_check_egl_extension(extensions, "GL_OES_get_program_binary")) {
+		gr->get_program_binary =
+			(void *) eglGetProcAddress("glGetProgramBinaryOES");
+		gr->program_binary =
+			(void *) eglGetProcAddress("glProgramBinaryOES");
+	}
+	gr->has_program_binary = gr->get_program_binary && gr->program_binary;
+
+	gl_shader_cache_init(gr);
+
 	glActiveTexture(GL_TEXTURE0);
 
 	gr->fallback_shader = gl_renderer_create_fallback_shader(gr);
@@ -3979,6 +4357,8 @@ gl_renderer_setup(struct weston_compositor *ec, EGLSurface egl_surface)
 		ec->read_format == PIXMAN_a8r8g8b8 ? "BGRA" : "RGBA");
 	weston_log_continue(STAMP_SPACE "EGL Wayland extension: %s\n",
 			    gr->has_bind_display ? "yes" : "no");
+	weston_log_continue(STAMP_SPACE "program binary cache: %s\n",
+			    gr->shader_cache_dir ?: "no");
 
 	return 0;
 }
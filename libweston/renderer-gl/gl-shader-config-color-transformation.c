@@ -44,11 +44,19 @@ struct gl_renderer_color_curve {
 	float offset;
 };
 
+struct gl_renderer_color_mapping {
+	enum gl_shader_color_mapping type;
+	GLuint tex;
+	float scale;
+	float offset;
+};
+
 struct gl_renderer_color_transform {
 	struct weston_color_transform *owner;
 	struct wl_listener destroy_listener;
 
 	struct gl_renderer_color_curve pre_curve;
+	struct gl_renderer_color_mapping mapping;
 };
 
 static void
@@ -58,10 +66,18 @@ gl_renderer_color_curve_fini(struct gl_renderer_color_curve *gl_curve)
 		glDeleteTextures(1, &gl_curve->tex);
 }
 
+static void
+gl_renderer_color_mapping_fini(struct gl_renderer_color_mapping *gl_mapping)
+{
+	if (gl_mapping->tex)
+		glDeleteTextures(1, &gl_mapping->tex);
+}
+
 static void
 gl_renderer_color_transform_destroy(struct gl_renderer_color_transform *gl_xform)
 {
 	gl_renderer_color_curve_fini(&gl_xform->pre_curve);
+	gl_renderer_color_mapping_fini(&gl_xform->mapping);
 	wl_list_remove(&gl_xform->destroy_listener.link);
 	free(gl_xform);
 }
@@ -152,6 +168,53 @@ gl_color_curve_lut_3x1d(struct gl_renderer_color_curve *gl_curve,
 	return true;
 }
 
+static bool
+gl_color_mapping_lut_3dlut(struct gl_renderer_color_mapping *gl_mapping,
+			   const struct weston_color_mapping *mapping,
+			   struct weston_color_transform *xform)
+{
+	struct gl_renderer *gr = get_renderer(xform->cm->compositor);
+	const unsigned lut_len = mapping->u.lut3d.optimal_len;
+	GLuint tex;
+	float *lut;
+
+	/* callers report the failure */
+	if (!gr->gl_supports_color_mapping_3dlut)
+		return false;
+
+	/* RGB triplets, R varying fastest, see struct weston_color_mapping_3dlut */
+	lut = calloc(lut_len * lut_len * lut_len * 3, sizeof *lut);
+	if (!lut)
+		return false;
+
+	mapping->u.lut3d.fill_in(xform, lut, lut_len);
+
+	glActiveTexture(GL_TEXTURE0);
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_3D, tex);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, sizeof (float));
+	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB32F, lut_len, lut_len, lut_len, 0,
+		     GL_RGB, GL_FLOAT, lut);
+
+	glBindTexture(GL_TEXTURE_3D, 0);
+	free(lut);
+
+	gl_mapping->type = SHADER_COLOR_MAPPING_3DLUT;
+	gl_mapping->tex = tex;
+	gl_mapping->scale = (float)(lut_len - 1) / lut_len;
+	gl_mapping->offset = 0.5f / lut_len;
+
+	return true;
+}
+
 static const struct gl_renderer_color_transform *
 gl_renderer_color_transform_from(struct weston_color_transform *xform)
 {
@@ -160,6 +223,10 @@ gl_renderer_color_transform_from(struct weston_color_transform *xform)
 		.pre_curve.tex = 0,
 		.pre_curve.scale = 0.0f,
 		.pre_curve.offset = 0.0f,
+		.mapping.type = SHADER_COLOR_MAPPING_IDENTITY,
+		.mapping.tex = 0,
+		.mapping.scale = 0.0f,
+		.mapping.offset = 0.0f,
 	};
 	struct gl_renderer_color_transform *gl_xform;
 	bool ok = false;
@@ -189,6 +256,21 @@ gl_renderer_color_transform_from(struct weston_color_transform *xform)
 					     &xform->pre_curve, xform);
 		break;
 	}
+	if (!ok) {
+		gl_renderer_color_transform_destroy(gl_xform);
+		return NULL;
+	}
+
+	switch (xform->mapping.type) {
+	case WESTON_COLOR_MAPPING_TYPE_IDENTITY:
+		gl_xform->mapping = no_op_gl_xform.mapping;
+		ok = true;
+		break;
+	case WESTON_COLOR_MAPPING_TYPE_3D_LUT:
+		ok = gl_color_mapping_lut_3dlut(&gl_xform->mapping,
+						&xform->mapping, xform);
+		break;
+	}
 
 	if (!ok) {
 		gl_renderer_color_transform_destroy(gl_xform);
@@ -212,6 +294,10 @@ gl_shader_config_set_color_transform(struct gl_shader_config *sconf,
 	sconf->color_pre_curve_lut_tex = gl_xform->pre_curve.tex;
 	sconf->color_pre_curve_lut_scale_offset[0] = gl_xform->pre_curve.scale;
 	sconf->color_pre_curve_lut_scale_offset[1] = gl_xform->pre_curve.offset;
+	sconf->req.color_mapping = gl_xform->mapping.type;
+	sconf->color_mapping_lut_tex = gl_xform->mapping.tex;
+	sconf->color_mapping_lut_scale_offset[0] = gl_xform->mapping.scale;
+	sconf->color_mapping_lut_scale_offset[1] = gl_xform->mapping.offset;
 
 	return true;
 }
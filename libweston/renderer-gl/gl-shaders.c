@@ -30,12 +30,20 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <libweston/libweston.h>
 #include <libweston/weston-log.h>
 #include <GLES2/gl2.h>
+#include <GLES3/gl3.h>
 
 #include <string.h>
 
@@ -50,16 +58,38 @@
 /* static const char fragment_shader[]; fragment.glsl */
 #include "fragment-shader.h"
 
+/* Bump when struct gl_shader_cache_header or the key encoding changes. */
+#define GL_SHADER_CACHE_VERSION 1
+
+/* Anything bigger than this is not a program binary we wrote. */
+#define GL_SHADER_CACHE_MAX_BINARY (16 * 1024 * 1024)
+
+/* Variants precompiled when WESTON_GL_SHADER_PRECOMPILE is not set */
+#define GL_SHADER_PRECOMPILE_DEFAULT "rgba,rgbx,solid,cached"
+
+static const char gl_shader_cache_magic[8] = "wstnGLp";
+
+/** On-disk program binary file header, followed by the binary itself */
+struct gl_shader_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t key;		/* struct gl_shader_requirements */
+	uint32_t binary_format;
+	uint32_t binary_length;
+	int64_t compile_nsec;	/* what building from source took */
+};
+
 struct gl_shader {
 	struct gl_shader_requirements key;
 	GLuint program;
-	GLuint vertex_shader, fragment_shader;
 	GLint proj_uniform;
 	GLint tex_uniforms[3];
 	GLint alpha_uniform;
 	GLint color_uniform;
 	GLint color_pre_curve_lut_2d_uniform;
 	GLint color_pre_curve_lut_scale_offset_uniform;
+	GLint color_mapping_lut_3d_uniform;
+	GLint color_mapping_lut_scale_offset_uniform;
 	struct wl_list link; /* gl_renderer::shader_list */
 	struct timespec last_used;
 };
@@ -97,6 +127,19 @@ gl_shader_color_curve_to_string(enum gl_shader_color_curve kind)
 	return "!?!?"; /* never reached */
 }
 
+static const char *
+gl_shader_color_mapping_to_string(enum gl_shader_color_mapping kind)
+{
+	switch (kind) {
+#define CASERET(x) case x: return #x;
+	CASERET(SHADER_COLOR_MAPPING_IDENTITY)
+	CASERET(SHADER_COLOR_MAPPING_3DLUT)
+#undef CASERET
+	}
+
+	return "!?!?"; /* never reached */
+}
+
 static void
 dump_program_with_line_numbers(int count, const char **sources)
 {
@@ -162,9 +205,10 @@ create_shader_description_string(const struct gl_shader_requirements *req)
 	int size;
 	char *str;
 
-	size = asprintf(&str, "%s %s %cinput_is_premult %cgreen",
+	size = asprintf(&str, "%s %s %s %cinput_is_premult %cgreen",
 			gl_shader_texture_variant_to_string(req->variant),
 			gl_shader_color_curve_to_string(req->color_pre_curve),
+			gl_shader_color_mapping_to_string(req->color_mapping),
 			req->input_is_premult ? '+' : '-',
 			req->green_tint ? '+' : '-');
 	if (size < 0)
@@ -182,79 +226,292 @@ create_shader_config_string(const struct gl_shader_requirements *req)
 			"#define DEF_GREEN_TINT %s\n"
 			"#define DEF_INPUT_IS_PREMULT %s\n"
 			"#define DEF_COLOR_PRE_CURVE %s\n"
+			"#define DEF_COLOR_MAPPING %s\n"
 			"#define DEF_VARIANT %s\n",
 			req->green_tint ? "true" : "false",
 			req->input_is_premult ? "true" : "false",
 			gl_shader_color_curve_to_string(req->color_pre_curve),
+			gl_shader_color_mapping_to_string(req->color_mapping),
 			gl_shader_texture_variant_to_string(req->variant));
 	if (size < 0)
 		return NULL;
 	return str;
 }
 
-static struct gl_shader *
-gl_shader_create(struct gl_renderer *gr,
-		 const struct gl_shader_requirements *requirements)
+static uint32_t
+gl_shader_requirements_to_key(const struct gl_shader_requirements *req)
 {
-	bool verbose = weston_log_scope_is_enabled(gr->shader_scope);
-	struct gl_shader *shader = NULL;
-	char msg[512];
+	uint32_t key;
+
+	static_assert(sizeof key == sizeof *req,
+		      "struct gl_shader_requirements must fit the cache key");
+	memcpy(&key, req, sizeof key);
+
+	return key;
+}
+
+static char *
+gl_shader_cache_path(struct gl_renderer *gr,
+		     const struct gl_shader_requirements *req)
+{
+	char *path;
+
+	if (asprintf(&path, "%s/%08" PRIx32 ".bin", gr->shader_cache_dir,
+		     gl_shader_requirements_to_key(req)) < 0)
+		return NULL;
+
+	return path;
+}
+
+/** Create a linked program from a cached program binary
+ *
+ * \param compile_nsec Set to how long building the program from source
+ * took when the binary was stored.
+ * \return The program, or 0 if there was no usable binary. A binary the
+ * driver rejects, e.g. after a driver update, is simply rebuilt and
+ * overwritten.
+ */
+static GLuint
+gl_shader_cache_load(struct gl_renderer *gr,
+		     const struct gl_shader_requirements *req,
+		     int64_t *compile_nsec)
+{
+	struct gl_shader_cache_header hdr;
+	void *binary = NULL;
+	GLuint program = 0;
 	GLint status;
-	const char *sources[3];
-	char *conf = NULL;
+	char *path;
+	FILE *fp;
 
-	shader = zalloc(sizeof *shader);
-	if (!shader) {
-		weston_log("could not create shader\n");
-		goto error_vertex;
+	if (!gr->shader_cache_dir)
+		return 0;
+
+	path = gl_shader_cache_path(gr, req);
+	if (!path)
+		return 0;
+
+	fp = fopen(path, "re");
+	free(path);
+	if (!fp)
+		return 0;
+
+	if (fread(&hdr, sizeof hdr, 1, fp) != 1 ||
+	    memcmp(hdr.magic, gl_shader_cache_magic, sizeof hdr.magic) != 0 ||
+	    hdr.version != GL_SHADER_CACHE_VERSION ||
+	    hdr.key != gl_shader_requirements_to_key(req) ||
+	    hdr.binary_length == 0 ||
+	    hdr.binary_length > GL_SHADER_CACHE_MAX_BINARY)
+		goto out;
+
+	binary = malloc(hdr.binary_length);
+	if (!binary || fread(binary, hdr.binary_length, 1, fp) != 1)
+		goto out;
+
+	program = glCreateProgram();
+	gr->program_binary(program, hdr.binary_format,
+			   binary, hdr.binary_length);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status) {
+		glDeleteProgram(program);
+		program = 0;
+		goto out;
 	}
 
-	wl_list_init(&shader->link);
-	shader->key = *requirements;
+	*compile_nsec = hdr.compile_nsec;
 
-	if (verbose) {
-		char *desc;
+out:
+	free(binary);
+	fclose(fp);
+	return program;
+}
 
-		desc = create_shader_description_string(requirements);
-		weston_log_scope_printf(gr->shader_scope,
-					"Compiling shader program for: %s\n",
-					desc);
-		free(desc);
+static void
+gl_shader_cache_store(struct gl_renderer *gr,
+		      const struct gl_shader_requirements *req,
+		      GLuint program, int64_t compile_nsec)
+{
+	struct gl_shader_cache_header hdr = {
+		.version = GL_SHADER_CACHE_VERSION,
+		.key = gl_shader_requirements_to_key(req),
+		.compile_nsec = compile_nsec,
+	};
+	GLint length = 0;
+	GLenum format;
+	void *binary = NULL;
+	char *path = NULL;
+	char *tmp = NULL;
+	FILE *fp = NULL;
+	bool ok = false;
+
+	if (!gr->shader_cache_dir)
+		return;
+
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+	if (length <= 0 || length > GL_SHADER_CACHE_MAX_BINARY)
+		return;
+
+	binary = malloc(length);
+	if (!binary)
+		return;
+
+	gr->get_program_binary(program, length, &length, &format, binary);
+	if (length <= 0)
+		goto out;
+
+	memcpy(hdr.magic, gl_shader_cache_magic, sizeof hdr.magic);
+	hdr.binary_format = format;
+	hdr.binary_length = length;
+
+	path = gl_shader_cache_path(gr, req);
+	if (!path || asprintf(&tmp, "%s.tmp", path) < 0) {
+		tmp = NULL;
+		goto out;
+	}
+
+	/* Write a temporary file and rename it, so readers never see
+	 * a partially written binary. */
+	fp = fopen(tmp, "we");
+	if (!fp)
+		goto out;
+
+	ok = fwrite(&hdr, sizeof hdr, 1, fp) == 1 &&
+	     fwrite(binary, length, 1, fp) == 1;
+	ok = fclose(fp) == 0 && ok;
+	if (ok)
+		ok = rename(tmp, path) == 0;
+	if (!ok) {
+		weston_log("GL shader cache: failed to write %s: %s\n",
+			   path, strerror(errno));
+		unlink(tmp);
 	}
 
+out:
+	free(tmp);
+	free(path);
+	free(binary);
+}
+
+/** Compile and link a program from the GLSL sources */
+static GLuint
+gl_shader_build_program(struct gl_renderer *gr,
+			const struct gl_shader_requirements *req)
+{
+	GLuint vs, fs;
+	GLuint program = GL_NONE;
+	char msg[512];
+	GLint status;
+	const char *sources[3];
+	char *conf;
+
 	sources[0] = vertex_shader;
-	shader->vertex_shader = compile_shader(GL_VERTEX_SHADER, 1, sources);
-	if (shader->vertex_shader == GL_NONE)
-		goto error_vertex;
+	vs = compile_shader(GL_VERTEX_SHADER, 1, sources);
+	if (vs == GL_NONE)
+		return GL_NONE;
 
-	conf = create_shader_config_string(&shader->key);
+	conf = create_shader_config_string(req);
 	if (!conf)
 		goto error_fragment;
 
 	sources[0] = "#version 100\n";
 	sources[1] = conf;
 	sources[2] = fragment_shader;
-	shader->fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
-						 3, sources);
-	if (shader->fragment_shader == GL_NONE)
+	fs = compile_shader(GL_FRAGMENT_SHADER, 3, sources);
+	free(conf);
+	if (fs == GL_NONE)
 		goto error_fragment;
 
-	shader->program = glCreateProgram();
-	glAttachShader(shader->program, shader->vertex_shader);
-	glAttachShader(shader->program, shader->fragment_shader);
-	glBindAttribLocation(shader->program, 0, "position");
-	glBindAttribLocation(shader->program, 1, "texcoord");
-
-	glLinkProgram(shader->program);
-	glGetProgramiv(shader->program, GL_LINK_STATUS, &status);
+	program = glCreateProgram();
+	glAttachShader(program, vs);
+	glAttachShader(program, fs);
+	glBindAttribLocation(program, 0, "position");
+	glBindAttribLocation(program, 1, "texcoord");
+
+	/* Without the hint, GLES 3 drivers may drop what they need to hand
+	 * the binary back, or not produce one at all. OES_get_program_binary
+	 * has no such hint. */
+	if (gr->shader_cache_dir && gr->gl_version >= gr_gl_version(3, 0))
+		glProgramParameteri(program,
+				    GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+				    GL_TRUE);
+
+	glLinkProgram(program);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
 	if (!status) {
-		glGetProgramInfoLog(shader->program, sizeof msg, NULL, msg);
+		glGetProgramInfoLog(program, sizeof msg, NULL, msg);
 		weston_log("link info: %s\n", msg);
-		goto error_link;
+		glDeleteProgram(program);
+		program = GL_NONE;
+	}
+
+	glDeleteShader(fs);
+
+error_fragment:
+	glDeleteShader(vs);
+
+	return program;
+}
+
+static struct gl_shader *
+gl_shader_create(struct gl_renderer *gr,
+		 const struct gl_shader_requirements *requirements)
+{
+	bool verbose = weston_log_scope_is_enabled(gr->shader_scope);
+	struct gl_shader *shader = NULL;
+	struct timespec begin, end;
+	int64_t compile_nsec = 0;
+	int64_t load_nsec;
+	char *desc = NULL;
+
+	shader = zalloc(sizeof *shader);
+	if (!shader) {
+		weston_log("could not create shader\n");
+		return NULL;
 	}
 
-	glDeleteShader(shader->vertex_shader);
-	glDeleteShader(shader->fragment_shader);
+	wl_list_init(&shader->link);
+	shader->key = *requirements;
+
+	if (verbose)
+		desc = create_shader_description_string(requirements);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	shader->program = gl_shader_cache_load(gr, requirements, &compile_nsec);
+	if (shader->program != GL_NONE) {
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		load_nsec = timespec_sub_to_nsec(&end, &begin);
+
+		gr->shader_stats.loaded++;
+		gr->shader_stats.load_nsec += load_nsec;
+		if (compile_nsec > load_nsec)
+			gr->shader_stats.saved_nsec += compile_nsec - load_nsec;
+
+		if (verbose)
+			weston_log_scope_printf(gr->shader_scope,
+						"Loaded cached shader program for: %s\n",
+						desc);
+	} else {
+		if (verbose)
+			weston_log_scope_printf(gr->shader_scope,
+						"Compiling shader program for: %s\n",
+						desc);
+
+		shader->program = gl_shader_build_program(gr, requirements);
+		if (shader->program == GL_NONE) {
+			free(desc);
+			free(shader);
+			return NULL;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		compile_nsec = timespec_sub_to_nsec(&end, &begin);
+
+		gr->shader_stats.compiled++;
+		gr->shader_stats.compile_nsec += compile_nsec;
+
+		gl_shader_cache_store(gr, requirements, shader->program,
+				      compile_nsec);
+	}
+	free(desc);
 
 	shader->proj_uniform = glGetUniformLocation(shader->program, "proj");
 	shader->tex_uniforms[0] = glGetUniformLocation(shader->program, "tex");
@@ -267,24 +524,14 @@ gl_shader_create(struct gl_renderer *gr,
 		glGetUniformLocation(shader->program, "color_pre_curve_lut_2d");
 	shader->color_pre_curve_lut_scale_offset_uniform =
 		glGetUniformLocation(shader->program, "color_pre_curve_lut_scale_offset");
-
-	free(conf);
+	shader->color_mapping_lut_3d_uniform =
+		glGetUniformLocation(shader->program, "color_mapping_lut_3d");
+	shader->color_mapping_lut_scale_offset_uniform =
+		glGetUniformLocation(shader->program, "color_mapping_lut_scale_offset");
 
 	wl_list_insert(&gr->shader_list, &shader->link);
 
 	return shader;
-
-error_link:
-	glDeleteProgram(shader->program);
-	glDeleteShader(shader->fragment_shader);
-
-error_fragment:
-	glDeleteShader(shader->vertex_shader);
-
-error_vertex:
-	free(conf);
-	free(shader);
-	return NULL;
 }
 
 void
@@ -355,6 +602,16 @@ gl_shader_scope_new_subscription(struct weston_log_subscription *subs,
 					       msecs / 1000.0, desc);
 	}
 	weston_log_subscription_printf(subs, "Total: %d programs.\n", count);
+	weston_log_subscription_printf(subs,
+		"Program binary cache: %s\n"
+		"Built from source: %u in %.1f ms\n"
+		"Loaded from cache: %u in %.1f ms, %.1f ms of compilation saved\n",
+		gr->shader_cache_dir ?: "disabled",
+		gr->shader_stats.compiled,
+		gr->shader_stats.compile_nsec / 1e6,
+		gr->shader_stats.loaded,
+		gr->shader_stats.load_nsec / 1e6,
+		gr->shader_stats.saved_nsec / 1e6);
 }
 
 struct weston_log_scope *
@@ -442,6 +699,321 @@ gl_renderer_garbage_collect_programs(struct gl_renderer *gr)
 	}
 }
 
+static int
+mkdir_p(char *path)
+{
+	char *p;
+
+	for (p = path + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+
+		*p = '\0';
+		if (mkdir(path, 0700) < 0 && errno != EEXIST) {
+			*p = '/';
+			return -1;
+		}
+		*p = '/';
+	}
+
+	if (mkdir(path, 0700) < 0 && errno != EEXIST)
+		return -1;
+
+	return 0;
+}
+
+static uint64_t
+fnv1a_64(uint64_t hash, const char *str)
+{
+	for (; str && *str; str++)
+		hash = (hash ^ (uint8_t)*str) * 1099511628211ull;
+
+	return hash;
+}
+
+/** Set up the on-disk program binary cache
+ *
+ * Program binaries are only valid for the driver that produced them and
+ * for the exact shader sources, so the cache directory name is a hash of
+ * the GL vendor, renderer and version strings and of the GLSL sources.
+ * Stale directories are never read again.
+ *
+ * The cache lives in $XDG_CACHE_HOME/weston/gl-programs, and can be
+ * disabled with weston_compositor_set_gl_shader_cache() or
+ * WESTON_DISABLE_GL_SHADER_CACHE.
+ */
+void
+gl_shader_cache_init(struct gl_renderer *gr)
+{
+	const char *base = getenv("XDG_CACHE_HOME");
+	const char *suffix = "";
+	uint64_t hash = 14695981039346656037ull;
+	GLint nformats = 0;
+	char *dir;
+
+	if (!gr->has_program_binary)
+		return;
+
+	if (!gr->compositor->gl_shader_cache ||
+	    getenv("WESTON_DISABLE_GL_SHADER_CACHE"))
+		return;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &nformats);
+	if (nformats <= 0)
+		return;
+
+	if (!base || base[0] != '/') {
+		base = getenv("HOME");
+		suffix = "/.cache";
+		if (!base || base[0] != '/')
+			return;
+	}
+
+	hash = fnv1a_64(hash, (const char *) glGetString(GL_VENDOR));
+	hash = fnv1a_64(hash, (const char *) glGetString(GL_RENDERER));
+	hash = fnv1a_64(hash, (const char *) glGetString(GL_VERSION));
+	hash = fnv1a_64(hash, vertex_shader);
+	hash = fnv1a_64(hash, fragment_shader);
+
+	if (asprintf(&dir, "%s%s/weston/gl-programs/v%d-%016" PRIx64,
+		     base, suffix, GL_SHADER_CACHE_VERSION, hash) < 0)
+		return;
+
+	if (mkdir_p(dir) < 0) {
+		weston_log("GL shader cache: cannot create %s: %s\n",
+			   dir, strerror(errno));
+		free(dir);
+		return;
+	}
+
+	gr->shader_cache_dir = dir;
+}
+
+void
+gl_shader_cache_fini(struct gl_renderer *gr)
+{
+	if (gr->shader_precompile_source)
+		wl_event_source_remove(gr->shader_precompile_source);
+	gr->shader_precompile_source = NULL;
+	wl_array_release(&gr->shader_precompile_queue);
+	wl_array_init(&gr->shader_precompile_queue);
+
+	free(gr->shader_cache_dir);
+	gr->shader_cache_dir = NULL;
+}
+
+static bool
+gl_shader_requirements_supported(struct gl_renderer *gr,
+				 const struct gl_shader_requirements *req)
+{
+	if (req->pad_bits_ != 0)
+		return false;
+
+	if (req->variant == SHADER_VARIANT_NONE ||
+	    req->variant > SHADER_VARIANT_EXTERNAL)
+		return false;
+
+	if (req->variant == SHADER_VARIANT_EXTERNAL &&
+	    !gr->has_egl_image_external)
+		return false;
+
+	if ((req->color_pre_curve != SHADER_COLOR_CURVE_IDENTITY ||
+	     req->color_mapping != SHADER_COLOR_MAPPING_IDENTITY) &&
+	    !gr->gl_supports_color_transforms)
+		return false;
+
+	if (req->color_mapping == SHADER_COLOR_MAPPING_3DLUT &&
+	    !gr->gl_supports_color_mapping_3dlut)
+		return false;
+
+	return true;
+}
+
+static void
+gl_shader_precompile_queue_add(struct gl_renderer *gr,
+			       const struct gl_shader_requirements *req)
+{
+	struct gl_shader_requirements *r;
+
+	if (!gl_shader_requirements_supported(gr, req))
+		return;
+
+	wl_array_for_each(r, &gr->shader_precompile_queue) {
+		if (gl_shader_requirements_cmp(r, req) == 0)
+			return;
+	}
+
+	r = wl_array_add(&gr->shader_precompile_queue, sizeof *r);
+	if (r)
+		*r = *req;
+}
+
+/* Queue every program found in the on-disk cache, i.e. what earlier
+ * sessions on this driver needed. */
+static void
+gl_shader_precompile_queue_cached(struct gl_renderer *gr)
+{
+	struct gl_shader_requirements req;
+	struct dirent *ent;
+	uint32_t key;
+	char tail;
+	DIR *dir;
+
+	if (!gr->shader_cache_dir)
+		return;
+
+	dir = opendir(gr->shader_cache_dir);
+	if (!dir)
+		return;
+
+	while ((ent = readdir(dir))) {
+		if (sscanf(ent->d_name, "%8" SCNx32 ".bi%c", &key, &tail) != 2 ||
+		    tail != 'n' || strlen(ent->d_name) != 12)
+			continue;
+
+		memcpy(&req, &key, sizeof req);
+		gl_shader_precompile_queue_add(gr, &req);
+	}
+
+	closedir(dir);
+}
+
+static void
+gl_shader_precompile_queue_variant(struct gl_renderer *gr, const char *name)
+{
+	static const char prefix[] = "SHADER_VARIANT_";
+	struct gl_shader_requirements req = {};
+	enum gl_shader_texture_variant v;
+	const char *str;
+
+	for (v = SHADER_VARIANT_RGBX; v <= SHADER_VARIANT_EXTERNAL; v++) {
+		str = gl_shader_texture_variant_to_string(v);
+		if (strcasecmp(str + strlen(prefix), name) != 0)
+			continue;
+
+		req.variant = v;
+		req.input_is_premult = gl_shader_texture_variant_can_be_premult(v);
+		gl_shader_precompile_queue_add(gr, &req);
+		return;
+	}
+
+	weston_log("GL shader precompile: unknown variant '%s'\n", name);
+}
+
+static void
+gl_shader_precompile_report(struct gl_renderer *gr,
+			    const struct timespec *begin)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	weston_log("GL shader precompile done in %.1f ms. Since startup: "
+		   "%u programs compiled in %.1f ms, %u loaded from cache "
+		   "in %.1f ms, about %.1f ms of compilation saved\n",
+		   timespec_sub_to_nsec(&now, begin) / 1e6,
+		   gr->shader_stats.compiled,
+		   gr->shader_stats.compile_nsec / 1e6,
+		   gr->shader_stats.loaded,
+		   gr->shader_stats.load_nsec / 1e6,
+		   gr->shader_stats.saved_nsec / 1e6);
+}
+
+/* Build one program per timer expiry. An idle source re-added from its own
+ * callback would run again in the same dispatch, so a 1 ms timer is what
+ * lets client requests in between compilations. */
+static int
+gl_shader_precompile_timer(void *data)
+{
+	struct gl_renderer *gr = data;
+	struct gl_shader_requirements *reqs = gr->shader_precompile_queue.data;
+	size_t count = gr->shader_precompile_queue.size / sizeof *reqs;
+	struct gl_shader_requirements *req;
+	struct gl_shader *shader;
+
+	if (eglGetCurrentContext() != gr->egl_context)
+		eglMakeCurrent(gr->egl_display, gr->dummy_surface,
+			       gr->dummy_surface, gr->egl_context);
+
+	while (gr->shader_precompile_next < count) {
+		req = &reqs[gr->shader_precompile_next++];
+
+		wl_list_for_each(shader, &gr->shader_list, link) {
+			if (gl_shader_requirements_cmp(req, &shader->key) == 0)
+				break;
+		}
+		if (&shader->link != &gr->shader_list)
+			continue;
+
+		shader = gl_shader_create(gr, req);
+		if (!shader)
+			continue;
+
+		/* Survive garbage collection until it had a chance to be used */
+		weston_compositor_read_presentation_clock(gr->compositor,
+							  &shader->last_used);
+
+		if (gr->shader_precompile_next < count) {
+			wl_event_source_timer_update(gr->shader_precompile_source,
+						     1);
+			return 0;
+		}
+	}
+
+	gl_shader_precompile_report(gr, &gr->shader_precompile_begin);
+	wl_array_release(&gr->shader_precompile_queue);
+	wl_array_init(&gr->shader_precompile_queue);
+
+	wl_event_source_remove(gr->shader_precompile_source);
+	gr->shader_precompile_source = NULL;
+
+	return 0;
+}
+
+/** Precompile shader programs in the background after startup
+ *
+ * The list is a comma separated list of texture variant names (rgbx,
+ * rgba, y_u_v, y_uv, y_xuxv, xyuv, solid, external), and "cached" for
+ * every program in the on-disk cache. It comes from
+ * WESTON_GL_SHADER_PRECOMPILE if set, else from
+ * weston_compositor_set_gl_shader_cache(). An empty list disables
+ * precompiling.
+ */
+void
+gl_renderer_schedule_shader_precompile(struct gl_renderer *gr)
+{
+	const char *env = getenv("WESTON_GL_SHADER_PRECOMPILE");
+	struct wl_event_loop *loop;
+	char *list, *tok, *saveptr;
+
+	if (!env)
+		env = gr->compositor->gl_shader_precompile;
+
+	list = strdup(env ?: GL_SHADER_PRECOMPILE_DEFAULT);
+	if (!list)
+		return;
+
+	for (tok = strtok_r(list, ", ", &saveptr); tok;
+	     tok = strtok_r(NULL, ", ", &saveptr)) {
+		if (strcmp(tok, "cached") == 0)
+			gl_shader_precompile_queue_cached(gr);
+		else
+			gl_shader_precompile_queue_variant(gr, tok);
+	}
+	free(list);
+
+	if (gr->shader_precompile_queue.size == 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &gr->shader_precompile_begin);
+	gr->shader_precompile_next = 0;
+
+	loop = wl_display_get_event_loop(gr->compositor->wl_display);
+	gr->shader_precompile_source =
+		wl_event_loop_add_timer(loop, gl_shader_precompile_timer, gr);
+	if (gr->shader_precompile_source)
+		wl_event_source_timer_update(gr->shader_precompile_source, 1);
+}
+
 bool
 gl_shader_texture_variant_can_be_premult(enum gl_shader_texture_variant v)
 {
@@ -515,6 +1087,25 @@ gl_shader_load_config(struct gl_shader *shader,
 			     1, sconf->color_pre_curve_lut_scale_offset);
 		break;
 	}
+
+	/* Fixed texture unit for color_mapping LUT */
+	i = GL_SHADER_INPUT_TEX_MAX + 1;
+	glActiveTexture(GL_TEXTURE0 + i);
+	switch (sconf->req.color_mapping) {
+	case SHADER_COLOR_MAPPING_IDENTITY:
+		assert(sconf->color_mapping_lut_tex == 0);
+		break;
+	case SHADER_COLOR_MAPPING_3DLUT:
+		assert(sconf->color_mapping_lut_tex != 0);
+		assert(shader->color_mapping_lut_3d_uniform != -1);
+		assert(shader->color_mapping_lut_scale_offset_uniform != -1);
+
+		glBindTexture(GL_TEXTURE_3D_OES, sconf->color_mapping_lut_tex);
+		glUniform1i(shader->color_mapping_lut_3d_uniform, i);
+		glUniform2fv(shader->color_mapping_lut_scale_offset_uniform,
+			     1, sconf->color_mapping_lut_scale_offset);
+		break;
+	}
 }
 
 bool
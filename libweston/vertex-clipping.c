@@ -25,6 +25,13 @@
 #include <assert.h>
 #include <float.h>
 #include <math.h>
+#include <string.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "vertex-clipping.h"
 
@@ -328,3 +335,224 @@ clip_transformed(struct clip_context *ctx,
 
 	return n;
 }
+
+/** Precompute the bounding box and orientation of a transformed quad
+ *
+ * \param quad A quad whose four vertices have been filled in, in the order
+ * of the surface rectangle corners x1y1, x2y1, x2y2, x1y2.
+ */
+void
+clip_quad_init(struct clip_quad *quad)
+{
+	int i;
+
+	quad->min_x = quad->max_x = quad->x[0];
+	quad->min_y = quad->max_y = quad->y[0];
+	for (i = 1; i < 4; i++) {
+		quad->min_x = min(quad->min_x, quad->x[i]);
+		quad->max_x = max(quad->max_x, quad->x[i]);
+		quad->min_y = min(quad->min_y, quad->y[i]);
+		quad->max_y = max(quad->max_y, quad->y[i]);
+	}
+
+	quad->orientation =
+		(quad->x[0] - quad->x[2]) * (quad->y[1] - quad->y[3]) -
+		(quad->x[1] - quad->x[3]) * (quad->y[0] - quad->y[2]);
+	if (float_difference(quad->orientation, 0.0f) == 0.0f)
+		quad->orientation = 0.0f;
+}
+
+/* True if all four corners of the box lie inside the convex quad, in which
+ * case the intersection is the box itself.  Each lane handles one corner.
+ */
+static bool
+clip_box_inside_quad(const struct clip_quad *q,
+		     float x1, float y1, float x2, float y2)
+{
+#if defined(__SSE__)
+	__m128 px = _mm_setr_ps(x1, x2, x2, x1);
+	__m128 py = _mm_setr_ps(y1, y1, y2, y2);
+	__m128 sign = _mm_set1_ps(q->orientation);
+	__m128 zero = _mm_setzero_ps();
+	__m128 outside = zero;
+	__m128 cross;
+	int k, l;
+
+	for (k = 0; k < 4; k++) {
+		l = (k + 1) & 3;
+		cross = _mm_sub_ps(
+			_mm_mul_ps(_mm_set1_ps(q->x[l] - q->x[k]),
+				   _mm_sub_ps(py, _mm_set1_ps(q->y[k]))),
+			_mm_mul_ps(_mm_set1_ps(q->y[l] - q->y[k]),
+				   _mm_sub_ps(px, _mm_set1_ps(q->x[k]))));
+		outside = _mm_or_ps(outside,
+				    _mm_cmplt_ps(_mm_mul_ps(cross, sign), zero));
+	}
+
+	return _mm_movemask_ps(outside) == 0;
+#elif defined(__ARM_NEON)
+	const float pxs[4] = { x1, x2, x2, x1 };
+	const float pys[4] = { y1, y1, y2, y2 };
+	float32x4_t px = vld1q_f32(pxs);
+	float32x4_t py = vld1q_f32(pys);
+	float32x4_t zero = vdupq_n_f32(0.0f);
+	uint32x4_t outside = vdupq_n_u32(0);
+	uint32x2_t any;
+	float32x4_t cross;
+	int k, l;
+
+	for (k = 0; k < 4; k++) {
+		l = (k + 1) & 3;
+		cross = vsubq_f32(
+			vmulq_n_f32(vsubq_f32(py, vdupq_n_f32(q->y[k])),
+				    q->x[l] - q->x[k]),
+			vmulq_n_f32(vsubq_f32(px, vdupq_n_f32(q->x[k])),
+				    q->y[l] - q->y[k]));
+		outside = vorrq_u32(outside,
+				    vcltq_f32(vmulq_n_f32(cross, q->orientation),
+					      zero));
+	}
+
+	any = vorr_u32(vget_low_u32(outside), vget_high_u32(outside));
+	return (vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) == 0;
+#else
+	const float px[4] = { x1, x2, x2, x1 };
+	const float py[4] = { y1, y1, y2, y2 };
+	float cross;
+	int i, k, l;
+
+	for (k = 0; k < 4; k++) {
+		l = (k + 1) & 3;
+		for (i = 0; i < 4; i++) {
+			cross = (q->x[l] - q->x[k]) * (py[i] - q->y[k]) -
+				(q->y[l] - q->y[k]) * (px[i] - q->x[k]);
+			if (cross * q->orientation < 0.0f)
+				return false;
+		}
+	}
+
+	return true;
+#endif
+}
+
+/* Intersection of two axis-aligned rectangles: clamp the quad corners. */
+static void
+clip_quad_clamp(const struct clip_quad *q,
+		float x1, float y1, float x2, float y2,
+		float *ex, float *ey)
+{
+#if defined(__SSE__)
+	_mm_storeu_ps(ex, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(q->x),
+						_mm_set1_ps(x1)),
+				     _mm_set1_ps(x2)));
+	_mm_storeu_ps(ey, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(q->y),
+						_mm_set1_ps(y1)),
+				     _mm_set1_ps(y2)));
+#elif defined(__ARM_NEON)
+	vst1q_f32(ex, vminq_f32(vmaxq_f32(vld1q_f32(q->x), vdupq_n_f32(x1)),
+				vdupq_n_f32(x2)));
+	vst1q_f32(ey, vminq_f32(vmaxq_f32(vld1q_f32(q->y), vdupq_n_f32(y1)),
+				vdupq_n_f32(y2)));
+#else
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		ex[i] = clip(q->x[i], x1, x2);
+		ey[i] = clip(q->y[i], y1, y2);
+	}
+#endif
+}
+
+/** Clip many transformed surface rectangles against many clip boxes
+ *
+ * \param boxes Clip rectangles in global coordinates.
+ * \param nboxes Number of clip rectangles.
+ * \param quads Surface rectangles in global coordinates, prepared with
+ * clip_quad_init().
+ * \param nquads Number of quads.
+ * \param axis_aligned True if every quad is an axis-aligned rectangle, that
+ * is the view transformation has no rotation. No polygon clipping is done
+ * then.
+ * \param vertices Output vertex positions, x and y at the start of every
+ * stride floats. Must have room for nboxes * nquads * 8 vertices.
+ * \param stride Distance in floats between consecutive output vertices.
+ * \param vtxcnt Receives the vertex count of every emitted polygon.
+ * \return The number of polygons emitted.
+ *
+ * Every box/quad pair with a non-empty intersection emits one convex
+ * polygon of 3 to 8 vertices.  Pairs whose bounding boxes do not overlap,
+ * quads entirely inside a box and boxes entirely inside a quad are
+ * resolved without running the general Sutherland-Hodgman clipper.
+ */
+int
+clip_quads_batch(const pixman_box32_t *boxes, int nboxes,
+		 const struct clip_quad *quads, int nquads,
+		 bool axis_aligned,
+		 float *vertices, int stride,
+		 unsigned int *vtxcnt)
+{
+	struct clip_context ctx;
+	struct polygon8 surf;
+	const struct clip_quad *q;
+	float x1, y1, x2, y2;
+	float ex[8], ey[8];
+	int i, j, k, n;
+	int npolygons = 0;
+
+	for (i = 0; i < nboxes; i++) {
+		x1 = boxes[i].x1;
+		y1 = boxes[i].y1;
+		x2 = boxes[i].x2;
+		y2 = boxes[i].y2;
+
+		for (j = 0; j < nquads; j++) {
+			q = &quads[j];
+
+			if (q->min_x >= x2 || q->max_x <= x1 ||
+			    q->min_y >= y2 || q->max_y <= y1)
+				continue;
+
+			if (axis_aligned) {
+				clip_quad_clamp(q, x1, y1, x2, y2, ex, ey);
+				n = 4;
+			} else if (q->orientation != 0.0f &&
+				   q->min_x >= x1 && q->max_x <= x2 &&
+				   q->min_y >= y1 && q->max_y <= y2) {
+				memcpy(ex, q->x, sizeof q->x);
+				memcpy(ey, q->y, sizeof q->y);
+				n = 4;
+			} else if (q->orientation != 0.0f &&
+				   clip_box_inside_quad(q, x1, y1, x2, y2)) {
+				ex[0] = x1;
+				ey[0] = y1;
+				ex[1] = x2;
+				ey[1] = y1;
+				ex[2] = x2;
+				ey[2] = y2;
+				ex[3] = x1;
+				ey[3] = y2;
+				n = 4;
+			} else {
+				ctx.clip.x1 = x1;
+				ctx.clip.y1 = y1;
+				ctx.clip.x2 = x2;
+				ctx.clip.y2 = y2;
+				memcpy(surf.x, q->x, sizeof q->x);
+				memcpy(surf.y, q->y, sizeof q->y);
+				surf.n = 4;
+				n = clip_transformed(&ctx, &surf, ex, ey);
+				if (n < 3)
+					continue;
+			}
+
+			for (k = 0; k < n; k++) {
+				vertices[0] = ex[k];
+				vertices[1] = ey[k];
+				vertices += stride;
+			}
+			vtxcnt[npolygons++] = n;
+		}
+	}
+
+	return npolygons;
+}
@@ -25,6 +25,9 @@
 #ifndef _WESTON_VERTEX_CLIPPING_H
 #define _WESTON_VERTEX_CLIPPING_H
 
+#include <stdbool.h>
+#include <pixman.h>
+
 struct polygon8 {
 	float x[8];
 	float y[8];
@@ -48,6 +51,17 @@ struct clip_context {
 	} vertices;
 };
 
+/* A surface rectangle transformed into global coordinates, with the
+ * data clip_quads_batch() needs precomputed by clip_quad_init().
+ */
+struct clip_quad {
+	float x[4];
+	float y[4];
+	float min_x, min_y;
+	float max_x, max_y;
+	float orientation;	/* signed doubled area, 0 if degenerate */
+};
+
 float
 float_difference(float a, float b);
 
@@ -61,6 +75,16 @@ int
 clip_transformed(struct clip_context *ctx,
 		 struct polygon8 *surf,
 		 float *ex,
-		 float *ey);\
+		 float *ey);
+
+void
+clip_quad_init(struct clip_quad *quad);
+
+int
+clip_quads_batch(const pixman_box32_t *boxes, int nboxes,
+		 const struct clip_quad *quads, int nquads,
+		 bool axis_aligned,
+		 float *vertices, int stride,
+		 unsigned int *vtxcnt);
 
 #endif
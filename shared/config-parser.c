@@ -34,33 +34,104 @@
 #include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
 
 #include <wayland-util.h>
+#include <wayland-server-core.h>
 #include <libweston/zalloc.h>
 #include <libweston/config-parser.h>
 #include "helpers.h"
 #include "string-helpers.h"
 
+/* Config data lives in string pools sized from the file, so there is no
+ * line length limit.  Every key, value and section name is interned in the
+ * pool of the parse that produced it, and both sections and entries are
+ * found through open-addressed hash tables instead of list walks.
+ */
+
 struct weston_config_entry {
-	char *key;
-	char *value;
-	struct wl_list link;
+	const char *key;
+	const char *value;
+	uint32_t hash;
 };
 
 struct weston_config_section {
-	char *name;
-	struct wl_list entry_list;
+	const char *name;
+	uint32_t hash;
+	struct weston_config_entry *entries;	/* in file order */
+	unsigned int entry_count;
+	unsigned int entry_alloc;
+	uint32_t *entry_index;	/* 1 + index into entries, 0 is empty */
+	uint32_t entry_index_mask;
+	/* next section with the same name, in file order */
+	struct weston_config_section *next_same_name;
+	/* reload bookkeeping */
+	bool matched;
+	struct weston_config_section *match;
+	/* copy of name for removed sections, which outlive the pool */
+	char *owned_name;
 	struct wl_list link;
 };
 
+struct config_string_pool {
+	size_t used;
+	size_t size;
+	char data[];
+};
+
+struct config_interner {
+	const char **slots;
+	uint32_t *hashes;
+	uint32_t mask;
+	uint32_t count;
+	struct config_string_pool *pool;
+};
+
 struct weston_config {
 	struct wl_list section_list;
+	/* sections dropped by a reload, kept so stale pointers stay valid */
+	struct wl_list removed_section_list;
+	struct weston_config_section **section_index;
+	uint32_t section_index_mask;
+	/* backs every key, value and live section name */
+	struct config_string_pool *pool;
+	struct wl_signal change_signal;
+	int inotify_fd;
+	struct wl_event_source *inotify_source;
 	char path[PATH_MAX];
 };
 
+static uint32_t
+config_hash(const char *s, size_t len)
+{
+	uint32_t h = 2166136261u;
+	size_t i;
+
+	/* FNV-1a */
+	for (i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+static uint32_t
+config_table_size(unsigned int count)
+{
+	uint32_t size = 8;
+
+	/* keep the load factor at or below one half */
+	while (size < count * 2)
+		size *= 2;
+
+	return size;
+}
+
 static int
 open_config_file(struct weston_config *c, const char *name)
 {
@@ -119,12 +190,39 @@ config_section_get_entry(struct weston_config_section *section,
 			 const char *key)
 {
 	struct weston_config_entry *e;
+	uint32_t hash, i, slot;
 
-	if (section == NULL)
+	if (section == NULL || section->entry_count == 0)
 		return NULL;
-	wl_list_for_each(e, &section->entry_list, link)
-		if (strcmp(e->key, key) == 0)
+
+	hash = config_hash(key, strlen(key));
+	for (i = hash & section->entry_index_mask;
+	     (slot = section->entry_index[i]) != 0;
+	     i = (i + 1) & section->entry_index_mask) {
+		e = &section->entries[slot - 1];
+		if (e->hash == hash && strcmp(e->key, key) == 0)
 			return e;
+	}
+
+	return NULL;
+}
+
+static struct weston_config_section *
+config_lookup_section(struct weston_config *config, const char *name)
+{
+	struct weston_config_section *s;
+	uint32_t hash, i;
+
+	if (config->section_index == NULL)
+		return NULL;
+
+	hash = config_hash(name, strlen(name));
+	for (i = hash & config->section_index_mask;
+	     (s = config->section_index[i]) != NULL;
+	     i = (i + 1) & config->section_index_mask) {
+		if (s->hash == hash && strcmp(s->name, name) == 0)
+			return s;
+	}
 
 	return NULL;
 }
@@ -139,9 +237,9 @@ weston_config_get_section(struct weston_config *config, const char *section,
 
 	if (config == NULL)
 		return NULL;
-	wl_list_for_each(s, &config->section_list, link) {
-		if (strcmp(s->name, section) != 0)
-			continue;
+
+	for (s = config_lookup_section(config, section);
+	     s != NULL; s = s->next_same_name) {
 		if (key == NULL)
 			return s;
 		e = config_section_get_entry(s, key);
@@ -340,8 +438,119 @@ weston_config_get_name_from_env(void)
 	return "weston.ini";
 }
 
+static struct config_string_pool *
+config_string_pool_create(size_t size)
+{
+	struct config_string_pool *pool;
+
+	pool = zalloc(sizeof *pool + size);
+	if (pool == NULL)
+		return NULL;
+
+	pool->size = size;
+
+	return pool;
+}
+
+static int
+config_interner_init(struct config_interner *in,
+		     struct config_string_pool *pool)
+{
+	uint32_t size = config_table_size(32);
+
+	in->slots = calloc(size, sizeof *in->slots);
+	in->hashes = calloc(size, sizeof *in->hashes);
+	if (in->slots == NULL || in->hashes == NULL) {
+		free(in->slots);
+		free(in->hashes);
+		return -1;
+	}
+
+	in->mask = size - 1;
+	in->count = 0;
+	in->pool = pool;
+
+	return 0;
+}
+
+static void
+config_interner_release(struct config_interner *in)
+{
+	free(in->slots);
+	free(in->hashes);
+}
+
+static int
+config_interner_grow(struct config_interner *in)
+{
+	uint32_t size = (in->mask + 1) * 2;
+	const char **slots;
+	uint32_t *hashes;
+	uint32_t i, j;
+
+	slots = calloc(size, sizeof *slots);
+	hashes = calloc(size, sizeof *hashes);
+	if (slots == NULL || hashes == NULL) {
+		free(slots);
+		free(hashes);
+		return -1;
+	}
+
+	for (i = 0; i <= in->mask; i++) {
+		if (in->slots[i] == NULL)
+			continue;
+		for (j = in->hashes[i] & (size - 1); slots[j] != NULL;
+		     j = (j + 1) & (size - 1))
+			;
+		slots[j] = in->slots[i];
+		hashes[j] = in->hashes[i];
+	}
+
+	free(in->slots);
+	free(in->hashes);
+	in->slots = slots;
+	in->hashes = hashes;
+	in->mask = size - 1;
+
+	return 0;
+}
+
+/* Every interned string is shorter than the part of the input line it was
+ * taken from, so a pool of file size + 1 bytes can never overflow.
+ */
+static const char *
+config_intern(struct config_interner *in, const char *s, size_t len)
+{
+	uint32_t hash = config_hash(s, len);
+	const char *str;
+	char *copy;
+	uint32_t i;
+
+	for (i = hash & in->mask; (str = in->slots[i]) != NULL;
+	     i = (i + 1) & in->mask) {
+		if (in->hashes[i] == hash &&
+		    strncmp(str, s, len) == 0 && str[len] == '\0')
+			return str;
+	}
+
+	assert(in->pool->used + len + 1 <= in->pool->size);
+	copy = &in->pool->data[in->pool->used];
+	memcpy(copy, s, len);
+	copy[len] = '\0';
+	in->pool->used += len + 1;
+
+	in->slots[i] = copy;
+	in->hashes[i] = hash;
+	in->count++;
+
+	if (in->count * 2 > in->mask + 1 && config_interner_grow(in) < 0)
+		return NULL;
+
+	return copy;
+}
+
 static struct weston_config_section *
-config_add_section(struct weston_config *config, const char *name)
+config_add_section(struct wl_list *section_list, const char *name)
 {
 	struct weston_config_section *section;
 
@@ -349,124 +558,302 @@ config_add_section(struct weston_config *config, const char *name)
 	if (section == NULL)
 		return NULL;
 
-	section->name = strdup(name);
-	if (section->name == NULL) {
-		free(section);
-		return NULL;
-	}
-
-	wl_list_init(&section->entry_list);
-	wl_list_insert(config->section_list.prev, &section->link);
+	section->name = name;
+	section->hash = config_hash(name, strlen(name));
+	wl_list_insert(section_list->prev, &section->link);
 
 	return section;
 }
 
-static struct weston_config_entry *
+static int
 section_add_entry(struct weston_config_section *section,
 		  const char *key, const char *value)
 {
-	struct weston_config_entry *entry;
+	struct weston_config_entry *entries, *entry;
+	unsigned int alloc;
+
+	if (section->entry_count == section->entry_alloc) {
+		alloc = section->entry_alloc ? section->entry_alloc * 2 : 8;
+		entries = realloc(section->entries, alloc * sizeof *entries);
+		if (entries == NULL)
+			return -1;
+		section->entries = entries;
+		section->entry_alloc = alloc;
+	}
 
-	entry = zalloc(sizeof *entry);
-	if (entry == NULL)
-		return NULL;
+	entry = &section->entries[section->entry_count++];
+	entry->key = key;
+	entry->value = value;
+	entry->hash = config_hash(key, strlen(key));
 
-	entry->key = strdup(key);
-	if (entry->key == NULL) {
-		free(entry);
-		return NULL;
-	}
+	return 0;
+}
 
-	entry->value = strdup(value);
-	if (entry->value == NULL) {
-		free(entry->key);
-		free(entry);
-		return NULL;
+static int
+section_build_index(struct weston_config_section *section)
+{
+	struct weston_config_entry *e, *other;
+	uint32_t size, i, slot;
+	unsigned int n;
+
+	if (section->entry_count == 0)
+		return 0;
+
+	size = config_table_size(section->entry_count);
+	section->entry_index = calloc(size, sizeof *section->entry_index);
+	if (section->entry_index == NULL)
+		return -1;
+	section->entry_index_mask = size - 1;
+
+	for (n = 0; n < section->entry_count; n++) {
+		e = &section->entries[n];
+		for (i = e->hash & section->entry_index_mask;
+		     (slot = section->entry_index[i]) != 0;
+		     i = (i + 1) & section->entry_index_mask) {
+			other = &section->entries[slot - 1];
+			/* the first occurrence of a duplicated key wins */
+			if (other->hash == e->hash &&
+			    strcmp(other->key, e->key) == 0)
+				break;
+		}
+		if (slot == 0)
+			section->entry_index[i] = n + 1;
 	}
 
-	wl_list_insert(section->entry_list.prev, &entry->link);
+	return 0;
+}
 
-	return entry;
+static void
+config_section_clear(struct weston_config_section *section)
+{
+	free(section->entries);
+	free(section->entry_index);
+	section->entries = NULL;
+	section->entry_index = NULL;
+	section->entry_count = 0;
+	section->entry_alloc = 0;
+	section->entry_index_mask = 0;
 }
 
-WL_EXPORT
-struct weston_config *
-weston_config_parse(const char *name)
+static void
+config_section_destroy(struct weston_config_section *section)
 {
-	FILE *fp;
-	char line[512], *p;
-	struct stat filestat;
-	struct weston_config *config;
-	struct weston_config_section *section = NULL;
-	int i, fd;
+	config_section_clear(section);
+	wl_list_remove(&section->link);
+	free(section->owned_name);
+	free(section);
+}
 
-	config = zalloc(sizeof *config);
-	if (config == NULL)
-		return NULL;
+/* Fills a zeroed index of size slots; size must come from
+ * config_table_size() for at least the number of sections in the list.
+ */
+static void
+config_set_section_index(struct weston_config *config,
+			 struct weston_config_section **index, uint32_t size)
+{
+	struct weston_config_section *s, *head;
+	uint32_t i;
 
-	wl_list_init(&config->section_list);
+	wl_list_for_each(s, &config->section_list, link) {
+		s->next_same_name = NULL;
+		for (i = s->hash & (size - 1); (head = index[i]) != NULL;
+		     i = (i + 1) & (size - 1)) {
+			if (head->hash == s->hash &&
+			    strcmp(head->name, s->name) == 0)
+				break;
+		}
 
-	fd = open_config_file(config, name);
-	if (fd == -1) {
-		free(config);
-		return NULL;
-	}
+		if (head == NULL) {
+			index[i] = s;
+			continue;
+		}
 
-	if (fstat(fd, &filestat) < 0 ||
-	    !S_ISREG(filestat.st_mode)) {
-		close(fd);
-		free(config);
-		return NULL;
+		while (head->next_same_name)
+			head = head->next_same_name;
+		head->next_same_name = s;
 	}
 
-	fp = fdopen(fd, "r");
-	if (fp == NULL) {
-		free(config);
-		return NULL;
-	}
+	free(config->section_index);
+	config->section_index = index;
+	config->section_index_mask = size - 1;
+}
+
+static int
+config_build_section_index(struct weston_config *config)
+{
+	struct weston_config_section **index;
+	uint32_t size;
+
+	size = config_table_size(wl_list_length(&config->section_list));
+	index = calloc(size, sizeof *index);
+	if (index == NULL)
+		return -1;
+
+	config_set_section_index(config, index, size);
+
+	return 0;
+}
+
+static int
+config_parse_buffer(const char *buf, size_t len,
+		    struct config_interner *in, struct wl_list *section_list)
+{
+	struct weston_config_section *section = NULL;
+	const char *line, *end, *eol, *p, *v, *ve;
+	const char *name, *key, *value;
+	bool has_newline;
+
+	for (line = buf, end = buf + len; line < end; line = eol + 1) {
+		eol = memchr(line, '\n', end - line);
+		has_newline = eol != NULL;
+		if (!has_newline)
+			eol = end;
 
-	while (fgets(line, sizeof line, fp)) {
 		switch (line[0]) {
 		case '#':
 		case '\n':
 			continue;
 		case '[':
-			p = strchr(&line[1], ']');
-			if (!p || p[1] != '\n') {
+			p = memchr(line + 1, ']', eol - line - 1);
+			if (!p || p + 1 != eol || !has_newline) {
 				fprintf(stderr, "malformed "
-					"section header: %s\n", line);
-				fclose(fp);
-				weston_config_destroy(config);
-				return NULL;
+					"section header: %.*s\n",
+					(int)(eol - line), line);
+				return -1;
 			}
-			p[0] = '\0';
-			section = config_add_section(config, &line[1]);
+			name = config_intern(in, line + 1, p - line - 1);
+			if (name == NULL)
+				return -1;
+			section = config_add_section(section_list, name);
+			if (section == NULL)
+				return -1;
 			continue;
 		default:
-			p = strchr(line, '=');
+			p = memchr(line, '=', eol - line);
 			if (!p || p == line || !section) {
 				fprintf(stderr, "malformed "
-					"config line: %s\n", line);
-				fclose(fp);
-				weston_config_destroy(config);
-				return NULL;
+					"config line: %.*s\n",
+					(int)(eol - line), line);
+				return -1;
 			}
 
-			p[0] = '\0';
-			p++;
-			while (isspace(*p))
-				p++;
-			i = strlen(p);
-			while (i > 0 && isspace(p[i - 1])) {
-				p[i - 1] = '\0';
-				i--;
-			}
-			section_add_entry(section, line, p);
+			v = p + 1;
+			ve = eol;
+			while (v < ve && isspace((unsigned char)*v))
+				v++;
+			while (ve > v && isspace((unsigned char)ve[-1]))
+				ve--;
+
+			key = config_intern(in, line, p - line);
+			value = config_intern(in, v, ve - v);
+			if (key == NULL || value == NULL ||
+			    section_add_entry(section, key, value) < 0)
+				return -1;
 			continue;
 		}
 	}
 
-	fclose(fp);
+	return 0;
+}
+
+/* Parses the whole file from a single read-only mapping into
+ * section_list.  On success the string pool backing every key, value and
+ * name is returned in pool_out and must outlive the sections.
+ */
+static int
+config_parse_fd(int fd, struct wl_list *section_list,
+		struct config_string_pool **pool_out)
+{
+	struct weston_config_section *s, *next;
+	struct config_string_pool *pool;
+	struct config_interner in;
+	struct stat filestat;
+	void *map = NULL;
+	size_t size;
+	int ret;
+
+	if (fstat(fd, &filestat) < 0 ||
+	    !S_ISREG(filestat.st_mode))
+		return -1;
+	size = filestat.st_size;
+
+	pool = config_string_pool_create(size + 1);
+	if (pool == NULL)
+		return -1;
+
+	if (config_interner_init(&in, pool) < 0) {
+		free(pool);
+		return -1;
+	}
+
+	if (size > 0) {
+		map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			config_interner_release(&in);
+			free(pool);
+			return -1;
+		}
+	}
+
+	ret = config_parse_buffer(map, size, &in, section_list);
+
+	if (map)
+		munmap(map, size);
+	config_interner_release(&in);
+
+	if (ret == 0) {
+		wl_list_for_each(s, section_list, link) {
+			ret = section_build_index(s);
+			if (ret < 0)
+				break;
+		}
+	}
+
+	if (ret < 0) {
+		wl_list_for_each_safe(s, next, section_list, link)
+			config_section_destroy(s);
+		free(pool);
+		return -1;
+	}
+
+	*pool_out = pool;
+
+	return 0;
+}
+
+WL_EXPORT
+struct weston_config *
+weston_config_parse(const char *name)
+{
+	struct weston_config *config;
+	int fd, ret;
+
+	config = zalloc(sizeof *config);
+	if (config == NULL)
+		return NULL;
+
+	wl_list_init(&config->section_list);
+	wl_list_init(&config->removed_section_list);
+	wl_signal_init(&config->change_signal);
+	config->inotify_fd = -1;
+
+	fd = open_config_file(config, name);
+	if (fd == -1) {
+		free(config);
+		return NULL;
+	}
+
+	ret = config_parse_fd(fd, &config->section_list, &config->pool);
+	close(fd);
+	if (ret < 0) {
+		free(config);
+		return NULL;
+	}
+
+	if (config_build_section_index(config) < 0) {
+		weston_config_destroy(config);
+		return NULL;
+	}
 
 	return config;
 }
@@ -502,25 +889,387 @@ weston_config_next_section(struct weston_config *config,
 	return 1;
 }
 
+static const char *
+config_section_identity(struct weston_config_section *section)
+{
+	struct weston_config_entry *e;
+
+	e = config_section_get_entry(section, "name");
+
+	return e ? e->value : NULL;
+}
+
+/* Sections are matched across a reload by name plus the value of their
+ * "name" key, e.g. [output] name=DP-1.  Unnamed sections sharing a
+ * header are matched in file order.
+ */
+static struct weston_config_section *
+config_match_section(struct weston_config *config,
+		     struct weston_config_section *section)
+{
+	struct weston_config_section *old;
+	const char *ident, *old_ident;
+
+	ident = config_section_identity(section);
+	for (old = config_lookup_section(config, section->name);
+	     old != NULL; old = old->next_same_name) {
+		if (old->matched)
+			continue;
+
+		old_ident = config_section_identity(old);
+		if (ident == NULL && old_ident == NULL)
+			return old;
+		if (ident && old_ident && strcmp(ident, old_ident) == 0)
+			return old;
+	}
+
+	return NULL;
+}
+
+static bool
+config_section_equal(struct weston_config_section *a,
+		     struct weston_config_section *b)
+{
+	struct weston_config_entry *e;
+	unsigned int i;
+
+	if (a->entry_count != b->entry_count)
+		return false;
+
+	for (i = 0; i < b->entry_count; i++) {
+		e = config_section_get_entry(a, b->entries[i].key);
+		if (e == NULL || strcmp(e->value, b->entries[i].value) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+static int
+config_add_change(struct wl_array *changes,
+		  enum weston_config_change_type type,
+		  struct weston_config_section *section)
+{
+	struct weston_config_section_change *change;
+
+	change = wl_array_add(changes, sizeof *change);
+	if (change == NULL)
+		return -1;
+
+	change->type = type;
+	change->section = section;
+	change->name = section->name;
+
+	return 0;
+}
+
+static void
+config_swap_entries(struct weston_config_section *a,
+		    struct weston_config_section *b)
+{
+	struct weston_config_section tmp;
+
+	tmp.entries = a->entries;
+	tmp.entry_count = a->entry_count;
+	tmp.entry_alloc = a->entry_alloc;
+	tmp.entry_index = a->entry_index;
+	tmp.entry_index_mask = a->entry_index_mask;
+
+	a->entries = b->entries;
+	a->entry_count = b->entry_count;
+	a->entry_alloc = b->entry_alloc;
+	a->entry_index = b->entry_index;
+	a->entry_index_mask = b->entry_index_mask;
+
+	b->entries = tmp.entries;
+	b->entry_count = tmp.entry_count;
+	b->entry_alloc = tmp.entry_alloc;
+	b->entry_index = tmp.entry_index;
+	b->entry_index_mask = tmp.entry_index_mask;
+}
+
+static void
+config_release_scratch(struct weston_config *scratch)
+{
+	struct weston_config_section *s, *next;
+
+	wl_list_for_each_safe(s, next, &scratch->section_list, link)
+		config_section_destroy(s);
+	free(scratch->pool);
+}
+
+/** Re-read the config file and update the config in place
+ *
+ * \param config The config to update.
+ * \return The number of sections that changed, or -1 if the file could
+ * not be read or parsed, in which case the config is left untouched.
+ *
+ * Section pointers obtained before the reload stay valid: sections that
+ * still exist keep their identity and get the new entries, sections that
+ * disappeared become empty.  One change signal is emitted per added,
+ * changed or removed section once the whole config has been updated.
+ * Strings previously returned by the config, such as section names, are
+ * only valid until the next successful reload.
+ */
+WL_EXPORT
+int
+weston_config_reload(struct weston_config *config)
+{
+	struct weston_config_section *s, *next, *old;
+	struct weston_config_section_change *change;
+	struct weston_config_section **index;
+	struct weston_config scratch;
+	struct wl_array changes;
+	unsigned int count;
+	uint32_t size;
+	bool changed;
+	int fd, ret;
+
+	if (config == NULL)
+		return -1;
+
+	fd = open(config->path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	/* Parse into a scratch config and allocate everything the update
+	 * needs up front, so that a failure leaves the config untouched. */
+	wl_list_init(&scratch.section_list);
+	scratch.pool = NULL;
+	ret = config_parse_fd(fd, &scratch.section_list, &scratch.pool);
+	close(fd);
+	if (ret < 0)
+		return -1;
+
+	count = wl_list_length(&scratch.section_list);
+	size = config_table_size(count);
+	index = calloc(size, sizeof *index);
+	if (index == NULL) {
+		config_release_scratch(&scratch);
+		return -1;
+	}
+
+	count += wl_list_length(&config->section_list);
+	wl_array_init(&changes);
+	if (count > 0 &&
+	    !wl_array_add(&changes, count * sizeof *change)) {
+		free(index);
+		config_release_scratch(&scratch);
+		return -1;
+	}
+	changes.size = 0;
+
+	wl_list_for_each(old, &config->section_list, link)
+		old->matched = false;
+
+	wl_list_for_each(s, &scratch.section_list, link) {
+		s->match = config_match_section(config, s);
+		if (s->match)
+			s->match->matched = true;
+	}
+
+	/* removed sections stay reachable, but their names live in the
+	 * pool that is about to be freed */
+	ret = 0;
+	wl_list_for_each(old, &config->section_list, link) {
+		if (old->matched)
+			continue;
+		old->owned_name = strdup(old->name);
+		if (old->owned_name == NULL)
+			ret = -1;
+	}
+	if (ret < 0) {
+		wl_list_for_each(old, &config->section_list, link) {
+			free(old->owned_name);
+			old->owned_name = NULL;
+		}
+		wl_array_release(&changes);
+		free(index);
+		config_release_scratch(&scratch);
+		return -1;
+	}
+
+	/* nothing below can fail */
+	wl_list_for_each_safe(s, next, &scratch.section_list, link) {
+		old = s->match;
+		if (old == NULL) {
+			config_add_change(&changes,
+					  WESTON_CONFIG_SECTION_ADDED, s);
+			continue;
+		}
+
+		/* always take the new entries and name, the old ones point
+		 * into the old pool */
+		changed = !config_section_equal(old, s);
+		config_swap_entries(old, s);
+		old->name = s->name;
+		if (changed)
+			config_add_change(&changes,
+					  WESTON_CONFIG_SECTION_CHANGED, old);
+
+		/* keep the old section object in the new file order */
+		wl_list_remove(&old->link);
+		wl_list_insert(&s->link, &old->link);
+		config_section_destroy(s);
+	}
+
+	/* whatever was not matched is gone from the file */
+	wl_list_for_each_safe(old, next, &config->section_list, link) {
+		old->name = old->owned_name;
+		config_section_clear(old);
+		wl_list_remove(&old->link);
+		wl_list_insert(config->removed_section_list.prev, &old->link);
+		config_add_change(&changes, WESTON_CONFIG_SECTION_REMOVED, old);
+	}
+
+	wl_list_insert_list(&config->section_list, &scratch.section_list);
+	config_set_section_index(config, index, size);
+
+	free(config->pool);
+	config->pool = scratch.pool;
+
+	count = 0;
+	wl_array_for_each(change, &changes) {
+		wl_signal_emit(&config->change_signal, change);
+		count++;
+	}
+	wl_array_release(&changes);
+
+	return count;
+}
+
+/** Add a listener for section changes caused by weston_config_reload()
+ *
+ * The listener is called with a struct weston_config_section_change.
+ */
+WL_EXPORT
+void
+weston_config_add_change_listener(struct weston_config *config,
+				  struct wl_listener *listener)
+{
+	wl_signal_add(&config->change_signal, listener);
+}
+
+static int
+config_handle_inotify(int fd, uint32_t mask, void *data)
+{
+	struct weston_config *config = data;
+	char buf[4096]
+		__attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *event;
+	const char *base;
+	bool reload = false;
+	ssize_t len;
+	char *p;
+
+	base = strrchr(config->path, '/') + 1;
+
+	while ((len = read(fd, buf, sizeof buf)) > 0) {
+		for (p = buf; p < buf + len;
+		     p += sizeof *event + event->len) {
+			event = (const struct inotify_event *) p;
+			if (event->len > 0 && strcmp(event->name, base) == 0)
+				reload = true;
+		}
+	}
+
+	/* editors that write in place may leave a broken file behind for a
+	 * moment; keep the current config and wait for the next event */
+	if (reload && weston_config_reload(config) < 0)
+		fprintf(stderr, "failed to reload config file %s, "
+			"keeping the previous configuration\n", config->path);
+
+	return 0;
+}
+
+/** Reload the config automatically whenever its file changes
+ *
+ * \param config The config to watch.
+ * \param loop The event loop to dispatch file change events on.
+ * \return 0 on success, -1 on failure.
+ *
+ * The directory containing the file is watched, so that editors replacing
+ * the file by renaming a new one over it are picked up as well.
+ */
+WL_EXPORT
+int
+weston_config_watch(struct weston_config *config, struct wl_event_loop *loop)
+{
+	char dir[PATH_MAX];
+	const char *slash;
+
+	if (config == NULL)
+		return -1;
+	if (config->inotify_source)
+		return 0;
+
+	slash = strrchr(config->path, '/');
+	if (slash == NULL)
+		return -1;
+	if (slash == config->path)
+		snprintf(dir, sizeof dir, "/");
+	else
+		snprintf(dir, sizeof dir, "%.*s",
+			 (int)(slash - config->path), config->path);
+
+	config->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (config->inotify_fd < 0)
+		return -1;
+
+	if (inotify_add_watch(config->inotify_fd, dir,
+			      IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+		goto err;
+
+	config->inotify_source =
+		wl_event_loop_add_fd(loop, config->inotify_fd,
+				     WL_EVENT_READABLE,
+				     config_handle_inotify, config);
+	if (config->inotify_source == NULL)
+		goto err;
+
+	return 0;
+
+err:
+	close(config->inotify_fd);
+	config->inotify_fd = -1;
+	return -1;
+}
+
+/** Stop watching the config file
+ *
+ * Must be called before the event loop passed to weston_config_watch() is
+ * destroyed.
+ */
+WL_EXPORT
+void
+weston_config_unwatch(struct weston_config *config)
+{
+	if (config == NULL || config->inotify_source == NULL)
+		return;
+
+	wl_event_source_remove(config->inotify_source);
+	config->inotify_source = NULL;
+	close(config->inotify_fd);
+	config->inotify_fd = -1;
+}
+
 WL_EXPORT
 void
 weston_config_destroy(struct weston_config *config)
 {
 	struct weston_config_section *s, *next_s;
-	struct weston_config_entry *e, *next_e;
 
 	if (config == NULL)
 		return;
 
-	wl_list_for_each_safe(s, next_s, &config->section_list, link) {
-		wl_list_for_each_safe(e, next_e, &s->entry_list, link) {
-			free(e->key);
-			free(e->value);
-			free(e);
-		}
-		free(s->name);
-		free(s);
-	}
+	weston_config_unwatch(config);
+
+	wl_list_for_each_safe(s, next_s, &config->section_list, link)
+		config_section_destroy(s);
+	wl_list_for_each_safe(s, next_s, &config->removed_section_list, link)
+		config_section_destroy(s);
+	free(config->pool);
 
+	free(config->section_index);
 	free(config);
 }
@@ -27,10 +27,17 @@
 #include "config.h"
 
 #include <float.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #ifdef UNIT_TEST
 #define WL_EXPORT
 #else
@@ -59,23 +66,123 @@ weston_matrix_init(struct weston_matrix *matrix)
 	memcpy(matrix, &identity, sizeof identity);
 }
 
+/* Matrices carrying only translate and scale bits are diagonal plus a
+ * translation column, and matrices without WESTON_MATRIX_TRANSFORM_OTHER
+ * have a last row of 0 0 0 1.  The fast paths below rely on that.
+ */
+static inline bool
+matrix_is_axis_aligned(unsigned int type)
+{
+	return (type & ~(WESTON_MATRIX_TRANSFORM_TRANSLATE |
+			 WESTON_MATRIX_TRANSFORM_SCALE)) == 0;
+}
+
+static inline bool
+matrix_is_affine(unsigned int type)
+{
+	return (type & WESTON_MATRIX_TRANSFORM_OTHER) == 0;
+}
+
+/* Column c of the product is the columns of n weighted by column c of m. */
+static void
+matrix_multiply_full(float *out, const float *m, const float *n)
+{
+#if defined(__SSE__)
+	__m128 n0 = _mm_loadu_ps(&n[0]);
+	__m128 n1 = _mm_loadu_ps(&n[4]);
+	__m128 n2 = _mm_loadu_ps(&n[8]);
+	__m128 n3 = _mm_loadu_ps(&n[12]);
+	__m128 r;
+	int c;
+
+	for (c = 0; c < 4; c++) {
+		r = _mm_mul_ps(n0, _mm_set1_ps(m[c * 4 + 0]));
+		r = _mm_add_ps(r, _mm_mul_ps(n1, _mm_set1_ps(m[c * 4 + 1])));
+		r = _mm_add_ps(r, _mm_mul_ps(n2, _mm_set1_ps(m[c * 4 + 2])));
+		r = _mm_add_ps(r, _mm_mul_ps(n3, _mm_set1_ps(m[c * 4 + 3])));
+		_mm_storeu_ps(&out[c * 4], r);
+	}
+#elif defined(__ARM_NEON)
+	float32x4_t n0 = vld1q_f32(&n[0]);
+	float32x4_t n1 = vld1q_f32(&n[4]);
+	float32x4_t n2 = vld1q_f32(&n[8]);
+	float32x4_t n3 = vld1q_f32(&n[12]);
+	float32x4_t r;
+	int c;
+
+	for (c = 0; c < 4; c++) {
+		r = vmulq_n_f32(n0, m[c * 4 + 0]);
+		r = vaddq_f32(r, vmulq_n_f32(n1, m[c * 4 + 1]));
+		r = vaddq_f32(r, vmulq_n_f32(n2, m[c * 4 + 2]));
+		r = vaddq_f32(r, vmulq_n_f32(n3, m[c * 4 + 3]));
+		vst1q_f32(&out[c * 4], r);
+	}
+#else
+	int r, c;
+
+	for (c = 0; c < 4; c++)
+		for (r = 0; r < 4; r++)
+			out[c * 4 + r] = n[r] * m[c * 4 + 0] +
+					 n[r + 4] * m[c * 4 + 1] +
+					 n[r + 8] * m[c * 4 + 2] +
+					 n[r + 12] * m[c * 4 + 3];
+#endif
+}
+
+static void
+matrix_multiply_affine(float *out, const float *m, const float *n)
+{
+	int r, c;
+
+	for (c = 0; c < 3; c++) {
+		for (r = 0; r < 3; r++)
+			out[c * 4 + r] = n[r] * m[c * 4 + 0] +
+					 n[r + 4] * m[c * 4 + 1] +
+					 n[r + 8] * m[c * 4 + 2];
+		out[c * 4 + 3] = 0.0f;
+	}
+
+	for (r = 0; r < 3; r++)
+		out[12 + r] = n[r] * m[12] + n[r + 4] * m[13] +
+			      n[r + 8] * m[14] + n[r + 12];
+	out[15] = 1.0f;
+}
+
+static void
+matrix_multiply_axis_aligned(float *out, const float *m, const float *n)
+{
+	memset(out, 0, 16 * sizeof *out);
+
+	out[0] = n[0] * m[0];
+	out[5] = n[5] * m[5];
+	out[10] = n[10] * m[10];
+	out[12] = n[0] * m[12] + n[12];
+	out[13] = n[5] * m[13] + n[13];
+	out[14] = n[10] * m[14] + n[14];
+	out[15] = 1.0f;
+}
+
 /* m <- n * m, that is, m is multiplied on the LEFT. */
 WL_EXPORT void
 weston_matrix_multiply(struct weston_matrix *m, const struct weston_matrix *n)
 {
 	struct weston_matrix tmp;
-	const float *row, *column;
-	div_t d;
-	int i, j;
-
-	for (i = 0; i < 16; i++) {
-		tmp.d[i] = 0;
-		d = div(i, 4);
-		row = m->d + d.quot * 4;
-		column = n->d + d.rem;
-		for (j = 0; j < 4; j++)
-			tmp.d[i] += row[j] * column[j * 4];
+
+	if (n->type == 0)
+		return;
+
+	if (m->type == 0) {
+		memcpy(m, n, sizeof tmp);
+		return;
 	}
+
+	if (matrix_is_axis_aligned(m->type) && matrix_is_axis_aligned(n->type))
+		matrix_multiply_axis_aligned(tmp.d, m->d, n->d);
+	else if (matrix_is_affine(m->type) && matrix_is_affine(n->type))
+		matrix_multiply_affine(tmp.d, m->d, n->d);
+	else
+		matrix_multiply_full(tmp.d, m->d, n->d);
+
 	tmp.type = m->type | n->type;
 	memcpy(m, &tmp, sizeof tmp);
 }
@@ -117,13 +224,48 @@ weston_matrix_rotate_xy(struct weston_matrix *matrix, float cos, float sin)
 WL_EXPORT void
 weston_matrix_transform(struct weston_matrix *matrix, struct weston_vector *v)
 {
-	int i, j;
+	const float *d = matrix->d;
 	struct weston_vector t;
-
-	for (i = 0; i < 4; i++) {
-		t.f[i] = 0;
-		for (j = 0; j < 4; j++)
-			t.f[i] += v->f[j] * matrix->d[i + j * 4];
+	int i;
+
+	if (matrix->type == 0)
+		return;
+
+	if (matrix_is_axis_aligned(matrix->type)) {
+		t.f[0] = v->f[0] * d[0] + v->f[3] * d[12];
+		t.f[1] = v->f[1] * d[5] + v->f[3] * d[13];
+		t.f[2] = v->f[2] * d[10] + v->f[3] * d[14];
+		t.f[3] = v->f[3];
+	} else if (matrix_is_affine(matrix->type)) {
+		for (i = 0; i < 3; i++)
+			t.f[i] = v->f[0] * d[i] + v->f[1] * d[i + 4] +
+				 v->f[2] * d[i + 8] + v->f[3] * d[i + 12];
+		t.f[3] = v->f[3];
+	} else {
+#if defined(__SSE__)
+		__m128 r;
+
+		r = _mm_mul_ps(_mm_loadu_ps(&d[0]), _mm_set1_ps(v->f[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&d[4]),
+					     _mm_set1_ps(v->f[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&d[8]),
+					     _mm_set1_ps(v->f[2])));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&d[12]),
+					     _mm_set1_ps(v->f[3])));
+		_mm_storeu_ps(t.f, r);
+#elif defined(__ARM_NEON)
+		float32x4_t r;
+
+		r = vmulq_n_f32(vld1q_f32(&d[0]), v->f[0]);
+		r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(&d[4]), v->f[1]));
+		r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(&d[8]), v->f[2]));
+		r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(&d[12]), v->f[3]));
+		vst1q_f32(t.f, r);
+#else
+		for (i = 0; i < 4; i++)
+			t.f[i] = v->f[0] * d[i] + v->f[1] * d[i + 4] +
+				 v->f[2] * d[i + 8] + v->f[3] * d[i + 12];
+#endif
 	}
 
 	*v = t;
@@ -256,21 +398,114 @@ inverse_transform(const double *LU, const unsigned *p, float *v)
 		v[j] = b[j];
 }
 
+/* Returns -1 for near-singular input, so that the caller can fall back to
+ * the LU path and keep its exact failure behaviour.
+ */
+static int
+matrix_invert_axis_aligned(struct weston_matrix *inverse,
+			   const struct weston_matrix *matrix)
+{
+	const float *d = matrix->d;
+	double sx, sy, sz, tx, ty, tz;
+
+	if (fabs(d[0]) < 1e-9 || fabs(d[5]) < 1e-9 || fabs(d[10]) < 1e-9)
+		return -1;
+
+	sx = 1.0 / d[0];
+	sy = 1.0 / d[5];
+	sz = 1.0 / d[10];
+	tx = -d[12] * sx;
+	ty = -d[13] * sy;
+	tz = -d[14] * sz;
+
+	/* inverse may alias matrix */
+	weston_matrix_init(inverse);
+	inverse->d[0] = sx;
+	inverse->d[5] = sy;
+	inverse->d[10] = sz;
+	inverse->d[12] = tx;
+	inverse->d[13] = ty;
+	inverse->d[14] = tz;
+
+	return 0;
+}
+
+static int
+matrix_invert_affine(struct weston_matrix *inverse,
+		     const struct weston_matrix *matrix)
+{
+	const float *d = matrix->d;
+	double a[9], det, t[3];
+	int r;
+
+	/* adjugate of the upper 3x3, column-major */
+	a[0] = (double)d[5] * d[10] - (double)d[6] * d[9];
+	a[1] = (double)d[2] * d[9] - (double)d[1] * d[10];
+	a[2] = (double)d[1] * d[6] - (double)d[2] * d[5];
+	a[3] = (double)d[6] * d[8] - (double)d[4] * d[10];
+	a[4] = (double)d[0] * d[10] - (double)d[2] * d[8];
+	a[5] = (double)d[2] * d[4] - (double)d[0] * d[6];
+	a[6] = (double)d[4] * d[9] - (double)d[5] * d[8];
+	a[7] = (double)d[1] * d[8] - (double)d[0] * d[9];
+	a[8] = (double)d[0] * d[5] - (double)d[1] * d[4];
+
+	det = d[0] * a[0] + d[4] * a[1] + d[8] * a[2];
+	if (fabs(det) < 1e-9)
+		return -1;
+
+	for (r = 0; r < 9; r++)
+		a[r] /= det;
+
+	for (r = 0; r < 3; r++)
+		t[r] = -(a[r] * d[12] + a[r + 3] * d[13] + a[r + 6] * d[14]);
+
+	for (r = 0; r < 3; r++) {
+		inverse->d[r] = a[r];
+		inverse->d[r + 4] = a[r + 3];
+		inverse->d[r + 8] = a[r + 6];
+		inverse->d[r + 12] = t[r];
+	}
+	inverse->d[3] = 0.0f;
+	inverse->d[7] = 0.0f;
+	inverse->d[11] = 0.0f;
+	inverse->d[15] = 1.0f;
+
+	return 0;
+}
+
 WL_EXPORT int
 weston_matrix_invert(struct weston_matrix *inverse,
 		     const struct weston_matrix *matrix)
 {
 	double LU[16];		/* column-major */
 	unsigned perm[4];	/* permutation */
+	unsigned int type = matrix->type;
 	unsigned c;
 
+	if (type == 0) {
+		weston_matrix_init(inverse);
+		return 0;
+	}
+
+	if (matrix_is_axis_aligned(type) &&
+	    matrix_invert_axis_aligned(inverse, matrix) == 0) {
+		inverse->type = type;
+		return 0;
+	}
+
+	if (matrix_is_affine(type) &&
+	    matrix_invert_affine(inverse, matrix) == 0) {
+		inverse->type = type;
+		return 0;
+	}
+
 	if (matrix_invert(LU, perm, matrix) < 0)
 		return -1;
 
 	weston_matrix_init(inverse);
 	for (c = 0; c < 4; ++c)
 		inverse_transform(LU, perm, &inverse->d[c * 4]);
-	inverse->type = matrix->type;
+	inverse->type = type;
 
 	return 0;
 }
@@ -430,3 +430,119 @@ TEST(alpha_blend)
 	wl_subcompositor_destroy(subco);
 	client_destroy(client); /* destroys bg */
 }
+
+static void
+fill_translucent_red(struct buffer *buf)
+{
+	uint32_t color = premult_color(0x80, 255, 0, 0);
+	void *pixels;
+	int stride_bytes;
+	int w, h;
+	int x, y;
+
+	pixels = pixman_image_get_data(buf->image);
+	stride_bytes = pixman_image_get_stride(buf->image);
+	w = pixman_image_get_width(buf->image);
+	h = pixman_image_get_height(buf->image);
+
+	for (y = 0; y < h; y++) {
+		uint32_t *row = pixels + y * stride_bytes;
+
+		for (x = 0; x < w; x++)
+			row[x] = color;
+	}
+}
+
+static void
+commit_opaque_region(struct client *client, struct wl_surface *surface,
+		     bool opaque, int width, int height)
+{
+	struct wl_region *region = NULL;
+
+	if (opaque) {
+		region = wl_compositor_create_region(client->wl_compositor);
+		wl_region_add(region, 0, 0, width, height);
+	}
+	wl_surface_set_opaque_region(surface, region);
+	if (region)
+		wl_region_destroy(region);
+
+	wl_surface_damage(surface, 0, 0, width, height);
+	wl_surface_commit(surface);
+}
+
+static uint32_t
+shot_blue_channel(struct client *client)
+{
+	struct buffer *shot;
+	uint32_t pixel;
+
+	shot = capture_screenshot_of_output(client);
+	assert(shot);
+	pixel = ((uint32_t *)get_middle_row(shot))[0];
+	buffer_destroy(shot);
+
+	return pixel & 0xff;
+}
+
+/*
+ * A new opaque region must take effect even when the surface size stays
+ * the same. The opaque part of a translucent buffer is drawn without
+ * blending, so the blue background shows through only outside of it.
+ */
+TEST(opaque_region_same_size)
+{
+	const int width = BLOCK_WIDTH * ALPHA_STEPS;
+	const int height = BLOCK_WIDTH;
+	const pixman_color_t blue = {
+		.red   = 0x0000,
+		.green = 0x0000,
+		.blue  = 0xffff,
+		.alpha = 0xffff
+	};
+	struct client *client;
+	struct buffer *bg;
+	struct buffer *fg;
+	struct wl_subcompositor *subco;
+	struct wl_surface *surf;
+	struct wl_subsurface *sub;
+
+	client = create_client();
+	subco = bind_to_singleton_global(client, &wl_subcompositor_interface, 1);
+
+	bg = create_shm_buffer_a8r8g8b8(client, width, height);
+	fill_image_with_color(bg->image, &blue);
+
+	client->surface = create_test_surface(client);
+	client->surface->width = width;
+	client->surface->height = height;
+	client->surface->buffer = bg; /* pass ownership */
+	set_opaque_rect(client, client->surface,
+			&(struct rectangle){ 0, 0, width, height });
+
+	fg = create_shm_buffer_a8r8g8b8(client, width, height);
+	fill_translucent_red(fg);
+
+	surf = wl_compositor_create_surface(client->wl_compositor);
+	sub = wl_subcompositor_get_subsurface(subco, surf, client->surface->wl_surface);
+	wl_subsurface_set_desync(sub);
+	wl_surface_attach(surf, fg->proxy, 0, 0);
+	wl_surface_damage(surf, 0, 0, width, height);
+	wl_surface_commit(surf);
+
+	move_client(client, 0, 0);
+	assert(shot_blue_channel(client) != 0);
+
+	/* same buffer, same size, only the opaque region changes */
+	commit_opaque_region(client, surf, true, width, height);
+	assert(shot_blue_channel(client) == 0);
+
+	commit_opaque_region(client, surf, false, width, height);
+	assert(shot_blue_channel(client) != 0);
+
+	wl_subsurface_destroy(sub);
+	wl_surface_destroy(surf);
+	buffer_destroy(fg);
+	wl_subcompositor_destroy(subco);
+	client_destroy(client); /* destroys bg */
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include "shared/helpers.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = RENDERER_PIXMAN;
+	setup.shell = SHELL_TEST_DESKTOP;
+
+	weston_ini_setup(&setup,
+			 cfgln("[core]"),
+			 cfgln("commit-budget=1"));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static void
+buffer_release_handler(void *data, struct wl_buffer *buffer)
+{
+	int *released = data;
+
+	*released = 1;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	buffer_release_handler
+};
+
+static uint32_t
+shot_pixel(struct client *client, int x, int y)
+{
+	struct buffer *shot;
+	uint32_t *data;
+	int stride;
+	uint32_t pixel;
+
+	shot = capture_screenshot_of_output(client);
+	assert(shot);
+	data = pixman_image_get_data(shot->image);
+	stride = pixman_image_get_stride(shot->image) / sizeof *data;
+	pixel = data[y * stride + x];
+	buffer_destroy(shot);
+
+	return pixel & 0xffffff;
+}
+
+/*
+ * A client sending many commits in one go gets the first one applied
+ * right away and the rest folded into one, applied once the compositor
+ * is idle. The surface ends up with the last state, every frame callback
+ * is answered, and the buffers of the folded commits are released
+ * without being shown.
+ */
+TEST(commit_flood_folds)
+{
+	static const uint8_t levels[] = {
+		0x10, 0x30, 0x50, 0x70, 0x90, 0xb0, 0xd0, 0xf0
+	};
+	struct buffer *buffers[ARRAY_LENGTH(levels)];
+	int released[ARRAY_LENGTH(levels)];
+	int done[ARRAY_LENGTH(levels)];
+	struct client *client;
+	struct wl_surface *surface;
+	pixman_color_t color;
+	unsigned i;
+	bool waiting;
+
+	client = create_client_and_test_surface(0, 0, 64, 64);
+	surface = client->surface->wl_surface;
+
+	for (i = 0; i < ARRAY_LENGTH(levels); i++) {
+		buffers[i] = create_shm_buffer_a8r8g8b8(client, 64, 64);
+		fill_image_with_color(buffers[i]->image,
+				      color_rgb888(&color, levels[i], 0, 0));
+		released[i] = 0;
+		wl_buffer_add_listener(buffers[i]->proxy, &buffer_listener,
+				       &released[i]);
+	}
+
+	/* All in one flush, so they get dispatched in one go */
+	for (i = 0; i < ARRAY_LENGTH(levels); i++) {
+		wl_surface_attach(surface, buffers[i]->proxy, 0, 0);
+		wl_surface_damage(surface, 0, 0, 64, 64);
+		frame_callback_set(surface, &done[i]);
+		wl_surface_commit(surface);
+	}
+
+	do {
+		assert(wl_display_dispatch(client->wl_display) >= 0);
+
+		waiting = false;
+		for (i = 0; i < ARRAY_LENGTH(levels); i++)
+			waiting |= !done[i];
+	} while (waiting);
+
+	/* Everything but the shown buffer went back to the client */
+	for (i = 0; i < ARRAY_LENGTH(levels) - 1; i++)
+		assert(released[i]);
+
+	assert(shot_pixel(client, 32, 32) ==
+	       (uint32_t)levels[ARRAY_LENGTH(levels) - 1] << 16);
+
+	for (i = 0; i < ARRAY_LENGTH(levels); i++)
+		buffer_destroy(buffers[i]);
+	client_destroy(client);
+}
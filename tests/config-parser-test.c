@@ -33,6 +33,7 @@
 #include <errno.h>
 #include <unistd.h>
 
+#include <wayland-server-core.h>
 #include <libweston/config-parser.h>
 
 #include "shared/helpers.h"
@@ -630,3 +631,162 @@ ZUC_TEST(config_test, section_from_null)
 	section = weston_config_get_section(NULL, "bucket", NULL, NULL);
 	ZUC_ASSERT_NULL(section);
 }
+
+ZUC_TEST(config_test, long_line)
+{
+	struct weston_config_section *section;
+	struct weston_config *config;
+	char text[4096], value[2048];
+	char *s = NULL;
+	int r;
+
+	memset(value, 'x', sizeof value - 1);
+	value[sizeof value - 1] = '\0';
+	snprintf(text, sizeof text, "[long]\nkey=%s\nlast=1", value);
+
+	config = load_config(text);
+	ZUC_ASSERT_NOT_NULL(config);
+
+	section = weston_config_get_section(config, "long", NULL, NULL);
+	r = weston_config_section_get_string(section, "key", &s, NULL);
+	ZUC_ASSERTG_EQ(0, r, out_free);
+	ZUC_ASSERTG_STREQ(value, s, out_free);
+
+	/* no trailing newline on the last line */
+	free(s);
+	r = weston_config_section_get_string(section, "last", &s, NULL);
+	ZUC_ASSERTG_EQ(0, r, out_free);
+	ZUC_ASSERTG_STREQ("1", s, out_free);
+
+out_free:
+	free(s);
+	weston_config_destroy(config);
+}
+
+struct reload_data {
+	struct wl_listener listener;
+	int added, changed, removed;
+	struct weston_config_section *last_changed;
+};
+
+static void
+reload_change_notify(struct wl_listener *listener, void *data)
+{
+	struct reload_data *rd = container_of(listener, struct reload_data,
+					      listener);
+	struct weston_config_section_change *change = data;
+
+	switch (change->type) {
+	case WESTON_CONFIG_SECTION_ADDED:
+		rd->added++;
+		break;
+	case WESTON_CONFIG_SECTION_CHANGED:
+		rd->changed++;
+		rd->last_changed = change->section;
+		break;
+	case WESTON_CONFIG_SECTION_REMOVED:
+		rd->removed++;
+		break;
+	}
+}
+
+static int
+rewrite_file(const char *file, const char *text)
+{
+	FILE *fp;
+	int ret;
+
+	fp = fopen(file, "w");
+	if (!fp)
+		return -1;
+	ret = fputs(text, fp);
+	fclose(fp);
+
+	return ret < 0 ? -1 : 0;
+}
+
+ZUC_TEST(config_test, reload)
+{
+	struct weston_config_section *out1, *out2, *kbd;
+	struct weston_config *config = NULL;
+	struct reload_data rd = { 0 };
+	char file[] = "/tmp/weston-config-parser-test-XXXXXX";
+	int32_t n;
+	int fd;
+
+	fd = mkstemp(file);
+	ZUC_ASSERT_NE(-1, fd);
+	close(fd);
+
+	ZUC_ASSERTG_EQ(0, rewrite_file(file,
+		"[output]\nname=A\nscale=1\n"
+		"[output]\nname=B\nscale=1\n"
+		"[keyboard]\nrepeat-rate=40\n"), out);
+
+	config = weston_config_parse(file);
+	ZUC_ASSERTG_NOT_NULL(config, out);
+
+	rd.listener.notify = reload_change_notify;
+	weston_config_add_change_listener(config, &rd.listener);
+
+	out1 = weston_config_get_section(config, "output", "name", "A");
+	out2 = weston_config_get_section(config, "output", "name", "B");
+	kbd = weston_config_get_section(config, "keyboard", NULL, NULL);
+	ZUC_ASSERTG_NOT_NULL(out1, out);
+	ZUC_ASSERTG_NOT_NULL(out2, out);
+	ZUC_ASSERTG_NOT_NULL(kbd, out);
+
+	/* unchanged file, no signals */
+	ZUC_ASSERTG_EQ(0, weston_config_reload(config), out);
+
+	ZUC_ASSERTG_EQ(0, rewrite_file(file,
+		"[keyboard]\nrepeat-rate=40\n"
+		"[output]\nname=A\nscale=2\n"
+		"[shell]\nlocking=false\n"), out);
+
+	ZUC_ASSERTG_EQ(3, weston_config_reload(config), out);
+	ZUC_ASSERTG_EQ(1, rd.added, out);
+	ZUC_ASSERTG_EQ(1, rd.changed, out);
+	ZUC_ASSERTG_EQ(1, rd.removed, out);
+	ZUC_ASSERTG_EQ(out1, rd.last_changed, out);
+
+	/* surviving sections keep their identity and see the new values */
+	ZUC_ASSERTG_EQ(out1, weston_config_get_section(config, "output",
+						       "name", "A"), out);
+	ZUC_ASSERTG_EQ(kbd, weston_config_get_section(config, "keyboard",
+						      NULL, NULL), out);
+	weston_config_section_get_int(out1, "scale", &n, 0);
+	ZUC_ASSERTG_EQ(2, n, out);
+
+	/* removed sections are empty but still safe to query */
+	ZUC_ASSERTG_NULL(weston_config_get_section(config, "output",
+						   "name", "B"), out);
+	ZUC_ASSERTG_EQ(-1, weston_config_section_get_int(out2, "scale",
+							 &n, 7), out);
+	ZUC_ASSERTG_EQ(7, n, out);
+
+	/* a broken file leaves the config untouched */
+	ZUC_ASSERTG_EQ(0, rewrite_file(file, "[broken\n"), out);
+	ZUC_ASSERTG_EQ(-1, weston_config_reload(config), out);
+	ZUC_ASSERTG_NOT_NULL(weston_config_get_section(config, "shell",
+						       NULL, NULL), out);
+	weston_config_section_get_int(out1, "scale", &n, 0);
+	ZUC_ASSERTG_EQ(2, n, out);
+	weston_config_section_get_int(kbd, "repeat-rate", &n, 0);
+	ZUC_ASSERTG_EQ(40, n, out);
+
+	/* repeated reloads replace the string pool, values stay readable */
+	ZUC_ASSERTG_EQ(0, rewrite_file(file,
+		"[keyboard]\nrepeat-rate=25\n"
+		"[output]\nname=A\nscale=2\n"), out);
+	ZUC_ASSERTG_EQ(2, weston_config_reload(config), out);
+	ZUC_ASSERTG_EQ(0, weston_config_reload(config), out);
+	weston_config_section_get_int(kbd, "repeat-rate", &n, 0);
+	ZUC_ASSERTG_EQ(25, n, out);
+	ZUC_ASSERTG_EQ(out1, weston_config_get_section(config, "output",
+						       "name", "A"), out);
+
+out:
+	weston_config_destroy(config);
+	unlink(file);
+}
@@ -197,6 +197,45 @@ TEST(remove_from_array)
         weston_drm_format_array_fini(&format_array_C);
 }
 
+TEST(remove_from_array_unordered)
+{
+        struct weston_drm_format_array format_array_A, format_array_B;
+        uint32_t formats_A[] = {9, 3, 7, 1, 5};
+        uint32_t formats_B[] = {9, 7, 1, 5};
+        uint64_t modifiers[] = {15, 11, 14, 12, 13};
+        struct weston_drm_format *fmt;
+        const uint64_t *mods;
+        unsigned int num_mods, i, j;
+
+        weston_drm_format_array_init(&format_array_A);
+        weston_drm_format_array_init(&format_array_B);
+
+        /* Formats are not added in order, so the latest added format is
+         * not necessarily the last one in the array. */
+        ADD_FORMATS_AND_MODS(&format_array_A, formats_A, modifiers);
+        ADD_FORMATS_AND_MODS(&format_array_A, (uint32_t[]){4}, modifiers);
+        weston_drm_format_array_remove_latest_format(&format_array_A);
+        ADD_FORMATS_AND_MODS(&format_array_B, formats_B, modifiers);
+        ADD_FORMATS_AND_MODS(&format_array_B, (uint32_t[]){3}, modifiers);
+        assert(weston_drm_format_array_equal(&format_array_A, &format_array_B));
+
+        assert(!weston_drm_format_array_find_format(&format_array_A, 4));
+        for (i = 0; i < ARRAY_LENGTH(formats_A); i++) {
+                fmt = weston_drm_format_array_find_format(&format_array_A,
+                                                          formats_A[i]);
+                assert(fmt && fmt->format == formats_A[i]);
+                assert(!weston_drm_format_has_modifier(fmt, 16));
+
+                mods = weston_drm_format_get_modifiers(fmt, &num_mods);
+                assert(num_mods == ARRAY_LENGTH(modifiers));
+                for (j = 0; j < ARRAY_LENGTH(modifiers); j++)
+                        assert(weston_drm_format_has_modifier(fmt, mods[j]));
+        }
+
+        weston_drm_format_array_fini(&format_array_A);
+        weston_drm_format_array_fini(&format_array_B);
+}
+
 TEST(join_arrays)
 {
         struct weston_drm_format_array format_array_A, format_array_B;
@@ -0,0 +1,119 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.width = 400;
+	setup.height = 200;
+
+	/* Long enough that a repaint always comes before the timer */
+	weston_ini_setup(&setup,
+			 cfgln("[core]"),
+			 cfgln("occluded-frame-rate=1"));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static void
+set_opaque(struct client *client)
+{
+	struct surface *surface = client->surface;
+	struct wl_region *region;
+	int done;
+
+	region = wl_compositor_create_region(client->wl_compositor);
+	wl_region_add(region, 0, 0, surface->width, surface->height);
+	wl_surface_set_opaque_region(surface->wl_surface, region);
+	wl_region_destroy(region);
+
+	frame_callback_set(surface->wl_surface, &done);
+	wl_surface_commit(surface->wl_surface);
+	frame_callback_wait(client, &done);
+}
+
+/* Damage and commit, asking for a frame callback */
+static void
+commit_frame(struct client *client, int *done)
+{
+	struct surface *surface = client->surface;
+
+	wl_surface_damage(surface->wl_surface, 0, 0,
+			  surface->width, surface->height);
+	frame_callback_set(surface->wl_surface, done);
+	wl_surface_commit(surface->wl_surface);
+	client_roundtrip(client);
+}
+
+TEST(occluded_surface_is_throttled)
+{
+	struct client *below, *above;
+	int below_done;
+	int above_done;
+	int i;
+
+	below = create_client_and_test_surface(0, 0, 100, 100);
+	above = create_client_and_test_surface(0, 0, 200, 200);
+	set_opaque(above);
+
+	/* Covered: repaints go by without answering the frame callback */
+	commit_frame(below, &below_done);
+	for (i = 0; i < 3; i++) {
+		commit_frame(above, &above_done);
+		frame_callback_wait(above, &above_done);
+	}
+	client_roundtrip(below);
+	assert(!below_done);
+
+	/* The throttle timer answers it eventually */
+	frame_callback_wait(below, &below_done);
+
+	/* Uncovered: the repaint that shows it answers it */
+	commit_frame(below, &below_done);
+	move_client(above, 200, 0);
+	client_roundtrip(below);
+	assert(below_done);
+
+	/* Visible surfaces get a frame callback on every repaint */
+	for (i = 0; i < 3; i++) {
+		commit_frame(below, &below_done);
+		frame_callback_wait(below, &below_done);
+	}
+
+	client_destroy(above);
+	client_destroy(below);
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "fullscreen-shell-unstable-v1-client-protocol.h"
+#include "weston-debug-client-protocol.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = RENDERER_PIXMAN;
+	setup.shell = SHELL_FULLSCREEN;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+struct scene_graph {
+	bool done;
+};
+
+static void
+stream_complete(void *data, struct weston_debug_stream_v1 *stream)
+{
+	struct scene_graph *sg = data;
+
+	sg->done = true;
+}
+
+static void
+stream_failure(void *data, struct weston_debug_stream_v1 *stream,
+	       const char *msg)
+{
+	testlog("scene-graph stream failed: %s\n", msg ? msg : "");
+	abort();
+}
+
+static const struct weston_debug_stream_v1_listener stream_listener = {
+	stream_complete,
+	stream_failure
+};
+
+/* How many black backdrops the shell has in the scene graph */
+static int
+count_black_views(struct client *client, struct weston_debug_v1 *debug)
+{
+	static const char label[] = "fullscreen black background";
+	struct weston_debug_stream_v1 *stream;
+	struct scene_graph sg = { false };
+	char buf[65536];
+	size_t len = 0;
+	ssize_t ret;
+	const char *p;
+	int fds[2];
+	int count = 0;
+
+	assert(pipe(fds) == 0);
+
+	stream = weston_debug_v1_subscribe(debug, "scene-graph", fds[1]);
+	weston_debug_stream_v1_add_listener(stream, &stream_listener, &sg);
+	close(fds[1]);
+
+	while (!sg.done)
+		assert(wl_display_dispatch(client->wl_display) >= 0);
+	weston_debug_stream_v1_destroy(stream);
+	client_roundtrip(client);
+
+	/* The compositor closed its end once complete */
+	while ((ret = read(fds[0], buf + len, sizeof buf - 1 - len)) > 0)
+		len += ret;
+	assert(ret == 0);
+	close(fds[0]);
+	buf[len] = '\0';
+
+	for (p = strstr(buf, label); p; p = strstr(p + 1, label))
+		count++;
+
+	return count;
+}
+
+static void
+present(struct client *client, struct buffer *buffer, bool opaque)
+{
+	struct wl_surface *surface = client->surface->wl_surface;
+	struct wl_region *region;
+	int width = pixman_image_get_width(buffer->image);
+	int height = pixman_image_get_height(buffer->image);
+	int done;
+
+	region = wl_compositor_create_region(client->wl_compositor);
+	if (opaque)
+		wl_region_add(region, 0, 0, width, height);
+	wl_surface_set_opaque_region(surface, region);
+	wl_region_destroy(region);
+
+	wl_surface_attach(surface, buffer->proxy, 0, 0);
+	wl_surface_damage(surface, 0, 0, width, height);
+	frame_callback_set(surface, &done);
+	wl_surface_commit(surface);
+	frame_callback_wait(client, &done);
+}
+
+/*
+ * The black backdrop only stays in the layer while the presented surface
+ * leaves part of the output uncovered, or could be seen through.
+ */
+TEST(black_view_follows_coverage)
+{
+	struct client *client;
+	struct zwp_fullscreen_shell_v1 *shell;
+	struct weston_debug_v1 *debug;
+	struct buffer *full, *small;
+	struct output *output;
+
+	client = create_client();
+	output = client->output;
+	shell = bind_to_singleton_global(client,
+					 &zwp_fullscreen_shell_v1_interface, 1);
+	debug = bind_to_singleton_global(client, &weston_debug_v1_interface, 1);
+
+	client->surface = create_test_surface(client);
+	full = create_shm_buffer_a8r8g8b8(client, output->width,
+					  output->height);
+	small = create_shm_buffer_a8r8g8b8(client, output->width / 2,
+					   output->height / 2);
+
+	zwp_fullscreen_shell_v1_present_surface(shell,
+			client->surface->wl_surface,
+			ZWP_FULLSCREEN_SHELL_V1_PRESENT_METHOD_CENTER, NULL);
+
+	present(client, full, true);
+	assert(count_black_views(client, debug) == 0);
+
+	present(client, small, true);
+	assert(count_black_views(client, debug) == 1);
+
+	present(client, full, true);
+	assert(count_black_views(client, debug) == 0);
+
+	/* Covering the output, but not opaque */
+	present(client, full, false);
+	assert(count_black_views(client, debug) == 1);
+
+	buffer_destroy(full);
+	buffer_destroy(small);
+	weston_debug_v1_destroy(debug);
+	zwp_fullscreen_shell_v1_release(shell);
+	client_destroy(client);
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <libweston/matrix.h>
+
+#include "zunitc/zunitc.h"
+
+/* Checks the type-specialized matrix paths against the plain 4x4
+ * algorithms they replace.
+ */
+
+#define ITERATIONS 2000
+
+static void
+ref_multiply(struct weston_matrix *m, const struct weston_matrix *n)
+{
+	struct weston_matrix tmp;
+	const float *row, *column;
+	div_t d;
+	int i, j;
+
+	for (i = 0; i < 16; i++) {
+		tmp.d[i] = 0;
+		d = div(i, 4);
+		row = m->d + d.quot * 4;
+		column = n->d + d.rem;
+		for (j = 0; j < 4; j++)
+			tmp.d[i] += row[j] * column[j * 4];
+	}
+	tmp.type = m->type | n->type;
+	*m = tmp;
+}
+
+static void
+ref_transform(const struct weston_matrix *matrix, struct weston_vector *v)
+{
+	struct weston_vector t;
+	int i, j;
+
+	for (i = 0; i < 4; i++) {
+		t.f[i] = 0;
+		for (j = 0; j < 4; j++)
+			t.f[i] += v->f[j] * matrix->d[i + j * 4];
+	}
+
+	*v = t;
+}
+
+static int
+ref_invert(struct weston_matrix *inverse, const struct weston_matrix *matrix)
+{
+	double LU[16];
+	unsigned perm[4];
+	unsigned c;
+
+	if (matrix_invert(LU, perm, matrix) < 0)
+		return -1;
+
+	weston_matrix_init(inverse);
+	for (c = 0; c < 4; ++c)
+		inverse_transform(LU, perm, &inverse->d[c * 4]);
+	inverse->type = matrix->type;
+
+	return 0;
+}
+
+static float
+frand(float range)
+{
+	return ((float)random() / RAND_MAX * 2.0f - 1.0f) * range;
+}
+
+static float
+nonzero_frand(float range)
+{
+	float f = frand(range);
+
+	return fabsf(f) < 0.1f ? 0.5f : f;
+}
+
+/* kind: 0 identity, 1 axis-aligned, 2 affine, 3 full */
+static void
+random_typed_matrix(struct weston_matrix *m, int kind)
+{
+	float angle;
+	int i;
+
+	weston_matrix_init(m);
+
+	if (kind >= 1) {
+		weston_matrix_scale(m, nonzero_frand(4.0f),
+				    nonzero_frand(4.0f), 1.0f);
+		weston_matrix_translate(m, frand(2000.0f), frand(2000.0f),
+					frand(1.0f));
+	}
+
+	if (kind >= 2) {
+		angle = frand(3.14f);
+		weston_matrix_rotate_xy(m, cosf(angle), sinf(angle));
+		weston_matrix_translate(m, frand(100.0f), frand(100.0f), 0.0f);
+	}
+
+	if (kind >= 3) {
+		for (i = 0; i < 16; i++)
+			m->d[i] += frand(1.0f);
+		m->type |= WESTON_MATRIX_TRANSFORM_OTHER;
+	}
+}
+
+static float
+max_rel_error(const float *a, const float *b, int n)
+{
+	float err = 0.0f, e;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		e = fabsf(a[i] - b[i]) / fmaxf(1.0f, fabsf(b[i]));
+		if (e > err)
+			err = e;
+	}
+
+	return err;
+}
+
+ZUC_TEST(matrix_fast_path, multiply)
+{
+	struct weston_matrix m, n, ref;
+	int i, a, b;
+
+	srandom(1);
+	for (i = 0; i < ITERATIONS; i++) {
+		for (a = 0; a < 4; a++) {
+			for (b = 0; b < 4; b++) {
+				random_typed_matrix(&m, a);
+				random_typed_matrix(&n, b);
+				ref = m;
+
+				weston_matrix_multiply(&m, &n);
+				ref_multiply(&ref, &n);
+
+				ZUC_ASSERT_EQ(ref.type, m.type);
+				ZUC_ASSERT_TRUE(max_rel_error(m.d, ref.d, 16) <
+						1e-5f);
+			}
+		}
+	}
+}
+
+ZUC_TEST(matrix_fast_path, transform)
+{
+	struct weston_matrix m;
+	struct weston_vector v, ref;
+	int i, kind, j;
+
+	srandom(2);
+	for (i = 0; i < ITERATIONS; i++) {
+		for (kind = 0; kind < 4; kind++) {
+			random_typed_matrix(&m, kind);
+			for (j = 0; j < 3; j++)
+				v.f[j] = frand(4000.0f);
+			v.f[3] = (i & 1) ? 1.0f : 0.0f;
+			ref = v;
+
+			weston_matrix_transform(&m, &v);
+			ref_transform(&m, &ref);
+
+			ZUC_ASSERT_TRUE(max_rel_error(v.f, ref.f, 4) < 1e-5f);
+		}
+	}
+}
+
+ZUC_TEST(matrix_fast_path, invert)
+{
+	struct weston_matrix m, inv, ref;
+	int i, kind;
+
+	srandom(3);
+	for (i = 0; i < ITERATIONS; i++) {
+		for (kind = 0; kind < 4; kind++) {
+			random_typed_matrix(&m, kind);
+
+			ZUC_ASSERT_EQ(ref_invert(&ref, &m),
+				      weston_matrix_invert(&inv, &m));
+			ZUC_ASSERT_EQ(m.type, inv.type);
+			ZUC_ASSERT_TRUE(max_rel_error(inv.d, ref.d, 16) < 1e-5f);
+		}
+	}
+}
+
+ZUC_TEST(matrix_fast_path, invert_in_place)
+{
+	struct weston_matrix m, inv;
+	int kind;
+
+	for (kind = 0; kind < 4; kind++) {
+		random_typed_matrix(&m, kind);
+		if (weston_matrix_invert(&inv, &m) < 0)
+			continue;
+
+		ZUC_ASSERT_EQ(0, weston_matrix_invert(&m, &m));
+		ZUC_ASSERT_TRUE(max_rel_error(m.d, inv.d, 16) < 1e-6f);
+	}
+}
+
+ZUC_TEST(matrix_fast_path, invert_singular)
+{
+	struct weston_matrix m, inv;
+
+	weston_matrix_init(&m);
+	weston_matrix_scale(&m, 0.0f, 1.0f, 1.0f);
+	ZUC_ASSERT_EQ(-1, weston_matrix_invert(&inv, &m));
+
+	weston_matrix_init(&m);
+	weston_matrix_rotate_xy(&m, 0.0f, 1.0f);
+	weston_matrix_scale(&m, 1.0f, 0.0f, 1.0f);
+	ZUC_ASSERT_EQ(-1, weston_matrix_invert(&inv, &m));
+}
@@ -182,6 +182,7 @@ randomize_matrix(struct weston_matrix *m)
 #else
 		m->d[i] = frand();
 #endif
+	m->type = WESTON_MATRIX_TRANSFORM_OTHER;
 }
 
 /* Take a matrix, compute inverse, multiply together
@@ -371,6 +372,88 @@ test_loop_speed_invert_explicit(void)
 	       count, t, 1e9 * t / count);
 }
 
+static const char *matrix_type_names[] = {
+	"identity", "axis-aligned", "affine", "full"
+};
+
+static void
+make_typed_matrix(struct weston_matrix *m, int kind)
+{
+	weston_matrix_init(m);
+
+	switch (kind) {
+	case 0:
+		break;
+	case 1:
+		weston_matrix_scale(m, 1.5f, 0.75f, 1.0f);
+		weston_matrix_translate(m, 100.0f, -20.0f, 0.0f);
+		break;
+	case 2:
+		weston_matrix_scale(m, 1.5f, 0.75f, 1.0f);
+		weston_matrix_rotate_xy(m, cosf(0.3f), sinf(0.3f));
+		weston_matrix_translate(m, 100.0f, -20.0f, 0.0f);
+		break;
+	default:
+		randomize_matrix(m);
+		break;
+	}
+}
+
+static void __attribute__((noinline))
+test_loop_speed_typed(void)
+{
+	struct weston_matrix m, n, inv;
+	struct weston_vector v = { { 0.5, 0.5, 0.5, 1.0 } };
+	unsigned long count;
+	double t;
+	int kind;
+
+	for (kind = 0; kind < 4; kind++) {
+		make_typed_matrix(&n, kind);
+
+		printf("\nRunning 1 s tests on %s matrices...\n",
+		       matrix_type_names[kind]);
+
+		count = 0;
+		running = 1;
+		alarm(1);
+		reset_timer();
+		while (running) {
+			m = n;
+			weston_matrix_multiply(&m, &n);
+			count++;
+		}
+		t = read_timer();
+		printf("  weston_matrix_multiply(): avg. %.1f ns/iter.\n",
+		       1e9 * t / count);
+
+		count = 0;
+		running = 1;
+		alarm(1);
+		reset_timer();
+		while (running) {
+			weston_matrix_transform(&n, &v);
+			v.f[3] = 1.0f;
+			count++;
+		}
+		t = read_timer();
+		printf("  weston_matrix_transform(): avg. %.1f ns/iter.\n",
+		       1e9 * t / count);
+
+		count = 0;
+		running = 1;
+		alarm(1);
+		reset_timer();
+		while (running) {
+			weston_matrix_invert(&inv, &n);
+			count++;
+		}
+		t = read_timer();
+		printf("  weston_matrix_invert(): avg. %.1f ns/iter.\n",
+		       1e9 * t / count);
+	}
+}
+
 int main(void)
 {
 	struct sigaction ding;
@@ -391,6 +474,7 @@ int main(void)
 	M.d[1] = 2.0;	M.d[5] = 4.0;	M.d[9] = -2.0;	M.d[13] = 0.0;
 	M.d[2] = 6.0;	M.d[6] = 18.0;	M.d[10] = -12;	M.d[14] = 0.0;
 	M.d[3] = 0.0;	M.d[7] = 0.0;	M.d[11] = 0.0;	M.d[15] = 1.0;
+	M.type = WESTON_MATRIX_TRANSFORM_OTHER;
 
 	ret = matrix_invert(Q.LU, Q.perm, &M);
 	printf("ret = %d\n", ret);
@@ -419,6 +503,7 @@ int main(void)
 	test_loop_speed_inversetransform();
 	test_loop_speed_invert();
 	test_loop_speed_invert_explicit();
+	test_loop_speed_typed();
 
 	return 0;
 }
@@ -0,0 +1,107 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+
+	weston_ini_setup(&setup,
+			 cfgln("[core]"),
+			 cfgln("client-memory-limit=1"));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* Attach, damage and commit, waiting for the repaint */
+static void
+attach_buffer(struct client *client, struct buffer *buffer)
+{
+	struct wl_surface *surface = client->surface->wl_surface;
+	int done;
+
+	wl_surface_attach(surface, buffer->proxy, 0, 0);
+	wl_surface_damage(surface, 0, 0, 64, 64);
+	frame_callback_set(surface, &done);
+	wl_surface_commit(surface);
+	frame_callback_wait(client, &done);
+}
+
+TEST(destroyed_buffers_are_uncharged)
+{
+	struct client *client;
+	struct buffer *prev, *next;
+	int i;
+
+	client = create_client_and_test_surface(0, 0, 64, 64);
+
+	/* 448 KiB each: two alive at a time fit in 1 MiB, three do not */
+	prev = create_shm_buffer_a8r8g8b8(client, 448, 256);
+	attach_buffer(client, prev);
+	for (i = 0; i < 4; i++) {
+		next = create_shm_buffer_a8r8g8b8(client, 448, 256);
+		attach_buffer(client, next);
+		buffer_destroy(prev);
+		prev = next;
+	}
+	client_roundtrip(client);
+	assert(wl_display_get_error(client->wl_display) == 0);
+
+	buffer_destroy(prev);
+	client_destroy(client);
+}
+
+TEST(buffer_over_client_limit_is_refused)
+{
+	struct client *client;
+	struct buffer *buffer;
+	struct wl_surface *surface;
+
+	client = create_client_and_test_surface(0, 0, 64, 64);
+	surface = client->surface->wl_surface;
+
+	/* 2 MiB, over the limit on its own */
+	buffer = create_shm_buffer_a8r8g8b8(client, 1024, 512);
+	wl_surface_attach(surface, buffer->proxy, 0, 0);
+	wl_surface_damage(surface, 0, 0, 64, 64);
+	wl_surface_commit(surface);
+
+	expect_protocol_error(client, &wl_display_interface,
+			      WL_DISPLAY_ERROR_NO_MEMORY);
+
+	buffer_destroy(buffer);
+	client_destroy(client);
+}
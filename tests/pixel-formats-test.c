@@ -0,0 +1,128 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <string.h>
+#include <wayland-client-protocol.h>
+
+#include "pixel-formats.h"
+#include "shared/weston-drm-fourcc.h"
+
+#include "weston-test-runner.h"
+
+/* Every table entry must be found by each of its keys, and the lookups
+ * must agree with a linear scan of the table. */
+TEST(lookup_every_format)
+{
+	const struct pixel_format_info *info, *other;
+	unsigned int i, j;
+	char lower[64];
+
+	for (i = 0; i < pixel_format_get_info_count(); i++) {
+		info = pixel_format_get_info_by_index(i);
+
+		assert(pixel_format_get_info(info->format) == info);
+		assert(pixel_format_get_info_by_drm_name(info->drm_format_name) == info);
+
+		assert(strlen(info->drm_format_name) < sizeof lower);
+		for (j = 0; info->drm_format_name[j]; j++)
+			lower[j] = info->drm_format_name[j] | 0x20;
+		lower[j] = '\0';
+		assert(pixel_format_get_info_by_drm_name(lower) == info);
+
+		if (info->opaque_substitute) {
+			other = pixel_format_get_opaque_substitute(info);
+			assert(other);
+			assert(other->format == info->opaque_substitute);
+
+			other = pixel_format_get_info_by_opaque_substitute(info->opaque_substitute);
+			assert(other);
+			assert(other->opaque_substitute == info->opaque_substitute);
+			for (j = 0; j < i; j++)
+				assert(pixel_format_get_info_by_index(j)->opaque_substitute !=
+				       info->opaque_substitute ||
+				       pixel_format_get_info_by_index(j) == other);
+		} else {
+			assert(pixel_format_get_opaque_substitute(info) == info);
+		}
+	}
+}
+
+TEST(lookup_unknown_format)
+{
+	assert(!pixel_format_get_info(0));
+	assert(!pixel_format_get_info(DRM_FORMAT_C8));
+	assert(!pixel_format_get_info_by_drm_name(""));
+	assert(!pixel_format_get_info_by_drm_name("XRGB888"));
+	assert(!pixel_format_get_info_by_drm_name("XRGB88888"));
+	assert(!pixel_format_get_info_by_opaque_substitute(DRM_FORMAT_ARGB8888));
+}
+
+TEST(lookup_shm_format)
+{
+	assert(pixel_format_get_info_shm(WL_SHM_FORMAT_ARGB8888) ==
+	       pixel_format_get_info(DRM_FORMAT_ARGB8888));
+	assert(pixel_format_get_info_shm(WL_SHM_FORMAT_XRGB8888) ==
+	       pixel_format_get_info(DRM_FORMAT_XRGB8888));
+	assert(pixel_format_get_info_shm(WL_SHM_FORMAT_RGB565) ==
+	       pixel_format_get_info(DRM_FORMAT_RGB565));
+}
+
+TEST(format_caps)
+{
+	const struct pixel_format_info *info;
+	uint32_t caps;
+	unsigned int i;
+
+	for (i = 0; i < pixel_format_get_info_count(); i++) {
+		info = pixel_format_get_info_by_index(i);
+		caps = pixel_format_get_caps(info);
+
+		assert(!!(caps & PIXEL_FORMAT_CAP_OPAQUE) ==
+		       pixel_format_is_opaque(info));
+		assert(!!(caps & PIXEL_FORMAT_CAP_HAS_OPAQUE_SUBSTITUTE) ==
+		       !pixel_format_is_opaque(info));
+		assert(!!(caps & PIXEL_FORMAT_CAP_MULTI_PLANAR) ==
+		       (pixel_format_get_plane_count(info) > 1));
+	}
+
+	caps = pixel_format_get_caps(pixel_format_get_info(DRM_FORMAT_ARGB8888));
+	assert(caps == PIXEL_FORMAT_CAP_HAS_OPAQUE_SUBSTITUTE);
+
+	caps = pixel_format_get_caps(pixel_format_get_info(DRM_FORMAT_NV12));
+	assert(caps == (PIXEL_FORMAT_CAP_OPAQUE | PIXEL_FORMAT_CAP_YUV |
+			PIXEL_FORMAT_CAP_MULTI_PLANAR |
+			PIXEL_FORMAT_CAP_SUBSAMPLED));
+
+	caps = pixel_format_get_caps(pixel_format_get_info(DRM_FORMAT_YUYV));
+	assert(caps == (PIXEL_FORMAT_CAP_OPAQUE | PIXEL_FORMAT_CAP_YUV |
+			PIXEL_FORMAT_CAP_SUBSAMPLED));
+
+	caps = pixel_format_get_caps(pixel_format_get_info(DRM_FORMAT_YUV444));
+	assert(caps == (PIXEL_FORMAT_CAP_OPAQUE | PIXEL_FORMAT_CAP_YUV |
+			PIXEL_FORMAT_CAP_MULTI_PLANAR));
+}
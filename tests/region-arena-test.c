@@ -0,0 +1,192 @@
+/*
+ * Copyright © 2026 Hubble contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include "weston-test-runner.h"
+
+#include "region-arena.h"
+
+/* Two disjoint rectangles, so the region needs heap storage */
+static void
+two_rects(pixman_region32_t *region, int x)
+{
+	pixman_region32_t rect;
+
+	pixman_region32_init_rect(region, x, 0, 10, 10);
+	pixman_region32_init_rect(&rect, x + 20, 0, 10, 10);
+	pixman_region32_union(region, region, &rect);
+	pixman_region32_fini(&rect);
+}
+
+TEST(region_arena_reuses_slots)
+{
+	struct weston_region_arena arena;
+	pixman_region32_t *first, *second;
+	int i;
+
+	weston_region_arena_init(&arena);
+
+	for (i = 0; i < 4; i++) {
+		first = weston_region_arena_get(&arena);
+		second = weston_region_arena_get(&arena);
+		assert(first != second);
+		assert(!pixman_region32_not_empty(first));
+		assert(!pixman_region32_not_empty(second));
+		weston_region_arena_reset(&arena);
+	}
+
+	/* Only the first frame allocates slots */
+	assert(arena.slots.size == 2 * sizeof(pixman_region32_t *));
+	assert(arena.allocations == 2);
+	assert(arena.frames == 4);
+	assert(arena.last_frame_allocations == 0);
+
+	weston_region_arena_fini(&arena);
+}
+
+TEST(region_arena_get_or_init_prefers_slots)
+{
+	struct weston_region_arena arena;
+	pixman_region32_t fallback;
+	pixman_region32_t *region, *slot;
+
+	weston_region_arena_init(&arena);
+
+	region = weston_region_arena_get_or_init(&arena, &fallback);
+	assert(region != &fallback);
+	slot = region;
+	two_rects(&fallback, 0);
+	weston_region_arena_copy(&arena, region, &fallback);
+	pixman_region32_fini(&fallback);
+
+	/* Releasing a slot leaves it to the arena, emptied at the reset */
+	weston_region_arena_release(region, &fallback);
+	assert(pixman_region32_n_rects(slot) == 2);
+	weston_region_arena_reset(&arena);
+
+	region = weston_region_arena_get_or_init(&arena, &fallback);
+	assert(region == slot);
+	assert(!pixman_region32_not_empty(region));
+	weston_region_arena_release(region, &fallback);
+
+	weston_region_arena_fini(&arena);
+}
+
+TEST(region_arena_keeps_storage)
+{
+	struct weston_region_arena arena;
+	pixman_region32_t a, b;
+	pixman_region32_t *dst;
+	pixman_region32_data_t *storage;
+	uint64_t allocations;
+	int i;
+
+	weston_region_arena_init(&arena);
+	two_rects(&a, 0);
+	two_rects(&b, 100);
+
+	dst = weston_region_arena_get(&arena);
+	weston_region_arena_union(&arena, dst, &a, &b);
+	assert(pixman_region32_n_rects(dst) == 4);
+	storage = dst->data;
+	weston_region_arena_reset(&arena);
+	allocations = arena.allocations;
+
+	/* The same shape in later frames lands in the same storage */
+	for (i = 0; i < 3; i++) {
+		dst = weston_region_arena_get(&arena);
+		assert(!pixman_region32_not_empty(dst));
+		weston_region_arena_copy(&arena, dst, &a);
+		assert(pixman_region32_n_rects(dst) == 2);
+		assert(dst->data == storage);
+		weston_region_arena_reset(&arena);
+	}
+	assert(arena.allocations == allocations);
+	assert(arena.last_frame_allocations == 0);
+
+	pixman_region32_fini(&a);
+	pixman_region32_fini(&b);
+	weston_region_arena_fini(&arena);
+}
+
+TEST(region_arena_ops)
+{
+	struct weston_region_arena arena;
+	pixman_region32_t a, b;
+	pixman_region32_t *dst;
+	pixman_box32_t *box;
+	int n;
+
+	weston_region_arena_init(&arena);
+	pixman_region32_init_rect(&a, 0, 0, 20, 20);
+	pixman_region32_init_rect(&b, 10, 10, 20, 20);
+
+	dst = weston_region_arena_get(&arena);
+	weston_region_arena_intersect(&arena, dst, &a, &b);
+	box = pixman_region32_rectangles(dst, &n);
+	assert(n == 1);
+	assert(box->x1 == 10 && box->y1 == 10);
+	assert(box->x2 == 20 && box->y2 == 20);
+
+	dst = weston_region_arena_get(&arena);
+	weston_region_arena_subtract(&arena, dst, &a, &b);
+	assert(pixman_region32_n_rects(dst) == 2);
+	assert(!pixman_region32_contains_point(dst, 15, 15, NULL));
+	assert(pixman_region32_contains_point(dst, 5, 15, NULL));
+
+	weston_region_swap(&a, dst);
+	assert(pixman_region32_n_rects(&a) == 2);
+	assert(pixman_region32_n_rects(dst) == 1);
+
+	weston_region_arena_reset(&arena);
+	pixman_region32_fini(&a);
+	pixman_region32_fini(&b);
+	weston_region_arena_fini(&arena);
+}
+
+TEST(region_empty_keeps_storage)
+{
+	pixman_region32_t damage, other;
+	pixman_region32_data_t *storage;
+
+	two_rects(&damage, 0);
+	two_rects(&other, 100);
+	storage = damage.data;
+
+	weston_region_empty(&damage);
+	assert(!pixman_region32_not_empty(&damage));
+	assert(damage.data == storage);
+
+	/* A union into the emptied region copies into the kept storage */
+	pixman_region32_union(&damage, &damage, &other);
+	assert(pixman_region32_n_rects(&damage) == 2);
+	assert(damage.data == storage);
+
+	pixman_region32_fini(&damage);
+	pixman_region32_fini(&other);
+}
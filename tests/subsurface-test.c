@@ -27,7 +27,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
+#include "shared/timespec-util.h"
 #include "weston-test-client-helper.h"
 #include "weston-test-fixture-compositor.h"
 
@@ -124,6 +126,9 @@ TEST(test_subsurface_basic_protocol)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com1, client);
 	populate_compound_surface(&com2, client);
@@ -143,6 +148,9 @@ TEST(test_subsurface_position_protocol)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 	for (i = 0; i < NUM_SUBSURFACES; i++)
@@ -162,6 +170,9 @@ TEST(test_subsurface_placement_protocol)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -185,6 +196,9 @@ TEST(test_subsurface_paradox)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	subco = get_subcompositor(client);
 	parent = wl_compositor_create_surface(client->wl_compositor);
@@ -209,6 +223,9 @@ TEST(test_subsurface_identical_link)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -232,6 +249,9 @@ TEST(test_subsurface_change_link)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	stranger = wl_compositor_create_surface(client->wl_compositor);
 	populate_compound_surface(&com, client);
@@ -257,6 +277,9 @@ TEST(test_subsurface_nesting)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	stranger = wl_compositor_create_surface(client->wl_compositor);
 	populate_compound_surface(&com, client);
@@ -281,6 +304,9 @@ TEST(test_subsurface_nesting_parent)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	stranger = wl_compositor_create_surface(client->wl_compositor);
 	populate_compound_surface(&com, client);
@@ -306,6 +332,9 @@ TEST(test_subsurface_loop_paradox)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	subco = get_subcompositor(client);
 	surface[0] = wl_compositor_create_surface(client->wl_compositor);
@@ -339,6 +368,9 @@ TEST(test_subsurface_place_above_nested_parent)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -367,6 +399,9 @@ TEST(test_subsurface_place_above_grandparent)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -397,6 +432,9 @@ TEST(test_subsurface_place_above_great_aunt)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -427,6 +465,9 @@ TEST(test_subsurface_place_above_child)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -457,6 +498,9 @@ TEST(test_subsurface_place_below_nested_parent)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -485,6 +529,9 @@ TEST(test_subsurface_place_below_grandparent)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -515,6 +562,9 @@ TEST(test_subsurface_place_below_great_aunt)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -545,6 +595,9 @@ TEST(test_subsurface_place_below_child)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -573,6 +626,9 @@ TEST(test_subsurface_place_above_stranger)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	stranger = wl_compositor_create_surface(client->wl_compositor);
 	populate_compound_surface(&com, client);
@@ -596,6 +652,9 @@ TEST(test_subsurface_place_below_stranger)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	stranger = wl_compositor_create_surface(client->wl_compositor);
 	populate_compound_surface(&com, client);
@@ -619,6 +678,9 @@ TEST(test_subsurface_place_above_foreign)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com1, client);
 	populate_compound_surface(&com2, client);
@@ -642,6 +704,9 @@ TEST(test_subsurface_place_below_foreign)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com1, client);
 	populate_compound_surface(&com2, client);
@@ -664,6 +729,9 @@ TEST(test_subsurface_destroy_protocol)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	populate_compound_surface(&com, client);
 
@@ -878,6 +946,9 @@ TEST(test_subsurface_destroy_permutations)
 
 	client = create_client_and_test_surface(100, 50, 123, 77);
 	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
 
 	permu_init(&per, test_size * 2 - 1);
 	while (permu_next(&per) != -1) {
@@ -910,3 +981,112 @@ TEST(test_subsurface_destroy_permutations)
 
 	client_destroy(client);
 }
+
+#define DEEP_TREE_DEPTH 16
+#define DEEP_TREE_FRAMES 200
+
+static void
+deep_tree_move_pointer(struct client *client, int x, int y)
+{
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, x, y);
+	client_roundtrip(client);
+}
+
+/*
+ * A chain of synchronized sub-surfaces, each the parent of the next, as
+ * in e.g. a video player. Every frame commits the whole chain from the
+ * bottom up, and only the root commit applies the cached state. Opaque
+ * and input regions are set once, as clients normally do, and must still
+ * be in effect after all the frames, and follow a later change.
+ */
+TEST(test_subsurface_deep_tree_benchmark)
+{
+	struct client *client;
+	struct wl_subcompositor *subco;
+	struct wl_surface *surf[DEEP_TREE_DEPTH];
+	struct wl_subsurface *sub[DEEP_TREE_DEPTH];
+	/* only compared as pointer focus, see pointer_handle_enter() */
+	struct surface marker[DEEP_TREE_DEPTH];
+	struct pointer *pointer;
+	struct wl_surface *parent;
+	struct wl_region *region;
+	struct buffer *buf;
+	struct timespec begin, end;
+	int frame;
+	int i;
+
+	client = create_client_and_test_surface(100, 50, 123, 77);
+	assert(client);
+	pointer = client->input->pointer;
+	assert(pointer);
+	deep_tree_move_pointer(client, 2, 30);
+
+	subco = get_subcompositor(client);
+	buf = create_shm_buffer_a8r8g8b8(client, 16, 16);
+
+	region = wl_compositor_create_region(client->wl_compositor);
+	wl_region_add(region, 0, 0, 16, 16);
+
+	parent = client->surface->wl_surface;
+	for (i = 0; i < DEEP_TREE_DEPTH; i++) {
+		surf[i] = wl_compositor_create_surface(client->wl_compositor);
+		wl_surface_set_user_data(surf[i], &marker[i]);
+		sub[i] = wl_subcompositor_get_subsurface(subco, surf[i], parent);
+		wl_subsurface_set_position(sub[i], 1, 1);
+		wl_surface_set_opaque_region(surf[i], region);
+		wl_surface_set_input_region(surf[i], region);
+		parent = surf[i];
+	}
+	wl_region_destroy(region);
+
+	client_roundtrip(client);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (frame = 0; frame < DEEP_TREE_FRAMES; frame++) {
+		for (i = DEEP_TREE_DEPTH - 1; i >= 0; i--) {
+			wl_surface_attach(surf[i], buf->proxy, 0, 0);
+			wl_surface_damage_buffer(surf[i], frame % 16, 0, 1, 16);
+			wl_surface_commit(surf[i]);
+		}
+		wl_surface_damage(client->surface->wl_surface, 0, 0, 1, 1);
+		wl_surface_commit(client->surface->wl_surface);
+	}
+	client_roundtrip(client);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	testlog("%d frames of a %d deep synchronized sub-surface tree: "
+		"%.3f ms per frame\n", DEEP_TREE_FRAMES, DEEP_TREE_DEPTH,
+		timespec_sub_to_nsec(&end, &begin) / 1e6 / DEEP_TREE_FRAMES);
+
+	/*
+	 * Sub-surface i sits at (i + 1, i + 1) from the root, so the last one
+	 * covers root-local (16, 16) to (32, 32), on top of all the others.
+	 */
+	deep_tree_move_pointer(client, 100 + 20, 50 + 20);
+	assert(pointer->focus == &marker[DEEP_TREE_DEPTH - 1]);
+	assert(pointer->x == 20 - DEEP_TREE_DEPTH);
+	assert(pointer->y == 20 - DEEP_TREE_DEPTH);
+
+	/* an empty input region lets the pointer through to its parent */
+	region = wl_compositor_create_region(client->wl_compositor);
+	wl_surface_set_input_region(surf[DEEP_TREE_DEPTH - 1], region);
+	wl_region_destroy(region);
+	wl_surface_commit(surf[DEEP_TREE_DEPTH - 1]);
+	for (i = DEEP_TREE_DEPTH - 2; i >= 0; i--)
+		wl_surface_commit(surf[i]);
+	wl_surface_commit(client->surface->wl_surface);
+	client_roundtrip(client);
+
+	deep_tree_move_pointer(client, 100 + 21, 50 + 21);
+	assert(pointer->focus == &marker[DEEP_TREE_DEPTH - 2]);
+	assert(pointer->x == 21 - (DEEP_TREE_DEPTH - 1));
+	assert(pointer->y == 21 - (DEEP_TREE_DEPTH - 1));
+
+	for (i = DEEP_TREE_DEPTH - 1; i >= 0; i--) {
+		wl_subsurface_destroy(sub[i]);
+		wl_surface_destroy(surf[i]);
+	}
+	buffer_destroy(buf);
+	wl_subcompositor_destroy(subco);
+	client_destroy(client);
+}
@@ -26,6 +26,7 @@
 #include "config.h"
 
 #include <assert.h>
+#include <math.h>
 #include <string.h>
 
 #include "weston-test-runner.h"
@@ -221,3 +222,139 @@ TEST(float_difference_same)
 	assert(float_difference(1.0f, 1.0f) == 0.0f);
 }
 
+static float
+polygon_area(const float *x, const float *y, int n, int stride)
+{
+	float area = 0.0f;
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		j = (i + 1) % n;
+		area += x[i * stride] * y[j * stride] -
+			x[j * stride] * y[i * stride];
+	}
+
+	return fabsf(area) * 0.5f;
+}
+
+static void
+rotated_quad(struct clip_quad *quad, float cx, float cy, float w, float h,
+	     float phi)
+{
+	const float sx[4] = { -w, w, w, -w };
+	const float sy[4] = { -h, -h, h, h };
+	float s = sinf(phi), c = cosf(phi);
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		quad->x[i] = cx + c * sx[i] + s * sy[i];
+		quad->y[i] = cy - s * sx[i] + c * sy[i];
+	}
+	clip_quad_init(quad);
+}
+
+TEST(clip_quads_batch_axis_aligned)
+{
+	const pixman_box32_t box = {
+		BOUNDING_BOX_LEFT_X, BOUNDING_BOX_BOTTOM_Y,
+		BOUNDING_BOX_RIGHT_X, BOUNDING_BOX_TOP_Y
+	};
+	struct clip_context ctx;
+	struct polygon8 polygon;
+	struct clip_quad quads[5];
+	float vertices[5 * 4 * 2];
+	float ex[8], ey[8];
+	unsigned int vtxcnt[5];
+	int i, k, n;
+
+	/* the first five test_data entries are axis aligned */
+	for (i = 0; i < 5; i++) {
+		memcpy(quads[i].x, test_data[i].surface.x, sizeof quads[i].x);
+		memcpy(quads[i].y, test_data[i].surface.y, sizeof quads[i].y);
+		clip_quad_init(&quads[i]);
+	}
+
+	n = clip_quads_batch(&box, 1, quads, 5, true, vertices, 2, vtxcnt);
+	assert(n == 5);
+
+	for (i = 0; i < 5; i++) {
+		assert(vtxcnt[i] == 4);
+		deep_copy_polygon8(&test_data[i].surface, &polygon);
+		populate_clip_context(&ctx);
+		clip_simple(&ctx, &polygon, ex, ey);
+		for (k = 0; k < 4; k++) {
+			assert(vertices[(i * 4 + k) * 2] == ex[k]);
+			assert(vertices[(i * 4 + k) * 2 + 1] == ey[k]);
+		}
+	}
+}
+
+TEST(clip_quads_batch_box_inside_quad)
+{
+	const pixman_box32_t box = { 10, 20, 30, 40 };
+	struct clip_quad quad;
+	float vertices[8 * 2];
+	unsigned int vtxcnt[1];
+	int n;
+
+	rotated_quad(&quad, 20.0f, 30.0f, 100.0f, 100.0f, 0.3f);
+
+	n = clip_quads_batch(&box, 1, &quad, 1, false, vertices, 2, vtxcnt);
+	assert(n == 1);
+	assert(vtxcnt[0] == 4);
+	assert(vertices[0] == 10.0f && vertices[1] == 20.0f);
+	assert(vertices[2] == 30.0f && vertices[3] == 20.0f);
+	assert(vertices[4] == 30.0f && vertices[5] == 40.0f);
+	assert(vertices[6] == 10.0f && vertices[7] == 40.0f);
+}
+
+TEST(clip_quads_batch_matches_clip_transformed)
+{
+	pixman_box32_t boxes[16];
+	struct clip_quad quads[12];
+	struct clip_context ctx;
+	struct polygon8 polygon;
+	float vertices[16 * 12 * 8 * 4];
+	unsigned int vtxcnt[16 * 12];
+	float ex[8], ey[8];
+	float *v = vertices;
+	int i, j, n, m, p = 0;
+
+	for (i = 0; i < 16; i++) {
+		boxes[i].x1 = (i % 4) * 25;
+		boxes[i].y1 = (i / 4) * 25;
+		boxes[i].x2 = boxes[i].x1 + 25;
+		boxes[i].y2 = boxes[i].y1 + 25;
+	}
+
+	for (j = 0; j < 12; j++)
+		rotated_quad(&quads[j], 7.0f + j * 8.0f, 90.0f - j * 7.0f,
+			     4.0f + j * 3.0f, 30.0f - j * 2.0f,
+			     j * 0.55f);
+
+	/* stride 4 like gl-renderer, leaving room for texcoords */
+	n = clip_quads_batch(boxes, 16, quads, 12, false, vertices, 4, vtxcnt);
+
+	for (i = 0; i < 16; i++) {
+		for (j = 0; j < 12; j++) {
+			ctx.clip.x1 = boxes[i].x1;
+			ctx.clip.y1 = boxes[i].y1;
+			ctx.clip.x2 = boxes[i].x2;
+			ctx.clip.y2 = boxes[i].y2;
+			memcpy(polygon.x, quads[j].x, sizeof quads[j].x);
+			memcpy(polygon.y, quads[j].y, sizeof quads[j].y);
+			polygon.n = 4;
+			m = clip_transformed(&ctx, &polygon, ex, ey);
+			if (m < 3)
+				continue;
+
+			assert(p < n);
+			assert(fabsf(polygon_area(v, v + 1, vtxcnt[p], 4) -
+				     polygon_area(ex, ey, m, 1)) < 1e-2f);
+			v += vtxcnt[p] * 4;
+			p++;
+		}
+	}
+
+	assert(p == n);
+}
@@ -35,30 +35,47 @@
 #include <errno.h>
 #include <unistd.h>
 #include <signal.h>
+#include <inttypes.h>
+#include <time.h>
 
 #include "xwayland.h"
 #include <libweston/xwayland-api.h>
 #include "shared/helpers.h"
 #include "shared/string-helpers.h"
+#include "shared/timespec-util.h"
 
 static int
-weston_xserver_handle_event(int listen_fd, uint32_t mask, void *data)
+weston_xserver_spawn(struct weston_xserver *wxs)
 {
-	struct weston_xserver *wxs = data;
 	char display[8];
 
+	if (wxs->pid != 0)
+		return 0;
+
 	snprintf(display, sizeof display, ":%d", wxs->display);
 
+	clock_gettime(CLOCK_MONOTONIC, &wxs->spawn_time);
 	wxs->pid = wxs->spawn_func(wxs->user_data, display, wxs->abstract_fd, wxs->unix_fd);
 	if (wxs->pid == -1) {
 		weston_log("Failed to spawn the Xwayland server\n");
-		return 1;
+		wxs->pid = 0;
+		return -1;
 	}
 
 	weston_log("Spawned Xwayland server, pid %d\n", wxs->pid);
 	wl_event_source_remove(wxs->abstract_source);
 	wl_event_source_remove(wxs->unix_source);
 
+	return 0;
+}
+
+static int
+weston_xserver_handle_event(int listen_fd, uint32_t mask, void *data)
+{
+	struct weston_xserver *wxs = data;
+
+	weston_xserver_spawn(wxs);
+
 	return 1;
 }
 
@@ -309,8 +326,28 @@ weston_xwayland_xserver_loaded(struct weston_xwayland *xwayland,
 			       struct wl_client *client, int wm_fd)
 {
 	struct weston_xserver *wxs = (struct weston_xserver *)xwayland;
+	struct timespec ready, created;
+
+	clock_gettime(CLOCK_MONOTONIC, &ready);
 	wxs->wm = weston_wm_create(wxs, wm_fd);
 	wxs->client = client;
+	clock_gettime(CLOCK_MONOTONIC, &created);
+
+	weston_log("Xwayland ready %" PRId64 " ms after spawn, "
+		   "WM created in %" PRId64 " ms\n",
+		   timespec_sub_to_msec(&ready, &wxs->spawn_time),
+		   timespec_sub_to_msec(&created, &ready));
+}
+
+static int
+weston_xwayland_spawn(struct weston_xwayland *xwayland)
+{
+	struct weston_xserver *wxs = (struct weston_xserver *)xwayland;
+
+	if (!wxs->loop)
+		return -1;
+
+	return weston_xserver_spawn(wxs);
 }
 
 static void
@@ -349,6 +386,7 @@ const struct weston_xwayland_api api = {
 	weston_xwayland_listen,
 	weston_xwayland_xserver_loaded,
 	weston_xwayland_xserver_exited,
+	weston_xwayland_spawn,
 };
 extern const struct weston_xwayland_surface_api surface_api;
 
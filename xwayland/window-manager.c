@@ -48,6 +48,7 @@
 #include "shared/cairo-util.h"
 #include "hash.h"
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 
 struct wm_size_hints {
 	uint32_t flags;
@@ -652,11 +653,22 @@ weston_wm_window_read_properties(struct weston_wm_window *window)
 #undef TYPE_NET_WM_STATE
 #undef TYPE_WM_NORMAL_HINTS
 
+/* The theme takes a while to render, it gets created from the setup timer
+ * after the WM is up, or here when a window needs it before that. */
+static struct theme *
+weston_wm_get_theme(struct weston_wm *wm)
+{
+	if (!wm->theme)
+		wm->theme = theme_create();
+
+	return wm->theme;
+}
+
 static void
 weston_wm_window_get_frame_size(struct weston_wm_window *window,
 				int *width, int *height)
 {
-	struct theme *t = window->wm->theme;
+	struct theme *t = weston_wm_get_theme(window->wm);
 
 	if (window->fullscreen) {
 		*width = window->width;
@@ -674,7 +686,7 @@ static void
 weston_wm_window_get_child_position(struct weston_wm_window *window,
 				    int *x, int *y)
 {
-	struct theme *t = window->wm->theme;
+	struct theme *t = weston_wm_get_theme(window->wm);
 
 	if (window->fullscreen) {
 		*x = 0;
@@ -1079,7 +1091,7 @@ weston_wm_window_create_frame(struct weston_wm_window *window)
 	if (window->decorate & MWM_DECOR_MAXIMIZE)
 		buttons |= FRAME_BUTTON_MAXIMIZE;
 
-	window->frame = frame_create(window->wm->theme,
+	window->frame = frame_create(weston_wm_get_theme(window->wm),
 				     window->width, window->height,
 				     buttons, window->name, NULL);
 
@@ -1305,7 +1317,7 @@ weston_wm_window_draw_decoration(struct weston_wm_window *window)
 		cairo_set_source_rgba(cr, 0, 0, 0, 0);
 		cairo_paint(cr);
 
-		render_shadow(cr, window->wm->theme->shadow,
+		render_shadow(cr, weston_wm_get_theme(window->wm)->shadow,
 			      2, 2, width + 8, height + 8, 64, 64);
 	}
 
@@ -1331,17 +1343,17 @@ weston_wm_window_set_pending_state(struct weston_wm_window *window)
 	weston_wm_window_get_frame_size(window, &width, &height);
 	weston_wm_window_get_child_position(window, &x, &y);
 
-	pixman_region32_fini(&window->surface->pending.opaque);
 	if (window->has_alpha) {
-		pixman_region32_init(&window->surface->pending.opaque);
+		weston_surface_set_pending_opaque_rect(window->surface,
+						       0, 0, 0, 0);
 	} else {
 		/* We leave an extra pixel around the X window area to
 		 * make sure we don't sample from the undefined alpha
 		 * channel when filtering. */
-		pixman_region32_init_rect(&window->surface->pending.opaque,
-					  x - 1, y - 1,
-					  window->width + 2,
-					  window->height + 2);
+		weston_surface_set_pending_opaque_rect(window->surface,
+						       x - 1, y - 1,
+						       window->width + 2,
+						       window->height + 2);
 	}
 
 	if (window->decorate && !window->fullscreen) {
@@ -1357,9 +1369,9 @@ weston_wm_window_set_pending_state(struct weston_wm_window *window)
 	wm_printf(window->wm, "XWM: win %d geometry: %d,%d %dx%d\n",
 		  window->id, input_x, input_y, input_w, input_h);
 
-	pixman_region32_fini(&window->surface->pending.input);
-	pixman_region32_init_rect(&window->surface->pending.input,
-				  input_x, input_y, input_w, input_h);
+	weston_surface_set_pending_input_rect(window->surface,
+					      input_x, input_y,
+					      input_w, input_h);
 
 	xwayland_interface->set_window_geometry(window->shsurf,
 						input_x, input_y,
@@ -1397,12 +1409,12 @@ weston_wm_window_set_pending_state_OR(struct weston_wm_window *window)
 		return;
 
 	weston_wm_window_get_frame_size(window, &width, &height);
-	pixman_region32_fini(&window->surface->pending.opaque);
 	if (window->has_alpha) {
-		pixman_region32_init(&window->surface->pending.opaque);
+		weston_surface_set_pending_opaque_rect(window->surface,
+						       0, 0, 0, 0);
 	} else {
-		pixman_region32_init_rect(&window->surface->pending.opaque, 0, 0,
-					  width, height);
+		weston_surface_set_pending_opaque_rect(window->surface, 0, 0,
+						       width, height);
 	}
 }
 
@@ -1987,23 +1999,32 @@ static const struct cursor_alternatives cursors[] = {
 
 static void
 weston_wm_create_cursors(struct weston_wm *wm)
+{
+	wm->cursors = calloc(ARRAY_LENGTH(cursors), sizeof(xcb_cursor_t));
+	wm->cursors_loaded = 0;
+	wm->last_cursor = -1;
+}
+
+/* Loading a cursor reads and uploads the theme images, so they get
+ * loaded one per setup timer step, or when first used. */
+static xcb_cursor_t
+weston_wm_get_cursor(struct weston_wm *wm, int cursor)
 {
 	const char *name;
-	int i, count = ARRAY_LENGTH(cursors);
 	size_t j;
 
-	wm->cursors = malloc(count * sizeof(xcb_cursor_t));
-	for (i = 0; i < count; i++) {
-		for (j = 0; j < cursors[i].count; j++) {
-			name = cursors[i].names[j];
-			wm->cursors[i] =
-				xcb_cursor_library_load_cursor(wm, name);
-			if (wm->cursors[i] != (xcb_cursor_t)-1)
-				break;
-		}
+	if (wm->cursors_loaded & (1u << cursor))
+		return wm->cursors[cursor];
+
+	for (j = 0; j < cursors[cursor].count; j++) {
+		name = cursors[cursor].names[j];
+		wm->cursors[cursor] = xcb_cursor_library_load_cursor(wm, name);
+		if (wm->cursors[cursor] != (xcb_cursor_t)-1)
+			break;
 	}
+	wm->cursors_loaded |= 1u << cursor;
 
-	wm->last_cursor = -1;
+	return wm->cursors[cursor];
 }
 
 static void
@@ -2011,8 +2032,11 @@ weston_wm_destroy_cursors(struct weston_wm *wm)
 {
 	uint8_t i;
 
-	for (i = 0; i < ARRAY_LENGTH(cursors); i++)
-		xcb_free_cursor(wm->conn, wm->cursors[i]);
+	for (i = 0; i < ARRAY_LENGTH(cursors); i++) {
+		if ((wm->cursors_loaded & (1u << i)) &&
+		    wm->cursors[i] != (xcb_cursor_t)-1)
+			xcb_free_cursor(wm->conn, wm->cursors[i]);
+	}
 
 	free(wm->cursors);
 }
@@ -2055,7 +2079,7 @@ weston_wm_window_set_cursor(struct weston_wm *wm, xcb_window_t window_id,
 
 	wm->last_cursor = cursor;
 
-	cursor_value_list = wm->cursors[cursor];
+	cursor_value_list = weston_wm_get_cursor(wm, cursor);
 	xcb_change_window_attributes (wm->conn, window_id,
 				      XCB_CW_CURSOR, &cursor_value_list);
 	xcb_flush(wm->conn);
@@ -2566,6 +2590,49 @@ weston_wm_create_wm_window(struct weston_wm *wm)
 				XCB_TIME_CURRENT_TIME);
 }
 
+static int
+weston_wm_deferred_setup(void *data)
+{
+	struct weston_wm *wm = data;
+	struct timespec now;
+	xcb_cursor_t root_cursor;
+	unsigned int i;
+
+	wm->setup_steps++;
+
+	/* The root cursor first, then what new windows need */
+	if (!(wm->cursors_loaded & (1u << XWM_CURSOR_LEFT_PTR))) {
+		root_cursor = weston_wm_get_cursor(wm, XWM_CURSOR_LEFT_PTR);
+		xcb_change_window_attributes(wm->conn, wm->screen->root,
+					     XCB_CW_CURSOR, &root_cursor);
+		xcb_flush(wm->conn);
+	} else if (!wm->theme) {
+		weston_wm_get_theme(wm);
+	} else {
+		for (i = 0; i < ARRAY_LENGTH(cursors); i++) {
+			if (!(wm->cursors_loaded & (1u << i)))
+				break;
+		}
+		if (i == ARRAY_LENGTH(cursors)) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			weston_log("xwm: theme and cursors set up %" PRId64
+				   " ms after the WM, in %u steps\n",
+				   timespec_sub_to_msec(&now, &wm->create_time),
+				   wm->setup_steps - 1);
+			wl_event_source_remove(wm->setup_source);
+			wm->setup_source = NULL;
+			return 0;
+		}
+		weston_wm_get_cursor(wm, i);
+	}
+
+	/* A timer rather than idle, so that clients get served in between:
+	 * idle sources added from idle run in the same dispatch. */
+	wl_event_source_timer_update(wm->setup_source, 1);
+
+	return 0;
+}
+
 struct weston_wm *
 weston_wm_create(struct weston_xserver *wxs, int fd)
 {
@@ -2580,6 +2647,7 @@ weston_wm_create(struct weston_xserver *wxs, int fd)
 		return NULL;
 
 	wm->server = wxs;
+	clock_gettime(CLOCK_MONOTONIC, &wm->create_time);
 	wm->window_hash = hash_table_create();
 	if (wm->window_hash == NULL) {
 		free(wm);
@@ -2619,8 +2687,6 @@ weston_wm_create(struct weston_xserver *wxs, int fd)
 	xcb_composite_redirect_subwindows(wm->conn, wm->screen->root,
 					  XCB_COMPOSITE_REDIRECT_MANUAL);
 
-	wm->theme = theme_create();
-
 	supported[0] = wm->atom.net_wm_moveresize;
 	supported[1] = wm->atom.net_wm_state;
 	supported[2] = wm->atom.net_wm_state_fullscreen;
@@ -2655,7 +2721,10 @@ weston_wm_create(struct weston_xserver *wxs, int fd)
 	wl_list_init(&wm->unpaired_window_list);
 
 	weston_wm_create_cursors(wm);
-	weston_wm_window_set_cursor(wm, wm->screen->root, XWM_CURSOR_LEFT_PTR);
+	wm->setup_source = wl_event_loop_add_timer(loop,
+						   weston_wm_deferred_setup, wm);
+	if (wm->setup_source)
+		wl_event_source_timer_update(wm->setup_source, 1);
 
 	/* Create wm window and take WM_S0 selection last, which
 	 * signals to Xwayland that we're done with setup. */
@@ -2671,8 +2740,11 @@ weston_wm_destroy(struct weston_wm *wm)
 {
 	/* FIXME: Free windows in hash. */
 	hash_table_destroy(wm->window_hash);
+	if (wm->setup_source)
+		wl_event_source_remove(wm->setup_source);
 	weston_wm_destroy_cursors(wm);
-	theme_destroy(wm->theme);
+	if (wm->theme)
+		theme_destroy(wm->theme);
 	xcb_disconnect(wm->conn);
 	wl_event_source_remove(wm->source);
 	wl_list_remove(&wm->selection_listener.link);
@@ -2745,7 +2817,7 @@ send_configure(struct weston_surface *surface, int32_t width, int32_t height)
 	if (!window || !window->wm)
 		return;
 	wm = window->wm;
-	t = wm->theme;
+	t = weston_wm_get_theme(wm);
 
 	if (window->decorate && !window->fullscreen) {
 		hborder = 2 * t->width;
@@ -24,6 +24,7 @@
  */
 
 #include <stdio.h>
+#include <time.h>
 #include <wayland-server.h>
 #include <xcb/xcb.h>
 #include <xcb/xfixes.h>
@@ -52,6 +53,7 @@ struct weston_xserver {
 	struct wl_listener destroy_listener;
 	weston_xwayland_spawn_xserver_func_t spawn_func;
 	void *user_data;
+	struct timespec spawn_time;
 
 	struct weston_log_scope *wm_debug;
 };
@@ -65,9 +67,14 @@ struct weston_wm {
 	struct weston_xserver *server;
 	xcb_window_t wm_window;
 	struct weston_wm_window *focus_window;
-	struct theme *theme;
+	struct theme *theme;		/* NULL until needed or set up */
 	xcb_cursor_t *cursors;
+	uint32_t cursors_loaded;	/* bit per XWM_CURSOR_* */
 	int last_cursor;
+	/* Theme and cursors load step by step after the WM is up */
+	struct wl_event_source *setup_source;
+	struct timespec create_time;
+	unsigned int setup_steps;
 	xcb_render_pictforminfo_t format_rgb, format_rgba;
 	xcb_visualid_t visual_id;
 	xcb_colormap_t colormap;